@@ -0,0 +1,1252 @@
+/***********************************************************************
+ * Program:
+ *    Benchmark
+ * Summary:
+ *    Run every ordered-container backend through the same workloads so
+ *    the right one can be picked for each call site from data. Build with
+ *    optimizations (-DCMAKE_BUILD_TYPE=Release) and pass the number of
+ *    elements (default 100000) and the workload seed (default 42) on the
+ *    command line; the same seed always gives the same keys. Hardware
+ *    counters need perf_event_paranoid <= 2 (or CAP_PERFMON); without
+ *    them only the time column is filled in.
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#include "benchmark.h"
+#include "orderedContainer.h"
+#include "bst.h"
+#include "sortedVector.h"
+#include "bplusTree.h"
+#include "skipList.h"
+#include "fatTree.h"
+#include "yFastTrie.h"
+#include "stringBST.h"
+#include "keyEncoding.h"
+#include "leftRight.h"
+#include "keyRangeLock.h"
+#include "snapshot.h"
+#include "splitBST.h"
+#include "rangeSet.h"
+#include "orderBook.h"
+#include "synthetic.h"
+#include "trace.h"
+#include "workload.h"
+
+#include <algorithm>  // for std::min and std::max
+#include <atomic>     // for std::atomic
+#include <cmath>      // for std::fabs
+#include <cstdio>     // for snprintf and std::remove
+#include <cstdlib>    // for atoi and strtoull
+#include <limits>     // for std::numeric_limits
+#include <list>       // for std::list, the order queues of the plain book
+#include <mutex>      // for std::mutex
+#include <shared_mutex> // for std::shared_timed_mutex, as C++14 has no std::shared_mutex
+#include <string>
+#include <thread>     // for std::thread
+#include <vector>
+
+/**********************************************************************
+ * KEYS
+ * Every key sequence the workloads use, generated once from the seed
+ * so all the backends see exactly the same input
+ ***********************************************************************/
+struct Keys
+{
+   Keys(size_t n, uint64_t seed)
+   {
+      Workload workload(seed);
+      random = workload.shuffled(n);
+      for (int & key : random)
+         key *= 2;
+      lookups = workload.shuffled(n);
+      for (int & key : lookups)
+         key *= 2;
+      reverse    = workload.reverse(n);
+      sawtooth   = workload.sawtooth(n, 64);
+      cascades   = workload.recolorCascades(n);
+      zipfian    = workload.zipfian(n, (int)n);
+      clustered  = workload.clustered(n, (int)n * 2, 16, (int)(n / 64) + 1);
+      mix        = workload.mix(n, (int)n * 2, 0.25, 0.25);
+      deleteHeavy = workload.deleteHeavy(n, (int)n * 2);
+   }
+
+   std::vector<int> random;      // the even numbers below 2n, shuffled
+   std::vector<int> lookups;     // the same keys in a different order
+   std::vector<int> reverse;     // n - 1 down to 0
+   std::vector<int> sawtooth;    // 64 interleaved ascending runs
+   std::vector<int> cascades;    // the inserts that recolor the most
+   std::vector<int> zipfian;     // skewed toward the small keys
+   std::vector<int> clustered;   // bunched around 16 centers
+   std::vector<Workload::Operation> mix;          // half inserts, a quarter each erase and find
+   std::vector<Workload::Operation> deleteHeavy;  // n inserts then mostly erases
+};
+
+/**********************************************************************
+ * RUN INSERTS
+ * Time inserting one key sequence into an empty container
+ ***********************************************************************/
+template <class Container>
+size_t runInserts(const char * name, const char * workload, const std::vector<int> & keys)
+{
+   Container c;
+   BenchmarkRegion region(name, workload, keys.size());
+   for (int key : keys)
+      c.insert(key);
+   return c.size();
+}
+
+/**********************************************************************
+ * RUN OPERATIONS
+ * Time a mix of inserts, erases and finds on an empty container
+ ***********************************************************************/
+template <class Container>
+size_t runOperations(const char * name, const char * workload,
+                     const std::vector<Workload::Operation> & ops)
+{
+   Container c;
+   BenchmarkRegion region(name, workload, ops.size());
+   return Workload::apply(c, ops) + c.size();
+}
+
+/**********************************************************************
+ * RUN WORKLOADS
+ * The same sequence of operations against one backend. The random keys
+ * are the even numbers, so the odd numbers are all misses.
+ ***********************************************************************/
+template <class Container>
+void runWorkloads(const char * name, const Keys & allKeys)
+{
+   static_assert(custom::isOrderedContainer<Container, int>::value,
+                 "backend must provide the ordered-container interface");
+   const std::vector<int> & keys = allKeys.random;
+   size_t n = keys.size();
+   size_t sum = 0;
+   Container c;
+
+   {
+      BenchmarkRegion region(name, "insert random", n);
+      for (int key : keys)
+         c.insert(key);
+   }
+   {
+      BenchmarkRegion region(name, "find hit", n);
+      for (int key : allKeys.lookups)
+         sum += (c.find(key) != c.end());
+   }
+   {
+      BenchmarkRegion region(name, "find zipfian", n);
+      for (int key : allKeys.zipfian)
+         sum += (c.find(key * 2) != c.end());
+   }
+   {
+      BenchmarkRegion region(name, "find clustered", n);
+      for (int key : allKeys.clustered)
+         sum += (c.find(key) != c.end());
+   }
+   {
+      BenchmarkRegion region(name, "find miss", n);
+      for (int key : keys)
+         sum += (c.find(key + 1) != c.end());
+   }
+   {
+      BenchmarkRegion region(name, "lower_bound", n);
+      for (int key : keys)
+      {
+         auto it = c.lower_bound(key + 1);
+         if (it != c.end())
+            sum += *it;
+      }
+   }
+   {
+      BenchmarkRegion region(name, "iterate", n);
+      for (auto it = c.begin(); it != c.end(); ++it)
+         sum += *it;
+   }
+   {
+      BenchmarkRegion region(name, "erase half", n / 2);
+      for (size_t i = 0; i < n / 2; i++)
+      {
+         auto it = c.find(keys[i]);
+         c.erase(it);
+      }
+   }
+
+   Container sequential;
+   {
+      BenchmarkRegion region(name, "insert sequential", n);
+      for (size_t i = 0; i < n; i++)
+         sequential.insert((int)i);
+   }
+
+   sum += runInserts <Container> (name, "insert reverse",  allKeys.reverse);
+   sum += runInserts <Container> (name, "insert sawtooth", allKeys.sawtooth);
+   sum += runInserts <Container> (name, "insert cascades", allKeys.cascades);
+   sum += runOperations <Container> (name, "mix",          allKeys.mix);
+   sum += runOperations <Container> (name, "delete heavy", allKeys.deleteHeavy);
+
+   benchmarkSink(sum + c.size() + sequential.size());
+}
+
+/**********************************************************************
+ * RUN ALLOCATION
+ * Random-key lookups in a BST whose nodes are allocated one at a time
+ * against one whose siblings share a cache-aligned pair
+ ***********************************************************************/
+void runAllocation(const Keys & allKeys)
+{
+   typedef custom::BST<int> BST;
+   const std::vector<int> & keys = allKeys.random;
+   size_t n = keys.size();
+   size_t sum = 0;
+
+   const char * names[] = { "BST", "BST paired" };
+   BST::Allocation modes[] = { BST::INDEPENDENT, BST::PAIRED };
+   for (int i = 0; i < 2; i++)
+   {
+      BST bst;
+      bst.setAllocation(modes[i]);
+      for (int key : keys)
+         bst.insert(key);
+
+      BenchmarkRegion region(names[i], "find random", n);
+      for (int key : allKeys.lookups)
+         sum += (bst.find(key) != bst.end());
+   }
+
+   benchmarkSink(sum);
+}
+
+/**********************************************************************
+ * RUN DESCENT
+ * Root-to-leaf walks on random keys, half of them misses, so which way
+ * each step goes is as hard to predict as it can be
+ ***********************************************************************/
+void runDescent(const Keys & allKeys)
+{
+   const std::vector<int> & keys = allKeys.random;
+   size_t n = keys.size();
+   size_t sum = 0;
+   std::vector<int> probes = Workload(keys.size()).uniform(n, (int)n * 2);
+
+   custom::BST<int> bst;
+   for (int key : keys)
+      bst.insert(key);
+   {
+      BenchmarkRegion region("BST", "find mixed", n);
+      for (int key : probes)
+         sum += (bst.find(key) != bst.end());
+   }
+   {
+      BenchmarkRegion region("BST", "lower_bound mixed", n);
+      for (int key : probes)
+         sum += (bst.lower_bound(key) != bst.end());
+   }
+   {
+      BenchmarkRegion region("BST", "upper_bound mixed", n);
+      for (int key : probes)
+         sum += (bst.upper_bound(key) != bst.end());
+   }
+
+   benchmarkSink(sum);
+}
+
+/**********************************************************************
+ * RUN RELAYOUT
+ * Skewed lookups before and after relayout() packs the top of the tree
+ * and the paths the sampled finds took into one block
+ ***********************************************************************/
+void runRelayout(const Keys & allKeys)
+{
+   const std::vector<int> & keys = allKeys.random;
+   size_t n = keys.size();
+   size_t sum = 0;
+
+   custom::BST<int> bst;
+   for (int key : keys)
+      bst.insert(key);
+   {
+      BenchmarkRegion region("BST", "find zipfian", n);
+      for (int key : allKeys.zipfian)
+         sum += (bst.find(key * 2) != bst.end());
+   }
+
+   // learn where the traffic goes, then stop counting
+   bst.setSampling(16);
+   for (int key : allKeys.zipfian)
+      sum += (bst.find(key * 2) != bst.end());
+   bst.setSampling(0);
+   bst.relayout(8, 4096);
+   {
+      BenchmarkRegion region("BST relayout", "find zipfian", n);
+      for (int key : allKeys.zipfian)
+         sum += (bst.find(key * 2) != bst.end());
+   }
+
+   benchmarkSink(sum);
+}
+
+/**********************************************************************
+ * RUN FREEZE
+ * Scans and lookups over a tree that is all nodes, then over the same
+ * tree with everything below the root frozen into sorted arrays
+ ***********************************************************************/
+void runFreeze(const Keys & allKeys)
+{
+   const std::vector<int> & keys = allKeys.random;
+   size_t n = keys.size();
+   size_t sum = 0;
+
+   custom::BST<int> bst;
+   for (int key : keys)
+      bst.insert(key);
+   for (int frozen = 0; frozen < 2; frozen++)
+   {
+      const char * name = (frozen ? "BST frozen" : "BST");
+      if (frozen)
+         bst.freeze(0);
+      {
+         BenchmarkRegion region(name, "iterate", n);
+         for (auto it = bst.begin(); it != bst.end(); ++it)
+            sum += *it;
+      }
+      {
+         BenchmarkRegion region(name, "find hit", n);
+         for (int key : allKeys.lookups)
+            sum += (bst.find(key) != bst.end());
+      }
+   }
+
+   benchmarkSink(sum);
+}
+
+/**********************************************************************
+ * RUN UPSERT
+ * Count how often each Zipfian key comes up, the way the tree had to
+ * before upsert(): find, then erase and insert the bumped count, or
+ * insert a count of 1. Then the same with upsert().
+ ***********************************************************************/
+struct Tally
+{
+   int key;
+   int count;
+   bool operator <  (const Tally & rhs) const { return key <  rhs.key; }
+   bool operator == (const Tally & rhs) const { return key == rhs.key; }
+};
+
+void runUpsert(const Keys & allKeys)
+{
+   const std::vector<int> & keys = allKeys.zipfian;
+   size_t n = keys.size();
+   size_t sum = 0;
+
+   {
+      custom::BST<Tally> bst;
+      BenchmarkRegion region("BST", "count reinsert", n);
+      for (int key : keys)
+      {
+         auto it = bst.find(Tally{ key, 0 });
+         int count = 1;
+         if (it != bst.end())
+         {
+            count += (*it).count;
+            bst.erase(it);
+         }
+         bst.insert(Tally{ key, count });
+      }
+      sum += bst.size();
+   }
+   {
+      custom::BST<Tally> bst;
+      BenchmarkRegion region("BST", "count upsert", n);
+      for (int key : keys)
+         bst.upsert(Tally{ key, 0 },
+            [](const Tally & tally) { return Tally{ tally.key, 1 }; },
+            [](Tally & tally) { tally.count++; });
+      sum += bst.size();
+   }
+
+   benchmarkSink(sum);
+}
+
+/**********************************************************************
+ * RUN SNAPSHOT
+ * Rebuild a tree by inserting its keys one at a time against loading
+ * a snapshot of it on 1, 2, 4 and 8 threads, then the time to save
+ ***********************************************************************/
+void runSnapshot(const Keys & allKeys)
+{
+   const std::vector<int> & keys = allKeys.random;
+   const char * path = "benchmark.snap";
+   size_t n = keys.size();
+   size_t sum = 0;
+
+   custom::BST<int> bst;
+   for (int key : keys)
+      bst.insert(key);
+   {
+      BenchmarkRegion region("BST", "snapshot save", n);
+      sum += custom::Snapshot<int>::save(bst, path);
+   }
+   {
+      custom::BST<int> rebuilt;
+      BenchmarkRegion region("BST", "insert sorted", n);
+      for (int key : bst)
+         rebuilt.insert(key);
+      sum += rebuilt.size();
+   }
+   for (unsigned int numThreads = 1; numThreads <= 8; numThreads *= 2)
+   {
+      char workload[32];
+      snprintf(workload, sizeof(workload), "load %u threads", numThreads);
+      custom::BST<int> loaded;
+      BenchmarkRegion region("BST", workload, n);
+      sum += custom::Snapshot<int>::load(loaded, path, numThreads);
+      sum += loaded.size();
+   }
+   std::remove(path);
+
+   benchmarkSink(sum);
+}
+
+/**********************************************************************
+ * RUN ESTIMATE
+ * Range counts from estimate_count() against walking the range, then
+ * how far off the estimates were as a share of the tree, and the time
+ * to build a histogram
+ ***********************************************************************/
+void runEstimate(const Keys & allKeys)
+{
+   const std::vector<int> & keys = allKeys.random;
+   size_t n = keys.size();
+   size_t sum = 0;
+   const size_t numRanges = 1000;
+   std::vector<int> ends = Workload(n).uniform(numRanges * 2, (int)n * 2);
+   std::vector<size_t> estimates(numRanges);
+   std::vector<size_t> exact(numRanges);
+
+   custom::BST<int> bst;
+   for (int key : keys)
+      bst.insert(key);
+   {
+      BenchmarkRegion region("BST", "estimate_count", numRanges);
+      for (size_t i = 0; i < numRanges; i++)
+         estimates[i] = bst.estimate_count(std::min(ends[2 * i], ends[2 * i + 1]),
+                                           std::max(ends[2 * i], ends[2 * i + 1]));
+   }
+   {
+      BenchmarkRegion region("BST", "exact count", numRanges);
+      for (size_t i = 0; i < numRanges; i++)
+      {
+         auto it = bst.lower_bound(std::min(ends[2 * i], ends[2 * i + 1]));
+         auto itEnd = bst.lower_bound(std::max(ends[2 * i], ends[2 * i + 1]));
+         for (; it != itEnd; ++it)
+            exact[i]++;
+      }
+   }
+   {
+      BenchmarkRegion region("BST", "build_histogram", n);
+      sum += bst.build_histogram(100).size();
+   }
+
+   double totalError = 0.0;
+   double worstError = 0.0;
+   for (size_t i = 0; i < numRanges; i++)
+   {
+      double error = std::fabs((double)estimates[i] - (double)exact[i]) / (double)n;
+      totalError += error;
+      worstError = std::max(worstError, error);
+   }
+   printf("%-14s %-18s %9.2f%% mean %.2f%% worst, of the size\n", "BST", "estimate error",
+          100.0 * totalError / numRanges, 100.0 * worstError);
+
+   benchmarkSink(sum);
+}
+
+/**********************************************************************
+ * MUTEX BST / SHARED MUTEX BST
+ * The two usual ways to share a BST between threads, to hold LeftRight
+ * up against: one lock for everything, or one that readers can share
+ ***********************************************************************/
+class MutexBST
+{
+public:
+   bool contains(int key) const
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      return bst.find(key) != bst.end();
+   }
+   void insert(int key)
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      bst.insert(key);
+   }
+   void erase(int key)
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = bst.find(key);
+      if (it != bst.end())
+         bst.erase(it);
+   }
+private:
+   mutable std::mutex mutex;
+   mutable custom::BST<int> bst;   // find() is not const
+};
+
+class SharedMutexBST
+{
+public:
+   bool contains(int key) const
+   {
+      std::shared_lock<std::shared_timed_mutex> lock(mutex);
+      auto it = bst.lower_bound(key);
+      return it != bst.end() && *it == key;
+   }
+   void insert(int key)
+   {
+      std::lock_guard<std::shared_timed_mutex> lock(mutex);
+      bst.insert(key);
+   }
+   void erase(int key)
+   {
+      std::lock_guard<std::shared_timed_mutex> lock(mutex);
+      auto it = bst.find(key);
+      if (it != bst.end())
+         bst.erase(it);
+   }
+private:
+   mutable std::shared_timed_mutex mutex;
+   custom::BST<int> bst;
+};
+
+/**********************************************************************
+ * RUN READERS
+ * 1, 2, 4 and 8 threads each look up every key while one more thread
+ * keeps inserting and erasing odd keys, which are never looked up
+ ***********************************************************************/
+template <class Shared>
+void runReaders(const char * name, const Keys & allKeys)
+{
+   const std::vector<int> & keys = allKeys.random;
+   size_t n = keys.size();
+   std::atomic<size_t> sum(0);
+
+   Shared tree;
+   for (int key : keys)
+      tree.insert(key);
+   for (size_t numReaders = 1; numReaders <= 8; numReaders *= 2)
+   {
+      char workload[32];
+      snprintf(workload, sizeof(workload), "read %zu threads", numReaders);
+      BenchmarkRegion region(name, workload, n * numReaders);
+      std::atomic<bool> done(false);
+      std::thread writer([&]()
+      {
+         for (size_t i = 0; !done.load(); i = (i + 1) % n)
+         {
+            tree.insert(keys[i] + 1);
+            tree.erase(keys[i] + 1);
+         }
+      });
+      std::vector<std::thread> readers;
+      for (size_t r = 0; r < numReaders; r++)
+         readers.emplace_back([&]()
+         {
+            size_t hits = 0;
+            for (int key : allKeys.lookups)
+               hits += tree.contains(key);
+            sum += hits;
+         });
+      for (std::thread & reader : readers)
+         reader.join();
+      done = true;
+      writer.join();
+   }
+
+   benchmarkSink(sum.load());
+}
+
+/**********************************************************************
+ * RUN WRITERS
+ * 1, 2, 4 and 8 threads insert and then erase the odd keys in their own
+ * band, n of each between them, into a tree already holding the even ones
+ ***********************************************************************/
+template <class Shared>
+void runWriters(const char * name, const Keys & allKeys)
+{
+   std::vector<int> keys = allKeys.random;
+   std::sort(keys.begin(), keys.end());
+   size_t n = keys.size();
+
+   Shared tree;
+   for (int key : allKeys.random)
+      tree.insert(key);
+   for (size_t numWriters = 1; numWriters <= 8; numWriters *= 2)
+   {
+      char workload[32];
+      snprintf(workload, sizeof(workload), "write %zu threads", numWriters);
+      BenchmarkRegion region(name, workload, 2 * n);
+      std::vector<std::thread> writers;
+      for (size_t w = 0; w < numWriters; w++)
+         writers.emplace_back([&tree, &keys, n, numWriters, w]()
+         {
+            size_t first = n * w / numWriters;
+            size_t last = n * (w + 1) / numWriters;
+            for (size_t i = first; i < last; i++)
+               tree.insert(keys[i] + 1);
+            for (size_t i = first; i < last; i++)
+               tree.erase(keys[i] + 1);
+         });
+      for (std::thread & writer : writers)
+         writer.join();
+   }
+}
+
+/**********************************************************************
+ * RUN RESERVE
+ * Random inserts into a BST that allocates each node as it goes against
+ * one that reserved room for all of them up front
+ ***********************************************************************/
+void runReserve(const Keys & allKeys)
+{
+   const std::vector<int> & keys = allKeys.random;
+   size_t n = keys.size();
+   size_t sum = 0;
+
+   for (int reserved = 0; reserved < 2; reserved++)
+   {
+      custom::BST<int> bst;
+      {
+         BenchmarkRegion region(reserved ? "BST reserved" : "BST", "insert random", n);
+         if (reserved)
+            bst.reserve(n);
+         for (int key : keys)
+            bst.insert(key);
+      }
+      {
+         BenchmarkRegion region(reserved ? "BST reserved" : "BST", "find random", n);
+         for (int key : allKeys.lookups)
+            sum += (bst.find(key) != bst.end());
+      }
+   }
+
+   benchmarkSink(sum);
+}
+
+/**********************************************************************
+ * RUN STRINGS
+ * A BST of std::string, each key in its own buffer once it outgrows
+ * the small-string optimization, against a StringBST that keeps every
+ * key's bytes in one arena. The keys share a long common prefix, like
+ * paths or URLs, so comparisons have to look past the first few bytes.
+ ***********************************************************************/
+void runStrings(const Keys & allKeys)
+{
+   size_t n = allKeys.random.size();
+   size_t sum = 0;
+   std::vector<std::string> keys;
+   std::vector<std::string> lookups;
+   keys.reserve(n);
+   lookups.reserve(n);
+   for (int key : allKeys.random)
+      keys.push_back("/srv/data/customers/" + std::to_string(key));
+   for (int key : allKeys.lookups)
+      lookups.push_back("/srv/data/customers/" + std::to_string(key));
+
+   {
+      custom::BST<std::string> bst;
+      {
+         BenchmarkRegion region("BST<string>", "insert strings", n);
+         for (const std::string & key : keys)
+            bst.insert(key);
+      }
+      {
+         BenchmarkRegion region("BST<string>", "find strings", n);
+         for (const std::string & key : lookups)
+            sum += (bst.find(key) != bst.end());
+      }
+   }
+   {
+      custom::StringBST bst;
+      {
+         BenchmarkRegion region("StringBST", "insert strings", n);
+         for (const std::string & key : keys)
+            bst.insert(key);
+      }
+      {
+         BenchmarkRegion region("StringBST", "find strings", n);
+         for (const std::string & key : lookups)
+            sum += (bst.find(key) != bst.end());
+      }
+      bst.compact();
+      {
+         BenchmarkRegion region("StringBST", "find compacted", n);
+         for (const std::string & key : lookups)
+            sum += (bst.find(key) != bst.end());
+      }
+   }
+
+   benchmarkSink(sum);
+}
+
+/**********************************************************************
+ * RUN COMPOSITE
+ * Keys of (tenant, timestamp, id) in a BST ordered a field at a time,
+ * against the same keys encoded by KeyEncoder, held inline in a
+ * BST<EncodedKey> and in a StringBST, both of which compare bytes. Then
+ * every tenant's keys in turn, found from the first key with that
+ * tenant in the first and as a prefix in the others. Keys are encoded
+ * before the timer starts, as they would be stored.
+ ***********************************************************************/
+struct Composite
+{
+   int32_t tenant;
+   int64_t timestamp;
+   uint64_t id;
+   bool operator < (const Composite & rhs) const
+   {
+      if (tenant != rhs.tenant)
+         return tenant < rhs.tenant;
+      if (timestamp != rhs.timestamp)
+         return timestamp < rhs.timestamp;
+      return id < rhs.id;
+   }
+   bool operator == (const Composite & rhs) const
+   {
+      return tenant == rhs.tenant && timestamp == rhs.timestamp && id == rhs.id;
+   }
+};
+
+void runComposite(const Keys & allKeys)
+{
+   const int32_t NUM_TENANTS = 64;
+   size_t n = allKeys.random.size();
+   size_t sum = 0;
+   std::vector<Composite> keys;
+   std::vector<Composite> lookups;
+   std::vector<std::string> encodedKeys;
+   std::vector<std::string> encodedLookups;
+   for (int key : allKeys.random)
+      keys.push_back(Composite{ key % NUM_TENANTS, (int64_t)key * 1000, (uint64_t)key });
+   for (int key : allKeys.lookups)
+      lookups.push_back(Composite{ key % NUM_TENANTS, (int64_t)key * 1000, (uint64_t)key });
+   for (const Composite & key : keys)
+      encodedKeys.push_back(custom::KeyEncoder().int32(key.tenant).int64(key.timestamp).uint64(key.id).str());
+   for (const Composite & key : lookups)
+      encodedLookups.push_back(custom::KeyEncoder().int32(key.tenant).int64(key.timestamp).uint64(key.id).str());
+
+   {
+      custom::BST<Composite> bst;
+      {
+         BenchmarkRegion region("BST<struct>", "insert composite", n);
+         for (const Composite & key : keys)
+            bst.insert(key);
+      }
+      {
+         BenchmarkRegion region("BST<struct>", "find composite", n);
+         for (const Composite & key : lookups)
+            sum += (bst.find(key) != bst.end());
+      }
+      {
+         BenchmarkRegion region("BST<struct>", "scan tenant", n);
+         for (int32_t tenant = 0; tenant < NUM_TENANTS; tenant++)
+            for (auto it = bst.lower_bound(Composite{ tenant, std::numeric_limits<int64_t>::min(), 0 });
+                 it != bst.end() && (*it).tenant == tenant; ++it)
+               sum++;
+      }
+   }
+   {
+      typedef custom::EncodedKey<20> Key;
+      std::vector<Key> fixedKeys;
+      std::vector<Key> fixedLookups;
+      for (const std::string & key : encodedKeys)
+         fixedKeys.push_back(Key(key));
+      for (const std::string & key : encodedLookups)
+         fixedLookups.push_back(Key(key));
+      custom::BST<Key> bst;
+      {
+         BenchmarkRegion region("BST<encoded>", "insert composite", n);
+         for (const Key & key : fixedKeys)
+            bst.insert(key);
+      }
+      {
+         BenchmarkRegion region("BST<encoded>", "find composite", n);
+         for (const Key & key : fixedLookups)
+            sum += (bst.find(key) != bst.end());
+      }
+      {
+         BenchmarkRegion region("BST<encoded>", "scan tenant", n);
+         for (int32_t tenant = 0; tenant < NUM_TENANTS; tenant++)
+         {
+            std::string prefix = custom::KeyEncoder().int32(tenant).str();
+            auto itEnd = bst.lower_bound(Key(custom::KeyEncoder::pastPrefix(prefix)));
+            for (auto it = bst.lower_bound(Key(prefix)); it != itEnd; ++it)
+               sum++;
+         }
+      }
+   }
+   {
+      custom::StringBST bst;
+      {
+         BenchmarkRegion region("StringBST", "insert composite", n);
+         for (const std::string & key : encodedKeys)
+            bst.insert(key);
+      }
+      {
+         BenchmarkRegion region("StringBST", "find composite", n);
+         for (const std::string & key : encodedLookups)
+            sum += (bst.find(key) != bst.end());
+      }
+      {
+         BenchmarkRegion region("StringBST", "scan tenant", n);
+         for (int32_t tenant = 0; tenant < NUM_TENANTS; tenant++)
+         {
+            auto range = bst.prefix_range(custom::KeyEncoder().int32(tenant).str());
+            for (auto it = range.first; it != range.second; ++it)
+               sum++;
+         }
+      }
+   }
+
+   benchmarkSink(sum);
+}
+
+/**********************************************************************
+ * RUN SPLIT
+ * Random inserts and lookups of 256-byte records in a BST that keeps
+ * each record in its node, against a SplitBST whose nodes hold only the
+ * key and a pointer to the record
+ ***********************************************************************/
+struct Record
+{
+   int key;
+   char payload[252];
+   bool operator <  (const Record & rhs) const { return key <  rhs.key; }
+   bool operator == (const Record & rhs) const { return key == rhs.key; }
+};
+
+struct KeyOfRecord
+{
+   int operator () (const Record & record) const { return record.key; }
+};
+
+void runSplit(const Keys & allKeys)
+{
+   const std::vector<int> & keys = allKeys.random;
+   size_t n = keys.size();
+   size_t sum = 0;
+   Record record = {};
+
+   {
+      custom::BST<Record> bst;
+      {
+         BenchmarkRegion region("BST<record>", "insert random", n);
+         for (int key : keys)
+         {
+            record.key = key;
+            bst.insert(record);
+         }
+      }
+      {
+         BenchmarkRegion region("BST<record>", "find random", n);
+         for (int key : allKeys.lookups)
+         {
+            record.key = key;
+            sum += (bst.find(record) != bst.end());
+         }
+      }
+   }
+   {
+      custom::SplitBST<Record, KeyOfRecord> bst;
+      {
+         BenchmarkRegion region("SplitBST", "insert random", n);
+         for (int key : keys)
+         {
+            record.key = key;
+            bst.insert(record);
+         }
+      }
+      {
+         BenchmarkRegion region("SplitBST", "find random", n);
+         for (int key : allKeys.lookups)
+            sum += (bst.find(key) != bst.end());
+      }
+   }
+
+   benchmarkSink(sum);
+}
+
+/**********************************************************************
+ * RUN RANGES
+ * IDs handed out in order with one in 64 given back, kept one per node
+ * in a BST against as intervals in a RangeSet, then looked up
+ ***********************************************************************/
+void runRanges(const Keys & allKeys)
+{
+   size_t n = allKeys.random.size();
+   size_t sum = 0;
+
+   {
+      custom::BST<int> bst;
+      {
+         BenchmarkRegion region("BST", "allocate ids", n);
+         for (int id = 0; id < (int)n; id++)
+            if (id % 64 != 63)
+               bst.insert(id);
+      }
+      {
+         BenchmarkRegion region("BST", "contains id", n);
+         for (int key : allKeys.lookups)
+            sum += (bst.find(key / 2) != bst.end());
+      }
+      printf("%-14s %-18s %10zu nodes\n", "BST", "ids", bst.size());
+   }
+   {
+      custom::RangeSet<int> ranges;
+      {
+         BenchmarkRegion region("RangeSet", "allocate ids", n);
+         for (int id = 0; id < (int)n; id++)
+            if (id % 64 != 63)
+               ranges.insert(id);
+      }
+      {
+         BenchmarkRegion region("RangeSet", "contains id", n);
+         for (int key : allKeys.lookups)
+            sum += ranges.contains(key / 2);
+      }
+      {
+         BenchmarkRegion region("RangeSet", "first gap", n / 64);
+         for (int from = 0; from < (int)n; from += 64)
+            sum += (size_t)ranges.firstGap(1, from);
+      }
+      printf("%-14s %-18s %10zu nodes\n", "RangeSet", "ids", ranges.size());
+   }
+
+   benchmarkSink(sum);
+}
+
+/**********************************************************************
+ * LIST BOOK
+ * An order book the plain way, for runBook to measure OrderBook against:
+ * each side a BST of price levels found by find() from the root, the
+ * best found by begin(), and the orders at a level in a std::list
+ ***********************************************************************/
+class ListBook
+{
+public:
+   typedef custom::OrderBook::Side Side;
+
+   struct Order
+   {
+      uint64_t id;
+      int64_t price;
+      int64_t quantity;
+   };
+
+   struct Level
+   {
+      int64_t key;   // price for asks, -price for bids, as in OrderBook
+      mutable std::list<Order> orders;
+      bool operator <  (const Level & rhs) const { return key <  rhs.key; }
+      bool operator == (const Level & rhs) const { return key == rhs.key; }
+   };
+
+   struct Handle
+   {
+      Side side;
+      int64_t key;
+      std::list<Order>::iterator it;
+   };
+
+   Handle add(Side side, int64_t price, int64_t quantity, uint64_t id)
+   {
+      Level probe{ keyOf(side, price), {} };
+      auto itLevel = sides[side].find(probe);
+      if (itLevel == sides[side].end())
+         itLevel = sides[side].insert(probe).first;
+      std::list<Order> & orders = (*itLevel).orders;
+      orders.push_back(Order{ id, price, quantity });
+      return Handle{ side, probe.key, --orders.end() };
+   }
+
+   void cancel(const Handle & handle)
+   {
+      auto itLevel = sides[handle.side].find(Level{ handle.key, {} });
+      (*itLevel).orders.erase(handle.it);
+      if ((*itLevel).orders.empty())
+         sides[handle.side].erase(itLevel);
+   }
+
+   template <class OnFill>
+   int64_t match(Side side, int64_t limit, int64_t quantity, OnFill onFill)
+   {
+      Side other = (side == custom::OrderBook::BID ? custom::OrderBook::ASK : custom::OrderBook::BID);
+      custom::BST<Level> & bst = sides[other];
+      while (quantity > 0 && !bst.empty())
+      {
+         auto itLevel = bst.begin();
+         std::list<Order> & orders = (*itLevel).orders;
+         int64_t price = orders.front().price;
+         if (side == custom::OrderBook::BID ? limit < price : price < limit)
+            break;
+         while (quantity > 0 && !orders.empty())
+         {
+            Order & maker = orders.front();
+            int64_t filled = std::min(quantity, maker.quantity);
+            onFill(maker, filled);
+            quantity -= filled;
+            if (filled == maker.quantity)
+               orders.pop_front();
+            else
+               maker.quantity -= filled;
+         }
+         if (orders.empty())
+            bst.erase(itLevel);
+      }
+      return quantity;
+   }
+
+private:
+   static int64_t keyOf(Side side, int64_t price)
+   {
+      return side == custom::OrderBook::BID ? -price : price;
+   }
+
+   custom::BST<Level> sides[2];
+};
+
+/**********************************************************************
+ * REPLAY
+ * Play market events into a book, limit orders matching first and
+ * resting what is left, and return the number of fills
+ ***********************************************************************/
+template <class Book>
+size_t replay(Book & book, const std::vector<Workload::MarketEvent> & events)
+{
+   typedef decltype(book.add(custom::OrderBook::BID, 0, 0, 0)) Handle;
+   std::vector<Handle> handles;
+   std::vector<char> isLive;
+   handles.reserve(events.size());
+   isLive.reserve(events.size());
+   size_t numFills = 0;
+   auto onFill = [&](const typename Book::Order & maker, int64_t filled)
+   {
+      numFills++;
+      if (filled == maker.quantity)
+         isLive[maker.id] = 0;
+   };
+
+   for (const Workload::MarketEvent & event : events)
+   {
+      custom::OrderBook::Side side = (event.isBid ? custom::OrderBook::BID : custom::OrderBook::ASK);
+      if (event.type == Workload::MarketEvent::LIMIT)
+      {
+         int64_t left = book.match(side, event.price, event.quantity, onFill);
+         handles.push_back(Handle());
+         isLive.push_back(0);
+         if (left > 0)
+         {
+            handles.back() = book.add(side, event.price, left, handles.size() - 1);
+            isLive.back() = 1;
+         }
+      }
+      else if (event.type == Workload::MarketEvent::CANCEL)
+      {
+         if (isLive[event.order])
+         {
+            book.cancel(handles[event.order]);
+            isLive[event.order] = 0;
+         }
+      }
+      else
+         book.match(side, event.price, event.quantity, onFill);
+   }
+   return numFills;
+}
+
+/**********************************************************************
+ * RUN BOOK
+ * Replay a synthetic market into the plain book and the OrderBook
+ ***********************************************************************/
+void runBook(const Keys & allKeys)
+{
+   size_t n = allKeys.random.size() * 4;
+   Workload workload(allKeys.random.size());
+   std::vector<Workload::MarketEvent> events = workload.marketReplay(n);
+   size_t sum = 0;
+
+   {
+      ListBook book;
+      BenchmarkRegion region("BST+list", "market replay", n);
+      sum += replay(book, events);
+   }
+   {
+      custom::OrderBook book;
+      BenchmarkRegion region("OrderBook", "market replay", n);
+      sum += replay(book, events);
+   }
+
+   benchmarkSink(sum);
+}
+
+/**********************************************************************
+ * RUN UNIVERSE
+ * Predecessor queries over 64-bit keys from a dense universe, 0 up to
+ * 2n, and a sparse one, the same keys multiplied by an odd constant so
+ * they spread over all 64 bits. A comparison tree does not care which;
+ * the y-fast trie's prefixes are shared far less in the sparse one.
+ ***********************************************************************/
+template <class Container>
+void runUniverse(const char * name, const Keys & allKeys)
+{
+   static const uint64_t SPREAD = 0x9E3779B97F4A7C15ull;
+   size_t n = allKeys.random.size();
+   size_t sum = 0;
+
+   const char * workloads[2][2] = { { "insert dense",  "lower_bound dense"  },
+                                    { "insert sparse", "lower_bound sparse" } };
+   for (uint64_t multiplier : { (uint64_t)1, SPREAD })
+   {
+      const char * const * workload = workloads[multiplier == 1 ? 0 : 1];
+      Container c;
+      {
+         BenchmarkRegion region(name, workload[0], n);
+         for (int key : allKeys.random)
+            c.insert((uint64_t)key * multiplier);
+      }
+      {
+         BenchmarkRegion region(name, workload[1], n);
+         for (int key : allKeys.lookups)
+         {
+            auto it = c.lower_bound((uint64_t)(key + 1) * multiplier);
+            if (it != c.end())
+               sum += (size_t)*it;
+         }
+      }
+   }
+
+   benchmarkSink(sum);
+}
+
+/**********************************************************************
+ * RUN SYNTHETIC
+ * The same inserts and lookups over a sweep of synthetic key shapes in
+ * each layout: BST with the key in the node, and FatTree and BPlusTree
+ * with several keys to a node. Bigger keys, dearer comparisons and
+ * dearer copies each favour a different one, and the table shows where.
+ * SplitBST is left out: its nodes hold a projection of the element, and
+ * any projection cheaper than the whole key would skip the costs being
+ * measured. After each shape's regions a line gives the comparisons and
+ * copies per operation the keys counted; trivially copyable keys cannot
+ * count their copies. At most 2^18 keys are used, so 256-byte keys fit
+ * in memory.
+ ***********************************************************************/
+template <class Container, class Key>
+void runShape(const char * name, const char * shape,
+              const std::vector<Key> & keys, const std::vector<int> & order)
+{
+   size_t n = keys.size();
+   size_t sum = 0;
+   char workload[32];
+   Container c;
+
+   Spy::Delta inserts;
+   {
+      snprintf(workload, sizeof(workload), "insert %s", shape);
+      BenchmarkRegion region(name, workload, n);
+      for (const Key & key : keys)
+         c.insert(key);
+   }
+   Spy::Snapshot inserted = inserts.counts();
+
+   Spy::Delta finds;
+   {
+      snprintf(workload, sizeof(workload), "find %s", shape);
+      BenchmarkRegion region(name, workload, n);
+      for (int i : order)
+         sum += c.find(keys[i]) != c.end();
+   }
+   Spy::Snapshot found = finds.counts();
+
+   double perInsert = (double)(inserted[LESSTHAN] + inserted[EQUALS]) / (double)n;
+   double perFind   = (double)(found[LESSTHAN] + found[EQUALS]) / (double)n;
+   double copies    = (double)(inserted[COPY] + inserted[COPY_MOVE] +
+                               inserted[ASSIGN] + inserted[ASSIGN_MOVE]) / (double)n;
+   printf("%-14s %-18s %10.1f cmp/insert %6.1f cmp/find ", name, shape, perInsert, perFind);
+   if (Key::isTrivial)
+      printf("%10s copy/insert\n", "-");
+   else
+      printf("%10.1f copy/insert\n", copies);
+
+   benchmarkSink(sum + c.size());
+}
+
+template <class Key>
+void runShapes(const char * shape, const Keys & allKeys)
+{
+   size_t n = std::min(allKeys.random.size(), (size_t)1 << 18);
+   std::vector<Key> keys(allKeys.random.begin(), allKeys.random.begin() + n);
+   std::vector<int> order = Workload(n).shuffled(n);
+
+   runShape <custom::BST       <Key>> ("BST",       shape, keys, order);
+   runShape <custom::FatTree   <Key>> ("FatTree",   shape, keys, order);
+   runShape <custom::BPlusTree <Key>> ("BPlusTree", shape, keys, order);
+}
+
+void runSynthetic(const Keys & allKeys)
+{
+   using custom::Synthetic;
+   //                    size  compared  compare  copy  move  trivial
+   runShapes <Synthetic<   8,        8,       0,    0,    0,  true >> ("8B",        allKeys);
+   runShapes <Synthetic<  64,        8,       0,    0,    0,  true >> ("64B",       allKeys);
+   runShapes <Synthetic< 256,        8,       0,    0,    0,  true >> ("256B",      allKeys);
+   runShapes <Synthetic<  64,       64,       0,    0,    0,  true >> ("64B cmp64", allKeys);
+   runShapes <Synthetic<   8,        8,      50,    0,    0,  true >> ("8B spin50", allKeys);
+   runShapes <Synthetic<  64,        8,       0,  100,   10,  false>> ("64B copy",  allKeys);
+}
+
+/**********************************************************************
+ * MAIN
+ ***********************************************************************/
+int main(int argc, char ** argv)
+{
+   size_t n = (argc > 1 ? (size_t)atoi(argv[1]) : 100000);
+   uint64_t seed = (argc > 2 ? strtoull(argv[2], nullptr, 10) : 42);
+   Keys keys(n, seed);
+
+   BenchmarkRegion::header();
+   runWorkloads <custom::BST          <int>> ("BST",          keys);
+   runWorkloads <custom::SortedVector <int>> ("SortedVector", keys);
+   runWorkloads <custom::BPlusTree    <int>> ("BPlusTree",    keys);
+   runWorkloads <custom::SkipList     <int>> ("SkipList",     keys);
+   runWorkloads <custom::FatTree      <int>> ("FatTree",      keys);
+   runWorkloads <custom::YFastTrie    <int>> ("YFastTrie",    keys);
+   runAllocation(keys);
+   runDescent(keys);
+   runRelayout(keys);
+   runFreeze(keys);
+   runEstimate(keys);
+   runUpsert(keys);
+   runSnapshot(keys);
+   runReaders <MutexBST>                     ("BST mutex",     keys);
+   runReaders <SharedMutexBST>               ("BST shared",    keys);
+   runReaders <custom::LeftRight <int>>      ("BST leftRight", keys);
+   runWriters <MutexBST>                     ("BST mutex",     keys);
+   runWriters <custom::RangeLockedBST <int>> ("BST rangeLock", keys);
+   runReserve(keys);
+   runStrings(keys);
+   runComposite(keys);
+   runSplit(keys);
+   runRanges(keys);
+   runBook(keys);
+   runUniverse <custom::BST       <uint64_t>> ("BST",       keys);
+   runUniverse <custom::YFastTrie <uint64_t>> ("YFastTrie", keys);
+   runSynthetic(keys);
+
+#ifdef TRACE
+   // each thread's last Trace::CAPACITY events, for a trace viewer
+   custom::Trace::dump("benchmark.json");
+#endif // TRACE
+
+   return 0;
+}
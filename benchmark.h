@@ -0,0 +1,88 @@
+/***********************************************************************
+ * Header:
+ *    BENCHMARK
+ * Summary:
+ *    A small harness for timing a region of code. A BenchmarkRegion
+ *    starts the clock and the hardware counters when it is created and,
+ *    when it goes out of scope, prints one row: backend, workload, then
+ *    nanoseconds, cycles, instructions, L1/LLC/dTLB misses and branch
+ *    misses, each per operation. Counters the machine will not give us
+ *    print as "-", so the numbers degrade to timing-only.
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include "perfCounters.h"
+
+#include <chrono>     // for std::chrono::steady_clock
+#include <cstdio>     // for printf
+#include <cstddef>    // for size_t
+
+/*************************************************************
+ * BENCHMARK SINK
+ * Somewhere to put results so the optimizer cannot drop the work
+ *************************************************************/
+inline void benchmarkSink(size_t value)
+{
+   static volatile size_t sink;
+   sink = sink + value;
+}
+
+/*************************************************************
+ * BENCHMARK REGION
+ * Time and count everything between construction and destruction
+ *************************************************************/
+class BenchmarkRegion
+{
+public:
+   BenchmarkRegion(const char * backend, const char * workload, size_t numOps) :
+      backend(backend), workload(workload), numOps(numOps)
+   {
+      counters().start();
+      start = std::chrono::steady_clock::now();
+   }
+
+   ~BenchmarkRegion()
+   {
+      auto finish = std::chrono::steady_clock::now();
+      counters().stop();
+      double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count();
+      printf("%-14s %-18s %10.1f", backend, workload, perOp((double)ns));
+      for (int i = 0; i < PerfCounters::NUM_COUNTERS; i++)
+         if (counters().isAvailable(i))
+            printf(" %10.2f", perOp((double)counters().get(i)));
+         else
+            printf(" %10s", "-");
+      printf("\n");
+   }
+
+   // print the column headings, noting when there are no hardware counters
+   static void header()
+   {
+      if (!counters().anyAvailable())
+         printf("hardware counters unavailable; reporting time only\n");
+      printf("%-14s %-18s %10s %10s %10s %10s %10s %10s %10s\n",
+             "backend", "workload", "ns/op", "cycles", "instr",
+             "L1-miss", "LLC-miss", "dTLB-miss", "br-miss");
+   }
+
+private:
+   // one set of counters for the whole run
+   static PerfCounters & counters()
+   {
+      static PerfCounters perf;
+      return perf;
+   }
+
+   double perOp(double value) const
+   {
+      return numOps == 0 ? 0.0 : value / (double)numOps;
+   }
+
+   const char * backend;      // which container
+   const char * workload;     // which operation mix
+   size_t numOps;             // operations performed in the region
+   std::chrono::steady_clock::time_point start;
+};
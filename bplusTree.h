@@ -0,0 +1,618 @@
+/***********************************************************************
+ * Header:
+ *    B+ TREE
+ * Summary:
+ *    An ordered container that stores its elements in wide leaves that
+ *    are linked together, with inner nodes holding only separators.
+ *    Each descent step searches one node of many keys instead of
+ *    chasing one pointer per comparison. It satisfies the same interface
+ *    as BST (see orderedContainer.h).
+ *
+ *    Separators are inclusive on both sides: every element in children[i]
+ *    is >= keys[i-1] and <= keys[i]. Leaves that drop below a quarter full
+ *    are merged into their right sibling when it fits, and empty leaves
+ *    are removed.
+ *
+ *    This will contain the class definition of:
+ *        BPlusTree           : A B+ tree behind the BST interface
+ *        BPlusTree::iterator : An iterator through BPlusTree
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include <cstddef>    // for size_t
+#include <utility>    // for std::pair
+
+class TestOrderedContainer;
+
+namespace custom
+{
+
+/*****************************************************************
+ * B+ TREE
+ * A B+ tree that can stand in for a BST
+ *****************************************************************/
+template <typename T>
+class BPlusTree
+{
+   friend class ::TestOrderedContainer;
+
+   class BPNode;
+   class BPLeaf;
+   class BPInner;
+public:
+   // number of elements in a leaf and separators in an inner node
+   static const int LEAF_MAX  = 32;
+   static const int INNER_MAX = 32;
+
+   //
+   // Construct
+   //
+
+   BPlusTree() : root(nullptr), numElements(0) {}
+   BPlusTree(const BPlusTree &  rhs) : root(nullptr), numElements(0) { *this = rhs; }
+   BPlusTree(      BPlusTree && rhs) : root(rhs.root), numElements(rhs.numElements)
+   {
+      rhs.root = nullptr;
+      rhs.numElements = 0;
+   }
+   BPlusTree(const std::initializer_list<T>& il) : root(nullptr), numElements(0)
+   {
+      for (auto& element : il)
+         insert(element);
+   }
+   ~BPlusTree() { clear(); }
+
+   //
+   // Assign
+   //
+
+   BPlusTree & operator = (const BPlusTree & rhs);
+   BPlusTree & operator = (BPlusTree && rhs)
+   {
+      clear();
+      swap(rhs);
+      return *this;
+   }
+   void swap(BPlusTree & rhs)
+   {
+      std::swap(root, rhs.root);
+      std::swap(numElements, rhs.numElements);
+   }
+
+   //
+   // Iterator
+   //
+
+   class iterator;
+   iterator begin() const noexcept;
+   iterator end()   const noexcept { return iterator(); }
+
+   //
+   // Access
+   //
+
+   iterator find(const T& t);
+   iterator lower_bound(const T& t);
+   iterator upper_bound(const T& t);
+
+   //
+   // Insert
+   //
+
+   std::pair<iterator, bool> insert(const T&  t, bool keepUnique = false);
+   std::pair<iterator, bool> insert(      T&& t, bool keepUnique = false);
+
+   //
+   // Remove
+   //
+
+   iterator erase(iterator& it);
+   void clear() noexcept
+   {
+      clearNode(root);
+      root = nullptr;
+      numElements = 0;
+   }
+
+   //
+   // Status
+   //
+
+   bool   empty() const noexcept { return numElements == 0; }
+   size_t size()  const noexcept { return numElements;      }
+
+private:
+   template <typename U>
+   std::pair<iterator, bool> insertValue(U&& t, bool keepUnique);
+   BPLeaf * findLeaf(const T & t, bool upper) const;
+   void insertIntoParent(BPNode * pLeft, const T & separator, BPNode * pRight);
+   void removeChild(BPInner * pParent, BPNode * pChild);
+   void deleteNode(BPNode * pNode);
+   void clearNode(BPNode * pNode);
+
+   BPNode * root;              // root node of the B+ tree
+   size_t numElements;         // number of elements currently in the tree
+};
+
+/*****************************************************************
+ * B+ TREE NODE
+ * The part common to leaves and inner nodes
+ *****************************************************************/
+template <typename T>
+class BPlusTree <T> :: BPNode
+{
+public:
+   BPNode(bool isLeaf) : isLeaf(isLeaf), numKeys(0), pParent(nullptr) {}
+
+   bool isLeaf;             // leaf or inner node?
+   int numKeys;             // elements in a leaf, separators in an inner node
+   BPInner * pParent;       // Parent
+};
+
+/*****************************************************************
+ * B+ TREE LEAF
+ * Holds the elements themselves, linked to its neighbors
+ *****************************************************************/
+template <typename T>
+class BPlusTree <T> :: BPLeaf : public BPNode
+{
+public:
+   BPLeaf() : BPNode(true), pNext(nullptr), pPrev(nullptr) {}
+
+   T keys[LEAF_MAX];        // the elements, in sorted order
+   BPLeaf * pNext;          // next leaf - larger
+   BPLeaf * pPrev;          // previous leaf - smaller
+};
+
+/*****************************************************************
+ * B+ TREE INNER NODE
+ * Holds numKeys separators and numKeys + 1 children
+ *****************************************************************/
+template <typename T>
+class BPlusTree <T> :: BPInner : public BPNode
+{
+public:
+   BPInner() : BPNode(false) {}
+
+   // which slot in children[] holds pChild?
+   int indexOf(const BPNode * pChild) const
+   {
+      int i = 0;
+      while (children[i] != pChild)
+         i++;
+      return i;
+   }
+
+   T keys[INNER_MAX];                // separators
+   BPNode * children[INNER_MAX + 1]; // subtrees
+};
+
+/**********************************************************
+ * B+ TREE ITERATOR
+ * Forward and reverse iterator through a B+ tree
+ *********************************************************/
+template <typename T>
+class BPlusTree <T> :: iterator
+{
+   friend class BPlusTree <T>;
+   friend class ::TestOrderedContainer;
+public:
+   iterator() : pLeaf(nullptr), index(0) {}
+   iterator(BPLeaf * pLeaf, int index) : pLeaf(pLeaf), index(index)
+   {
+      // one past the end of a leaf is the start of the next
+      if (this->pLeaf != nullptr && this->index == this->pLeaf->numKeys)
+      {
+         this->pLeaf = this->pLeaf->pNext;
+         this->index = 0;
+      }
+   }
+
+   bool operator == (const iterator & rhs) const
+   {
+      return pLeaf == rhs.pLeaf && index == rhs.index;
+   }
+   bool operator != (const iterator & rhs) const { return !(*this == rhs); }
+
+   // de-reference. Cannot change because it will invalidate the tree
+   const T & operator * () const { return pLeaf->keys[index]; }
+
+   iterator & operator ++ ()
+   {
+      if (pLeaf != nullptr && ++index == pLeaf->numKeys)
+      {
+         pLeaf = pLeaf->pNext;
+         index = 0;
+      }
+      return *this;
+   }
+   iterator & operator -- ()
+   {
+      if (pLeaf == nullptr)
+         return *this;
+      if (index > 0)
+         index--;
+      else
+      {
+         pLeaf = pLeaf->pPrev;
+         index = (pLeaf == nullptr ? 0 : pLeaf->numKeys - 1);
+      }
+      return *this;
+   }
+
+private:
+   BPLeaf * pLeaf;          // the leaf holding the element
+   int index;               // where in the leaf
+};
+
+/*********************************************
+ * B+ TREE :: ASSIGNMENT OPERATOR
+ * Elements arrive in order, so each one lands at the end
+ ********************************************/
+template <typename T>
+BPlusTree <T> & BPlusTree <T> :: operator = (const BPlusTree <T> & rhs)
+{
+   if (this == &rhs)
+      return *this;
+   clear();
+   for (auto it = rhs.begin(); it != rhs.end(); ++it)
+      insert(*it);
+   return *this;
+}
+
+/*********************************************
+ * B+ TREE :: BEGIN
+ * The first element of the left-most leaf
+ ********************************************/
+template <typename T>
+typename BPlusTree <T> :: iterator BPlusTree <T> :: begin() const noexcept
+{
+   if (root == nullptr)
+      return end();
+   BPNode * p = root;
+   while (!p->isLeaf)
+      p = static_cast<BPInner *>(p)->children[0];
+   return iterator(static_cast<BPLeaf *>(p), 0);
+}
+
+/*********************************************
+ * B+ TREE :: FIND LEAF
+ * Descend to the leaf where the first element >= t (or > t when
+ * upper is set) would be found
+ ********************************************/
+template <typename T>
+typename BPlusTree <T> :: BPLeaf * BPlusTree <T> :: findLeaf(const T & t, bool upper) const
+{
+   BPNode * p = root;
+   while (p != nullptr && !p->isLeaf)
+   {
+      BPInner * pInner = static_cast<BPInner *>(p);
+      int i = 0;
+      if (upper)
+         while (i < pInner->numKeys && !(t < pInner->keys[i]))
+            i++;
+      else
+         while (i < pInner->numKeys && pInner->keys[i] < t)
+            i++;
+      p = pInner->children[i];
+   }
+   return static_cast<BPLeaf *>(p);
+}
+
+/*********************************************
+ * B+ TREE :: LOWER BOUND
+ * Return the first element that is not less than t
+ ********************************************/
+template <typename T>
+typename BPlusTree <T> :: iterator BPlusTree <T> :: lower_bound(const T & t)
+{
+   BPLeaf * pLeaf = findLeaf(t, false /*upper*/);
+   if (pLeaf == nullptr)
+      return end();
+   int i = 0;
+   while (i < pLeaf->numKeys && pLeaf->keys[i] < t)
+      i++;
+   return iterator(pLeaf, i);
+}
+
+/*********************************************
+ * B+ TREE :: UPPER BOUND
+ * Return the first element that is greater than t
+ ********************************************/
+template <typename T>
+typename BPlusTree <T> :: iterator BPlusTree <T> :: upper_bound(const T & t)
+{
+   BPLeaf * pLeaf = findLeaf(t, true /*upper*/);
+   if (pLeaf == nullptr)
+      return end();
+   int i = 0;
+   while (i < pLeaf->numKeys && !(t < pLeaf->keys[i]))
+      i++;
+   return iterator(pLeaf, i);
+}
+
+/*********************************************
+ * B+ TREE :: FIND
+ * Return the first element equal to t
+ ********************************************/
+template <typename T>
+typename BPlusTree <T> :: iterator BPlusTree <T> :: find(const T & t)
+{
+   iterator it = lower_bound(t);
+   if (it != end() && !(t < *it))
+      return it;
+   return end();
+}
+
+/*********************************************
+ * B+ TREE :: INSERT
+ * Insert after any equal elements, splitting full nodes on the way out
+ ********************************************/
+template <typename T>
+std::pair<typename BPlusTree <T> :: iterator, bool> BPlusTree <T> :: insert(const T & t, bool keepUnique)
+{
+   return insertValue(t, keepUnique);
+}
+
+template <typename T>
+std::pair<typename BPlusTree <T> :: iterator, bool> BPlusTree <T> :: insert(T && t, bool keepUnique)
+{
+   return insertValue(std::move(t), keepUnique);
+}
+
+template <typename T>
+template <typename U>
+std::pair<typename BPlusTree <T> :: iterator, bool> BPlusTree <T> :: insertValue(U && t, bool keepUnique)
+{
+   if (keepUnique)
+   {
+      iterator it = find(t);
+      if (it != end())
+         return std::pair<iterator, bool>(it, false);
+   }
+
+   // an empty tree is a single leaf
+   if (root == nullptr)
+      root = new BPLeaf;
+
+   BPLeaf * pLeaf = findLeaf(t, true /*upper*/);
+
+   // split a full leaf in half, the right half's first element separates them
+   if (pLeaf->numKeys == LEAF_MAX)
+   {
+      BPLeaf * pRight = new BPLeaf;
+      int half = LEAF_MAX / 2;
+      for (int i = half; i < LEAF_MAX; i++)
+         pRight->keys[i - half] = std::move(pLeaf->keys[i]);
+      pRight->numKeys = LEAF_MAX - half;
+      pLeaf->numKeys = half;
+
+      pRight->pNext = pLeaf->pNext;
+      pRight->pPrev = pLeaf;
+      if (pLeaf->pNext != nullptr)
+         pLeaf->pNext->pPrev = pRight;
+      pLeaf->pNext = pRight;
+
+      insertIntoParent(pLeaf, pRight->keys[0], pRight);
+      if (!(t < pRight->keys[0]))
+         pLeaf = pRight;
+   }
+
+   // shift the larger elements over to make room
+   int i = pLeaf->numKeys;
+   while (i > 0 && t < pLeaf->keys[i - 1])
+   {
+      pLeaf->keys[i] = std::move(pLeaf->keys[i - 1]);
+      i--;
+   }
+   pLeaf->keys[i] = std::forward<U>(t);
+   pLeaf->numKeys++;
+   numElements++;
+   return std::pair<iterator, bool>(iterator(pLeaf, i), true);
+}
+
+/*********************************************
+ * B+ TREE :: INSERT INTO PARENT
+ * Hook a freshly split pRight in next to pLeft, splitting the parent
+ * in turn if it is full
+ ********************************************/
+template <typename T>
+void BPlusTree <T> :: insertIntoParent(BPNode * pLeft, const T & separator, BPNode * pRight)
+{
+   // splitting the root grows the tree by one level
+   if (pLeft->pParent == nullptr)
+   {
+      BPInner * pRoot = new BPInner;
+      pRoot->keys[0] = separator;
+      pRoot->children[0] = pLeft;
+      pRoot->children[1] = pRight;
+      pRoot->numKeys = 1;
+      pLeft->pParent = pRight->pParent = pRoot;
+      root = pRoot;
+      return;
+   }
+
+   BPInner * pParent = pLeft->pParent;
+   int index = pParent->indexOf(pLeft);
+
+   // room in the parent: shift over and drop the new child in
+   if (pParent->numKeys < INNER_MAX)
+   {
+      for (int i = pParent->numKeys; i > index; i--)
+      {
+         pParent->keys[i] = std::move(pParent->keys[i - 1]);
+         pParent->children[i + 1] = pParent->children[i];
+      }
+      pParent->keys[index] = separator;
+      pParent->children[index + 1] = pRight;
+      pParent->numKeys++;
+      pRight->pParent = pParent;
+      return;
+   }
+
+   // the parent is full: lay everything out in order, then split it
+   T keys[INNER_MAX + 1];
+   BPNode * children[INNER_MAX + 2];
+   for (int i = 0; i < INNER_MAX; i++)
+      keys[i] = std::move(pParent->keys[i]);
+   for (int i = 0; i <= INNER_MAX; i++)
+      children[i] = pParent->children[i];
+   for (int i = INNER_MAX; i > index; i--)
+      keys[i] = std::move(keys[i - 1]);
+   for (int i = INNER_MAX + 1; i > index + 1; i--)
+      children[i] = children[i - 1];
+   keys[index] = separator;
+   children[index + 1] = pRight;
+
+   BPInner * pSplit = new BPInner;
+   int half = (INNER_MAX + 1) / 2;
+   pParent->numKeys = half;
+   for (int i = 0; i < half; i++)
+   {
+      pParent->keys[i] = std::move(keys[i]);
+      pParent->children[i] = children[i];
+      children[i]->pParent = pParent;
+   }
+   pParent->children[half] = children[half];
+   children[half]->pParent = pParent;
+
+   pSplit->numKeys = INNER_MAX - half;
+   for (int i = half + 1; i <= INNER_MAX; i++)
+   {
+      pSplit->keys[i - half - 1] = std::move(keys[i]);
+      pSplit->children[i - half - 1] = children[i];
+      children[i]->pParent = pSplit;
+   }
+   pSplit->children[INNER_MAX - half] = children[INNER_MAX + 1];
+   children[INNER_MAX + 1]->pParent = pSplit;
+
+   insertIntoParent(pParent, keys[half], pSplit);
+}
+
+/*********************************************
+ * B+ TREE :: ERASE
+ * Remove the element the iterator refers to, returning the next one
+ ********************************************/
+template <typename T>
+typename BPlusTree <T> :: iterator BPlusTree <T> :: erase(iterator & it)
+{
+   if (it == end())
+      return end();
+
+   BPLeaf * pLeaf = it.pLeaf;
+   int index = it.index;
+   for (int i = index; i < pLeaf->numKeys - 1; i++)
+      pLeaf->keys[i] = std::move(pLeaf->keys[i + 1]);
+   pLeaf->numKeys--;
+   numElements--;
+
+   // fold a sparse leaf into the right sibling under the same parent
+   BPLeaf * pNext = pLeaf->pNext;
+   if (pLeaf->numKeys < LEAF_MAX / 4 && pNext != nullptr &&
+       pNext->pParent == pLeaf->pParent &&
+       pLeaf->numKeys + pNext->numKeys <= LEAF_MAX)
+   {
+      for (int i = 0; i < pNext->numKeys; i++)
+         pLeaf->keys[pLeaf->numKeys + i] = std::move(pNext->keys[i]);
+      pLeaf->numKeys += pNext->numKeys;
+      pLeaf->pNext = pNext->pNext;
+      if (pNext->pNext != nullptr)
+         pNext->pNext->pPrev = pLeaf;
+      removeChild(pLeaf->pParent, pNext);
+   }
+
+   // the element after the erased one slid into its spot
+   if (pLeaf->numKeys > 0)
+      return iterator(pLeaf, index);
+
+   // nothing left in this leaf so unlink it
+   pNext = pLeaf->pNext;
+   if (pLeaf->pPrev != nullptr)
+      pLeaf->pPrev->pNext = pLeaf->pNext;
+   if (pLeaf->pNext != nullptr)
+      pLeaf->pNext->pPrev = pLeaf->pPrev;
+   if (pLeaf->pParent == nullptr)
+   {
+      delete pLeaf;
+      root = nullptr;
+   }
+   else
+      removeChild(pLeaf->pParent, pLeaf);
+   return iterator(pNext, 0);
+}
+
+/*********************************************
+ * B+ TREE :: REMOVE CHILD
+ * Drop a child and one of its separators from an inner node. An inner
+ * node left with one child is replaced by it at the root; with none it
+ * is removed from its own parent.
+ ********************************************/
+template <typename T>
+void BPlusTree <T> :: removeChild(BPInner * pParent, BPNode * pChild)
+{
+   // the separator on the side of the removed child goes with it
+   int index = pParent->indexOf(pChild);
+   for (int i = (index > 0 ? index - 1 : 0); i < pParent->numKeys - 1; i++)
+      pParent->keys[i] = std::move(pParent->keys[i + 1]);
+   for (int i = index; i < pParent->numKeys; i++)
+      pParent->children[i] = pParent->children[i + 1];
+   pParent->numKeys--;
+   deleteNode(pChild);
+
+   // an inner node without children goes too
+   if (pParent->numKeys < 0)
+   {
+      if (pParent->pParent == nullptr)
+      {
+         root = nullptr;
+         delete pParent;
+      }
+      else
+         removeChild(pParent->pParent, pParent);
+   }
+   // a root with a single child is replaced by it
+   else if (pParent->pParent == nullptr && pParent->numKeys == 0)
+   {
+      root = pParent->children[0];
+      root->pParent = nullptr;
+      delete pParent;
+   }
+}
+
+/*********************************************
+ * B+ TREE :: DELETE NODE
+ * Free a single leaf or inner node
+ ********************************************/
+template <typename T>
+void BPlusTree <T> :: deleteNode(BPNode * pNode)
+{
+   if (pNode->isLeaf)
+      delete static_cast<BPLeaf *>(pNode);
+   else
+      delete static_cast<BPInner *>(pNode);
+}
+
+/*********************************************
+ * B+ TREE :: CLEAR NODE
+ * Delete a node and everything below it
+ ********************************************/
+template <typename T>
+void BPlusTree <T> :: clearNode(BPNode * pNode)
+{
+   if (pNode == nullptr)
+      return;
+   if (pNode->isLeaf)
+   {
+      deleteNode(pNode);
+      return;
+   }
+   BPInner * pInner = static_cast<BPInner *>(pNode);
+   for (int i = 0; i <= pInner->numKeys; i++)
+      clearNode(pInner->children[i]);
+   deleteNode(pInner);
+}
+
+} // namespace custom
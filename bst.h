@@ -25,15 +25,27 @@
 #define debug(x)
 #endif // !DEBUG
 
+#include <algorithm>  // for std::sort and std::stable_sort
 #include <cassert>
+#include <cstdint>    // for uintptr_t
+#include <cstdio>     // for std::FILE, where spilled subtrees go
 #include <utility>
 #include <memory>     // for std::allocator
+#include <new>        // for placement new
+#include <type_traits>// for std::aligned_storage
 #include <functional> // for std::less
 #include <utility>    // for std::pair
+#include <vector>     // for std::vector
+
+#include "trace.h"    // for trace(x), which records only with TRACE defined
 
 class TestBST; // forward declaration for unit tests
 class TestSet;
 class TestMap;
+class TestSnapshot;
+class TestOrderBook;
+class TestRangeSet;
+class Workload; // adversarial workloads read the colors
 
 namespace custom
 {
@@ -42,6 +54,16 @@ namespace custom
    class set;
    template <typename KK, typename VV>
    class map;
+   class StringBST;
+   template <typename TT>
+   class RangeLockedBST;
+   template <typename TT>
+   class Snapshot;
+   template <typename TT, typename KK>
+   class SplitBST;
+   template <typename TT>
+   class RangeSet;
+   class OrderBook;
 
 /*****************************************************************
  * BINARY SEARCH TREE
@@ -53,12 +75,32 @@ class BST
    friend class ::TestBST; // give unit tests access to the privates
    friend class ::TestSet;
    friend class ::TestMap;
+   friend class ::TestSnapshot;
+   friend class ::TestOrderBook;
+   friend class ::TestRangeSet;
+   friend class ::Workload;
 
    template <class TT>
    friend class custom::set;
 
    template <class KK, class VV>
    friend class custom::map;
+
+   friend class custom::StringBST;
+
+   template <class TT>
+   friend class custom::RangeLockedBST;
+
+   template <class TT>
+   friend class custom::Snapshot;
+
+   template <class TT, class KK>
+   friend class custom::SplitBST;
+
+   template <class TT>
+   friend class custom::RangeSet;
+
+   friend class custom::OrderBook;
 public:
    //
    // Construct
@@ -87,12 +129,7 @@ public:
    iterator   begin() const noexcept;
    iterator   end()   const noexcept
    {
-      if (root == nullptr)
-         return iterator(nullptr);
-      BNode* p = root;
-      while (p != nullptr)
-         p = p->pRight;
-      return iterator(p);
+      return iterator(nullptr);
    }
 
    //
@@ -100,6 +137,8 @@ public:
    //
 
    iterator find(const T& t);
+   iterator lower_bound(const T& t) const;
+   iterator upper_bound(const T& t) const;
 
    // 
    // Insert
@@ -107,6 +146,8 @@ public:
 
    std::pair<iterator, bool> insert(const T&  t, bool keepUnique = false);
    std::pair<iterator, bool> insert(      T&& t, bool keepUnique = false);
+   template <class Create, class Update>
+   std::pair<iterator, bool> upsert(const T& key, Create create, Update update);
 
    //
    // Remove
@@ -121,15 +162,114 @@ public:
 
    bool   empty() const noexcept { return numElements == 0; }
    size_t size()  const noexcept { return numElements;   }
+
+   //
+   // Allocation
+   //
+
+   enum Allocation { INDEPENDENT,   // every node is its own allocation
+                     PAIRED };      // siblings share one cache-aligned block
+   void setAllocation(Allocation allocation) { this->allocation = allocation; }
+   Allocation getAllocation() const noexcept { return allocation; }
+
+   //
+   // Capacity
+   //
+
+   void   reserve(size_t n);
+   size_t capacity() const noexcept { return numElements + pool.numFree; }
+   void   shrink_to_fit();
+
+   //
+   // Relayout
+   //
+
+   void setSampling(unsigned int period);
+   void relayout(size_t numLevels, size_t maxNodes);
+
+   //
+   // Tiering
+   //
+
+   size_t freeze(unsigned int period);
+   size_t frozenSize() const noexcept;
+
+   //
+   // Spilling
+   //
+
+   void   setMemoryLimit(size_t bytes, const char * path = nullptr);
+   size_t residentSize() const noexcept;
+
+   //
+   // Estimate
+   //
+
+   size_t         estimate_count(const T & lo, const T & hi) const;
+   std::vector<T> build_histogram(size_t buckets) const;
    
 private:
    class BNode;
+   class NodePair;
+   class NodePool;
+   class HotRegion;
+   class Frozen;
+   class Spill;
+
+   static const unsigned char POOLED = 3;  // BNode::slot of a node from reserve()
+   static const unsigned char HOT    = 4;  // BNode::slot of a node placed by relayout()
+
+   iterator findSampled(const T& t);
+   BNode * moveNode(BNode * pOld, void * pTo, unsigned char slot);
+
+   // a child link with this bit set points to a Frozen, not a BNode
+   static const size_t FROZEN = 1;
+   static bool     isFrozen(const BNode * p) { return (reinterpret_cast<size_t>(p) & FROZEN) != 0; }
+   static Frozen * frozenOf(const BNode * p) { return reinterpret_cast<Frozen *>(reinterpret_cast<size_t>(p) & ~FROZEN); }
+   static BNode *  linkTo(Frozen * p)        { return reinterpret_cast<BNode *>(reinterpret_cast<size_t>(p) | FROZEN); }
+   static void     setParent(BNode * pChild, BNode * pParent);
+   static bool     isRedLink(const BNode * p);
+   static void     setRedLink(BNode * p, bool isRed);
+
+   static const size_t MIN_FROZEN = 16;   // smaller cold subtrees stay nodes
+   static const size_t MAX_FROZEN = 4096; // bigger ones are split, to spill and thaw a piece at a time
+
+   bool freezeCold(BNode * pThis, unsigned int period, size_t & count);
+   size_t freezeInto(BNode * pThis, Frozen & frozen);
+   BNode * thaw(BNode * pLink);
+   BNode * thaw(BNode * pLink, size_t index);
+   BNode * thawNode(Frozen & frozen, size_t & iShape, size_t & iValue, size_t index, BNode *& pAt);
+   BNode * thawChildren(BNode * pNode);
+   iterator findIn(BNode * pLink, const T & t);
+   double estimateRank(const T & t) const;
+   void trim();
+   void moveBlocks(BNode * pThis, Spill * pTo);
+
+   template <typename U>
+   std::pair<iterator, bool> insertValue(U&& t, bool keepUnique);
+   template <typename U>
+   BNode * attach(BNode * pParent, bool isRight, U&& t);
+   void detach(BNode * pNode);
+   template <typename U>
+   BNode * allocateNode(BNode * pParent, bool isRight, U&& t);
+   void freeNode(BNode * pNode);
 
    void clearNode(BNode*& pThis);
-   void assign(BNode*& pDest, const BNode* pSrc);
+   void relocate(BNode*& pThis, NodePool& to);
+   void recycle(BNode* pThis, BNode**& ppTail);
+   void assign(BNode*& pDest, const BNode* pSrc, BNode*& pRecycle,
+               BNode* pParent = nullptr, bool isRight = false);
 
    BNode * root;              // root node of the binary search tree
    size_t numElements;        // number of elements currently in the tree
+   Allocation allocation;     // how new nodes are laid out in memory
+   NodePool pool;             // nodes set aside by reserve()
+   HotRegion hot;             // the nodes relayout() packed together
+   unsigned int samplePeriod; // count the path of every this-many finds, 0 for none
+   unsigned int sampleCountdown; // finds left until the next one is counted
+   unsigned int clock;        // inserts and erases so far, for freeze() to age nodes by
+   size_t numFrozen;          // elements in Frozens rather than nodes
+   std::unique_ptr<Spill> pSpill; // where Frozens go under a memory limit, if there is one
 };
 
 
@@ -150,18 +290,27 @@ public:
       pLeft = pRight = nullptr;
       pParent = nullptr;
       isRed = true;
+      slot = 0;
+      heat = 0;
+      written = 0;
    }
    BNode(const T& t) : data(t)
    {
       pLeft = pRight = nullptr;
       pParent = nullptr;
       isRed = true;
+      slot = 0;
+      heat = 0;
+      written = 0;
    }
    BNode(T&& t) : data(std::move(t))
    {
       pLeft = pRight = nullptr;
       pParent = nullptr;
       isRed = true;
+      slot = 0;
+      heat = 0;
+      written = 0;
    }
 
    //
@@ -180,6 +329,22 @@ public:
    bool isRightChild(BNode * pNode) const { return this->data < pNode->data; }
    bool isLeftChild( BNode * pNode) const { return pNode->data < this->data; }
 
+   // the link on the side a descent goes, right for true. Both links
+   // are read and one masked off, since a ?: here compiles to a branch
+   // that a descent mispredicts half the time.
+   BNode * child(bool isRight) const
+   {
+      uintptr_t mask = (uintptr_t)0 - (uintptr_t)isRight;
+      return (BNode *)(((uintptr_t)pLeft & ~mask) | ((uintptr_t)pRight & mask));
+   }
+   void setChild(bool isRight, BNode * pChild)
+   {
+      if (isRight)
+         pRight = pChild;
+      else
+         pLeft = pChild;
+   }
+
    // balance the tree
    void balance();
 
@@ -197,10 +362,384 @@ public:
    // Data
    //
    T data;                  // Actual data stored in the BNode
+   unsigned int written;    // the tree's clock when a write last passed through
    BNode* pLeft;          // Left child - smaller
    BNode* pRight;         // Right child - larger
    BNode* pParent;        // Parent
    bool isRed;              // Red-black balancing stuff
+   unsigned char slot;      // 0 on its own, 1 + which half of a NodePair, POOLED or HOT
+   unsigned int heat;       // sampled finds that passed through, in what was padding
+};
+
+/*****************************************************************
+ * NODE PAIR
+ * Room for two nodes side by side, aligned to a cache line. Because
+ * data comes first in BNode, the comparison data of both halves shares
+ * one 64-byte line whenever sizeof(BNode) + sizeof(T) <= 64, so a
+ * descent step that reads one child has already fetched its sibling.
+ *****************************************************************/
+template <typename T>
+class BST <T> :: NodePair
+{
+public:
+   static const size_t CACHE_LINE = 64;
+
+   // C++14 new only promises fundamental alignment, so align by hand
+   static NodePair * create()
+   {
+      void * pRaw = ::operator new(sizeof(NodePair) + CACHE_LINE);
+      size_t address = (reinterpret_cast<size_t>(pRaw) + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+      NodePair * pPair = new (reinterpret_cast<void *>(address)) NodePair;
+      pPair->pRaw = pRaw;
+      return pPair;
+   }
+   static void destroy(NodePair * pPair)
+   {
+      void * pRaw = pPair->pRaw;
+      pPair->~NodePair();
+      ::operator delete(pRaw);
+   }
+
+   // the pair a paired node lives in
+   static NodePair * of(BNode * pNode)
+   {
+      return reinterpret_cast<NodePair *>(reinterpret_cast<char *>(pNode) -
+                                          (pNode->slot - 1) * sizeof(Slot));
+   }
+
+   void * at(int slot)         { return &slots[slot];              }
+   bool isFree(int slot) const { return (used & (1 << slot)) == 0; }
+
+   typedef typename std::aligned_storage<sizeof(BNode), alignof(BNode)>::type Slot;
+   Slot slots[2];           // left half, right half
+   unsigned char used;      // which halves hold a live node
+   void * pRaw;             // what ::operator new actually returned
+
+private:
+   NodePair() : used(0), pRaw(nullptr) {}
+};
+
+/*****************************************************************
+ * NODE POOL
+ * Nodes set aside by reserve(), carved out of a few large chunks.
+ * A free node holds nothing but a link to the next free node.
+ *****************************************************************/
+template <typename T>
+class BST <T> :: NodePool
+{
+public:
+   typedef typename std::aligned_storage<sizeof(BNode), alignof(BNode)>::type Slot;
+
+   NodePool() : pFree(nullptr), numFree(0), numSlots(0) {}
+   NodePool(const NodePool &) = delete;
+   NodePool & operator = (const NodePool &) = delete;
+   ~NodePool()
+   {
+      for (Slot * pChunk : chunks)
+         ::operator delete(pChunk);
+   }
+
+   // one contiguous chunk of count more free nodes
+   void grow(size_t count)
+   {
+      Slot * pChunk = static_cast<Slot *>(::operator new(count * sizeof(Slot)));
+      chunks.push_back(pChunk);
+      numSlots += count;
+
+      // push from the back so the lowest addresses are handed out first
+      for (size_t i = count; i > 0; i--)
+         give(&pChunk[i - 1]);
+   }
+
+   // a free node's storage, or nullptr when there is none
+   void * take()
+   {
+      if (pFree == nullptr)
+         return nullptr;
+      FreeSlot * pSlot = pFree;
+      pFree = pSlot->pNext;
+      numFree--;
+      return pSlot;
+   }
+
+   // storage for a node that has already been destroyed
+   void give(void * p)
+   {
+      FreeSlot * pSlot = new (p) FreeSlot;
+      pSlot->pNext = pFree;
+      pFree = pSlot;
+      numFree++;
+   }
+
+   void swap(NodePool & rhs)
+   {
+      std::swap(pFree, rhs.pFree);
+      std::swap(numFree, rhs.numFree);
+      std::swap(numSlots, rhs.numSlots);
+      chunks.swap(rhs.chunks);
+   }
+
+   struct FreeSlot
+   {
+      FreeSlot * pNext;
+   };
+
+   std::vector<Slot *> chunks;  // everything we got from ::operator new
+   FreeSlot * pFree;            // the free list
+   size_t numFree;              // nodes on the free list
+   size_t numSlots;             // nodes in all the chunks, free or not
+};
+
+/*****************************************************************
+ * HOT REGION
+ * One cache-aligned block holding the nodes relayout() found to be
+ * visited the most, in level order. An erased hot node leaves a hole,
+ * and the block is released when the last node in it is gone.
+ *****************************************************************/
+template <typename T>
+class BST <T> :: HotRegion
+{
+public:
+   typedef typename NodePool::Slot Slot;
+
+   HotRegion() : pRaw(nullptr), pSlots(nullptr), numSlots(0), numLive(0) {}
+   HotRegion(const HotRegion &) = delete;
+   HotRegion & operator = (const HotRegion &) = delete;
+   ~HotRegion() { release(); }
+
+   // room for count nodes, the first one starting a cache line
+   void create(size_t count)
+   {
+      release();
+      const size_t CACHE_LINE = NodePair::CACHE_LINE;
+      pRaw = ::operator new(count * sizeof(Slot) + CACHE_LINE);
+      size_t address = (reinterpret_cast<size_t>(pRaw) + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+      pSlots = reinterpret_cast<Slot *>(address);
+      numSlots = count;
+   }
+
+   // storage for the node about to go in slot i
+   void * at(size_t i)
+   {
+      numLive++;
+      return &pSlots[i];
+   }
+
+   // a node in the region has been destroyed
+   void leave()
+   {
+      if (--numLive == 0)
+         release();
+   }
+
+   void swap(HotRegion & rhs)
+   {
+      std::swap(pRaw, rhs.pRaw);
+      std::swap(pSlots, rhs.pSlots);
+      std::swap(numSlots, rhs.numSlots);
+      std::swap(numLive, rhs.numLive);
+   }
+
+   void * pRaw;             // what ::operator new actually returned
+   Slot * pSlots;           // the first slot, on a cache line
+   size_t numSlots;         // slots in the block
+   size_t numLive;          // slots holding a node
+
+private:
+   void release()
+   {
+      ::operator delete(pRaw);
+      pRaw = nullptr;
+      pSlots = nullptr;
+      numSlots = 0;
+      numLive = 0;
+   }
+};
+
+/*****************************************************************
+ * FROZEN
+ * A subtree nobody has written to for a while, packed into two arrays:
+ * its elements in order, for searching and scanning, and one byte per
+ * node in prefix order giving its children and color, so thawing puts
+ * back exactly the nodes that were frozen. The parent's link to it
+ * carries the FROZEN bit. Under a memory limit the arrays may be out in
+ * the spill file, leaving a stub that knows where they are and what
+ * its first and last elements are.
+ *****************************************************************/
+template <typename T>
+class BST <T> :: Frozen
+{
+public:
+   enum { HAS_LEFT = 1, HAS_RIGHT = 2, IS_RED = 4 };
+
+   Frozen() : pParent(nullptr), count(0), isRed(false), offset(-1),
+              pSpill(nullptr), pNewer(nullptr), pOlder(nullptr) {}
+   Frozen(const Frozen &) = delete;
+   Frozen & operator = (const Frozen &) = delete;
+   ~Frozen()
+   {
+      if (pSpill != nullptr)
+         pSpill->forget(this);
+   }
+
+   size_t size()     const { return count;                  }
+   bool   isLoaded() const { return values.size() == count; }
+
+   // the block with its arrays in memory, read back from the file if need be
+   Frozen & load()
+   {
+      if (pSpill != nullptr)
+         pSpill->touch(this);
+      return *this;
+   }
+
+   std::vector<T> values;             // the elements in order, or only the first and last while spilled
+   std::vector<unsigned char> shape;  // HAS_LEFT | HAS_RIGHT | IS_RED, in prefix order
+   BNode * pParent;                   // the node whose link this is
+   size_t count;                      // elements, in memory or not
+   bool isRed;                        // color of the top node, which balance() changes without loading
+   long offset;                       // where the arrays are in the spill file, -1 if not written yet
+   Spill * pSpill;                    // the tree's spill file, if it has a memory limit
+   Frozen * pNewer;                   // next more recently used block in memory
+   Frozen * pOlder;                   // next less recently used block in memory
+};
+
+/*****************************************************************
+ * SPILL
+ * The file Frozens are written out to when the tree is over its memory
+ * limit, and the blocks still in memory from most to least recently
+ * used. A block is immutable once frozen, so it is written at most once
+ * and later evictions just drop the arrays. Only trivially copyable
+ * elements can be written as bytes; any other kind stays in memory.
+ *****************************************************************/
+template <typename T>
+class BST <T> :: Spill
+{
+public:
+   static const size_t BYTES = sizeof(T) + 1;  // per element in memory: value and shape
+
+   explicit Spill(const char * path) :
+      pFile(path == nullptr ? std::tmpfile() : std::fopen(path, "w+b")),
+      limit(0), budget(0), lastTrim(0), trimEvery(MIN_FROZEN), numLoaded(0), pNewest(nullptr), pOldest(nullptr) {}
+   Spill(const Spill &) = delete;
+   Spill & operator = (const Spill &) = delete;
+   ~Spill()
+   {
+      if (pFile != nullptr)
+         std::fclose(pFile);
+   }
+
+   // a new block, in memory
+   void add(Frozen * pFrozen)
+   {
+      pFrozen->pSpill = this;
+      pushNewest(pFrozen);
+   }
+
+   // pFrozen is being destroyed
+   void forget(Frozen * pFrozen)
+   {
+      if (pFrozen->isLoaded())
+         unlink(pFrozen);
+   }
+
+   // pFrozen is about to be read: fault it in if it is out in the file
+   // and make it the most recently used
+   void touch(Frozen * pFrozen)
+   {
+      if (pFrozen == pNewest)
+         return;
+      if (pFrozen->isLoaded())
+         unlink(pFrozen);
+      else
+         readBack(pFrozen);
+      pushNewest(pFrozen);
+      evict();
+   }
+
+   // Write out the least recently used blocks until the rest fit in
+   // budget. The newest two stay, so a reference into one of them
+   // survives reading the other.
+   void evict()
+   {
+      Frozen * p = pOldest;
+      while (numLoaded * BYTES > budget && p != nullptr &&
+             p != pNewest && p != pNewest->pOlder)
+      {
+         Frozen * pNext = p->pNewer;
+         if (!writeOut(p))
+            break;
+         p = pNext;
+      }
+   }
+
+   std::FILE * pFile;   // nullptr if it could not be opened, and nothing spills
+   size_t limit;        // bytes the whole tree may use
+   size_t budget;       // of those, what is left for blocks once the nodes are counted
+   unsigned int lastTrim; // the tree's clock when trim() last froze
+   size_t trimEvery;    // writes before trim() may freeze again
+   size_t numLoaded;    // elements in the blocks in memory
+   Frozen * pNewest;    // most recently used block in memory
+   Frozen * pOldest;    // least recently used
+
+private:
+   void pushNewest(Frozen * pFrozen)
+   {
+      pFrozen->pOlder = pNewest;
+      pFrozen->pNewer = nullptr;
+      if (pNewest != nullptr)
+         pNewest->pNewer = pFrozen;
+      else
+         pOldest = pFrozen;
+      pNewest = pFrozen;
+      numLoaded += pFrozen->count;
+   }
+
+   void unlink(Frozen * pFrozen)
+   {
+      (pFrozen->pNewer != nullptr ? pFrozen->pNewer->pOlder : pNewest) = pFrozen->pOlder;
+      (pFrozen->pOlder != nullptr ? pFrozen->pOlder->pNewer : pOldest) = pFrozen->pNewer;
+      pFrozen->pNewer = pFrozen->pOlder = nullptr;
+      numLoaded -= pFrozen->count;
+   }
+
+   // put pFrozen's arrays in the file if they are not there yet, then
+   // let them go, keeping the first and last element as its key range
+   bool writeOut(Frozen * pFrozen)
+   {
+      if (!std::is_trivially_copyable<T>::value || pFile == nullptr)
+         return false;
+      if (pFrozen->offset < 0)
+      {
+         if (std::fseek(pFile, 0, SEEK_END) != 0)
+            return false;
+         long offset = std::ftell(pFile);
+         if (offset < 0 ||
+             std::fwrite(pFrozen->values.data(), sizeof(T), pFrozen->count, pFile) != pFrozen->count ||
+             std::fwrite(pFrozen->shape.data(), 1, pFrozen->count, pFile) != pFrozen->count)
+            return false;
+         pFrozen->offset = offset;
+      }
+      unlink(pFrozen);
+      std::vector<T> range;
+      range.reserve(2);
+      range.push_back(pFrozen->values.front());
+      range.push_back(pFrozen->values.back());
+      pFrozen->values.swap(range);
+      std::vector<unsigned char>().swap(pFrozen->shape);
+      return true;
+   }
+
+   void readBack(Frozen * pFrozen)
+   {
+      pFrozen->values.resize(pFrozen->count);
+      pFrozen->shape.resize(pFrozen->count);
+      bool isRead = std::fseek(pFile, pFrozen->offset, SEEK_SET) == 0 &&
+         std::fread(pFrozen->values.data(), sizeof(T), pFrozen->count, pFile) == pFrozen->count &&
+         std::fread(pFrozen->shape.data(), 1, pFrozen->count, pFile) == pFrozen->count;
+      assert(isRead);
+      (void)isRead;
+   }
 };
 
 /**********************************************************
@@ -218,13 +757,14 @@ class BST <T> :: iterator
    friend class custom::map;
 public:
    // constructors and assignment
-   iterator(BNode * p = nullptr) : pNode(p) {};
+   iterator(BNode * p = nullptr, size_t index = 0) : pNode(p), index(index) {};
 
-   iterator(const iterator & rhs) : pNode(rhs.pNode) {};
+   iterator(const iterator & rhs) : pNode(rhs.pNode), index(rhs.index) {};
 
    iterator & operator = (const iterator & rhs)
    {
       this->pNode = rhs.pNode;
+      this->index = rhs.index;
       return *this;
    }
 
@@ -239,7 +779,7 @@ public:
          return false;
       // If neither are nullptr, compare the data.
       else
-         return pNode->data == rhs.pNode->data;
+         return **this == *rhs;
    }
    bool operator != (const iterator & rhs) const
    {
@@ -251,12 +791,14 @@ public:
          return true;
       // If neither are nullptr, compare the data.
       else
-         return !(pNode->data == rhs.pNode->data);
+         return !(**this == *rhs);
    }
 
    // de-reference. Cannot change because it will invalidate the BST
    const T & operator * () const 
    {
+      if (isFrozen(pNode))
+         return frozenOf(pNode)->load().values[index];
       return pNode->data;
    }
 
@@ -279,6 +821,8 @@ private:
    
     // the node
     BNode * pNode;
+    // which element, when pNode is a link to a Frozen
+    size_t index;
 };
 
 
@@ -299,6 +843,10 @@ BST <T> ::BST()
 {
    numElements = 0;
    root = nullptr;
+   allocation = INDEPENDENT;
+   samplePeriod = sampleCountdown = 0;
+   clock = 0;
+   numFrozen = 0;
 }
 
 /*********************************************
@@ -311,6 +859,13 @@ BST <T> :: BST (const BST<T>& rhs)
    // Copy nodes from rhs to this tree.
    numElements = 0;
    root = nullptr;
+   allocation = rhs.allocation;
+   samplePeriod = sampleCountdown = rhs.samplePeriod;
+   clock = 0;
+   numFrozen = 0;
+   // the copy gets the same limit, spilling to a file of its own
+   if (rhs.pSpill)
+      setMemoryLimit(rhs.pSpill->limit);
    *this = rhs;
 }
 
@@ -321,10 +876,19 @@ BST <T> :: BST (const BST<T>& rhs)
 template <typename T>
 BST <T> :: BST(BST <T> && rhs) : 
 root(std::move(rhs.root)), 
-numElements(std::move(rhs.numElements))
+numElements(std::move(rhs.numElements)),
+allocation(rhs.allocation),
+samplePeriod(rhs.samplePeriod),
+sampleCountdown(rhs.sampleCountdown),
+clock(rhs.clock),
+numFrozen(rhs.numFrozen),
+pSpill(std::move(rhs.pSpill))
 {
    rhs.numElements = 0;
+   rhs.numFrozen = 0;
    rhs.root = nullptr;
+   pool.swap(rhs.pool);
+   hot.swap(rhs.hot);
 }
 
 /*********************************************
@@ -332,7 +896,10 @@ numElements(std::move(rhs.numElements))
  * Create a BST from an initializer list
  ********************************************/
 template <typename T>
-BST <T> :: BST(const std::initializer_list<T>& il) : root(nullptr), numElements(0)
+BST <T> :: BST(const std::initializer_list<T>& il) : root(nullptr), numElements(0),
+                                                    allocation(INDEPENDENT),
+                                                    samplePeriod(0), sampleCountdown(0),
+                                                    clock(0), numFrozen(0)
 {
    // Insert each node from the initializer list.
    for (auto& element : il)
@@ -358,8 +925,31 @@ BST <T> :: ~BST()
 template <typename T>
 BST <T> & BST <T> :: operator = (const BST <T> & rhs)
 {
-   assign(root, rhs.root);
+   if (this == &rhs)
+      return *this;
+
+   // line up every node we have, whatever shape it is in
+   BNode * pRecycle = nullptr;
+   BNode ** ppTail = &pRecycle;
+   recycle(root, ppTail);
+   root = nullptr;
+
+   // build rhs's shape out of them, then free whatever is left over
+   assign(root, rhs.root, pRecycle);
+   while (pRecycle != nullptr)
+   {
+      BNode * pNext = pRecycle->pRight;
+      freeNode(pRecycle);
+      pRecycle = pNext;
+   }
+
    this->numElements = rhs.numElements;
+   this->clock = rhs.clock;   // the stamps came along with the data
+   if (pSpill)
+   {
+      pSpill->lastTrim = clock < MIN_FROZEN ? 0 : clock - (unsigned int)MIN_FROZEN;
+      trim();
+   }
    return *this;
 }
 
@@ -405,6 +995,14 @@ void BST <T> :: swap (BST <T>& rhs)
    size_t tempElements = rhs.numElements;
    rhs.numElements = this->numElements;
    this->numElements = tempElements;
+
+   // reserved and hot nodes go with the tree they are in, the clock
+   // goes with the stamps on them, and the spill file with the Frozens
+   pool.swap(rhs.pool);
+   hot.swap(rhs.hot);
+   std::swap(clock, rhs.clock);
+   std::swap(numFrozen, rhs.numFrozen);
+   std::swap(pSpill, rhs.pSpill);
 }
 
 /*****************************************************
@@ -414,6 +1012,26 @@ void BST <T> :: swap (BST <T>& rhs)
 template <typename T>
 std::pair<typename BST <T> :: iterator, bool> BST <T> :: insert(const T & t, bool keepUnique)
 {
+   return insertValue(t, keepUnique);
+}
+
+template <typename T>
+std::pair<typename BST <T> ::iterator, bool> BST <T> ::insert(T && t, bool keepUnique)
+{
+   return insertValue(std::move(t), keepUnique);
+}
+
+/*****************************************************
+ * BST :: INSERT VALUE
+ * Find the leaf to hang the new node from, then create it there so the
+ * allocator knows who its parent and sibling are
+ ****************************************************/
+template <typename T>
+template <typename U>
+std::pair<typename BST <T> :: iterator, bool> BST <T> :: insertValue(U && t, bool keepUnique)
+{
+   trace(Trace::Scope scope("insert"));
+
    // If keepUnique is true, check if the node already exists.
    // If it does, return the iterator to the node and false.
    if (keepUnique)
@@ -422,125 +1040,114 @@ std::pair<typename BST <T> :: iterator, bool> BST <T> :: insert(const T & t, boo
       if (it != this->end())
          return std::pair<iterator, bool>(it, false);
    }
+   this->clock++;
 
-   // Create a new node with the given data.
-   auto newNode = new BNode(t);
-
-   // If the root is nullptr, set the root to the new node.
+   // If the root is nullptr, the new node is the root.
    if (this->root == nullptr)
    {
-      this->root = newNode;
+      this->root = allocateNode(nullptr, false, std::forward<U>(t));
+      this->root->written = clock;
       this->root->isRed = false;
       this->numElements++;
-      return std::pair<iterator, bool>(newNode, true);
+      return std::pair<iterator, bool>(this->root, true);
    }
 
-   // Set the current node to the root.
+   // Find where to insert the new node: less goes left, otherwise right.
    auto current = this->root;
-   bool found = false;
-
-   // Find where to insert the new node.
-   while (!found)
+   bool isRight = false;
+   while (true)
    {
-      // If the new node is less than the current node, go left.
-      if (current->isLeftChild(newNode))
-      {
-         // If we are not at a leaf, go left.
-         if (current->pLeft != nullptr)
-            current = current->pLeft;
-         // If we are at a leaf, add the new node to the left.
-         else
-         {
-            current->addLeft(newNode);
-            found = true;
-         }
-      }
-      // If the new node is greater than the current node, go right.
-      else
-      {
-         // If we are not at a leaf, go right.
-         if (current->pRight != nullptr)
-            current = current->pRight;
-         // If we are at a leaf, add the new node to the right.
-         else
-         {
-            current->addRight(newNode);
-            found = true;
-         }
-      }
+      current->written = clock;
+      isRight = !(t < current->data);
+      BNode * pNext = current->child(isRight);
+      // If we are at a leaf, this is the spot.
+      if (pNext == nullptr)
+         break;
+      // A frozen subtree in the way goes back to being nodes.
+      if (isFrozen(pNext))
+         pNext = thaw(pNext);
+      current = pNext;
    }
 
-   // Balance the tree.
-   newNode->balance();
-   // Reset the root node.
+   // Create the new node, hook it up and balance the tree.
+   BNode * newNode = attach(current, isRight, std::forward<U>(t));
+   // The fix-up may have cascaded all the way up, so walk to the root.
    auto pTemp = newNode;
    while (pTemp->pParent != nullptr)
       pTemp = pTemp->pParent;
    this->root = pTemp;
    // Increment the number of elements.
    this->numElements++;
+   // Stay under the memory limit. The new node was just written, so
+   // it is not going anywhere.
+   if (pSpill)
+      trim();
    return std::pair<iterator, bool>(newNode, true);
 }
 
+/*****************************************************
+ * BST :: UPSERT
+ * One descent: if an element equivalent to key is there, hand it to
+ * update(T &) to change in place, otherwise hang create(key) where it
+ * belongs. update must not change how the element orders. Equivalent
+ * means neither is less, so == is free to compare the rest. Returns
+ * the element and whether it was created.
+ ****************************************************/
 template <typename T>
-std::pair<typename BST <T> ::iterator, bool> BST <T> ::insert(T && t, bool keepUnique)
+template <class Create, class Update>
+std::pair<typename BST <T> :: iterator, bool> BST <T> :: upsert(const T & key, Create create, Update update)
 {
-   if (keepUnique)
-   {
-      auto it = this->find(t);
-      if (it != this->end())
-         return std::pair<iterator, bool>(it, false);
-   }
+   trace(Trace::Scope scope("upsert"));
+   this->clock++;
 
-   auto newNode = new BNode(std::move(t));
-
-   // If the root is nullptr, set the root to the new node.
    if (this->root == nullptr)
    {
-      this->root = newNode;
+      this->root = allocateNode(nullptr, false, create(key));
+      this->root->written = clock;
       this->root->isRed = false;
       this->numElements++;
-      return std::pair<iterator, bool>(newNode, true);
+      return std::pair<iterator, bool>(this->root, true);
    }
 
-   // Set the current node to the root.
+   // Insert's descent, stopping early on an equivalent element. Frozen
+   // subtrees thaw as for insert, so the update lands in a node rather
+   // than in a block that may already be in the spill file.
    auto current = this->root;
-   bool found = false;
-
-   while (!found)
+   bool isRight = false;
+   while (true)
    {
-      // Find where to insert the new node.
-      if (current->isLeftChild(newNode))
-      {
-         if (current->pLeft != nullptr)
-            current = current->pLeft;
-         else
-         {
-            current->addLeft(newNode);
-            found = true;
-         }
-      }
+      current->written = clock;
+      if (key < current->data)
+         isRight = false;
+      else if (current->data < key)
+         isRight = true;
       else
       {
-         if (current->pRight != nullptr)
-            current = current->pRight;
-         else
-         {
-            current->addRight(newNode);
-            found = true;
-         }
+         // An update changes no links or colors, so there is nothing to
+         // balance. What it passed through was just stamped, so trimming
+         // whatever it thawed leaves it be.
+         update(current->data);
+         if (pSpill)
+            trim();
+         return std::pair<iterator, bool>(current, false);
       }
+      BNode * pNext = current->child(isRight);
+      if (pNext == nullptr)
+         break;
+      if (isFrozen(pNext))
+         pNext = thaw(pNext);
+      current = pNext;
    }
 
-   newNode->balance(); // balance from inserted node
-   if (newNode->pParent == nullptr)
-      this->root = newNode;
-   else if (newNode->pParent->pParent == nullptr)
-      this->root = newNode->pParent;
-
+   BNode * newNode = attach(current, isRight, create(key));
+   auto pTemp = newNode;
+   while (pTemp->pParent != nullptr)
+      pTemp = pTemp->pParent;
+   this->root = pTemp;
    this->numElements++;
-   std::pair<iterator, bool> pairReturn(newNode, true);
-   return pairReturn;
+   if (pSpill)
+      trim();
+   return std::pair<iterator, bool>(newNode, true);
 }
 
 /*************************************************
@@ -550,48 +1157,114 @@ std::pair<typename BST <T> ::iterator, bool> BST <T> ::insert(T && t, bool keepU
 template <typename T>
 typename BST <T> ::iterator BST <T> :: erase(iterator & it)
 {
+   trace(Trace::Scope scope("erase"));
    if (it == end())
       return end();
 
+   // Thaw whatever the erase will touch: the element itself if it is
+   // frozen, its children, and the path to its in-order successor.
+   // Stamp it all as well, for freeze() to know this part of the tree
+   // is live and trim() to leave it be.
+   if (isFrozen(it.pNode))
+      it = iterator(thaw(it.pNode, it.index));
+   thawChildren(it.pNode);
+   this->clock++;
+   for (BNode * p = it.pNode; p != nullptr; p = p->pParent)
+      p->written = clock;
+   for (BNode * pChild : { it.pNode->pLeft, it.pNode->pRight })
+      if (pChild != nullptr)
+         pChild->written = clock;
+   if (it.pNode->pLeft != nullptr && it.pNode->pRight != nullptr)
+   {
+      BNode * pSuccessor = it.pNode->pRight;
+      while (true)
+      {
+         pSuccessor->written = clock;
+         if (isFrozen(pSuccessor->pLeft))
+            thaw(pSuccessor->pLeft);
+         if (pSuccessor->pLeft == nullptr)
+            break;
+         pSuccessor = pSuccessor->pLeft;
+      }
+      thawChildren(pSuccessor);
+      if (pSuccessor->pRight != nullptr)
+         pSuccessor->pRight->written = clock;
+   }
+
+   // The thawing may have put us over the memory limit.
+   if (pSpill)
+      trim();
+
+   // The in-order successor is what we hand back, whichever case we hit.
+   iterator itNext(it.pNode);
+   ++itNext;
+
+   detach(it.pNode);
+   it.pNode = nullptr;
+   this->numElements--;
+   return itNext;
+}
+
+/*****************************************************
+ * BST :: ATTACH
+ * Hang a new node holding t from pParent and balance from it. Only
+ * the nodes balance() recolors or rotates are written: the caller
+ * keeps the root and the count up to date.
+ ****************************************************/
+template <typename T>
+template <typename U>
+typename BST <T> :: BNode * BST <T> :: attach(BNode * pParent, bool isRight, U && t)
+{
+   BNode * newNode = allocateNode(pParent, isRight, std::forward<U>(t));
+   newNode->written = clock;
+   newNode->pParent = pParent;
+   pParent->setChild(isRight, newNode);
+   newNode->balance();
+   return newNode;
+}
+
+/*****************************************************
+ * BST :: DETACH
+ * Unhook a node, put its in-order successor in its place if it has
+ * two children, and free it. Nothing above its parent is written,
+ * and root only when the node is the root. The caller keeps the
+ * count up to date.
+ ****************************************************/
+template <typename T>
+void BST <T> :: detach(BNode * pNode)
+{
    // Case 1: No children
-   if (it.pNode->pLeft == nullptr && it.pNode->pRight == nullptr)
+   if (pNode->pLeft == nullptr && pNode->pRight == nullptr)
    {
-      // Store the parent for return.
-      auto pParent = it.pNode->pParent;
       // If the removed node is the root.
-      if (it.pNode->pParent == nullptr)
+      if (pNode->pParent == nullptr)
          this->root = nullptr;
       // If the removed node is a left child.
-      else if (it.pNode->pParent->pLeft == it.pNode)
-         it.pNode->pParent->pLeft = nullptr;
+      else if (pNode->pParent->pLeft == pNode)
+         pNode->pParent->pLeft = nullptr;
       // If the removed node is a right child.
       else
-         it.pNode->pParent->pRight = nullptr;
-      // Delete the node and decrement the number of elements.
-      delete it.pNode;
-      it.pNode = nullptr;
-      it.pNode = pParent;
-      this->numElements--;
-      // Return the parent.
-      return it;
+         pNode->pParent->pRight = nullptr;
+      // Delete the node.
+      freeNode(pNode);
    }
 
    // Case 2: One child
-   else if ((it.pNode->pLeft == nullptr && it.pNode->pRight != nullptr)
-      || (it.pNode->pLeft != nullptr && it.pNode->pRight == nullptr))
+   else if ((pNode->pLeft == nullptr && pNode->pRight != nullptr)
+      || (pNode->pLeft != nullptr && pNode->pRight == nullptr))
    {
       // If the removed node is the root.
-      if (it.pNode->pParent == nullptr)
+      if (pNode->pParent == nullptr)
       {
          // If left child is present.
-         if (it.pNode->pLeft != nullptr)
+         if (pNode->pLeft != nullptr)
          {
-            this->root = it.pNode->pLeft;
+            this->root = pNode->pLeft;
          }
          // If right child is present.
          else
          {
-            this->root = it.pNode->pRight;
+            this->root = pNode->pRight;
          }
          // Set the child node's parent to
          // nullptr since it will be the new
@@ -599,96 +1272,82 @@ typename BST <T> ::iterator BST <T> :: erase(iterator & it)
          this->root->pParent = nullptr;
       }
       // If the removed node is a left child.
-      else if (it.pNode->pParent->pLeft == it.pNode)
+      else if (pNode->pParent->pLeft == pNode)
       {
          // If the left child is present.
-         if (it.pNode->pLeft != nullptr)
+         if (pNode->pLeft != nullptr)
          {
-            it.pNode->pParent->pLeft = it.pNode->pLeft;
-            it.pNode->pLeft->pParent = it.pNode->pParent;
+            pNode->pParent->pLeft = pNode->pLeft;
+            pNode->pLeft->pParent = pNode->pParent;
          }
          // If the right child is present.
          else
          {
-            it.pNode->pParent->pLeft = it.pNode->pRight;
-            it.pNode->pRight->pParent = it.pNode->pParent;
+            pNode->pParent->pLeft = pNode->pRight;
+            pNode->pRight->pParent = pNode->pParent;
          }
       }
       // If the removed node is right child.
       else
       {
          // If the left node is present.
-         if (it.pNode->pLeft != nullptr)
+         if (pNode->pLeft != nullptr)
          {
-            it.pNode->pParent->pRight = it.pNode->pLeft;
-            it.pNode->pLeft->pParent = it.pNode->pParent;
+            pNode->pParent->pRight = pNode->pLeft;
+            pNode->pLeft->pParent = pNode->pParent;
          }
          // If the right node is present.
          else
          {
-            it.pNode->pParent->pRight = it.pNode->pRight;
-            it.pNode->pRight->pParent = it.pNode->pParent;
+            pNode->pParent->pRight = pNode->pRight;
+            pNode->pRight->pParent = pNode->pParent;
          }
       }
-      delete it.pNode;
-      it.pNode = nullptr;
-      this->numElements--;
-      // Return the first element in the tree.
-      return begin();
+      freeNode(pNode);
    }
 
    // Case 3: Two Children
    else
    {
       // Find in order successor.
-      auto pTemp = it.pNode->pRight;
+      auto pTemp = pNode->pRight;
       // Stop once we find the leftmost node in the right branch.
       while (pTemp->pLeft != nullptr)
       {
          pTemp = pTemp->pLeft;
       }
 
-      // Check if our in-order successor has a right child.
-      if (pTemp->pRight)
+      // If the ios is deeper in the right branch, detach it from its
+      // parent (handing over its right child) and give it our right branch.
+      if (pTemp->pParent != pNode)
       {
-         // If the our ios' parent is not the removed node,
-         // set the right child's parent to ios' parent and
-         // ios' parent's left to ios' right child.
-         if (pTemp->pParent != it.pNode)
-         {
+         pTemp->pParent->pLeft = pTemp->pRight;
+         if (pTemp->pRight)
             pTemp->pRight->pParent = pTemp->pParent;
-            pTemp->pParent->pLeft = pTemp->pRight;
-         }
+         pTemp->pRight = pNode->pRight;
+         pNode->pRight->pParent = pTemp;
       }
 
       // Place the ios in the removed node's spot.
-      pTemp->pParent = it.pNode->pParent;
-      if (it.pNode == it.pNode->pParent->pLeft)   // If removed node is a left child.
-         it.pNode->pParent->pLeft = pTemp;
-      else                                // If removed node is a right child.
-         it.pNode->pParent->pLeft = pTemp;
+      pTemp->pParent = pNode->pParent;
+      if (pNode->pParent == nullptr)             // If removed node is the root.
+         this->root = pTemp;
+      else if (pNode == pNode->pParent->pLeft)   // If removed node is a left child.
+         pNode->pParent->pLeft = pTemp;
+      else                                       // If removed node is a right child.
+         pNode->pParent->pRight = pTemp;
 
       // Set ios' left child.
-      pTemp->pLeft = it.pNode->pLeft;
+      pTemp->pLeft = pNode->pLeft;
       // If left child is not nullptr,
-      // set it.pNode's parent to ios.
-      if (it.pNode->pLeft)
-         it.pNode->pLeft->pParent = pTemp;
+      // set pNode's parent to ios.
+      if (pNode->pLeft)
+         pNode->pLeft->pParent = pTemp;
 
-      // If our right node is not ios,
-      // set ios' right child to right node.
-      if (it.pNode->pRight != pTemp)
-      {
-         pTemp->pRight = it.pNode->pRight;
-         it.pNode->pRight->pParent = pTemp;
-      }
+      // The ios takes over the removed node's color.
+      pTemp->isRed = pNode->isRed;
 
-      delete it.pNode;
-      it.pNode = nullptr;
-      it.pNode = pTemp;
-      this->numElements--;
-      // Return the ios.
-      return it;
+      freeNode(pNode);
    }
 }
 
@@ -703,6 +1362,452 @@ void BST <T> ::clear() noexcept
    numElements = 0;
 }
 
+/*****************************************************
+ * BST :: RESERVE
+ * Set aside room for n elements in one contiguous chunk
+ * so the inserts that fill it never call the allocator
+ ****************************************************/
+template <typename T>
+void BST <T> :: reserve(size_t n)
+{
+   if (n > capacity())
+      pool.grow(n - capacity());
+}
+
+/*****************************************************
+ * BST :: SHRINK TO FIT
+ * Hand back the reserved nodes that are not in use. The
+ * reserved nodes that are move into one chunk of exactly
+ * the right size, so like std::vector this invalidates
+ * iterators.
+ ****************************************************/
+template <typename T>
+void BST <T> :: shrink_to_fit()
+{
+   if (pool.numFree == 0)
+      return;
+
+   NodePool fitted;
+   if (pool.numSlots > pool.numFree)
+      fitted.grow(pool.numSlots - pool.numFree);
+   relocate(root, fitted);
+
+   // the old chunks are released when fitted goes out of scope
+   pool.swap(fitted);
+}
+
+/*****************************************************
+ * BST :: SET SAMPLING
+ * Count the nodes on the path of every period-th find,
+ * for relayout() to decide what is hot. 0 turns it off.
+ ****************************************************/
+template <typename T>
+void BST <T> :: setSampling(unsigned int period)
+{
+   samplePeriod = sampleCountdown = period;
+}
+
+/*****************************************************
+ * BST :: RELAYOUT
+ * Move up to maxNodes nodes into one cache-aligned block
+ * in level order: the top numLevels levels, then the
+ * nodes the sampled finds passed through most. Every
+ * sampled find counts its whole path, so the hottest
+ * nodes hang together from the root. Links and order
+ * are unchanged but, like shrink_to_fit, this
+ * invalidates iterators. The counts are halved
+ * afterwards so the next relayout follows the traffic.
+ ****************************************************/
+template <typename T>
+void BST <T> :: relayout(size_t numLevels, size_t maxNodes)
+{
+   // number the nodes in level order
+   std::vector<BNode *> order;
+   std::vector<size_t> depths;
+   if (root != nullptr)
+   {
+      order.push_back(root);
+      depths.push_back(0);
+   }
+   for (size_t i = 0; i < order.size(); i++)
+      for (BNode * pChild : { order[i]->pLeft, order[i]->pRight })
+         if (pChild != nullptr && !isFrozen(pChild))
+         {
+            order.push_back(pChild);
+            depths.push_back(depths[i] + 1);
+         }
+
+   // the top levels first, then whatever is warm by how warm it is
+   std::vector<size_t> chosen;
+   size_t i = 0;
+   for (; i < order.size() && depths[i] < numLevels && chosen.size() < maxNodes; i++)
+      chosen.push_back(i);
+   std::vector<size_t> warm;
+   for (; i < order.size(); i++)
+      if (order[i]->heat > 0)
+         warm.push_back(i);
+   std::stable_sort(warm.begin(), warm.end(), [&order](size_t a, size_t b)
+   {
+      return order[a]->heat > order[b]->heat;
+   });
+   for (size_t j = 0; j < warm.size() && chosen.size() < maxNodes; j++)
+      chosen.push_back(warm[j]);
+   std::sort(chosen.begin(), chosen.end());
+
+   // whatever is cooling off leaves the old block, so it drains
+   std::vector<bool> isChosen(order.size(), false);
+   for (size_t index : chosen)
+      isChosen[index] = true;
+   for (size_t j = 0; j < order.size(); j++)
+      if (!isChosen[j] && order[j]->slot == HOT)
+         order[j] = moveNode(order[j], ::operator new(sizeof(BNode)), 0);
+
+   // then the chosen ones go side by side into the new block
+   HotRegion fresh;
+   if (!chosen.empty())
+      fresh.create(chosen.size());
+   for (size_t j = 0; j < chosen.size(); j++)
+      order[chosen[j]] = moveNode(order[chosen[j]], fresh.at(j), HOT);
+   hot.swap(fresh);
+
+   for (BNode * pNode : order)
+      pNode->heat /= 2;
+}
+
+/*****************************************************
+ * BST :: FREEZE
+ * Pack every subtree that no insert or erase has passed
+ * through in the last period writes into a Frozen, and
+ * return how many elements that took out of nodes. The
+ * root stays a node. Subtrees smaller than MIN_FROZEN
+ * are left alone, as is everything above a write.
+ ****************************************************/
+template <typename T>
+size_t BST <T> :: freeze(unsigned int period)
+{
+   size_t count = 0;
+   size_t numBefore = numFrozen;
+   if (root != nullptr)
+      freezeCold(root, period, count);
+   return numFrozen - numBefore;
+}
+
+/*****************************************************
+ * BST :: FROZEN SIZE
+ * How many elements are in Frozens rather than nodes
+ ****************************************************/
+template <typename T>
+size_t BST <T> :: frozenSize() const noexcept
+{
+   return numFrozen;
+}
+
+/*****************************************************
+ * BST :: SET MEMORY LIMIT
+ * Keep the tree in about this many bytes by freezing
+ * what has not been written lately and writing the
+ * least recently used Frozens out to the file at path,
+ * or to a temporary file. Frozens there come back when
+ * something reads them. A limit of 0 brings everything
+ * back into memory. The path only counts the first time.
+ ****************************************************/
+template <typename T>
+void BST <T> :: setMemoryLimit(size_t bytes, const char * path)
+{
+   if (bytes == 0)
+   {
+      if (pSpill)
+      {
+         pSpill->budget = (size_t)-1;
+         moveBlocks(root, nullptr);
+         pSpill.reset();
+      }
+      return;
+   }
+
+   if (!pSpill)
+   {
+      // anything not written in the last MIN_FROZEN writes is cold
+      pSpill.reset(new Spill(path));
+      pSpill->lastTrim = clock < MIN_FROZEN ? 0 : clock - (unsigned int)MIN_FROZEN;
+      moveBlocks(root, pSpill.get());
+   }
+   pSpill->limit = bytes;
+   trim();
+}
+
+/*****************************************************
+ * BST :: RESIDENT SIZE
+ * Bytes in memory: every node, and the elements and
+ * shape of every Frozen that is not out in the file
+ ****************************************************/
+template <typename T>
+size_t BST <T> :: residentSize() const noexcept
+{
+   size_t numLoaded = pSpill ? pSpill->numLoaded : numFrozen;
+   return (numElements - numFrozen) * sizeof(BNode) + numLoaded * Spill::BYTES;
+}
+
+/*****************************************************
+ * BST :: TRIM
+ * Get back under the memory limit. Nodes cannot be
+ * written out, so when they alone are over it, what
+ * has not been written since the last trim is frozen
+ * first. That walks every node, so it waits for a
+ * sixty-fourth as many writes as there were nodes
+ * left the last time. Then the oldest Frozens go to
+ * the file.
+ ****************************************************/
+template <typename T>
+void BST <T> :: trim()
+{
+   size_t nodeBytes = (numElements - numFrozen) * sizeof(BNode);
+   if (nodeBytes > pSpill->limit && clock - pSpill->lastTrim >= pSpill->trimEvery)
+   {
+      freeze(clock - pSpill->lastTrim);
+      pSpill->lastTrim = clock;
+      pSpill->trimEvery = std::max((size_t)MIN_FROZEN, (numElements - numFrozen) / 64);
+      nodeBytes = (numElements - numFrozen) * sizeof(BNode);
+   }
+   pSpill->budget = pSpill->limit > nodeBytes ? pSpill->limit - nodeBytes : 0;
+   pSpill->evict();
+}
+
+/*****************************************************
+ * BST :: MOVE BLOCKS
+ * Hand every Frozen under pThis over to pTo, or to no
+ * spill file at all, in memory
+ ****************************************************/
+template <typename T>
+void BST <T> :: moveBlocks(BNode * pThis, Spill * pTo)
+{
+   if (pThis == nullptr)
+      return;
+   if (isFrozen(pThis))
+   {
+      Frozen * pFrozen = &frozenOf(pThis)->load();
+      if (pFrozen->pSpill != nullptr)
+         pFrozen->pSpill->forget(pFrozen);
+      pFrozen->pSpill = nullptr;
+      pFrozen->offset = -1;      // that was in the old file
+      if (pTo != nullptr)
+         pTo->add(pFrozen);
+      return;
+   }
+   moveBlocks(pThis->pLeft, pTo);
+   moveBlocks(pThis->pRight, pTo);
+}
+
+/*****************************************************
+ * BST :: FREEZE COLD
+ * Postfix: LRV. Report whether the subtree at pThis is
+ * cold and how many elements it holds. A cold child of
+ * a live node, or of the root, is as big as a cold
+ * subtree there will get, so that is where it is frozen.
+ * One bigger than MAX_FROZEN counts as live, so its
+ * children are frozen instead.
+ ****************************************************/
+template <typename T>
+bool BST <T> :: freezeCold(BNode * pThis, unsigned int period, size_t & count)
+{
+   if (pThis == nullptr)
+   {
+      count = 0;
+      return true;
+   }
+   if (isFrozen(pThis))
+   {
+      count = frozenOf(pThis)->size();
+      return true;
+   }
+
+   size_t counts[2];
+   bool isCold[2];
+   for (int i = 0; i < 2; i++)
+      isCold[i] = freezeCold(pThis->child(i), period, counts[i]);
+   count = counts[0] + counts[1] + 1;
+   bool cold = isCold[0] && isCold[1] && clock - pThis->written >= period &&
+               count <= MAX_FROZEN;
+
+   if (!cold || pThis == root)
+      for (int i = 0; i < 2; i++)
+         if (isCold[i] && counts[i] >= MIN_FROZEN && !isFrozen(pThis->child(i)))
+         {
+            Frozen * pFrozen = new Frozen;
+            pFrozen->values.reserve(counts[i]);
+            pFrozen->shape.reserve(counts[i]);
+            numFrozen += freezeInto(pThis->child(i), *pFrozen);
+            pFrozen->count = pFrozen->values.size();
+            pFrozen->isRed = (pFrozen->shape[0] & Frozen::IS_RED) != 0;
+            pFrozen->pParent = pThis;
+            pThis->setChild(i, linkTo(pFrozen));
+            if (pSpill)
+               pSpill->add(pFrozen);
+         }
+   return cold;
+}
+
+/*****************************************************
+ * BST :: FREEZE INTO
+ * Move the subtree at pThis into frozen: each node's
+ * shape byte in prefix order, its element in order.
+ * Frozens already in the subtree are taken in whole.
+ * Return how many nodes were freed.
+ ****************************************************/
+template <typename T>
+size_t BST <T> :: freezeInto(BNode * pThis, Frozen & frozen)
+{
+   if (isFrozen(pThis))
+   {
+      Frozen * pInner = &frozenOf(pThis)->load();
+      size_t iTop = frozen.shape.size();
+      frozen.shape.insert(frozen.shape.end(), pInner->shape.begin(), pInner->shape.end());
+      frozen.shape[iTop] = (unsigned char)((frozen.shape[iTop] & ~Frozen::IS_RED) |
+                                           (pInner->isRed ? Frozen::IS_RED : 0));
+      for (T & t : pInner->values)
+         frozen.values.push_back(std::move(t));
+      delete pInner;
+      return 0;
+   }
+
+   frozen.shape.push_back((unsigned char)((pThis->pLeft  != nullptr ? Frozen::HAS_LEFT  : 0) |
+                                          (pThis->pRight != nullptr ? Frozen::HAS_RIGHT : 0) |
+                                          (pThis->isRed             ? Frozen::IS_RED    : 0)));
+   size_t count = 1;
+   if (pThis->pLeft != nullptr)
+      count += freezeInto(pThis->pLeft, frozen);
+   frozen.values.push_back(std::move(pThis->data));
+   if (pThis->pRight != nullptr)
+      count += freezeInto(pThis->pRight, frozen);
+   freeNode(pThis);
+   return count;
+}
+
+/*****************************************************
+ * BST :: THAW
+ * Turn the Frozen pLink leads to back into the nodes it
+ * was made from, hung where it was. Return the top one,
+ * or the one holding element index.
+ ****************************************************/
+template <typename T>
+typename BST <T> :: BNode * BST <T> :: thaw(BNode * pLink)
+{
+   BNode * pAt = nullptr;
+   size_t iShape = 0;
+   size_t iValue = 0;
+   Frozen * pFrozen = &frozenOf(pLink)->load();
+   BNode * pParent = pFrozen->pParent;
+   BNode * pTop = thawNode(*pFrozen, iShape, iValue, 0, pAt);
+   pTop->pParent = pParent;
+   pTop->isRed = pFrozen->isRed;
+   numFrozen -= pFrozen->size();
+   pParent->setChild(pParent->pRight == pLink, pTop);
+   delete pFrozen;
+   return pTop;
+}
+
+template <typename T>
+typename BST <T> :: BNode * BST <T> :: thaw(BNode * pLink, size_t index)
+{
+   BNode * pAt = nullptr;
+   size_t iShape = 0;
+   size_t iValue = 0;
+   Frozen * pFrozen = &frozenOf(pLink)->load();
+   BNode * pParent = pFrozen->pParent;
+   BNode * pTop = thawNode(*pFrozen, iShape, iValue, index, pAt);
+   pTop->pParent = pParent;
+   pTop->isRed = pFrozen->isRed;
+   numFrozen -= pFrozen->size();
+   pParent->setChild(pParent->pRight == pLink, pTop);
+   delete pFrozen;
+   return pAt;
+}
+
+/*****************************************************
+ * BST :: THAW NODE
+ * Rebuild the subtree whose shape starts at iShape and
+ * whose elements start at iValue, noting the node that
+ * gets element index in pAt
+ ****************************************************/
+template <typename T>
+typename BST <T> :: BNode * BST <T> :: thawNode(Frozen & frozen, size_t & iShape,
+                                               size_t & iValue, size_t index, BNode *& pAt)
+{
+   unsigned char shape = frozen.shape[iShape++];
+   BNode * pLeft = nullptr;
+   if (shape & Frozen::HAS_LEFT)
+      pLeft = thawNode(frozen, iShape, iValue, index, pAt);
+
+   BNode * pNode = allocateNode(nullptr, false, std::move(frozen.values[iValue]));
+   if (iValue++ == index)
+      pAt = pNode;
+   pNode->isRed = (shape & Frozen::IS_RED) != 0;
+   pNode->written = clock;
+   pNode->pLeft = pLeft;
+   if (pLeft != nullptr)
+      pLeft->pParent = pNode;
+
+   if (shape & Frozen::HAS_RIGHT)
+   {
+      pNode->pRight = thawNode(frozen, iShape, iValue, index, pAt);
+      pNode->pRight->pParent = pNode;
+   }
+   return pNode;
+}
+
+/*****************************************************
+ * BST :: THAW CHILDREN
+ * Make sure both of pNode's children are nodes
+ ****************************************************/
+template <typename T>
+typename BST <T> :: BNode * BST <T> :: thawChildren(BNode * pNode)
+{
+   for (int i = 0; i < 2; i++)
+      if (isFrozen(pNode->child(i)))
+         thaw(pNode->child(i));
+   return pNode;
+}
+
+/*****************************************************
+ * BST :: SET PARENT
+ * Point a child link, frozen or not, back at pParent
+ ****************************************************/
+template <typename T>
+void BST <T> :: setParent(BNode * pChild, BNode * pParent)
+{
+   if (pChild == nullptr)
+      return;
+   if (isFrozen(pChild))
+      frozenOf(pChild)->pParent = pParent;
+   else
+      pChild->pParent = pParent;
+}
+
+/*****************************************************
+ * BST :: IS RED LINK / SET RED LINK
+ * The color at the top of a child link, frozen or not.
+ * Nothing is black. A Frozen keeps its top color apart
+ * from its shape so a spilled one need not be read back.
+ ****************************************************/
+template <typename T>
+bool BST <T> :: isRedLink(const BNode * p)
+{
+   if (p == nullptr)
+      return false;
+   if (isFrozen(p))
+      return frozenOf(p)->isRed;
+   return p->isRed;
+}
+
+template <typename T>
+void BST <T> :: setRedLink(BNode * p, bool isRed)
+{
+   if (isFrozen(p))
+      frozenOf(p)->isRed = isRed;
+   else
+      p->isRed = isRed;
+}
+
 /*****************************************************
  * BST :: BEGIN
  * Return the first node (left-most) in a binary search tree
@@ -713,7 +1818,7 @@ typename BST <T> :: iterator custom :: BST <T> :: begin() const noexcept
    if (this->root == nullptr)
       return end();
    auto current = this->root;
-   while (current->pLeft != nullptr)
+   while (!isFrozen(current) && current->pLeft != nullptr)
       current = current->pLeft;
    return iterator(current);
 }
@@ -726,12 +1831,47 @@ typename BST <T> :: iterator custom :: BST <T> :: begin() const noexcept
 template <typename T>
 typename BST <T> :: iterator BST<T> :: find(const T & t)
 {
+   trace(Trace::Scope scope("find"));
    if (this->root == nullptr)
       return end();
+   if (samplePeriod != 0 && --sampleCountdown == 0)
+   {
+      sampleCountdown = samplePeriod;
+      return findSampled(t);
+   }
+
+   // Unlike lower_bound, this keeps its branches: it already branches on
+   // == every step, and picking child() by the comparison measured slower
+   // because the next load can no longer start before the compare is done.
+   auto current = this->root;
+   while (current != nullptr)
+   {
+      if (isFrozen(current))
+         return findIn(current, t);
+      if (current->data == t)
+         return iterator(current);
+      else if (current->data < t)
+         current = current->pRight;
+      else
+         current = current->pLeft;
+   }
 
+   return end();
+}
+
+/****************************************************
+ * BST :: FIND SAMPLED
+ * find, counting every node on the way down
+ ****************************************************/
+template <typename T>
+typename BST <T> :: iterator BST<T> :: findSampled(const T & t)
+{
    auto current = this->root;
    while (current != nullptr)
    {
+      if (isFrozen(current))
+         return findIn(current, t);
+      current->heat++;
       if (current->data == t)
          return iterator(current);
       else if (current->data < t)
@@ -743,6 +1883,204 @@ typename BST <T> :: iterator BST<T> :: find(const T & t)
    return end();
 }
 
+/****************************************************
+ * BST :: FIND IN
+ * find, in the frozen subtree pLink leads to. A key
+ * outside its first and last element misses without
+ * reading a spilled one back in.
+ ****************************************************/
+template <typename T>
+typename BST <T> :: iterator BST<T> :: findIn(BNode * pLink, const T & t)
+{
+   Frozen * pFrozen = frozenOf(pLink);
+   if (t < pFrozen->values.front() || pFrozen->values.back() < t)
+      return end();
+   const std::vector<T> & values = pFrozen->load().values;
+   auto it = std::lower_bound(values.begin(), values.end(), t);
+   if (it != values.end() && *it == t)
+      return iterator(pLink, it - values.begin());
+   return end();
+}
+
+/****************************************************
+ * BST :: LOWER BOUND
+ * Return the first node that is not less than a given value. The
+ * comparison picks the child and pResult with conditional moves,
+ * so the loop has no data-dependent branch to mispredict.
+ ****************************************************/
+template <typename T>
+typename BST <T> :: iterator BST<T> :: lower_bound(const T & t) const
+{
+   trace(Trace::Scope scope("lower_bound"));
+   BNode* pResult = nullptr;
+   auto current = this->root;
+   while (current != nullptr)
+   {
+      if (isFrozen(current))
+      {
+         // the ends of the block settle it without loading, if they can
+         Frozen * pFrozen = frozenOf(current);
+         if (pFrozen->values.back() < t)
+            break;
+         if (!(pFrozen->values.front() < t))
+            return iterator(current, 0);
+         const std::vector<T> & values = pFrozen->load().values;
+         auto it = std::lower_bound(values.begin(), values.end(), t);
+         if (it != values.end())
+            return iterator(current, it - values.begin());
+         break;
+      }
+      bool isRight = current->data < t;
+      pResult = (isRight ? pResult : current);
+      current = current->child(isRight);
+   }
+   return iterator(pResult);
+}
+
+/****************************************************
+ * BST :: UPPER BOUND
+ * Return the first node that is greater than a given value, without
+ * branching on the comparison, like lower_bound
+ ****************************************************/
+template <typename T>
+typename BST <T> :: iterator BST<T> :: upper_bound(const T & t) const
+{
+   trace(Trace::Scope scope("upper_bound"));
+   BNode* pResult = nullptr;
+   auto current = this->root;
+   while (current != nullptr)
+   {
+      if (isFrozen(current))
+      {
+         Frozen * pFrozen = frozenOf(current);
+         if (!(t < pFrozen->values.back()))
+            break;
+         if (t < pFrozen->values.front())
+            return iterator(current, 0);
+         const std::vector<T> & values = pFrozen->load().values;
+         auto it = std::upper_bound(values.begin(), values.end(), t);
+         if (it != values.end())
+            return iterator(current, it - values.begin());
+         break;
+      }
+      bool isLeft = t < current->data;
+      pResult = (isLeft ? current : pResult);
+      current = current->child(!isLeft);
+   }
+   return iterator(pResult);
+}
+
+/****************************************************
+ * BST :: ESTIMATE COUNT
+ * About how many elements are in [lo, hi), from two
+ * descents and no counts kept in the nodes. The ends
+ * of the tree come out exact.
+ ****************************************************/
+template <typename T>
+size_t BST <T> :: estimate_count(const T & lo, const T & hi) const
+{
+   if (!(lo < hi))
+      return 0;
+   double count = estimateRank(hi) - estimateRank(lo);
+   return count <= 0.0 ? 0 : (size_t)(count + 0.5);
+}
+
+/****************************************************
+ * BST :: ESTIMATE RANK
+ * About how many elements are less than t. The root's
+ * subtree holds exactly numElements, and each node
+ * splits what is below it between its children by
+ * color: siblings have the same black height, and a
+ * red child has two children that each match its black
+ * sibling, so it holds about twice as much. A missing
+ * child holds nothing and a Frozen knows exactly.
+ * Going right adds the left side and the node.
+ ****************************************************/
+template <typename T>
+double BST <T> :: estimateRank(const T & t) const
+{
+   double rank = 0.0;
+   double size = (double)numElements;   // under current, as far as we can tell
+   const BNode * current = root;
+   while (current != nullptr)
+   {
+      // a spilled block is not read back in just for an estimate
+      if (isFrozen(current))
+      {
+         Frozen * pFrozen = frozenOf(current);
+         if (!(pFrozen->values.front() < t))
+            return rank;
+         if (pFrozen->values.back() < t)
+            return rank + (double)pFrozen->size();
+         if (!pFrozen->isLoaded())
+            return rank + (double)pFrozen->size() / 2.0;
+         const std::vector<T> & values = pFrozen->values;
+         return rank + (double)(std::lower_bound(values.begin(), values.end(), t) - values.begin());
+      }
+
+      const BNode * pLeft = current->pLeft;
+      const BNode * pRight = current->pRight;
+      double self = std::min(size, 1.0);    // so the shares always add up to numElements
+      double below = size - self;
+      double left;
+      if (isFrozen(pLeft))
+         left = (double)frozenOf(pLeft)->size();
+      else if (isFrozen(pRight))
+         left = below - (double)frozenOf(pRight)->size();
+      else
+      {
+         double weightLeft  = pLeft  == nullptr ? 0.0 : (pLeft->isRed  ? 2.0 : 1.0);
+         double weightRight = pRight == nullptr ? 0.0 : (pRight->isRed ? 2.0 : 1.0);
+         left = (weightLeft == 0.0) ? 0.0 : below * weightLeft / (weightLeft + weightRight);
+      }
+      left = std::min(std::max(left, 0.0), below);   // erase leaves the colors loose
+
+      bool isRight = current->data < t;
+      if (isRight)
+      {
+         rank += left + self;
+         size = below - left;
+      }
+      else
+         size = left;
+      current = current->child(isRight);
+   }
+   return rank;
+}
+
+/****************************************************
+ * BST :: BUILD HISTOGRAM
+ * Equi-depth bucket boundaries from one in-order pass:
+ * the element at rank i * size / buckets for each of
+ * the buckets, then the last element, so bucket i is
+ * [bounds[i], bounds[i + 1]) and the last one includes
+ * its end. A tree smaller than buckets gets one bucket
+ * per element.
+ ****************************************************/
+template <typename T>
+std::vector<T> BST <T> :: build_histogram(size_t buckets) const
+{
+   std::vector<T> bounds;
+   if (numElements == 0 || buckets == 0)
+      return bounds;
+   size_t numBuckets = std::min(buckets, numElements);
+   bounds.reserve(numBuckets + 1);
+
+   size_t rank = 0;
+   size_t next = 0;       // rank of the next boundary
+   for (iterator it = begin(); it != end(); ++it, ++rank)
+   {
+      if (rank == next)
+      {
+         bounds.push_back(*it);
+         next = bounds.size() < numBuckets ? bounds.size() * numElements / numBuckets : numElements;
+      }
+      if (rank + 1 == numElements)
+         bounds.push_back(*it);
+   }
+   return bounds;
+}
+
 /******************************************************
  ******************************************************
  ******************************************************
@@ -834,54 +2172,238 @@ void BST<T>::clearNode(BNode*& pThis)
 {
    if (pThis == nullptr)
       return;
+   if (isFrozen(pThis))
+   {
+      numFrozen -= frozenOf(pThis)->size();
+      delete frozenOf(pThis);
+      pThis = nullptr;
+      return;
+   }
    clearNode(pThis->pLeft);
    clearNode(pThis->pRight);
-   delete pThis;
+   freeNode(pThis);
    pThis = nullptr;
 }
 
+/*****************************************************
+ * RELOCATE
+ * Move every reserved node below pThis, including pThis,
+ * into the pool to, in prefix order: VLR
+ ****************************************************/
+template <typename T>
+void BST<T>::relocate(BNode*& pThis, NodePool& to)
+{
+   if (pThis == nullptr || isFrozen(pThis))
+      return;
+   if (pThis->slot == POOLED)
+   {
+      BNode* pOld = pThis;
+      BNode* pNew = new (to.take()) BNode(std::move(pOld->data));
+      pNew->pLeft = pOld->pLeft;
+      pNew->pRight = pOld->pRight;
+      pNew->pParent = pOld->pParent;
+      pNew->isRed = pOld->isRed;
+      pNew->heat = pOld->heat;
+      pNew->written = pOld->written;
+      pNew->slot = POOLED;
+      setParent(pNew->pLeft, pNew);
+      setParent(pNew->pRight, pNew);
+      pThis = pNew;
+      pOld->~BNode();
+   }
+   relocate(pThis->pLeft, to);
+   relocate(pThis->pRight, to);
+}
+
+/*****************************************************
+ * MOVE NODE
+ * Move pOld into the storage at pTo, relink everything
+ * that pointed at it, and free where it was
+ ****************************************************/
+template <typename T>
+typename BST <T> :: BNode * BST<T>::moveNode(BNode* pOld, void* pTo, unsigned char slot)
+{
+   BNode* pNew = new (pTo) BNode(std::move(pOld->data));
+   pNew->pLeft = pOld->pLeft;
+   pNew->pRight = pOld->pRight;
+   pNew->pParent = pOld->pParent;
+   pNew->isRed = pOld->isRed;
+   pNew->heat = pOld->heat;
+   pNew->written = pOld->written;
+   pNew->slot = slot;
+   setParent(pNew->pLeft, pNew);
+   setParent(pNew->pRight, pNew);
+   if (pNew->pParent == nullptr)
+      root = pNew;
+   else
+      pNew->pParent->setChild(pNew->pParent->pRight == pOld, pNew);
+   freeNode(pOld);
+   return pNew;
+}
+
+/*****************************************************
+ * RECYCLE
+ * Unhook every node below pThis, including pThis, and
+ * chain them through pRight onto *ppTail in prefix
+ * order: VLR. A tree rebuilt in the same order puts
+ * each node back where it was when the shapes match.
+ ****************************************************/
+template <typename T>
+void BST<T>::recycle(BNode* pThis, BNode**& ppTail)
+{
+   if (pThis == nullptr)
+      return;
+   if (isFrozen(pThis))
+   {
+      numFrozen -= frozenOf(pThis)->size();
+      delete frozenOf(pThis);
+      return;
+   }
+   BNode* pLeft = pThis->pLeft;
+   BNode* pRight = pThis->pRight;
+   pThis->pRight = nullptr;
+   *ppTail = pThis;
+   ppTail = &pThis->pRight;
+   recycle(pLeft, ppTail);
+   recycle(pRight, ppTail);
+}
+
 /**********************************************
  * assign
- * copy the values from pSrc onto pDest preserving
- * as many of the nodes as possible.
+ * copy the values from pSrc onto pDest, taking
+ * the nodes from pRecycle for as long as it lasts
+ * and only allocating once it runs out.
  *********************************************/
 template <typename T>
-void BST<T>::assign(BNode*& pDest, const BNode* pSrc)
+void BST<T>::assign(BNode*& pDest, const BNode* pSrc, BNode*& pRecycle,
+                    BNode* pParent, bool isRight)
 {
-   // If source is nullptr, clear and return.
+   // If source is nullptr, there is nothing here.
    if (pSrc == nullptr)
    {
-      clearNode(pDest);
+      pDest = nullptr;
       return;
    }
 
-   // If destination is empty, create a new node
-   // and copy the rest.
-   if (pDest == nullptr && pSrc != nullptr)
+   // A frozen subtree is copied frozen, and into our own spill file.
+   if (isFrozen(pSrc))
    {
-      pDest = new BNode(pSrc->data);
-      pDest->isRed = pSrc->isRed;
-
-      assign(pDest->pLeft, pSrc->pLeft);
-      if (pDest->pLeft != nullptr)
-         pDest->pLeft->pParent = pDest;
-      assign(pDest->pRight, pSrc->pRight);
-      if (pDest->pRight != nullptr)
-         pDest->pRight->pParent = pDest;
+      const Frozen & from = frozenOf(pSrc)->load();
+      Frozen * pFrozen = new Frozen;
+      pFrozen->values = from.values;
+      pFrozen->shape = from.shape;
+      pFrozen->count = from.count;
+      pFrozen->isRed = from.isRed;
+      pFrozen->pParent = pParent;
+      pDest = linkTo(pFrozen);
+      numFrozen += pFrozen->size();
+      if (pSpill)
+      {
+         pSpill->add(pFrozen);
+         pSpill->evict();
+      }
       return;
    }
 
-   if (pDest != nullptr && pSrc != nullptr)
+   // Reuse a node if there is one, otherwise create one.
+   if (pRecycle != nullptr)
+   {
+      pDest = pRecycle;
+      pRecycle = pRecycle->pRight;
+      pDest->data = pSrc->data;
+   }
+   else
+      pDest = allocateNode(pParent, isRight, pSrc->data);
+
+   pDest->isRed = pSrc->isRed;
+   pDest->written = pSrc->written;
+   pDest->pParent = pParent;
+   pDest->pLeft = pDest->pRight = nullptr;
+   assign(pDest->pLeft, pSrc->pLeft, pRecycle, pDest, false);
+   assign(pDest->pRight, pSrc->pRight, pRecycle, pDest, true);
+}
+
+/*****************************************************
+ * BST :: ALLOCATE NODE
+ * Create a node that is about to become pParent's left or right child.
+ * Nodes set aside by reserve() are used first. After that, with PAIRED
+ * allocation the node goes into the free half of its sibling's pair if
+ * there is one, otherwise into a fresh pair whose other half is kept
+ * for the sibling.
+ ****************************************************/
+template <typename T>
+template <typename U>
+typename BST <T> :: BNode * BST <T> :: allocateNode(BNode * pParent, bool isRight, U && t)
+{
+   trace(Trace::instant("allocate"));
+   void * pReserved = pool.take();
+   if (pReserved != nullptr)
+   {
+      BNode * pNode = new (pReserved) BNode(std::forward<U>(t));
+      pNode->slot = POOLED;
+      return pNode;
+   }
+
+   if (allocation == INDEPENDENT || pParent == nullptr)
+      return new BNode(std::forward<U>(t));
+
+   NodePair * pPair = nullptr;
+   int slot = (isRight ? 1 : 0);
+   BNode * pSibling = (isRight ? pParent->pLeft : pParent->pRight);
+   if (pSibling != nullptr && !isFrozen(pSibling) &&
+       (pSibling->slot == 1 || pSibling->slot == 2))
+   {
+      // rotations never move nodes, so the sibling's partner may be in use
+      NodePair * pSiblingPair = NodePair::of(pSibling);
+      int partner = 2 - pSibling->slot;
+      if (pSiblingPair->isFree(partner))
+      {
+         pPair = pSiblingPair;
+         slot = partner;
+      }
+   }
+   if (pPair == nullptr)
+      pPair = NodePair::create();
+
+   BNode * pNode = new (pPair->at(slot)) BNode(std::forward<U>(t));
+   pNode->slot = (unsigned char)(slot + 1);
+   pPair->used |= (unsigned char)(1 << slot);
+   return pNode;
+}
+
+/*****************************************************
+ * BST :: FREE NODE
+ * Destroy a node, however it was allocated. A reserved node goes back
+ * on the free list, and a pair or the hot region is released once
+ * everything in it is empty.
+ ****************************************************/
+template <typename T>
+void BST <T> :: freeNode(BNode * pNode)
+{
+   trace(Trace::instant("free"));
+   if (pNode->slot == 0)
    {
-         pDest->data = pSrc->data;
-         pDest->isRed = pSrc->isRed;
-         assign(pDest->pRight, pSrc->pRight);
-         if (pDest->pRight != nullptr)
-            pDest->pRight->pParent = pDest;
-         assign(pDest->pLeft, pSrc->pLeft);
-         if (pDest->pLeft != nullptr)
-            pDest->pLeft->pParent = pDest;
+      delete pNode;
+      return;
+   }
+   if (pNode->slot == POOLED)
+   {
+      pNode->~BNode();
+      pool.give(pNode);
+      return;
    }
+   if (pNode->slot == HOT)
+   {
+      pNode->~BNode();
+      hot.leave();
+      return;
+   }
+   NodePair * pPair = NodePair::of(pNode);
+   int slot = pNode->slot - 1;
+   pNode->~BNode();
+   pPair->used &= (unsigned char)~(1 << slot);
+   if (pPair->used == 0)
+      NodePair::destroy(pPair);
 }
 
 #ifdef DEBUG
@@ -935,7 +2457,7 @@ bool BST <T> :: BNode :: verifyRedBlack(int depth) const
    }
 
    // Rule d) Every path from a leaf to the root has the same # of black nodes
-   if (pLeft == nullptr && pRight && nullptr)
+   if (pLeft == nullptr && pRight == nullptr)
       if (depth != 0)
          fReturn = false;
    if (pLeft != nullptr)
@@ -1018,13 +2540,17 @@ void BST <T> :: BNode :: balance()
    // Case 1: if we are the root, then color ourselves black and call it a day.
    if (!this->pParent)
    {
+      trace(Trace::instant("balance 1"));
       this->isRed = false;
       return;
    }
 
    // Case 2: if the parent is black, then there is nothing left to do
    if (!this->pParent->isRed)
+   {
+      trace(Trace::instant("balance 2"));
       return;
+   }
 
    // Case 3: If parent is red, grandparent is black, and aunt is red and exists
    // then recolor.
@@ -1032,11 +2558,12 @@ void BST <T> :: BNode :: balance()
    if (!pGranny) return; // If granny is null, none of the other operations will work.
    BNode* pAunt = (pGranny->pLeft == pParent) ? pGranny->pRight : pGranny->pLeft;
 
-   if (pParent->isRed && !pGranny->isRed &&
-      pAunt != nullptr && pAunt->isRed)
+   // The aunt may be a frozen subtree, whose color is kept in the Frozen.
+   if (pParent->isRed && !pGranny->isRed && isRedLink(pAunt))
   {
+      trace(Trace::instant("balance 3"));
       pParent->isRed = false;
-      pAunt->isRed = false;
+      setRedLink(pAunt, false);
       if (pGranny->pParent != nullptr)
          pGranny->isRed = true;
 
@@ -1048,117 +2575,56 @@ void BST <T> :: BNode :: balance()
       return;
    }
 
-   // Case 4: if the aunt is black or non-existent, then we need to rotate
-   if (pParent->isRed && !pGranny->isRed &&
-      pAunt == nullptr || !pAunt->isRed)
+   // Case 4: if the aunt is black or non-existent, then we need to rotate.
+   // side is which child mom is of granny; the mirror-image cases are the
+   // same code with side and !side trading places.
+   if (!isRedLink(pAunt))
    {
-      // Case 4a: We are mom's left and mom is granny's left
-      if (this == pParent->pLeft && pParent == pGranny->pLeft)
-      {
-         // In this case the sibling is to the right.
-         BNode* pSibling = this->pParent->pRight;
-         pParent->pRight = pGranny;
-         pGranny->pLeft = pSibling;
-         pParent->pParent = pGranny->pParent;
-         pGranny->pParent = pParent;
-
-         // If parent is not the root, then we need to update the grandparent's
-         // child pointer to point to the parent.
-         if (pParent->pParent != nullptr)
-            if (pParent->pParent->pLeft == pGranny)
-               pParent->pParent->pLeft = pParent;
-            else
-               pParent->pParent->pRight = pParent;
-
-         // Recolor.
-         pParent->isRed = false;
-         pGranny->isRed = true;
-      }
-      // case 4b: We are mom's right and mom is granny's right
-      if (this == pParent->pRight && pParent == pGranny->pRight)
-      {
-         // In this case the sibling is to the left.
-         BNode* pSibling = this->pParent->pLeft;
-         pParent->pLeft = pGranny;
-         pGranny->pRight = pSibling;
-         pParent->pParent = pGranny->pParent;
-         pGranny->pParent = pParent;
-
-         // If parent is not the root, then we need to update the grandparent's
-         // child pointer to point to the parent.
-         if (pParent->pParent != nullptr)
-            if (pParent->pParent->pLeft == pGranny)
-               pParent->pParent->pLeft = pParent;
-            else
-               pParent->pParent->pRight = pParent;
-
-         // Recolor.
-         pParent->isRed = false;
-         pGranny->isRed = true;
-      }
-      // Case 4c: We are mom's right and mom is granny's left
-      if (this == pParent->pRight && pParent == pGranny->pLeft)
-      {
-         // Distribute N's children.
-         pGranny->pLeft = this->pRight;
-         pParent->pRight = this->pLeft;
-         // Set N's children's parents to be their new parents
-         // if they are not nullptr.
-         if (this->pRight != nullptr)
-            this->pRight->pParent = pGranny;
-         if (this->pLeft != nullptr)
-            this->pLeft->pParent = pParent;
-
-         // Set granny to be right of this.
-         this->pRight = pGranny;
-         // Set parent of this to be granny's parent.
-         this->pParent = pGranny->pParent;
-         // Set granny's parent to this.
-         pGranny->pParent = this;
-
-         // Set parent's parent to this.
-         pParent->pParent = this;
-         // Set this' left to parent.
-         this->pLeft = pParent;
+      bool side = (pParent == pGranny->pRight);
+      BNode* pTop;   // whoever ends up where granny was
 
-         // Recolor.
-         this->isRed = false;
-         pGranny->isRed = true;
+      // Case 4a/4b: we are on the same side of mom as mom is of granny,
+      // so mom goes up and granny comes down on the other side of her.
+      // In the trace, 4a and 4c are with mom on granny's left.
+      if (this == pParent->child(side))
+      {
+         trace(Trace::instant(side ? "balance 4b" : "balance 4a"));
+         trace(Trace::instant("rotate"));
+         BNode* pSibling = pParent->child(!side);
+         pParent->setChild(!side, pGranny);
+         pGranny->setChild(side, pSibling);
+         setParent(pSibling, pGranny);
+         pTop = pParent;
       }
-      // case 4d: We are mom's left and mom is granny's right
-      if (this == pParent->pLeft && pParent == pGranny->pRight)
+      // Case 4c/4d: we are on the other side, so we go up past both of
+      // them, handing our children to mom and granny.
+      else
       {
-         // Distribute N's children
-         pGranny->pRight = this->pLeft;
-         pParent->pLeft = this->pRight;
-         // Set N's children's parents to be their new parents
-         // if they are not nullptr.
-         if (this->pLeft != nullptr)
-            this->pLeft->pParent = pGranny;
-         if (this->pRight != nullptr)
-            this->pRight->pParent = pParent;
-
-         // If pGranny is the root, parent's parent needs to be nullptr.
-         if (pGranny->pParent == nullptr)
-            this->pParent = nullptr;
-         // Otherwise, set this' parent to be granny's parent.
-         else if (pGranny->pParent->pRight == pGranny)
-            pGranny->pParent->pRight = this;
-         else
-            pGranny->pParent->pLeft = this;
-
-         // Set granny to be left of this.
-         this->pLeft = pGranny;
-         // Set right of this to be parent.
-         this->pRight = pParent;
-         // Set granny's parent to this.
-         pGranny->pParent = this;
-         // Set parent's parent to this.
+         trace(Trace::instant(side ? "balance 4d" : "balance 4c"));
+         trace(Trace::instant("rotate"));
+         trace(Trace::instant("rotate"));
+         BNode* pInner = this->child(side);
+         BNode* pOuter = this->child(!side);
+         pGranny->setChild(side, pOuter);
+         pParent->setChild(!side, pInner);
+         setParent(pOuter, pGranny);
+         setParent(pInner, pParent);
+         this->setChild(side, pParent);
+         this->setChild(!side, pGranny);
          pParent->pParent = this;
-         // Recolor.
-         pGranny->isRed = true;
-         this->isRed = false;
+         pTop = this;
       }
+
+      // Hang the new top where granny was. If granny was not the root,
+      // her parent needs to point to it.
+      pTop->pParent = pGranny->pParent;
+      if (pTop->pParent != nullptr)
+         pTop->pParent->setChild(pTop->pParent->pRight == pGranny, pTop);
+      pGranny->pParent = pTop;
+
+      // Recolor.
+      pTop->isRed = false;
+      pGranny->isRed = true;
    }
 }
 
@@ -1177,21 +2643,33 @@ void BST <T> :: BNode :: balance()
 template <typename T>
 typename BST <T> :: iterator & BST <T> :: iterator :: operator ++ ()
 {
+   trace(Trace::instant("iterator ++"));
+
    // If there is no node, return.
    if (pNode == nullptr)
       return *this;
 
+   // In a frozen subtree, the next element is next door until we run off
+   // the end, and then we climb out as though from the subtree's root.
+   if (isFrozen(pNode))
+   {
+      Frozen* pFrozen = frozenOf(pNode);
+      if (++index < pFrozen->size())
+         return *this;
+      index = 0;
+   }
+
    // If there is a right node, go right, then left as far as possible.
-   if (pNode->pRight != nullptr)
+   else if (pNode->pRight != nullptr)
    {
       pNode = pNode->pRight;
-      while (pNode->pLeft != nullptr)
+      while (!isFrozen(pNode) && pNode->pLeft != nullptr)
          pNode = pNode->pLeft;
       return *this;
    }
 
    BNode* pSave = pNode;
-   pNode = pNode->pParent;
+   pNode = isFrozen(pNode) ? frozenOf(pNode)->pParent : pNode->pParent;
    if (pNode == nullptr)
       return *this;
 
@@ -1214,21 +2692,35 @@ typename BST <T> :: iterator & BST <T> :: iterator :: operator ++ ()
 template <typename T>
 typename BST <T> :: iterator & BST <T> :: iterator :: operator -- ()
 {
+   trace(Trace::instant("iterator --"));
+
    // If there is no node, return.
    if (pNode == nullptr)
       return *this;
 
+   // In a frozen subtree, step back until we run off the front.
+   if (isFrozen(pNode))
+   {
+      if (index > 0)
+      {
+         --index;
+         return *this;
+      }
+   }
+
    // If there is a left node, go left, then as far right as possible.
-   if (pNode->pLeft != nullptr)
+   else if (pNode->pLeft != nullptr)
    {
       pNode = pNode->pLeft;
-      while (pNode->pRight != nullptr)
+      while (!isFrozen(pNode) && pNode->pRight != nullptr)
          pNode = pNode->pRight;
+      if (isFrozen(pNode))
+         index = frozenOf(pNode)->size() - 1;
       return *this;
    }
 
    BNode* pSave = pNode;
-   pNode = pNode->pParent;
+   pNode = isFrozen(pNode) ? frozenOf(pNode)->pParent : pNode->pParent;
    if (pNode == nullptr)
       return *this;
 
@@ -0,0 +1,696 @@
+/***********************************************************************
+ * Header:
+ *    FAT TREE
+ * Summary:
+ *    The red-black tree laid out as the 2-3-4 tree it is isomorphic to:
+ *    each black node and its red children live together in one fat node
+ *    of up to three keys and four children. A descent step reads one
+ *    node and picks a child from all of its keys at once, so it follows
+ *    half as many pointers as BST does, and for int keys the three
+ *    comparisons are a single SSE2 compare.
+ *
+ *    Insert and erase keep the red-black invariants in their 2-3-4 form.
+ *    Every leaf is at the same depth (equal black height) and no node
+ *    has more than three keys (no red node has a red child). Insert
+ *    splits an overflowing node and pushes its middle key up, which is
+ *    balance() case 3. Putting a key into a node with room is a case 4
+ *    rotation. Erase borrows from a sibling or merges with it.
+ *
+ *    It satisfies the same interface as BST (see orderedContainer.h).
+ *
+ *    This will contain the class definition of:
+ *        FatSearch           : Where a key falls among a node's keys
+ *        FatTree             : A 2-3-4 tree behind the BST interface
+ *        FatTree::iterator   : An iterator through FatTree
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include <cstddef>    // for size_t
+#include <utility>    // for std::pair
+
+#ifdef __SSE2__
+#include <emmintrin.h> // for the SSE2 integer compares
+#endif // __SSE2__
+
+class TestOrderedContainer;
+
+namespace custom
+{
+
+/*****************************************************************
+ * FAT SEARCH
+ * Where t falls among the numKeys sorted keys of a node, comparing
+ * with < like everything else
+ *****************************************************************/
+template <typename T>
+struct FatSearch
+{
+   // the first key that is not less than t
+   static int lower(const T * keys, int numKeys, const T & t)
+   {
+      int i = 0;
+      while (i < numKeys && keys[i] < t)
+         i++;
+      return i;
+   }
+
+   // the first key that is greater than t
+   static int upper(const T * keys, int numKeys, const T & t)
+   {
+      int i = 0;
+      while (i < numKeys && !(t < keys[i]))
+         i++;
+      return i;
+   }
+};
+
+#ifdef __SSE2__
+/*****************************************************************
+ * FAT SEARCH for int
+ * All the keys of a node compared against t in one instruction. The
+ * keys are sorted, so the lanes that pass form a prefix and counting
+ * them gives the position.
+ *****************************************************************/
+template <>
+struct FatSearch <int>
+{
+   static int lower(const int * keys, int numKeys, const int & t)
+   {
+      __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys));
+      __m128i less = _mm_cmplt_epi32(lanes, _mm_set1_epi32(t));
+      return count(_mm_movemask_ps(_mm_castsi128_ps(less)), numKeys);
+   }
+
+   static int upper(const int * keys, int numKeys, const int & t)
+   {
+      __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys));
+      __m128i greater = _mm_cmpgt_epi32(lanes, _mm_set1_epi32(t));
+      return count(~_mm_movemask_ps(_mm_castsi128_ps(greater)), numKeys);
+   }
+
+private:
+   // set bits among the first numKeys lanes
+   static int count(int mask, int numKeys)
+   {
+      static const int bits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+      return bits[mask & ((1 << numKeys) - 1)];
+   }
+};
+#endif // __SSE2__
+
+/*****************************************************************
+ * FAT TREE
+ * A 2-3-4 tree that can stand in for a BST
+ *****************************************************************/
+template <typename T>
+class FatTree
+{
+   friend class ::TestOrderedContainer;
+
+   class FNode;
+public:
+   // keys in a node: a black node and up to two red children
+   static const int KEYS_MAX = 3;
+
+   //
+   // Construct
+   //
+
+   FatTree() : root(nullptr), numElements(0) {}
+   FatTree(const FatTree &  rhs) : root(nullptr), numElements(0) { *this = rhs; }
+   FatTree(      FatTree && rhs) : root(rhs.root), numElements(rhs.numElements)
+   {
+      rhs.root = nullptr;
+      rhs.numElements = 0;
+   }
+   FatTree(const std::initializer_list<T>& il) : root(nullptr), numElements(0)
+   {
+      for (auto& element : il)
+         insert(element);
+   }
+   ~FatTree() { clear(); }
+
+   //
+   // Assign
+   //
+
+   FatTree & operator = (const FatTree & rhs);
+   FatTree & operator = (FatTree && rhs)
+   {
+      clear();
+      swap(rhs);
+      return *this;
+   }
+   void swap(FatTree & rhs)
+   {
+      std::swap(root, rhs.root);
+      std::swap(numElements, rhs.numElements);
+   }
+
+   //
+   // Iterator
+   //
+
+   class iterator;
+   iterator begin() const noexcept;
+   iterator end()   const noexcept { return iterator(); }
+
+   //
+   // Access
+   //
+
+   iterator find(const T& t);
+   iterator lower_bound(const T& t);
+   iterator upper_bound(const T& t);
+
+   //
+   // Insert
+   //
+
+   std::pair<iterator, bool> insert(const T&  t, bool keepUnique = false);
+   std::pair<iterator, bool> insert(      T&& t, bool keepUnique = false);
+
+   //
+   // Remove
+   //
+
+   iterator erase(iterator& it);
+   void clear() noexcept
+   {
+      clearNode(root);
+      root = nullptr;
+      numElements = 0;
+   }
+
+   //
+   // Status
+   //
+
+   bool   empty() const noexcept { return numElements == 0; }
+   size_t size()  const noexcept { return numElements;      }
+
+private:
+   template <typename U>
+   std::pair<iterator, bool> insertValue(U&& t, bool keepUnique);
+   void split(FNode * pNode, FNode *& pAt, int & at);
+   void fixUnderflow(FNode * pNode);
+   void removeKey(FNode * pNode, int index, int child);
+   void clearNode(FNode * pNode);
+
+   FNode * root;               // root node of the 2-3-4 tree
+   size_t numElements;         // number of elements currently in the tree
+};
+
+/*****************************************************************
+ * FAT NODE
+ * A black node and its red children: up to three keys in order and
+ * one more child than keys. A leaf has no children at all.
+ *****************************************************************/
+template <typename T>
+class FatTree <T> :: FNode
+{
+public:
+   FNode() : keys(), children(), numKeys(0), pParent(nullptr) {}
+
+   bool isLeaf() const { return children[0] == nullptr; }
+
+   // which slot in children[] holds pChild?
+   int indexOf(const FNode * pChild) const
+   {
+      int i = 0;
+      while (children[i] != pChild)
+         i++;
+      return i;
+   }
+
+   // one spare key and child hold the overflow until a split, and let
+   // FatSearch<int> load four keys without reading past the node
+   T keys[KEYS_MAX + 1];              // in sorted order
+   FNode * children[KEYS_MAX + 2];    // subtrees, nullptr in a leaf
+   int numKeys;                       // keys in use
+   FNode * pParent;                   // Parent
+};
+
+/**********************************************************
+ * FAT TREE ITERATOR
+ * Forward and reverse iterator through a 2-3-4 tree
+ *********************************************************/
+template <typename T>
+class FatTree <T> :: iterator
+{
+   friend class FatTree <T>;
+   friend class ::TestOrderedContainer;
+public:
+   iterator() : pNode(nullptr), index(0) {}
+   iterator(FNode * pNode, int index) : pNode(pNode), index(index) {}
+
+   bool operator == (const iterator & rhs) const
+   {
+      return pNode == rhs.pNode && index == rhs.index;
+   }
+   bool operator != (const iterator & rhs) const { return !(*this == rhs); }
+
+   // de-reference. Cannot change because it will invalidate the tree
+   const T & operator * () const { return pNode->keys[index]; }
+
+   iterator & operator ++ ();
+   iterator & operator -- ();
+
+private:
+   FNode * pNode;           // the node holding the element
+   int index;               // which of its keys
+};
+
+/*********************************************
+ * FAT TREE ITERATOR :: INCREMENT
+ * Down to the smallest key right of this one, else up
+ * to the first ancestor we are left of
+ ********************************************/
+template <typename T>
+typename FatTree <T> :: iterator & FatTree <T> :: iterator :: operator ++ ()
+{
+   if (pNode == nullptr)
+      return *this;
+
+   if (!pNode->isLeaf())
+   {
+      pNode = pNode->children[index + 1];
+      while (!pNode->isLeaf())
+         pNode = pNode->children[0];
+      index = 0;
+      return *this;
+   }
+
+   if (++index < pNode->numKeys)
+      return *this;
+
+   while (pNode->pParent != nullptr)
+   {
+      int child = pNode->pParent->indexOf(pNode);
+      pNode = pNode->pParent;
+      if (child < pNode->numKeys)
+      {
+         index = child;
+         return *this;
+      }
+   }
+   pNode = nullptr;
+   index = 0;
+   return *this;
+}
+
+/*********************************************
+ * FAT TREE ITERATOR :: DECREMENT
+ * The mirror image of increment
+ ********************************************/
+template <typename T>
+typename FatTree <T> :: iterator & FatTree <T> :: iterator :: operator -- ()
+{
+   if (pNode == nullptr)
+      return *this;
+
+   if (!pNode->isLeaf())
+   {
+      pNode = pNode->children[index];
+      while (!pNode->isLeaf())
+         pNode = pNode->children[pNode->numKeys];
+      index = pNode->numKeys - 1;
+      return *this;
+   }
+
+   if (index-- > 0)
+      return *this;
+
+   while (pNode->pParent != nullptr)
+   {
+      int child = pNode->pParent->indexOf(pNode);
+      pNode = pNode->pParent;
+      if (child > 0)
+      {
+         index = child - 1;
+         return *this;
+      }
+   }
+   pNode = nullptr;
+   index = 0;
+   return *this;
+}
+
+/*********************************************
+ * FAT TREE :: ASSIGNMENT OPERATOR
+ * Elements arrive in order, so each one lands at the end
+ ********************************************/
+template <typename T>
+FatTree <T> & FatTree <T> :: operator = (const FatTree <T> & rhs)
+{
+   if (this == &rhs)
+      return *this;
+   clear();
+   for (auto it = rhs.begin(); it != rhs.end(); ++it)
+      insert(*it);
+   return *this;
+}
+
+/*********************************************
+ * FAT TREE :: BEGIN
+ * The first key of the left-most leaf
+ ********************************************/
+template <typename T>
+typename FatTree <T> :: iterator FatTree <T> :: begin() const noexcept
+{
+   if (root == nullptr)
+      return end();
+   FNode * p = root;
+   while (!p->isLeaf())
+      p = p->children[0];
+   return iterator(p, 0);
+}
+
+/*********************************************
+ * FAT TREE :: LOWER BOUND
+ * Return the first element that is not less than t. Every
+ * candidate on the way down is no larger than the last one.
+ ********************************************/
+template <typename T>
+typename FatTree <T> :: iterator FatTree <T> :: lower_bound(const T & t)
+{
+   iterator it;
+   for (FNode * p = root; p != nullptr; )
+   {
+      int i = FatSearch<T>::lower(p->keys, p->numKeys, t);
+      if (i < p->numKeys)
+         it = iterator(p, i);
+      p = p->children[i];
+   }
+   return it;
+}
+
+/*********************************************
+ * FAT TREE :: UPPER BOUND
+ * Return the first element that is greater than t
+ ********************************************/
+template <typename T>
+typename FatTree <T> :: iterator FatTree <T> :: upper_bound(const T & t)
+{
+   iterator it;
+   for (FNode * p = root; p != nullptr; )
+   {
+      int i = FatSearch<T>::upper(p->keys, p->numKeys, t);
+      if (i < p->numKeys)
+         it = iterator(p, i);
+      p = p->children[i];
+   }
+   return it;
+}
+
+/*********************************************
+ * FAT TREE :: FIND
+ * Return the first element equal to t
+ ********************************************/
+template <typename T>
+typename FatTree <T> :: iterator FatTree <T> :: find(const T & t)
+{
+   iterator it = lower_bound(t);
+   if (it != end() && !(t < *it))
+      return it;
+   return end();
+}
+
+/*********************************************
+ * FAT TREE :: INSERT
+ * Insert after any equal elements, splitting on the way back up
+ ********************************************/
+template <typename T>
+std::pair<typename FatTree <T> :: iterator, bool> FatTree <T> :: insert(const T & t, bool keepUnique)
+{
+   return insertValue(t, keepUnique);
+}
+
+template <typename T>
+std::pair<typename FatTree <T> :: iterator, bool> FatTree <T> :: insert(T && t, bool keepUnique)
+{
+   return insertValue(std::move(t), keepUnique);
+}
+
+template <typename T>
+template <typename U>
+std::pair<typename FatTree <T> :: iterator, bool> FatTree <T> :: insertValue(U && t, bool keepUnique)
+{
+   if (keepUnique)
+   {
+      iterator it = find(t);
+      if (it != end())
+         return std::pair<iterator, bool>(it, false);
+   }
+
+   // an empty tree is a single leaf
+   if (root == nullptr)
+      root = new FNode;
+
+   // new keys always go into a leaf
+   FNode * pNode = root;
+   while (!pNode->isLeaf())
+      pNode = pNode->children[FatSearch<T>::upper(pNode->keys, pNode->numKeys, t)];
+   int i = FatSearch<T>::upper(pNode->keys, pNode->numKeys, t);
+
+   // shift the larger keys over to make room
+   for (int j = pNode->numKeys; j > i; j--)
+      pNode->keys[j] = std::move(pNode->keys[j - 1]);
+   pNode->keys[i] = std::forward<U>(t);
+   pNode->numKeys++;
+   numElements++;
+
+   // a fourth key is a red node with a red child: split until it fits
+   FNode * pAt = pNode;
+   int at = i;
+   while (pNode != nullptr && pNode->numKeys > KEYS_MAX)
+   {
+      split(pNode, pAt, at);
+      pNode = pNode->pParent;
+   }
+   return std::pair<iterator, bool>(iterator(pAt, at), true);
+}
+
+/*********************************************
+ * FAT TREE :: SPLIT
+ * Break a node of four keys into two keys on the left and one on
+ * the right, sending the third up to the parent. This is balance()
+ * case 3: the parent and aunt turn black and the grandparent red.
+ * The key at pAt[at] is followed to wherever it ends up.
+ ********************************************/
+template <typename T>
+void FatTree <T> :: split(FNode * pNode, FNode *& pAt, int & at)
+{
+   FNode * pRight = new FNode;
+   pRight->keys[0] = std::move(pNode->keys[3]);
+   pRight->children[0] = pNode->children[3];
+   pRight->children[1] = pNode->children[4];
+   for (int i = 0; i < 2; i++)
+      if (pRight->children[i] != nullptr)
+         pRight->children[i]->pParent = pRight;
+   pRight->numKeys = 1;
+   pNode->children[3] = pNode->children[4] = nullptr;
+   pNode->numKeys = 2;
+
+   // splitting the root grows the tree by one level
+   FNode * pParent = pNode->pParent;
+   int index = 0;
+   if (pParent == nullptr)
+   {
+      pParent = new FNode;
+      pParent->children[0] = pNode;
+      pNode->pParent = pParent;
+      root = pParent;
+   }
+   else
+      index = pParent->indexOf(pNode);
+
+   // room in the parent: shift over and drop the middle key in
+   for (int i = pParent->numKeys; i > index; i--)
+   {
+      pParent->keys[i] = std::move(pParent->keys[i - 1]);
+      pParent->children[i + 1] = pParent->children[i];
+   }
+   pParent->keys[index] = std::move(pNode->keys[2]);
+   pParent->children[index + 1] = pRight;
+   pParent->numKeys++;
+   pRight->pParent = pParent;
+
+   // follow the key we were asked to
+   if (pAt == pParent && at >= index)
+      at++;
+   else if (pAt == pNode && at == 2)
+   {
+      pAt = pParent;
+      at = index;
+   }
+   else if (pAt == pNode && at == 3)
+   {
+      pAt = pRight;
+      at = 0;
+   }
+}
+
+/*********************************************
+ * FAT TREE :: ERASE
+ * Remove the element the iterator refers to, returning the next one.
+ * Keys move between nodes as the tree rebalances, so the next element
+ * is found again afterwards by its value and how many equal elements
+ * come before it.
+ ********************************************/
+template <typename T>
+typename FatTree <T> :: iterator FatTree <T> :: erase(iterator & it)
+{
+   if (it == end())
+      return end();
+
+   // remember the next element
+   iterator itNext(it);
+   ++itNext;
+   bool hasNext = (itNext != end());
+   T next = hasNext ? *itNext : T();
+   size_t numBefore = 0;
+   if (hasNext)
+      for (iterator p = lower_bound(next); p != itNext; ++p)
+         if (p != it)
+            numBefore++;
+
+   // a key in an inner node trades places with its successor in a leaf
+   FNode * pNode = it.pNode;
+   int index = it.index;
+   if (!pNode->isLeaf())
+   {
+      FNode * pLeaf = pNode->children[index + 1];
+      while (!pLeaf->isLeaf())
+         pLeaf = pLeaf->children[0];
+      pNode->keys[index] = std::move(pLeaf->keys[0]);
+      pNode = pLeaf;
+      index = 0;
+   }
+
+   removeKey(pNode, index, 0);
+   numElements--;
+   fixUnderflow(pNode);
+
+   if (!hasNext)
+      return end();
+   iterator itReturn = lower_bound(next);
+   while (numBefore-- > 0)
+      ++itReturn;
+   return itReturn;
+}
+
+/*********************************************
+ * FAT TREE :: REMOVE KEY
+ * Take keys[index] and children[child] out of a node, closing the gaps
+ ********************************************/
+template <typename T>
+void FatTree <T> :: removeKey(FNode * pNode, int index, int child)
+{
+   for (int i = index; i < pNode->numKeys - 1; i++)
+      pNode->keys[i] = std::move(pNode->keys[i + 1]);
+   for (int i = child; i < pNode->numKeys; i++)
+      pNode->children[i] = pNode->children[i + 1];
+   pNode->children[pNode->numKeys] = nullptr;
+   pNode->numKeys--;
+}
+
+/*********************************************
+ * FAT TREE :: FIX UNDERFLOW
+ * A node with no keys left takes one through the parent from a sibling
+ * that can spare it, otherwise merges with a sibling and passes the
+ * problem up to the parent
+ ********************************************/
+template <typename T>
+void FatTree <T> :: fixUnderflow(FNode * pNode)
+{
+   while (pNode->numKeys == 0)
+   {
+      // an empty root is replaced by its only child
+      FNode * pParent = pNode->pParent;
+      if (pParent == nullptr)
+      {
+         root = pNode->children[0];
+         if (root != nullptr)
+            root->pParent = nullptr;
+         delete pNode;
+         return;
+      }
+
+      int child = pParent->indexOf(pNode);
+      FNode * pLeft  = (child > 0                 ? pParent->children[child - 1] : nullptr);
+      FNode * pRight = (child < pParent->numKeys  ? pParent->children[child + 1] : nullptr);
+
+      // borrow from the left: its last key goes up, the separator comes down
+      if (pLeft != nullptr && pLeft->numKeys > 1)
+      {
+         pNode->keys[0] = std::move(pParent->keys[child - 1]);
+         pNode->children[1] = pNode->children[0];
+         pNode->children[0] = pLeft->children[pLeft->numKeys];
+         if (pNode->children[0] != nullptr)
+            pNode->children[0]->pParent = pNode;
+         pNode->numKeys = 1;
+         pParent->keys[child - 1] = std::move(pLeft->keys[pLeft->numKeys - 1]);
+         pLeft->children[pLeft->numKeys] = nullptr;
+         pLeft->numKeys--;
+         return;
+      }
+
+      // borrow from the right: its first key goes up, the separator comes down
+      if (pRight != nullptr && pRight->numKeys > 1)
+      {
+         pNode->keys[0] = std::move(pParent->keys[child]);
+         pNode->children[1] = pRight->children[0];
+         if (pNode->children[1] != nullptr)
+            pNode->children[1]->pParent = pNode;
+         pNode->numKeys = 1;
+         pParent->keys[child] = std::move(pRight->keys[0]);
+         removeKey(pRight, 0, 0);
+         return;
+      }
+
+      // both neighbors have one key: merge with one around the separator
+      if (pLeft != nullptr)
+      {
+         pLeft->keys[1] = std::move(pParent->keys[child - 1]);
+         pLeft->children[2] = pNode->children[0];
+         if (pLeft->children[2] != nullptr)
+            pLeft->children[2]->pParent = pLeft;
+         pLeft->numKeys = 2;
+         removeKey(pParent, child - 1, child);
+      }
+      else
+      {
+         pRight->keys[1] = std::move(pRight->keys[0]);
+         pRight->children[2] = pRight->children[1];
+         pRight->children[1] = pRight->children[0];
+         pRight->keys[0] = std::move(pParent->keys[child]);
+         pRight->children[0] = pNode->children[0];
+         if (pRight->children[0] != nullptr)
+            pRight->children[0]->pParent = pRight;
+         pRight->numKeys = 2;
+         removeKey(pParent, child, child);
+      }
+      delete pNode;
+      pNode = pParent;
+   }
+}
+
+/*********************************************
+ * FAT TREE :: CLEAR NODE
+ * Delete a node and everything below it
+ ********************************************/
+template <typename T>
+void FatTree <T> :: clearNode(FNode * pNode)
+{
+   if (pNode == nullptr)
+      return;
+   for (int i = 0; i <= pNode->numKeys; i++)
+      clearNode(pNode->children[i]);
+   delete pNode;
+}
+
+} // namespace custom
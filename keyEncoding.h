@@ -0,0 +1,307 @@
+/***********************************************************************
+ * Header:
+ *    KEY ENCODING
+ * Summary:
+ *    Turn a composite key, such as (tenant, timestamp, id), into a string
+ *    of bytes whose memcmp order is the key's order, field by field. A
+ *    descent over encoded keys then compares bytes instead of calling a
+ *    comparator that branches on every field, and StringBST stores and
+ *    orders them as they are.
+ *
+ *    Integers are written big-endian with the sign bit flipped, so
+ *    negative numbers come before positive ones. Doubles are written as
+ *    their bits, with every bit flipped for negative numbers and only the
+ *    sign bit flipped otherwise; -0.0 is written as 0.0 and every NaN as
+ *    one NaN, after infinity. Strings end in 0x00 0x01 and write each
+ *    0x00 inside as 0x00 0xFF, so a string sorts before any longer string
+ *    it begins, whatever follows it.
+ *
+ *    Every field knows where it ends, so the encoding of the first few
+ *    fields is a prefix of the encoding of every key starting with them.
+ *    StringBST::prefix_range() turns that into a scan by tenant.
+ *
+ *    Keys made only of fixed-width fields can skip the arena: EncodedKey
+ *    holds them inline as big-endian words, so a BST<EncodedKey<N>>
+ *    compares a word at a time with no comparator per field.
+ *
+ *    This will contain the class definition of:
+ *        KeyEncoder         : Append fields to an order-preserving key
+ *        KeyDecoder         : Read the fields back out, in the same order
+ *        EncodedKey         : A fixed-width encoded key, stored inline
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include <cassert>    // for assert
+#include <cmath>      // for std::isnan
+#include <cstdint>    // for int32_t, int64_t and uint64_t
+#include <cstring>    // for memcpy
+#include <string>
+
+class TestKeyEncoding;  // forward declaration for unit tests
+
+namespace custom
+{
+
+/*****************************************************************
+ * KEY ENCODER
+ * Builds one encoded key a field at a time. The fields must be
+ * decoded in the order they were added, with the same types.
+ *****************************************************************/
+class KeyEncoder
+{
+   friend class ::TestKeyEncoding; // give unit tests access to the privates
+public:
+   KeyEncoder() {}
+
+   KeyEncoder & int32(int32_t value)
+   {
+      return bigEndian((uint32_t)value ^ 0x80000000u, 4);
+   }
+   KeyEncoder & int64(int64_t value)
+   {
+      return bigEndian((uint64_t)value ^ SIGN, 8);
+   }
+   KeyEncoder & uint64(uint64_t value)
+   {
+      return bigEndian(value, 8);
+   }
+   KeyEncoder & float64(double value);
+   KeyEncoder & string(const std::string & value);
+
+   const std::string & str() const { return bytes; }
+   void clear() { bytes.clear(); }
+
+   static std::string pastPrefix(const std::string & prefix);
+
+private:
+   static const uint64_t SIGN = (uint64_t)1 << 63;
+
+   // the low numBytes bytes of value, most significant first
+   KeyEncoder & bigEndian(uint64_t value, int numBytes)
+   {
+      for (int i = numBytes - 1; i >= 0; i--)
+         bytes.push_back((char)(unsigned char)(value >> (8 * i)));
+      return *this;
+   }
+
+   std::string bytes;
+};
+
+/*****************************************************************
+ * KEY DECODER
+ * Reads fields back out of an encoded key. Each read returns false,
+ * leaving the value alone, if the key ends or is malformed.
+ *****************************************************************/
+class KeyDecoder
+{
+public:
+   KeyDecoder(const std::string & bytes) : bytes(bytes), position(0) {}
+
+   bool int32(int32_t & value)
+   {
+      uint64_t bits;
+      if (!bigEndian(bits, 4))
+         return false;
+      value = (int32_t)((uint32_t)bits ^ 0x80000000u);
+      return true;
+   }
+   bool int64(int64_t & value)
+   {
+      uint64_t bits;
+      if (!bigEndian(bits, 8))
+         return false;
+      value = (int64_t)(bits ^ ((uint64_t)1 << 63));
+      return true;
+   }
+   bool uint64(uint64_t & value)
+   {
+      return bigEndian(value, 8);
+   }
+   bool float64(double & value);
+   bool string(std::string & value);
+
+   // every byte has been read
+   bool done() const { return position == bytes.size(); }
+
+private:
+   bool bigEndian(uint64_t & value, size_t numBytes)
+   {
+      if (bytes.size() - position < numBytes)
+         return false;
+      value = 0;
+      for (size_t i = 0; i < numBytes; i++)
+         value = (value << 8) | (unsigned char)bytes[position++];
+      return true;
+   }
+
+   const std::string & bytes;
+   size_t position;
+};
+
+/*****************************************************************
+ * ENCODED KEY
+ * Up to NUM_BYTES bytes of encoded key, zero padded and packed into
+ * big-endian words so that comparing the words in turn is comparing
+ * the bytes. Keys that differ only in trailing zeros are equal, so
+ * every key in one tree should have the same fields.
+ *****************************************************************/
+template <size_t NUM_BYTES>
+class EncodedKey
+{
+public:
+   static const size_t NUM_WORDS = (NUM_BYTES + 7) / 8;
+
+   EncodedKey() : words() {}
+   explicit EncodedKey(const std::string & bytes);
+
+   // the NUM_BYTES bytes, padding and all
+   std::string str() const;
+
+   bool operator < (const EncodedKey & rhs) const
+   {
+      for (size_t i = 0; i < NUM_WORDS; i++)
+         if (words[i] != rhs.words[i])
+            return words[i] < rhs.words[i];
+      return false;
+   }
+   bool operator == (const EncodedKey & rhs) const
+   {
+      for (size_t i = 0; i < NUM_WORDS; i++)
+         if (words[i] != rhs.words[i])
+            return false;
+      return true;
+   }
+   bool operator != (const EncodedKey & rhs) const { return !(*this == rhs); }
+
+private:
+   uint64_t words[NUM_WORDS];
+};
+
+/*********************************************
+ * KEY ENCODER :: PAST PREFIX
+ * The least string greater than every string that begins with prefix:
+ * prefix with its trailing 0xFF bytes dropped and the last byte left
+ * bumped up by one. Empty if there is none, as when prefix is all 0xFF.
+ ********************************************/
+inline std::string KeyEncoder :: pastPrefix(const std::string & prefix)
+{
+   std::string past = prefix;
+   while (!past.empty() && (unsigned char)past.back() == 0xFF)
+      past.pop_back();
+   if (!past.empty())
+      past.back() = (char)((unsigned char)past.back() + 1);
+   return past;
+}
+
+/*********************************************
+ * KEY ENCODER :: FLOAT64
+ * Flipping the sign bit puts positive numbers above negative ones, and
+ * flipping everything else for negative numbers puts the larger
+ * magnitudes lower
+ ********************************************/
+inline KeyEncoder & KeyEncoder :: float64(double value)
+{
+   uint64_t bits;
+   if (value == 0.0)
+      value = 0.0;   // -0.0 == 0.0, so they encode the same
+   std::memcpy(&bits, &value, sizeof(bits));
+   if (std::isnan(value))
+      bits = 0x7ff8000000000000ull;
+   bits = (bits & SIGN) ? ~bits : bits | SIGN;
+   return bigEndian(bits, 8);
+}
+
+/*********************************************
+ * KEY ENCODER :: STRING
+ * 0x00 becomes 0x00 0xFF and the end is 0x00 0x01, which is below
+ * 0x00 0xFF and below any byte but 0x00
+ ********************************************/
+inline KeyEncoder & KeyEncoder :: string(const std::string & value)
+{
+   for (char c : value)
+   {
+      bytes.push_back(c);
+      if (c == '\0')
+         bytes.push_back((char)0xFF);
+   }
+   bytes.push_back('\0');
+   bytes.push_back((char)0x01);
+   return *this;
+}
+
+/*********************************************
+ * KEY DECODER :: FLOAT64
+ ********************************************/
+inline bool KeyDecoder :: float64(double & value)
+{
+   const uint64_t SIGN = (uint64_t)1 << 63;
+   uint64_t bits;
+   if (!bigEndian(bits, 8))
+      return false;
+   bits = (bits & SIGN) ? bits ^ SIGN : ~bits;
+   std::memcpy(&value, &bits, sizeof(value));
+   return true;
+}
+
+/*********************************************
+ * KEY DECODER :: STRING
+ * Undo the escaping up to the 0x00 0x01 at the end
+ ********************************************/
+inline bool KeyDecoder :: string(std::string & value)
+{
+   std::string decoded;
+   for (size_t i = position; i < bytes.size(); i++)
+   {
+      if (bytes[i] != '\0')
+      {
+         decoded.push_back(bytes[i]);
+         continue;
+      }
+      if (i + 1 == bytes.size())
+         return false;
+      unsigned char next = (unsigned char)bytes[++i];
+      if (next == 0x01)
+      {
+         position = i + 1;
+         value.swap(decoded);
+         return true;
+      }
+      if (next != 0xFF)
+         return false;
+      decoded.push_back('\0');
+   }
+   return false;
+}
+
+/*********************************************
+ * ENCODED KEY :: CONSTRUCTOR
+ ********************************************/
+template <size_t NUM_BYTES>
+EncodedKey <NUM_BYTES> :: EncodedKey(const std::string & bytes)
+{
+   assert(bytes.size() <= NUM_BYTES);
+   for (size_t i = 0; i < NUM_WORDS; i++)
+   {
+      uint64_t word = 0;
+      for (size_t j = i * 8; j < i * 8 + 8; j++)
+         word = (word << 8) | (j < bytes.size() ? (unsigned char)bytes[j] : 0);
+      words[i] = word;
+   }
+}
+
+/*********************************************
+ * ENCODED KEY :: STR
+ ********************************************/
+template <size_t NUM_BYTES>
+std::string EncodedKey <NUM_BYTES> :: str() const
+{
+   std::string bytes(NUM_BYTES, '\0');
+   for (size_t j = 0; j < NUM_BYTES; j++)
+      bytes[j] = (char)(unsigned char)(words[j / 8] >> (8 * (7 - j % 8)));
+   return bytes;
+}
+
+} // namespace custom
@@ -0,0 +1,498 @@
+/***********************************************************************
+ * Header:
+ *    KEY RANGE LOCK
+ * Summary:
+ *    A BST that many threads can write at once, as long as they write in
+ *    different parts of the tree. There is no fixed set of shards: each
+ *    write works out, before it locks anything, which subtree it will
+ *    change, including the nodes balance() will recolor and rotate. It
+ *    then locks just the keys that subtree can hold. Writes whose ranges
+ *    do not overlap go ahead together. A write whose fix-up reaches the
+ *    top two levels locks every key, so it escalates to a lock on the
+ *    whole tree.
+ *
+ *    Working out the subtree means reading the path to the key. While a
+ *    thread reads, it holds an intent on its key. Nobody may lock a range
+ *    containing that key until the intent is dropped, so the path it read
+ *    is still there when it locks. A writer that finds its range taken by
+ *    another lock, or by an older intent, drops its own intent, waits for
+ *    something to change and starts over. A writer that finds only
+ *    younger intents in its range waits for them with its intent kept.
+ *    Either way, the oldest writer always gets through.
+ *
+ *    The tree's nodes are allocated one at a time, since a NodePair,
+ *    reserve() or relayout() block is shared by nodes that may end up in
+ *    different ranges. Like BST::erase, erase does not rebalance.
+ *
+ *    This will contain the class definition of:
+ *        KeyRangeLocks      : Locks on closed ranges of keys
+ *        RangeLockedBST     : A BST that writers lock by key range
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include "bst.h"
+
+#include <atomic>     // for std::atomic
+#include <condition_variable>
+#include <cstddef>    // for size_t
+#include <mutex>      // for std::mutex and std::unique_lock
+#include <utility>    // for std::declval
+#include <vector>
+
+class TestKeyRangeLock;  // forward declaration for unit tests
+
+namespace custom
+{
+
+/*****************************************************************
+ * KEY RANGE LOCKS
+ * Closed ranges of keys, each either held by a writer or an intent:
+ * the one key a thread is reading the path to. A bound of nullptr is
+ * no bound at all. The bounds point at keys that stay put while the
+ * lock is listed.
+ *****************************************************************/
+template <typename T>
+class KeyRangeLocks
+{
+   friend class ::TestKeyRangeLock; // give unit tests access to the privates
+public:
+   KeyRangeLocks() : lastTicket(0), generation(0) {}
+   KeyRangeLocks(const KeyRangeLocks &) = delete;
+   KeyRangeLocks & operator = (const KeyRangeLocks &) = delete;
+
+   // One thread's lock, released when it goes out of scope. Its ticket
+   // is handed out the first time it enters or acquires and kept across
+   // retries, so a write that has waited longer wins.
+   class Lock
+   {
+      friend class KeyRangeLocks;
+      friend class ::TestKeyRangeLock;
+   public:
+      explicit Lock(KeyRangeLocks & locks) : locks(locks), pLo(nullptr), pHi(nullptr),
+         ticket(0), isHeld(false), isListed(false) {}
+      Lock(const Lock &) = delete;
+      Lock & operator = (const Lock &) = delete;
+      ~Lock() { release(); }
+
+      void enter(const T & key);
+      bool acquire(const T * pLo, const T * pHi);
+      void release();
+
+   private:
+      KeyRangeLocks & locks;
+      const T * pLo;          // smallest key covered, nullptr for none
+      const T * pHi;          // largest key covered, nullptr for none
+      unsigned long ticket;   // lower is older, 0 before the first try
+      bool isHeld;            // a held range rather than an intent
+      bool isListed;          // in locks.listed
+   };
+
+   // do [pLo1, pHi1] and [pLo2, pHi2] have a key in common
+   static bool overlaps(const T * pLo1, const T * pHi1, const T * pLo2, const T * pHi2)
+   {
+      return !(pHi1 != nullptr && pLo2 != nullptr && *pHi1 < *pLo2) &&
+             !(pHi2 != nullptr && pLo1 != nullptr && *pHi2 < *pLo1);
+   }
+
+private:
+   void list(Lock & lock);
+   void unlist(Lock & lock);
+   void changed();
+   void waitForChange(std::unique_lock<std::mutex> & guard);
+
+   std::mutex mutex;                  // guards everything below
+   std::condition_variable cvChanged; // a lock was listed or unlisted
+   std::vector<Lock *> listed;        // held ranges and intents
+   unsigned long lastTicket;          // the newest ticket handed out
+   unsigned long generation;          // how many times listed has changed
+};
+
+/*****************************************************************
+ * RANGE LOCKED BST
+ * A BST that writers in different key ranges can change at once
+ *****************************************************************/
+template <typename T>
+class RangeLockedBST
+{
+   friend class ::TestKeyRangeLock; // give unit tests access to the privates
+public:
+   RangeLockedBST() : numElements(0) { bst.setAllocation(BST<T>::INDEPENDENT); }
+   RangeLockedBST(const RangeLockedBST &) = delete;
+   RangeLockedBST & operator = (const RangeLockedBST &) = delete;
+
+   bool   insert(const T & t, bool keepUnique = false);
+   bool   erase(const T & t);
+   bool   contains(const T & t) const;
+   size_t size() const noexcept { return numElements.load(); }
+
+   // Lock every key and run f on the tree, to iterate or anything else
+   // the methods above do not cover. f must not reserve, relayout,
+   // freeze or set a memory limit.
+   template <class F>
+   auto exclusive(F f) -> decltype(f(std::declval<BST<T> &>()))
+   {
+      typename KeyRangeLocks<T>::Lock lock(locks);
+      while (!lock.acquire(nullptr, nullptr))
+         ;
+      bst.numElements = numElements.load();
+      Recount recount(*this);
+      return f(bst);
+   }
+
+private:
+   typedef typename BST<T>::BNode BNode;
+
+   // a node on the way down, with the range of keys its subtree holds
+   struct Step
+   {
+      BNode * pNode;
+      const T * pLo;
+      const T * pHi;
+   };
+
+   // what a write will change, worked out before it locks anything
+   struct Plan
+   {
+      BNode * pNode;     // insert: where the new node hangs, erase: the node to remove
+      bool isRight;      // insert: which side it hangs on
+      const T * pLo;     // the range to lock, nullptr for no bound
+      const T * pHi;
+      bool isWhole;      // the root may change
+   };
+
+   // takes the count back from the tree once exclusive() is done with it
+   class Recount
+   {
+   public:
+      explicit Recount(RangeLockedBST & tree) : tree(tree) {}
+      ~Recount() { tree.numElements = tree.bst.numElements; }
+   private:
+      RangeLockedBST & tree;
+   };
+
+   bool planInsert(const T & t, bool keepUnique, Plan & plan) const;
+   bool planErase(const T & t, Plan & plan) const;
+   static void lockAbove(const std::vector<Step> & path, size_t depth, Plan & plan);
+
+   BST<T> bst;
+   std::atomic<size_t> numElements;   // bst.numElements is only kept during exclusive()
+   mutable KeyRangeLocks<T> locks;
+};
+
+/*********************************************
+ * KEY RANGE LOCKS :: LOCK :: ENTER
+ * Wait until no held range covers key, then list an intent on it
+ ********************************************/
+template <typename T>
+void KeyRangeLocks <T> :: Lock :: enter(const T & key)
+{
+   std::unique_lock<std::mutex> guard(locks.mutex);
+   if (ticket == 0)
+      ticket = ++locks.lastTicket;
+   while (true)
+   {
+      bool isCovered = false;
+      for (const Lock * pOther : locks.listed)
+         if (pOther->isHeld && overlaps(&key, &key, pOther->pLo, pOther->pHi))
+            isCovered = true;
+      if (!isCovered)
+         break;
+      locks.waitForChange(guard);
+   }
+   pLo = pHi = &key;
+   isHeld = false;
+   locks.list(*this);
+}
+
+/*********************************************
+ * KEY RANGE LOCKS :: LOCK :: ACQUIRE
+ * Turn the intent, if any, into a hold on [pLo, pHi]. Returns false,
+ * with nothing listed, if another lock or an older intent is in the
+ * way: the caller should enter and look again, as the tree changed.
+ ********************************************/
+template <typename T>
+bool KeyRangeLocks <T> :: Lock :: acquire(const T * pLo, const T * pHi)
+{
+   std::unique_lock<std::mutex> guard(locks.mutex);
+   if (ticket == 0)
+      ticket = ++locks.lastTicket;
+   while (true)
+   {
+      bool mustYield = false;
+      bool mustWait = false;
+      for (const Lock * pOther : locks.listed)
+         if (pOther != this && overlaps(pLo, pHi, pOther->pLo, pOther->pHi))
+         {
+            if (pOther->isHeld || pOther->ticket < ticket)
+               mustYield = true;
+            else
+               mustWait = true;
+         }
+
+      if (!mustYield && !mustWait)
+      {
+         this->pLo = pLo;
+         this->pHi = pHi;
+         isHeld = true;
+         if (!isListed)
+            locks.list(*this);
+         else
+            locks.changed();
+         return true;
+      }
+      if (mustYield)
+      {
+         if (isListed)
+            locks.unlist(*this);
+         locks.waitForChange(guard);
+         return false;
+      }
+
+      // only younger intents are in the way, and they will either lock
+      // something or get out of it
+      locks.waitForChange(guard);
+   }
+}
+
+/*********************************************
+ * KEY RANGE LOCKS :: LOCK :: RELEASE
+ * Drop the range or intent, if there is one
+ ********************************************/
+template <typename T>
+void KeyRangeLocks <T> :: Lock :: release()
+{
+   if (!isListed)
+      return;
+   std::lock_guard<std::mutex> guard(locks.mutex);
+   locks.unlist(*this);
+}
+
+/*********************************************
+ * KEY RANGE LOCKS :: LIST / UNLIST
+ * Add or remove a lock, waking whoever waits on it. Called with the
+ * mutex held.
+ ********************************************/
+template <typename T>
+void KeyRangeLocks <T> :: list(Lock & lock)
+{
+   listed.push_back(&lock);
+   lock.isListed = true;
+   changed();
+}
+
+template <typename T>
+void KeyRangeLocks <T> :: unlist(Lock & lock)
+{
+   for (size_t i = 0; i < listed.size(); i++)
+      if (listed[i] == &lock)
+      {
+         listed[i] = listed.back();
+         listed.pop_back();
+         break;
+      }
+   lock.isListed = false;
+   lock.isHeld = false;
+   changed();
+}
+
+template <typename T>
+void KeyRangeLocks <T> :: changed()
+{
+   generation++;
+   cvChanged.notify_all();
+}
+
+/*********************************************
+ * KEY RANGE LOCKS :: WAIT FOR CHANGE
+ * Sleep until the list changes
+ ********************************************/
+template <typename T>
+void KeyRangeLocks <T> :: waitForChange(std::unique_lock<std::mutex> & guard)
+{
+   unsigned long seen = generation;
+   cvChanged.wait(guard, [this, seen]() { return generation != seen; });
+}
+
+/*********************************************
+ * RANGE LOCKED BST :: INSERT
+ * Plan, lock the range the plan needs, then hang the node and balance
+ ********************************************/
+template <typename T>
+bool RangeLockedBST <T> :: insert(const T & t, bool keepUnique)
+{
+   typename KeyRangeLocks<T>::Lock lock(locks);
+   Plan plan;
+   do
+   {
+      lock.enter(t);
+      if (!planInsert(t, keepUnique, plan))
+         return false;
+   }
+   while (!lock.acquire(plan.pLo, plan.pHi));
+
+   if (plan.pNode == nullptr)
+   {
+      bst.root = bst.allocateNode(nullptr, false, t);
+      bst.root->written = bst.clock;
+      bst.root->isRed = false;
+   }
+   else
+   {
+      BNode * pNode = bst.attach(plan.pNode, plan.isRight, t);
+      if (plan.isWhole)
+      {
+         while (pNode->pParent != nullptr)
+            pNode = pNode->pParent;
+         bst.root = pNode;
+      }
+   }
+   numElements++;
+   return true;
+}
+
+/*********************************************
+ * RANGE LOCKED BST :: ERASE
+ * Plan, lock the range the plan needs, then take the node out
+ ********************************************/
+template <typename T>
+bool RangeLockedBST <T> :: erase(const T & t)
+{
+   typename KeyRangeLocks<T>::Lock lock(locks);
+   Plan plan;
+   do
+   {
+      lock.enter(t);
+      if (!planErase(t, plan))
+         return false;
+   }
+   while (!lock.acquire(plan.pLo, plan.pHi));
+
+   bst.detach(plan.pNode);
+   numElements--;
+   return true;
+}
+
+/*********************************************
+ * RANGE LOCKED BST :: CONTAINS
+ * An intent keeps writers out of the path while we read it
+ ********************************************/
+template <typename T>
+bool RangeLockedBST <T> :: contains(const T & t) const
+{
+   typename KeyRangeLocks<T>::Lock lock(locks);
+   lock.enter(t);
+   BNode * current = bst.root;
+   while (current != nullptr)
+   {
+      if (current->data == t)
+         return true;
+      current = current->child(current->data < t);
+   }
+   return false;
+}
+
+/*********************************************
+ * RANGE LOCKED BST :: PLAN INSERT
+ * Follow insert's path to the leaf, then play balance() through without
+ * writing to find the highest node it changes. Returns false if
+ * keepUnique and t is already there.
+ ********************************************/
+template <typename T>
+bool RangeLockedBST <T> :: planInsert(const T & t, bool keepUnique, Plan & plan) const
+{
+   // kept from one plan to the next so planning does not allocate
+   static thread_local std::vector<Step> path;
+   path.clear();
+   const T * pLo = nullptr;
+   const T * pHi = nullptr;
+   for (BNode * current = bst.root; current != nullptr; )
+   {
+      if (keepUnique && current->data == t)
+         return false;
+      path.push_back(Step{ current, pLo, pHi });
+      bool isRight = !(t < current->data);
+      (isRight ? pLo : pHi) = &current->data;
+      current = current->child(isRight);
+   }
+
+   if (path.empty())
+   {
+      plan = Plan{ nullptr, false, nullptr, nullptr, true };
+      return true;
+   }
+   plan.pNode = path.back().pNode;
+   plan.isRight = !(t < plan.pNode->data);
+
+   // The parent's link changes however the fix-up goes. Then while the
+   // aunt is red, balance() recolors and starts again from granny; when
+   // she is black it rotates and hangs the new top from granny's parent.
+   size_t depth = path.size();    // of the node being balanced
+   long top = (long)depth - 1;    // of the highest node written, -1 for the root pointer
+   while (depth >= 2 && path[depth - 1].pNode->isRed)
+   {
+      BNode * pParent = path[depth - 1].pNode;
+      BNode * pGranny = path[depth - 2].pNode;
+      BNode * pAunt = pGranny->child(pGranny->pLeft == pParent);
+      if (!BST<T>::isRedLink(pAunt))
+      {
+         top = (long)depth - 3;
+         break;
+      }
+      top = (long)depth - 2;
+      depth -= 2;
+   }
+   if (depth == 0)
+      top = -1;
+
+   // Lock the keys under the written node's parent as well, since a
+   // thread passing through the parent reads its children's colors.
+   lockAbove(path, (size_t)(top + 1), plan);
+   return true;
+}
+
+/*********************************************
+ * RANGE LOCKED BST :: PLAN ERASE
+ * Find the node the way find() does. Erasing it writes its parent's
+ * link and nothing higher. Returns false if t is not there.
+ ********************************************/
+template <typename T>
+bool RangeLockedBST <T> :: planErase(const T & t, Plan & plan) const
+{
+   static thread_local std::vector<Step> path;
+   path.clear();
+   const T * pLo = nullptr;
+   const T * pHi = nullptr;
+   for (BNode * current = bst.root; current != nullptr; )
+   {
+      path.push_back(Step{ current, pLo, pHi });
+      if (current->data == t)
+      {
+         plan.pNode = current;
+         plan.isRight = false;
+         lockAbove(path, path.size() - 1, plan);
+         return true;
+      }
+      bool isRight = current->data < t;
+      (isRight ? pLo : pHi) = &current->data;
+      current = current->child(isRight);
+   }
+   return false;
+}
+
+/*********************************************
+ * RANGE LOCKED BST :: LOCK ABOVE
+ * Set the plan to lock the range of the grandparent of the node at
+ * depth, or everything if that is above the root
+ ********************************************/
+template <typename T>
+void RangeLockedBST <T> :: lockAbove(const std::vector<Step> & path, size_t depth, Plan & plan)
+{
+   plan.isWhole = depth < 2;
+   plan.pLo = plan.isWhole ? nullptr : path[depth - 2].pLo;
+   plan.pHi = plan.isWhole ? nullptr : path[depth - 2].pHi;
+}
+
+} // namespace custom
@@ -0,0 +1,208 @@
+/***********************************************************************
+ * Header:
+ *    LEFT RIGHT
+ * Summary:
+ *    Two copies of a BST behind the left-right technique (Ramalhete and
+ *    Correia), so readers never wait and never take a lock. Readers go to
+ *    whichever copy leftRight points at. A writer, one at a time, changes
+ *    the other copy, points the readers at it, waits for the readers
+ *    still on the old copy to leave, then makes the same change there.
+ *
+ *    A read only increments and later decrements one counter, and the
+ *    counters are spread over cache lines by thread, so reads scale with
+ *    the number of cores. Writes do all their work twice and wait for
+ *    readers, which suits small and medium trees read far more often than
+ *    written. Unlike copying the path to each change, a write allocates
+ *    no more than the two inserts themselves.
+ *
+ *    A write is a function run once on each copy, so it must do the same
+ *    thing both times, and what it returns must not point into a copy.
+ *    The copies must not have a memory limit, since faulting a spilled
+ *    block back in is itself a write.
+ *
+ *    This will contain the class definition of:
+ *        ReadIndicator      : How many readers are in one version
+ *        LeftRight          : A BST that many threads can read at once
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include "bst.h"
+
+#include <atomic>     // for std::atomic
+#include <cstddef>    // for size_t
+#include <mutex>      // for std::mutex and std::lock_guard
+#include <thread>     // for std::this_thread::yield
+#include <utility>    // for std::declval and std::move
+
+class TestLeftRight;  // forward declaration for unit tests
+
+namespace custom
+{
+
+/*****************************************************************
+ * READ INDICATOR
+ * Counts the readers inside one version. Each thread arrives and
+ * departs on its own stripe, a cache line apart from the rest, so
+ * readers on different cores do not fight over one counter.
+ *****************************************************************/
+class ReadIndicator
+{
+public:
+   static const size_t NUM_STRIPES = 16;
+   static const size_t CACHE_LINE = 64;
+
+   ReadIndicator()
+   {
+      for (Stripe & s : stripes)
+         s.count.store(0, std::memory_order_relaxed);
+   }
+   ReadIndicator(const ReadIndicator &) = delete;
+   ReadIndicator & operator = (const ReadIndicator &) = delete;
+
+   void arrive(size_t stripe) { stripes[stripe].count.fetch_add(1, std::memory_order_seq_cst); }
+   void depart(size_t stripe) { stripes[stripe].count.fetch_sub(1, std::memory_order_release); }
+
+   // no reader is inside
+   bool isEmpty() const
+   {
+      for (const Stripe & s : stripes)
+         if (s.count.load(std::memory_order_acquire) != 0)
+            return false;
+      return true;
+   }
+
+   // this thread's stripe, handed out in turn the first time it asks
+   static size_t stripe()
+   {
+      static std::atomic<size_t> next(0);
+      static thread_local size_t mine = next.fetch_add(1, std::memory_order_relaxed) % NUM_STRIPES;
+      return mine;
+   }
+
+private:
+   struct Stripe
+   {
+      std::atomic<long> count;
+      char padding[CACHE_LINE - sizeof(std::atomic<long>)];
+   };
+   Stripe stripes[NUM_STRIPES];
+};
+
+/*****************************************************************
+ * LEFT RIGHT
+ * A BST with wait-free reads and one writer at a time
+ *****************************************************************/
+template <typename T>
+class LeftRight
+{
+   friend class ::TestLeftRight; // give unit tests access to the privates
+public:
+   LeftRight() : leftRight(0), versionIndex(0) {}
+   LeftRight(const LeftRight &) = delete;
+   LeftRight & operator = (const LeftRight &) = delete;
+
+   //
+   // Read
+   //
+
+   // run f on the copy readers are using and return what it returns
+   template <class F>
+   auto read(F f) const -> decltype(f(std::declval<const BST<T> &>()))
+   {
+      size_t stripe = ReadIndicator::stripe();
+      int version = versionIndex.load(std::memory_order_seq_cst);
+      Departure departure(readIndicators[version], stripe);
+      return f(instances[leftRight.load(std::memory_order_seq_cst)]);
+   }
+
+   bool contains(const T & t) const
+   {
+      return read([&t](const BST<T> & bst)
+      {
+         auto it = bst.lower_bound(t);
+         return it != bst.end() && !(t < *it);
+      });
+   }
+   size_t size() const
+   {
+      return read([](const BST<T> & bst) { return bst.size(); });
+   }
+
+   //
+   // Write
+   //
+
+   // run f on both copies, one after the other, and return what it
+   // returned the second time
+   template <class F>
+   auto write(F f) -> decltype(f(std::declval<BST<T> &>()))
+   {
+      std::lock_guard<std::mutex> lock(writerMutex);
+      int side = leftRight.load(std::memory_order_relaxed);
+      f(instances[1 - side]);
+      leftRight.store(1 - side, std::memory_order_seq_cst);
+      toggleVersionAndWait();
+      return f(instances[side]);
+   }
+
+   bool insert(const T & t, bool keepUnique = false)
+   {
+      return write([&](BST<T> & bst) { return bst.insert(t, keepUnique).second; });
+   }
+   bool erase(const T & t)
+   {
+      return write([&t](BST<T> & bst)
+      {
+         auto it = bst.lower_bound(t);
+         if (it == bst.end() || t < *it)
+            return false;
+         bst.erase(it);
+         return true;
+      });
+   }
+   void clear()
+   {
+      write([](BST<T> & bst) { bst.clear(); });
+   }
+
+private:
+   // leaves its version's read indicator however the read ends
+   class Departure
+   {
+   public:
+      Departure(ReadIndicator & indicator, size_t stripe) : indicator(indicator), stripe(stripe)
+      {
+         indicator.arrive(stripe);
+      }
+      ~Departure() { indicator.depart(stripe); }
+   private:
+      ReadIndicator & indicator;
+      size_t stripe;
+   };
+
+   // Move new readers to the other version, then wait until nobody who
+   // might have seen the old leftRight is still reading. Waiting on the
+   // next version first catches readers that read versionIndex before
+   // the last toggle but arrived after it.
+   void toggleVersionAndWait()
+   {
+      int previous = versionIndex.load(std::memory_order_relaxed);
+      int next = 1 - previous;
+      while (!readIndicators[next].isEmpty())
+         std::this_thread::yield();
+      versionIndex.store(next, std::memory_order_seq_cst);
+      while (!readIndicators[previous].isEmpty())
+         std::this_thread::yield();
+   }
+
+   BST<T> instances[2];                      // the two copies
+   std::atomic<int> leftRight;               // the copy readers use
+   std::atomic<int> versionIndex;            // the read indicator new readers arrive on
+   mutable ReadIndicator readIndicators[2];  // readers on each version
+   std::mutex writerMutex;                   // one writer at a time
+};
+
+} // namespace custom
@@ -0,0 +1,406 @@
+/***********************************************************************
+ * Header:
+ *    ORDER BOOK
+ * Summary:
+ *    The two sides of a limit order book, each a BST of price levels
+ *    with a first-in first-out list of orders at every level. Most of a
+ *    matching engine's traffic is at or near the best price, so the book
+ *    keeps the node of each side's best level: reading the top of the
+ *    book follows one pointer, and a level that empties at the top hands
+ *    the title to its in-order successor without a descent.
+ *
+ *    Both sides are ordered so that the best level is the leftmost node:
+ *    asks by price, bids by the negated price. The leftmost node's
+ *    ancestors are all on the left spine, so a new or existing level a
+ *    few ticks from the best is found by climbing the spine from the best
+ *    node only as far as the price needs, then descending as insert()
+ *    would, which is the hint std::map::insert takes but from the end of
+ *    the tree where the work is.
+ *
+ *    Orders are linked into their level through pointers in the orders
+ *    themselves, and come from a pool of chunks with a free list, so
+ *    adding and removing an order never calls the allocator once the pool
+ *    is big enough. The levels' nodes are reserved the same way. A
+ *    pointer to an order is a handle to it until it is canceled or filled
+ *    in full.
+ *
+ *    Prices are in ticks. The book's BSTs are never frozen or spilled.
+ *
+ *    This will contain the class definition of:
+ *        OrderBook          : Bids and asks by price, orders in time priority
+ *        OrderBook::Order   : One resting order
+ *        OrderBook::Level   : The orders at one price on one side
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include "bst.h"
+
+#include <cstdint>    // for int64_t and uint64_t
+#include <vector>
+
+class TestOrderBook;  // forward declaration for unit tests
+
+namespace custom
+{
+
+/*****************************************************************
+ * ORDER BOOK
+ * Resting orders on both sides, and matching against them
+ *****************************************************************/
+class OrderBook
+{
+   friend class ::TestOrderBook; // give unit tests access to the privates
+public:
+   enum Side { BID, ASK };
+
+   struct Level;
+
+   // a resting order; id, price and side are the caller's to read
+   class Order
+   {
+      friend class OrderBook;
+      friend class ::TestOrderBook;
+   public:
+      uint64_t id;
+      int64_t price;
+      int64_t quantity;    // still to fill
+      Side side;
+
+   private:
+      Order * pNext;       // behind this one at its level, or the next free order
+      Order * pPrev;       // ahead of this one at its level
+      Level * pLevel;
+   };
+
+   // the orders at one price on one side, oldest first
+   struct Level
+   {
+      int64_t key;         // price for asks, -price for bids, so the best is least
+      int64_t price;
+      int64_t quantity;    // the sum over the orders
+      size_t numOrders;
+      Order * pHead;
+      Order * pTail;
+      void * pNode;        // the BNode this level is in
+
+      const Order * front() const { return pHead; }
+
+      bool operator <  (const Level & rhs) const { return key <  rhs.key; }
+      bool operator == (const Level & rhs) const { return key == rhs.key; }
+   };
+
+   //
+   // Construct
+   //
+
+   OrderBook() : numOrdersLive(0)
+   {
+      pBest[BID] = pBest[ASK] = nullptr;
+   }
+   OrderBook(const OrderBook &) = delete;
+   OrderBook & operator = (const OrderBook &) = delete;
+
+   // room for numOrders orders and numLevels levels on each side
+   void reserve(size_t numOrders, size_t numLevels)
+   {
+      pool.reserve(numOrders);
+      sides[BID].reserve(numLevels);
+      sides[ASK].reserve(numLevels);
+   }
+
+   //
+   // Access
+   //
+
+   // the best level on one side in O(1), or nullptr if the side is empty
+   const Level * best(Side side) const
+   {
+      return pBest[side] == nullptr ? nullptr : &pBest[side]->data;
+   }
+
+   //
+   // Orders
+   //
+
+   Order * add(Side side, int64_t price, int64_t quantity, uint64_t id);
+   void cancel(Order * pOrder);
+   void reduce(Order * pOrder, int64_t quantity);
+   template <class OnFill>
+   int64_t match(Side side, int64_t limit, int64_t quantity, OnFill onFill);
+
+   //
+   // Status
+   //
+
+   size_t numLevels(Side side) const noexcept { return sides[side].size(); }
+   size_t numOrders()          const noexcept { return numOrdersLive;      }
+
+private:
+   typedef BST<Level>::BNode BNode;
+
+   /*****************************************************************
+    * ORDER POOL
+    * Orders carved out of chunks, growing by as many orders as there
+    * already are, with the free ones linked through pNext
+    *****************************************************************/
+   class OrderPool
+   {
+   public:
+      static const size_t FIRST_CHUNK = 64;   // orders in the first chunk
+
+      OrderPool() : pFree(nullptr), numSlots(0) {}
+      OrderPool(const OrderPool &) = delete;
+      OrderPool & operator = (const OrderPool &) = delete;
+      ~OrderPool()
+      {
+         for (Order * pChunk : chunks)
+            delete [] pChunk;
+      }
+
+      Order * take()
+      {
+         if (pFree == nullptr)
+            grow(numSlots == 0 ? FIRST_CHUNK : numSlots);
+         Order * pOrder = pFree;
+         pFree = pOrder->pNext;
+         return pOrder;
+      }
+
+      void give(Order * pOrder)
+      {
+         pOrder->pNext = pFree;
+         pFree = pOrder;
+      }
+
+      void reserve(size_t n)
+      {
+         if (n > numSlots)
+            grow(n - numSlots);
+      }
+
+   private:
+      void grow(size_t count)
+      {
+         Order * pChunk = new Order[count];
+         chunks.push_back(pChunk);
+         numSlots += count;
+         for (size_t i = count; i > 0; i--)
+            give(&pChunk[i - 1]);
+      }
+
+      std::vector<Order *> chunks;  // everything we got from new
+      Order * pFree;                // the free list
+      size_t numSlots;              // orders in all the chunks, free or not
+   };
+
+   static int64_t keyOf(Side side, int64_t price) { return side == BID ? -price : price; }
+
+   Level & levelAt(Side side, int64_t price);
+   void eraseLevel(Side side, Level & level);
+   Level & unlink(Order * pOrder);
+
+   BST<Level> sides[2];   // the levels, best first, by Side
+   BNode * pBest[2];      // the leftmost node of each side
+   OrderPool pool;        // the orders
+   size_t numOrdersLive;  // orders resting on either side
+};
+
+/*********************************************
+ * ORDER BOOK :: ADD
+ * Rest an order at the back of its level, making the level if this is
+ * the first order at that price. Nothing is matched: call match()
+ * first for an order that may cross.
+ ********************************************/
+inline OrderBook::Order * OrderBook :: add(Side side, int64_t price, int64_t quantity, uint64_t id)
+{
+   Level & level = levelAt(side, price);
+   Order * pOrder = pool.take();
+   pOrder->id = id;
+   pOrder->price = price;
+   pOrder->quantity = quantity;
+   pOrder->side = side;
+   pOrder->pNext = nullptr;
+   pOrder->pPrev = level.pTail;
+   pOrder->pLevel = &level;
+   if (level.pTail != nullptr)
+      level.pTail->pNext = pOrder;
+   else
+      level.pHead = pOrder;
+   level.pTail = pOrder;
+   level.quantity += quantity;
+   level.numOrders++;
+   numOrdersLive++;
+   return pOrder;
+}
+
+/*********************************************
+ * ORDER BOOK :: CANCEL
+ * Take an order off the book. Its level goes if it was the last one
+ * there.
+ ********************************************/
+inline void OrderBook :: cancel(Order * pOrder)
+{
+   Side side = pOrder->side;
+   Level & level = unlink(pOrder);
+   pool.give(pOrder);
+   if (level.pHead == nullptr)
+      eraseLevel(side, level);
+}
+
+/*********************************************
+ * ORDER BOOK :: REDUCE
+ * Take quantity off an order without losing its place in line. An
+ * order reduced to nothing is canceled.
+ ********************************************/
+inline void OrderBook :: reduce(Order * pOrder, int64_t quantity)
+{
+   if (quantity >= pOrder->quantity)
+   {
+      cancel(pOrder);
+      return;
+   }
+   pOrder->quantity -= quantity;
+   pOrder->pLevel->quantity -= quantity;
+}
+
+/*********************************************
+ * ORDER BOOK :: MATCH
+ * An incoming order on side takes from the best levels on the other
+ * side, oldest order first, for as long as their prices are no worse
+ * than limit and it has quantity left. onFill(maker, filled) is called
+ * for every fill with the resting order as it was before the fill; a
+ * maker filled in full is then gone. Returns the quantity not filled,
+ * which the caller may add() to rest.
+ ********************************************/
+template <class OnFill>
+int64_t OrderBook :: match(Side side, int64_t limit, int64_t quantity, OnFill onFill)
+{
+   Side other = (side == BID ? ASK : BID);
+   while (quantity > 0 && pBest[other] != nullptr)
+   {
+      Level & level = pBest[other]->data;
+      if (side == BID ? limit < level.price : level.price < limit)
+         break;
+      while (quantity > 0 && level.pHead != nullptr)
+      {
+         Order * pOrder = level.pHead;
+         int64_t filled = (quantity < pOrder->quantity ? quantity : pOrder->quantity);
+         onFill(static_cast<const Order &>(*pOrder), filled);
+         quantity -= filled;
+         if (filled == pOrder->quantity)
+         {
+            unlink(pOrder);
+            pool.give(pOrder);
+         }
+         else
+         {
+            pOrder->quantity -= filled;
+            level.quantity -= filled;
+         }
+      }
+      if (level.pHead == nullptr)
+         eraseLevel(other, level);
+   }
+   return quantity;
+}
+
+/*********************************************
+ * ORDER BOOK :: LEVEL AT
+ * The level at price on side, made if it is not there. The climb from
+ * the best node stops at the first ancestor the price is below, since
+ * everything under its left child is below it too, and the descent
+ * from there is insert's, comparing == first as find does.
+ ********************************************/
+inline OrderBook::Level & OrderBook :: levelAt(Side side, int64_t price)
+{
+   BST<Level> & bst = sides[side];
+   Level level{ keyOf(side, price), price, 0, 0, nullptr, nullptr, nullptr };
+
+   if (bst.root == nullptr)
+   {
+      bst.clock++;
+      bst.root = bst.allocateNode(nullptr, false, level);
+      bst.root->written = bst.clock;
+      bst.root->isRed = false;
+      bst.numElements++;
+      bst.root->data.pNode = bst.root;
+      pBest[side] = bst.root;
+      return bst.root->data;
+   }
+
+   BNode * pNode = pBest[side];
+   while (pNode->pParent != nullptr && !(level.key < pNode->pParent->data.key))
+      pNode = pNode->pParent;
+
+   bool isRight;
+   while (true)
+   {
+      if (pNode->data.key == level.key)
+         return pNode->data;
+      isRight = pNode->data.key < level.key;
+      if (pNode->child(isRight) == nullptr)
+         break;
+      pNode = pNode->child(isRight);
+   }
+
+   bst.clock++;
+   BNode * pNew = bst.attach(pNode, isRight, level);
+   pNew->data.pNode = pNew;
+   bst.numElements++;
+   // a rotation at the top leaves the old root under the new one
+   while (bst.root->pParent != nullptr)
+      bst.root = bst.root->pParent;
+   if (level.key < pBest[side]->data.key)
+      pBest[side] = pNew;
+   return pNew->data;
+}
+
+/*********************************************
+ * ORDER BOOK :: ERASE LEVEL
+ * Remove an empty level. If it was the best, the next best is its
+ * in-order successor: the leftmost node has no left child, so that is
+ * the leftmost of its right subtree, or else its parent.
+ ********************************************/
+inline void OrderBook :: eraseLevel(Side side, Level & level)
+{
+   BNode * pNode = static_cast<BNode *>(level.pNode);
+   if (pNode == pBest[side])
+   {
+      BNode * pNext = pNode->pRight;
+      if (pNext == nullptr)
+         pNext = pNode->pParent;
+      else
+         while (pNext->pLeft != nullptr)
+            pNext = pNext->pLeft;
+      pBest[side] = pNext;
+   }
+   BST<Level>::iterator it(pNode);
+   sides[side].erase(it);
+}
+
+/*********************************************
+ * ORDER BOOK :: UNLINK
+ * Take an order out of its level's list and totals, leaving the level
+ * in place even if it is now empty
+ ********************************************/
+inline OrderBook::Level & OrderBook :: unlink(Order * pOrder)
+{
+   Level & level = *pOrder->pLevel;
+   if (pOrder->pPrev != nullptr)
+      pOrder->pPrev->pNext = pOrder->pNext;
+   else
+      level.pHead = pOrder->pNext;
+   if (pOrder->pNext != nullptr)
+      pOrder->pNext->pPrev = pOrder->pPrev;
+   else
+      level.pTail = pOrder->pPrev;
+   level.quantity -= pOrder->quantity;
+   level.numOrders--;
+   numOrdersLive--;
+   return level;
+}
+
+} // namespace custom
@@ -0,0 +1,76 @@
+/***********************************************************************
+ * Header:
+ *    ORDERED CONTAINER
+ * Summary:
+ *    The interface shared by every ordered-container backend, so any one
+ *    of them can be dropped in wherever a BST is used:
+ *
+ *        insert(t, keepUnique)    -> std::pair<iterator, bool>
+ *        find(t)                  -> iterator, end() when missing
+ *        lower_bound(t)           -> first element not less than t
+ *        upper_bound(t)           -> first element greater than t
+ *        erase(iterator &)        -> iterator to the following element
+ *        begin(), end()           -> in-order iteration with ++ and *
+ *        clear(), empty(), size()
+ *
+ *    Duplicates are allowed unless keepUnique is set, and equal elements
+ *    iterate in the order they were inserted. The backends are:
+ *
+ *        BST          : red-black tree                 (bst.h)
+ *        SortedVector : one contiguous sorted array    (sortedVector.h)
+ *        BPlusTree    : B+ tree with linked leaves     (bplusTree.h)
+ *        SkipList     : lock-free skip list            (skipList.h)
+ *        FatTree      : 2-3-4 tree of up to 3 keys     (fatTree.h)
+ *        YFastTrie    : integer buckets under a trie   (yFastTrie.h)
+ *
+ *    isOrderedContainer<C, T> checks the interface at compile time.
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include <type_traits>  // for std::true_type and std::false_type
+#include <utility>      // for std::declval and std::pair
+
+namespace custom
+{
+
+/*****************************************************************
+ * VOID TYPE
+ * Maps any set of well-formed types onto void (std::void_t in C++17)
+ *****************************************************************/
+template <typename ...>
+struct voidType
+{
+   typedef void type;
+};
+
+/*****************************************************************
+ * IS ORDERED CONTAINER
+ * True when C provides the ordered-container interface over T
+ *****************************************************************/
+template <typename C, typename T, typename = void>
+struct isOrderedContainer : std::false_type {};
+
+template <typename C, typename T>
+struct isOrderedContainer <C, T, typename voidType <
+   decltype(std::declval<C &>().insert(std::declval<const T &>(), true)),
+   decltype(std::declval<C &>().find(std::declval<const T &>())),
+   decltype(std::declval<C &>().lower_bound(std::declval<const T &>())),
+   decltype(std::declval<C &>().upper_bound(std::declval<const T &>())),
+   decltype(std::declval<C &>().erase(std::declval<typename C::iterator &>())),
+   decltype(std::declval<const C &>().begin() != std::declval<const C &>().end()),
+   decltype(++std::declval<typename C::iterator &>()),
+   decltype(std::declval<C &>().clear()),
+   decltype(std::declval<const C &>().empty()),
+   decltype(std::declval<const C &>().size())
+>::type> : std::integral_constant<bool,
+   std::is_same<decltype(std::declval<C &>().insert(std::declval<const T &>(), true)),
+                std::pair<typename C::iterator, bool>>::value &&
+   std::is_same<decltype(std::declval<C &>().find(std::declval<const T &>())),
+                typename C::iterator>::value &&
+   std::is_convertible<decltype(*std::declval<typename C::iterator &>()), const T &>::value>
+{};
+
+} // namespace custom
@@ -0,0 +1,148 @@
+/***********************************************************************
+ * Header:
+ *    PERF COUNTERS
+ * Summary:
+ *    Read the CPU's hardware performance counters around a region of
+ *    code with Linux perf_event_open: cycles, instructions, L1 data and
+ *    last-level cache misses, data TLB misses and branch misses.
+ *
+ *    Every counter is opened on its own, so one the CPU or kernel does
+ *    not offer just reads as unavailable. Where perf_event_open is not
+ *    allowed at all (containers, perf_event_paranoid, non-Linux builds)
+ *    nothing is available and callers fall back to wall-clock time.
+ *
+ *    Counters follow the thread that opened them into every thread it
+ *    starts afterwards, so a region that runs worker threads counts all
+ *    of them, not just the thread waiting in join(). Open them before
+ *    starting any worker.
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include <cstdint>    // for uint64_t
+
+#ifdef __linux__
+#include <linux/perf_event.h>  // for perf_event_attr
+#include <sys/ioctl.h>         // for ioctl
+#include <sys/syscall.h>       // for SYS_perf_event_open
+#include <unistd.h>            // for syscall, read and close
+#include <cstring>             // for memset
+#endif // __linux__
+
+/*************************************************************
+ * PERF COUNTERS
+ * A set of hardware counters that can be started and stopped
+ *************************************************************/
+class PerfCounters
+{
+public:
+   enum { CYCLES,           // CPU cycles
+          INSTRUCTIONS,     // instructions retired
+          L1D_MISSES,       // L1 data cache read misses
+          LLC_MISSES,       // last-level cache read misses
+          DTLB_MISSES,      // data TLB read misses
+          BRANCH_MISSES,    // mispredicted branches
+          NUM_COUNTERS };
+
+   PerfCounters()
+   {
+      for (int i = 0; i < NUM_COUNTERS; i++)
+      {
+         fds[i] = -1;
+         values[i] = 0;
+      }
+#ifdef __linux__
+      fds[CYCLES]        = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+      fds[INSTRUCTIONS]  = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+      fds[L1D_MISSES]    = open(PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D));
+      fds[LLC_MISSES]    = open(PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL));
+      fds[DTLB_MISSES]   = open(PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_DTLB));
+      fds[BRANCH_MISSES] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif // __linux__
+   }
+
+   ~PerfCounters()
+   {
+#ifdef __linux__
+      for (int i = 0; i < NUM_COUNTERS; i++)
+         if (fds[i] >= 0)
+            close(fds[i]);
+#endif // __linux__
+   }
+
+   PerfCounters(const PerfCounters &) = delete;
+   PerfCounters & operator = (const PerfCounters &) = delete;
+
+   // zero the counters and start counting
+   void start()
+   {
+#ifdef __linux__
+      for (int i = 0; i < NUM_COUNTERS; i++)
+         if (fds[i] >= 0)
+         {
+            ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+         }
+#endif // __linux__
+   }
+
+   // stop counting and take a reading
+   void stop()
+   {
+#ifdef __linux__
+      for (int i = 0; i < NUM_COUNTERS; i++)
+         if (fds[i] >= 0)
+         {
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t value = 0;
+            if (read(fds[i], &value, sizeof(value)) == (ssize_t)sizeof(value))
+               values[i] = value;
+         }
+#endif // __linux__
+   }
+
+   bool isAvailable(int counter) const { return fds[counter] >= 0; }
+   bool anyAvailable() const
+   {
+      for (int i = 0; i < NUM_COUNTERS; i++)
+         if (isAvailable(i))
+            return true;
+      return false;
+   }
+   uint64_t get(int counter) const { return values[counter]; }
+
+private:
+#ifdef __linux__
+   // a read miss in one of the caches
+   static uint64_t cache(uint64_t which)
+   {
+      return which |
+             (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+   }
+
+   // open one counter for this thread, user space only, starting disabled.
+   // It is inherited by every thread started after it is opened, so a
+   // region that spawns workers counts their work too: a worker's counts
+   // are added when it exits, which a region that joins its workers sees
+   static int open(uint32_t type, uint64_t config)
+   {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = type;
+      attr.config = config;
+      attr.disabled = 1;
+      attr.inherit = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      return (int)syscall(SYS_perf_event_open, &attr, 0 /*this thread*/,
+                          -1 /*any cpu*/, -1 /*no group*/, 0 /*flags*/);
+   }
+#endif // __linux__
+
+   int fds[NUM_COUNTERS];           // one file descriptor per counter, -1 if unavailable
+   uint64_t values[NUM_COUNTERS];   // the last reading
+};
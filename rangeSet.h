@@ -0,0 +1,337 @@
+/***********************************************************************
+ * Header:
+ *    RANGE SET
+ * Summary:
+ *    A set of values kept as disjoint half-open intervals [lo, hi), for
+ *    IDs and addresses that are handed out in runs. Each interval is one
+ *    element of a BST ordered by lo, so a million consecutive IDs cost
+ *    one node rather than a million.
+ *
+ *    Inserting merges the new interval with every interval it overlaps or
+ *    touches, and erasing cuts a hole, splitting the interval it lands in
+ *    if it has to. Either way the intervals stay disjoint and never
+ *    adjacent, so there is exactly one way to write any set. Growing an
+ *    interval at its top end, the usual case for IDs handed out in order,
+ *    changes hi in place through BST::upsert() without rebalancing.
+ *
+ *    BST::erase() does not rebalance, so merges and splits slowly leave
+ *    the tree deeper than a red-black tree would be. Once there have been
+ *    more erases than there are intervals, the insert or erase that did
+ *    the last one rebuilds the tree perfectly balanced, in time linear in
+ *    the number of intervals: O(1) per erase, amortized. The drift never
+ *    builds up over more than r erases for r intervals, so contains()
+ *    stays close to log r. A rebuild invalidates iterators.
+ *
+ *    T needs <, and - for firstGap(). Values are counted as T, so a set
+ *    of ints cannot reach past the largest int.
+ *
+ *    This will contain the class definition of:
+ *        RangeSet           : A set of values stored as coalesced intervals
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include "bst.h"
+
+#include <vector>
+
+class TestRangeSet;  // forward declaration for unit tests
+
+namespace custom
+{
+
+/*****************************************************************
+ * RANGE SET
+ * Disjoint, non-adjacent intervals of T in a BST ordered by lo
+ *****************************************************************/
+template <typename T>
+class RangeSet
+{
+   friend class ::TestRangeSet; // give unit tests access to the privates
+public:
+   // the values lo, lo + 1, ... up to but not including hi
+   struct Interval
+   {
+      T lo;
+      T hi;
+      // the intervals in a set never share a lo, so lo is the key
+      bool operator <  (const Interval & rhs) const { return lo < rhs.lo; }
+      bool operator == (const Interval & rhs) const { return !(lo < rhs.lo) && !(rhs.lo < lo); }
+   };
+
+   typedef typename BST<Interval>::iterator iterator;
+
+   RangeSet() : numErased(0) {}
+
+   //
+   // Iterator
+   //
+
+   iterator begin() const noexcept { return bst.begin(); }
+   iterator end()   const noexcept { return bst.end();   }
+
+   //
+   // Access
+   //
+
+   bool contains(const T & value) const;
+   iterator find(const T & value) const;
+   T firstGap(const T & length, const T & from = T()) const;
+
+   //
+   // Insert and remove
+   //
+
+   void insert(const T & value)   { insert(value, value + 1); }
+   void insert(const T & lo, const T & hi);
+   void erase(const T & value)    { erase(value, value + 1);  }
+   void erase(const T & lo, const T & hi);
+   void clear() noexcept { bst.clear(); numErased = 0; }
+
+   //
+   // Status
+   //
+
+   bool   empty() const noexcept { return bst.empty(); }
+   size_t size()  const noexcept { return bst.size();  }  // intervals, not values
+
+private:
+   static Interval probe(const T & value) { return Interval{ value, value }; }
+
+   iterator atOrBefore(const T & value) const;
+
+   // the first interval starting after the one at itPrev, which may be end()
+   iterator after(iterator itPrev) const
+   {
+      return itPrev == end() ? bst.begin() : ++itPrev;
+   }
+
+   // the interval starting at lo, which must be there, now ends at hi
+   void setHi(const T & lo, const T & hi)
+   {
+      bst.upsert(probe(lo),
+                 [&hi](const Interval & interval) { return Interval{ interval.lo, hi }; },
+                 [&hi](Interval & interval) { interval.hi = hi; });
+   }
+
+   // take an interval out of the tree, counting toward the next rebuild
+   iterator eraseInterval(iterator it)
+   {
+      numErased++;
+      return bst.erase(it);
+   }
+
+   // rebuild the tree balanced if enough erases have gone by
+   void rebalance()
+   {
+      if (numErased > bst.size())
+         rebuild();
+   }
+
+   void rebuild();
+   typename BST<Interval>::BNode * build(const Interval * pIntervals, size_t count,
+                                         size_t depth, size_t redDepth);
+
+   BST<Interval> bst;   // the intervals, by lo
+   size_t numErased;    // erases since the tree was last rebuilt
+};
+
+/*********************************************
+ * RANGE SET :: AT OR BEFORE
+ * The last interval starting at or before value, or end(), in one
+ * descent. The tree is never frozen, so every link is a node.
+ ********************************************/
+template <typename T>
+typename RangeSet <T> :: iterator RangeSet <T> :: atOrBefore(const T & value) const
+{
+   typename BST<Interval>::BNode * pResult = nullptr;
+   typename BST<Interval>::BNode * pNode = bst.root;
+   while (pNode != nullptr)
+   {
+      if (value < pNode->data.lo)
+         pNode = pNode->pLeft;
+      else
+      {
+         pResult = pNode;
+         pNode = pNode->pRight;
+      }
+   }
+   return iterator(pResult);
+}
+
+/*********************************************
+ * RANGE SET :: FIND
+ * The interval holding value, or end(). The last interval starting at
+ * or before value is the only one that can.
+ ********************************************/
+template <typename T>
+typename RangeSet <T> :: iterator RangeSet <T> :: find(const T & value) const
+{
+   iterator it = atOrBefore(value);
+   return (it != end() && value < (*it).hi) ? it : end();
+}
+
+/*********************************************
+ * RANGE SET :: CONTAINS
+ ********************************************/
+template <typename T>
+bool RangeSet <T> :: contains(const T & value) const
+{
+   return find(value) != end();
+}
+
+/*********************************************
+ * RANGE SET :: FIRST GAP
+ * The least value at or after from that starts length values none of
+ * which are in the set. This walks the intervals from from, so it
+ * takes as long as the number of gaps too short to use. Past the last
+ * interval everything is free.
+ ********************************************/
+template <typename T>
+T RangeSet <T> :: firstGap(const T & length, const T & from) const
+{
+   T lo = from;
+   iterator itPrev = atOrBefore(lo);
+   if (itPrev != end() && lo < (*itPrev).hi)
+      lo = (*itPrev).hi;
+   iterator it = after(itPrev);
+   for (; it != bst.end(); ++it)
+   {
+      // the gap [lo, it->lo) is long enough
+      if (!((*it).lo - lo < length))
+         return lo;
+      lo = (*it).hi;
+   }
+   return lo;
+}
+
+/*********************************************
+ * RANGE SET :: INSERT
+ * Add [lo, hi). An interval ending at or after lo that starts at or
+ * before it is grown in place; the ones starting inside the new
+ * interval or just past it are swallowed.
+ ********************************************/
+template <typename T>
+void RangeSet <T> :: insert(const T & lo, const T & hi)
+{
+   if (!(lo < hi))
+      return;
+   T first = lo;
+   T last = hi;
+
+   // the one interval that can start at or before lo and reach it
+   iterator itPrev = atOrBefore(lo);
+   bool isGrown = false;
+   if (itPrev != end() && !((*itPrev).hi < lo))
+   {
+      if (!((*itPrev).hi < hi))
+         return;  // already all there
+      first = (*itPrev).lo;
+      isGrown = true;
+   }
+   iterator it = after(itPrev);
+
+   // every interval starting from lo up to hi, which touches the end
+   while (it != bst.end() && !(last < (*it).lo))
+   {
+      if (last < (*it).hi)
+         last = (*it).hi;
+      it = eraseInterval(it);
+   }
+
+   if (isGrown)
+      setHi(first, last);
+   else
+      bst.insert(Interval{ first, last });
+   rebalance();
+}
+
+/*********************************************
+ * RANGE SET :: ERASE
+ * Remove [lo, hi). The interval starting before lo is cut short, and
+ * if it reached past hi its end goes back in as an interval of its
+ * own. Whatever starts inside [lo, hi) is removed, except any part
+ * past hi.
+ ********************************************/
+template <typename T>
+void RangeSet <T> :: erase(const T & lo, const T & hi)
+{
+   if (!(lo < hi))
+      return;
+
+   iterator itPrev = atOrBefore(lo);
+   iterator it = after(itPrev);
+   if (itPrev != end() && lo < (*itPrev).hi)
+   {
+      Interval prev = *itPrev;
+      // changing hi leaves the shape, and so it, alone
+      if (prev.lo < lo)
+         setHi(prev.lo, lo);
+      else
+         it = eraseInterval(itPrev);
+      if (hi < prev.hi)
+      {
+         bst.insert(Interval{ hi, prev.hi });
+         rebalance();
+         return;
+      }
+   }
+
+   while (it != bst.end() && (*it).lo < hi)
+   {
+      Interval next = *it;
+      it = eraseInterval(it);
+      if (hi < next.hi)
+      {
+         bst.insert(Interval{ hi, next.hi });
+         break;
+      }
+   }
+   rebalance();
+}
+
+/*********************************************
+ * RANGE SET :: REBUILD
+ * Put the intervals back as a perfectly balanced red-black tree: every
+ * level full but maybe the last, which is red, as Snapshot loads one
+ ********************************************/
+template <typename T>
+void RangeSet <T> :: rebuild()
+{
+   std::vector<Interval> intervals;
+   intervals.reserve(bst.size());
+   for (iterator it = bst.begin(); it != bst.end(); ++it)
+      intervals.push_back(*it);
+   bst.clear();
+
+   size_t levels = 0;   // full levels, which are the black ones
+   while (((size_t)2 << levels) - 1 <= intervals.size())
+      levels++;
+   bst.root = build(intervals.data(), intervals.size(), 0, levels);
+   bst.numElements = intervals.size();
+   numErased = 0;
+}
+
+/*********************************************
+ * RANGE SET :: BUILD
+ * A subtree of pIntervals[0..count) with the middle one on top
+ ********************************************/
+template <typename T>
+typename BST<typename RangeSet <T> :: Interval>::BNode * RangeSet <T> :: build(
+   const Interval * pIntervals, size_t count, size_t depth, size_t redDepth)
+{
+   if (count == 0)
+      return nullptr;
+   size_t middle = count / 2;
+   typename BST<Interval>::BNode * pNode = bst.allocateNode(nullptr, false, pIntervals[middle]);
+   pNode->isRed = (depth == redDepth);
+   pNode->pLeft = build(pIntervals, middle, depth + 1, redDepth);
+   pNode->pRight = build(pIntervals + middle + 1, count - middle - 1, depth + 1, redDepth);
+   BST<Interval>::setParent(pNode->pLeft, pNode);
+   BST<Interval>::setParent(pNode->pRight, pNode);
+   return pNode;
+}
+
+} // namespace custom
@@ -0,0 +1,736 @@
+/***********************************************************************
+ * Header:
+ *    SKIP LIST
+ * Summary:
+ *    An ordered container built from towers of forward links. Insert,
+ *    find and erase are lock-free: links are swung with compare-and-swap
+ *    and an erase first marks the victim's links, then any later search
+ *    that walks past it snips it out. It satisfies the same interface as
+ *    BST (see orderedContainer.h).
+ *
+ *    Equal elements are kept in insertion order by tagging every node
+ *    with a sequence number, so an erase can always find its exact node.
+ *
+ *    An erased node may still have a concurrent reader standing on it,
+ *    so it is retired rather than freed, and reclaimed by epoch: every
+ *    operation announces the epoch it started in, the epoch moves on
+ *    only when every thread inside an operation has caught up with it,
+ *    and a node retired in epoch e is freed once the epoch reaches e + 2,
+ *    when nobody who could have seen it is still reading. Every
+ *    RECLAIM_PERIOD erases one of them tries to move the epoch on and
+ *    frees what it can, so under churn the retired nodes stay a small
+ *    multiple of RECLAIM_PERIOD. A thread that stays inside an operation,
+ *    or holds a Guard, holds them all back until it leaves.
+ *
+ *    Operations protect themselves while they run. An iterator they hand
+ *    back is only protected while its thread holds a SkipList::Guard, so
+ *    a thread that keeps iterators while others erase must hold one for
+ *    as long as it uses them. clear(), copy and assignment are not safe
+ *    to run concurrently with anything else.
+ *
+ *    This will contain the class definition of:
+ *        Epoch              : Epoch-based reclamation shared by every SkipList
+ *        SkipList           : A lock-free skip list behind the BST interface
+ *        SkipList::iterator : A forward iterator through SkipList
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include <atomic>     // for std::atomic
+#include <cstddef>    // for size_t
+#include <cstdint>    // for std::uintptr_t
+#include <memory>     // for std::unique_ptr
+#include <mutex>      // for std::mutex and std::lock_guard
+#include <new>        // for placement new
+#include <utility>    // for std::pair
+#include <vector>
+
+class TestOrderedContainer;
+
+namespace custom
+{
+
+/*****************************************************************
+ * EPOCH
+ * The global epoch, and the epoch each thread inside an operation
+ * announced when it went in. Threads register the first time they
+ * enter and their records outlive them, as quiescent.
+ *****************************************************************/
+class Epoch
+{
+public:
+   static const unsigned long long QUIESCENT = ~0ull;   // not in an operation
+
+   // in an operation from construction to destruction; these nest
+   class Guard
+   {
+   public:
+      Guard()  { enter(); }
+      ~Guard() { leave(); }
+      Guard(const Guard &) = delete;
+      Guard & operator = (const Guard &) = delete;
+   };
+
+   static unsigned long long now() { return domain().global.load(); }
+
+   // move the epoch on if every thread in an operation has announced
+   // this one, and return the epoch as it is after
+   static unsigned long long tryAdvance()
+   {
+      Domain & dom = domain();
+      unsigned long long epoch = dom.global.load();
+      {
+         std::lock_guard<std::mutex> lock(dom.mutex);
+         for (const std::unique_ptr<Record> & pRecord : dom.records)
+         {
+            unsigned long long announced = pRecord->announced.load();
+            if (announced != QUIESCENT && announced != epoch)
+               return epoch;
+         }
+      }
+      dom.global.compare_exchange_strong(epoch, epoch + 1);
+      return dom.global.load();
+   }
+
+private:
+   struct Record
+   {
+      Record() : announced(QUIESCENT), depth(0) {}
+      std::atomic<unsigned long long> announced;  // written only by its thread
+      int depth;                                  // Guards this thread holds
+   };
+
+   struct Domain
+   {
+      Domain() : global(0) {}
+      std::atomic<unsigned long long> global;
+      std::mutex mutex;                           // for records
+      std::vector<std::unique_ptr<Record>> records;
+   };
+
+   static Domain & domain()
+   {
+      static Domain theDomain;
+      return theDomain;
+   }
+
+   // this thread's record, registered the first time it is asked for
+   static Record & record()
+   {
+      thread_local Record * pRecord = nullptr;
+      if (pRecord == nullptr)
+      {
+         Domain & dom = domain();
+         std::lock_guard<std::mutex> lock(dom.mutex);
+         dom.records.emplace_back(new Record);
+         pRecord = dom.records.back().get();
+      }
+      return *pRecord;
+   }
+
+   static void enter()
+   {
+      Record & rec = record();
+      if (rec.depth++ == 0)
+         rec.announced.store(domain().global.load());
+   }
+
+   static void leave()
+   {
+      Record & rec = record();
+      if (--rec.depth == 0)
+         rec.announced.store(QUIESCENT);
+   }
+};
+
+/*****************************************************************
+ * SKIP LIST
+ * A lock-free skip list that can stand in for a BST
+ *****************************************************************/
+template <typename T>
+class SkipList
+{
+   friend class ::TestOrderedContainer;
+
+   class SNode;
+   typedef std::atomic<std::uintptr_t> Link;  // an SNode * with a mark bit
+public:
+   // tallest tower; with 1-in-4 promotion this covers 4^16 elements
+   static const int MAX_LEVEL = 16;
+
+   // erases between attempts to free retired nodes
+   static const size_t RECLAIM_PERIOD = 64;
+
+   // keeps this thread's iterators readable while other threads erase
+   typedef Epoch::Guard Guard;
+
+   //
+   // Construct
+   //
+
+   SkipList();
+   SkipList(const SkipList &  rhs) : SkipList() { *this = rhs; }
+   SkipList(      SkipList && rhs) : SkipList() { swap(rhs); }
+   SkipList(const std::initializer_list<T>& il) : SkipList()
+   {
+      for (auto& element : il)
+         insert(element);
+   }
+   ~SkipList() { clear(); }
+
+   //
+   // Assign
+   //
+
+   SkipList & operator = (const SkipList & rhs);
+   SkipList & operator = (SkipList && rhs)
+   {
+      clear();
+      swap(rhs);
+      return *this;
+   }
+   void swap(SkipList & rhs);
+
+   //
+   // Iterator
+   //
+
+   class iterator;
+   iterator begin() const noexcept
+   {
+      Guard guard;
+      return iterator(firstLive(head[0].load()));
+   }
+   iterator end()   const noexcept { return iterator(nullptr); }
+
+   //
+   // Access
+   //
+
+   iterator find(const T& t);
+   iterator lower_bound(const T& t);
+   iterator upper_bound(const T& t);
+
+   //
+   // Insert
+   //
+
+   std::pair<iterator, bool> insert(const T&  t, bool keepUnique = false);
+   std::pair<iterator, bool> insert(      T&& t, bool keepUnique = false);
+
+   //
+   // Remove
+   //
+
+   iterator erase(iterator& it);
+   void clear() noexcept;
+
+   //
+   // Status
+   //
+
+   bool   empty() const noexcept { return numElements.load() == 0; }
+   size_t size()  const noexcept { return numElements.load();      }
+   size_t retired() const noexcept { return numRetired.load();     }  // erased, not yet freed
+
+private:
+   static SNode * getNode(std::uintptr_t link) { return reinterpret_cast<SNode *>(link & ~std::uintptr_t(1)); }
+   static bool    isMarked(std::uintptr_t link) { return (link & 1) != 0; }
+   static std::uintptr_t makeLink(SNode * p, bool mark = false)
+   {
+      return reinterpret_cast<std::uintptr_t>(p) | (mark ? 1 : 0);
+   }
+
+   static SNode * firstLive(std::uintptr_t link);
+   static bool precedes(const SNode * pNode, const T & t, unsigned long long id);
+   static int randomLevel();
+
+   template <typename U>
+   std::pair<iterator, bool> insertValue(U&& t, bool keepUnique);
+   bool locate(const T & t, unsigned long long id, Link ** preds, SNode ** succs);
+   SNode * seek(const T & t, unsigned long long id) const;
+   void retire(SNode * pNode);
+   void reclaim();
+
+   Link head[MAX_LEVEL];                        // the sentinel tower
+   std::atomic<size_t> numElements;             // live elements
+   std::atomic<unsigned long long> nextId;      // orders equal elements
+   std::atomic<SNode *> pRetired;               // erased, waiting to be freed
+   std::atomic<size_t> numRetired;              // nodes on pRetired
+   std::atomic<size_t> numErases;               // every erase, to time reclaim()
+   std::atomic<bool> isReclaiming;              // one reclaim() at a time
+};
+
+/*****************************************************************
+ * SKIP LIST NODE
+ * An element and a tower of level + 1 links. The tower is allocated
+ * along with the node so a short tower costs only the links it uses.
+ *****************************************************************/
+template <typename T>
+class SkipList <T> :: SNode
+{
+public:
+   template <typename U>
+   static SNode * create(U && t, unsigned long long id, int level)
+   {
+      void * pMem = ::operator new(sizeof(SNode) + level * sizeof(Link));
+      SNode * pNode = new (pMem) SNode(std::forward<U>(t), id, level);
+      for (int i = 1; i <= level; i++)
+         new (&pNode->next[i]) Link(0);
+      return pNode;
+   }
+   static void destroy(SNode * pNode)
+   {
+      for (int i = 1; i <= pNode->level; i++)
+         pNode->next[i].~Link();
+      pNode->~SNode();
+      ::operator delete(pNode);
+   }
+
+   T data;                      // the element
+   unsigned long long id;       // breaks ties between equal elements
+   SNode * pRetired;            // next in the retired list
+   unsigned long long retiredAt;// the epoch it was retired in
+   int level;                   // top of the tower
+   Link next[1];                // the tower, level + 1 links long
+
+private:
+   template <typename U>
+   SNode(U && t, unsigned long long id, int level) :
+      data(std::forward<U>(t)), id(id), pRetired(nullptr), retiredAt(0), level(level)
+   {
+      next[0].store(0);
+   }
+};
+
+/**********************************************************
+ * SKIP LIST ITERATOR
+ * Forward iterator through the bottom level
+ *********************************************************/
+template <typename T>
+class SkipList <T> :: iterator
+{
+   friend class SkipList <T>;
+   friend class ::TestOrderedContainer;
+public:
+   iterator(SNode * p = nullptr) : pNode(p) {}
+
+   bool operator == (const iterator & rhs) const { return pNode == rhs.pNode; }
+   bool operator != (const iterator & rhs) const { return pNode != rhs.pNode; }
+
+   // de-reference. Cannot change because it will invalidate the list
+   const T & operator * () const { return pNode->data; }
+
+   // advance to the next element that has not been erased
+   iterator & operator ++ ()
+   {
+      if (pNode != nullptr)
+         pNode = firstLive(pNode->next[0].load());
+      return *this;
+   }
+
+private:
+   SNode * pNode;
+};
+
+/*********************************************
+ * SKIP LIST :: DEFAULT CONSTRUCTOR
+ ********************************************/
+template <typename T>
+SkipList <T> :: SkipList() : numElements(0), nextId(1), pRetired(nullptr),
+                             numRetired(0), numErases(0), isReclaiming(false)
+{
+   for (int i = 0; i < MAX_LEVEL; i++)
+      head[i].store(0);
+}
+
+/*********************************************
+ * SKIP LIST :: ASSIGNMENT OPERATOR
+ ********************************************/
+template <typename T>
+SkipList <T> & SkipList <T> :: operator = (const SkipList <T> & rhs)
+{
+   if (this == &rhs)
+      return *this;
+   clear();
+   for (auto it = rhs.begin(); it != rhs.end(); ++it)
+      insert(*it);
+   return *this;
+}
+
+/*********************************************
+ * SKIP LIST :: SWAP
+ ********************************************/
+template <typename T>
+void SkipList <T> :: swap(SkipList <T> & rhs)
+{
+   for (int i = 0; i < MAX_LEVEL; i++)
+      head[i].store(rhs.head[i].exchange(head[i].load()));
+   numElements.store(rhs.numElements.exchange(numElements.load()));
+   nextId.store(rhs.nextId.exchange(nextId.load()));
+   pRetired.store(rhs.pRetired.exchange(pRetired.load()));
+   numRetired.store(rhs.numRetired.exchange(numRetired.load()));
+   numErases.store(rhs.numErases.exchange(numErases.load()));
+   isReclaiming.store(rhs.isReclaiming.exchange(isReclaiming.load()));
+}
+
+/*********************************************
+ * SKIP LIST :: CLEAR
+ * Free every node, live or retired
+ ********************************************/
+template <typename T>
+void SkipList <T> :: clear() noexcept
+{
+   SNode * p = getNode(head[0].load());
+   while (p != nullptr)
+   {
+      SNode * pNext = getNode(p->next[0].load());
+      // marked nodes are still linked until snipped; those are freed below
+      if (!isMarked(p->next[0].load()))
+         SNode::destroy(p);
+      p = pNext;
+   }
+   p = pRetired.exchange(nullptr);
+   while (p != nullptr)
+   {
+      SNode * pNext = p->pRetired;
+      SNode::destroy(p);
+      p = pNext;
+   }
+   for (int i = 0; i < MAX_LEVEL; i++)
+      head[i].store(0);
+   numElements.store(0);
+   numRetired.store(0);
+}
+
+/*********************************************
+ * SKIP LIST :: FIRST LIVE
+ * Skip over nodes that have been erased but not yet snipped
+ ********************************************/
+template <typename T>
+typename SkipList <T> :: SNode * SkipList <T> :: firstLive(std::uintptr_t link)
+{
+   SNode * p = getNode(link);
+   while (p != nullptr && isMarked(p->next[0].load()))
+      p = getNode(p->next[0].load());
+   return p;
+}
+
+/*********************************************
+ * SKIP LIST :: PRECEDES
+ * Does the node sort before (t, id)?
+ ********************************************/
+template <typename T>
+bool SkipList <T> :: precedes(const SNode * pNode, const T & t, unsigned long long id)
+{
+   if (pNode->data < t)
+      return true;
+   if (t < pNode->data)
+      return false;
+   return pNode->id < id;
+}
+
+/*********************************************
+ * SKIP LIST :: RANDOM LEVEL
+ * Each level up is a one-in-four chance
+ ********************************************/
+template <typename T>
+int SkipList <T> :: randomLevel()
+{
+   static thread_local std::uint32_t state = 2463534242u;
+   state ^= state << 13;
+   state ^= state >> 17;
+   state ^= state << 5;
+   int level = 0;
+   std::uint32_t bits = state;
+   while (level < MAX_LEVEL - 1 && (bits & 3) == 0)
+   {
+      level++;
+      bits >>= 2;
+   }
+   return level;
+}
+
+/*********************************************
+ * SKIP LIST :: LOCATE
+ * Find, on every level, the last link before (t, id) and the node
+ * after it, snipping out any marked nodes along the way. Returns true
+ * when the bottom-level successor is exactly (t, id).
+ ********************************************/
+template <typename T>
+bool SkipList <T> :: locate(const T & t, unsigned long long id, Link ** preds, SNode ** succs)
+{
+retry:
+   Link * pPred = head;
+   for (int level = MAX_LEVEL - 1; level >= 0; level--)
+   {
+      SNode * pCurr = getNode(pPred[level].load());
+      while (pCurr != nullptr)
+      {
+         std::uintptr_t succLink = pCurr->next[level].load();
+         // pCurr has been erased: swing the predecessor past it
+         while (isMarked(succLink))
+         {
+            std::uintptr_t expected = makeLink(pCurr);
+            if (!pPred[level].compare_exchange_strong(expected, makeLink(getNode(succLink))))
+               goto retry;
+            pCurr = getNode(succLink);
+            if (pCurr == nullptr)
+               break;
+            succLink = pCurr->next[level].load();
+         }
+         if (pCurr == nullptr || !precedes(pCurr, t, id))
+            break;
+         pPred = pCurr->next;
+         pCurr = getNode(succLink);
+      }
+      preds[level] = pPred;
+      succs[level] = pCurr;
+   }
+   return succs[0] != nullptr && succs[0]->id == id;
+}
+
+/*********************************************
+ * SKIP LIST :: SEEK
+ * Wait-free search for the first live node at or after (t, id)
+ ********************************************/
+template <typename T>
+typename SkipList <T> :: SNode * SkipList <T> :: seek(const T & t, unsigned long long id) const
+{
+   const Link * pPred = head;
+   SNode * pCurr = nullptr;
+   for (int level = MAX_LEVEL - 1; level >= 0; level--)
+   {
+      pCurr = getNode(pPred[level].load());
+      while (pCurr != nullptr)
+      {
+         std::uintptr_t succLink = pCurr->next[level].load();
+         if (!isMarked(succLink) && !precedes(pCurr, t, id))
+            break;
+         if (!isMarked(succLink))
+            pPred = pCurr->next;
+         pCurr = getNode(succLink);
+      }
+   }
+   return pCurr;
+}
+
+/*********************************************
+ * SKIP LIST :: LOWER BOUND / UPPER BOUND / FIND
+ ********************************************/
+template <typename T>
+typename SkipList <T> :: iterator SkipList <T> :: lower_bound(const T & t)
+{
+   Guard guard;
+   return iterator(seek(t, 0));
+}
+
+template <typename T>
+typename SkipList <T> :: iterator SkipList <T> :: upper_bound(const T & t)
+{
+   Guard guard;
+   return iterator(seek(t, ~0ull));
+}
+
+template <typename T>
+typename SkipList <T> :: iterator SkipList <T> :: find(const T & t)
+{
+   Guard guard;
+   SNode * p = seek(t, 0);
+   if (p != nullptr && !(t < p->data))
+      return iterator(p);
+   return end();
+}
+
+/*********************************************
+ * SKIP LIST :: INSERT
+ * Link the bottom level first; that is the moment the element exists.
+ * The upper levels are then linked one at a time.
+ ********************************************/
+template <typename T>
+std::pair<typename SkipList <T> :: iterator, bool> SkipList <T> :: insert(const T & t, bool keepUnique)
+{
+   return insertValue(t, keepUnique);
+}
+
+template <typename T>
+std::pair<typename SkipList <T> :: iterator, bool> SkipList <T> :: insert(T && t, bool keepUnique)
+{
+   return insertValue(std::move(t), keepUnique);
+}
+
+template <typename T>
+template <typename U>
+std::pair<typename SkipList <T> :: iterator, bool> SkipList <T> :: insertValue(U && t, bool keepUnique)
+{
+   Guard guard;
+   Link * preds[MAX_LEVEL];
+   SNode * succs[MAX_LEVEL];
+
+   // a unique element sorts ahead of any equal one, so a racing insert of
+   // the same value is caught by the bottom-level compare-and-swap
+   unsigned long long id = keepUnique ? 0 : nextId.fetch_add(1);
+   SNode * pNode = nullptr;
+   while (true)
+   {
+      // once the node exists, t has been moved into it
+      const T & key = (pNode == nullptr ? t : pNode->data);
+      locate(key, id, preds, succs);
+      if (keepUnique && succs[0] != nullptr && !(key < succs[0]->data))
+      {
+         if (pNode != nullptr)
+            SNode::destroy(pNode);
+         return std::pair<iterator, bool>(iterator(succs[0]), false);
+      }
+
+      if (pNode == nullptr)
+         pNode = SNode::create(std::forward<U>(t), keepUnique ? nextId.fetch_add(1) : id, randomLevel());
+      for (int level = 0; level <= pNode->level; level++)
+         pNode->next[level].store(makeLink(succs[level]));
+
+      std::uintptr_t expected = makeLink(succs[0]);
+      if (preds[0][0].compare_exchange_strong(expected, makeLink(pNode)))
+         break;
+   }
+   numElements.fetch_add(1);
+
+   for (int level = 1; level <= pNode->level; level++)
+   {
+      bool isLinked = false;
+      while (!isLinked)
+      {
+         std::uintptr_t expected = makeLink(succs[level]);
+         if (preds[level][level].compare_exchange_strong(expected, makeLink(pNode)))
+         {
+            isLinked = true;
+            break;
+         }
+         // someone changed this level; look again and re-aim our link
+         locate(pNode->data, pNode->id, preds, succs);
+         std::uintptr_t link = pNode->next[level].load();
+         if (isMarked(link))
+            break;
+         if (!pNode->next[level].compare_exchange_strong(link, makeLink(succs[level])))
+            break;
+      }
+      if (!isLinked || isMarked(pNode->next[0].load()))
+         break;
+   }
+
+   // an erase that snipped the node before we linked a level would leave
+   // it linked there once retired, so snip it again while our Guard still
+   // keeps it from being freed
+   if (isMarked(pNode->next[0].load()))
+      locate(pNode->data, pNode->id, preds, succs);
+   return std::pair<iterator, bool>(iterator(pNode), true);
+}
+
+/*********************************************
+ * SKIP LIST :: ERASE
+ * Mark the tower top-down; whoever marks the bottom level owns the
+ * erase. A search for the node then snips it out of every level.
+ ********************************************/
+template <typename T>
+typename SkipList <T> :: iterator SkipList <T> :: erase(iterator & it)
+{
+   SNode * pNode = it.pNode;
+   if (pNode == nullptr)
+      return end();
+   Guard guard;
+
+   for (int level = pNode->level; level >= 1; level--)
+   {
+      std::uintptr_t link = pNode->next[level].load();
+      while (!isMarked(link))
+      {
+         pNode->next[level].compare_exchange_weak(link, link | 1);
+         link = pNode->next[level].load();
+      }
+   }
+
+   std::uintptr_t link = pNode->next[0].load();
+   while (true)
+   {
+      if (isMarked(link))
+         return iterator(firstLive(link));   // someone else erased it
+      if (pNode->next[0].compare_exchange_strong(link, link | 1))
+         break;
+   }
+   numElements.fetch_sub(1);
+
+   Link * preds[MAX_LEVEL];
+   SNode * succs[MAX_LEVEL];
+   locate(pNode->data, pNode->id, preds, succs);
+
+   it.pNode = nullptr;
+   iterator itNext(firstLive(pNode->next[0].load()));
+   retire(pNode);
+   if ((numErases.fetch_add(1) + 1) % RECLAIM_PERIOD == 0)
+      reclaim();
+   return itNext;
+}
+
+/*********************************************
+ * SKIP LIST :: RETIRE
+ * An unlinked node goes on the retired list, stamped with the epoch,
+ * for reclaim() to free once nobody can be reading it
+ ********************************************/
+template <typename T>
+void SkipList <T> :: retire(SNode * pNode)
+{
+   pNode->retiredAt = Epoch::now();
+   pNode->pRetired = pRetired.load();
+   while (!pRetired.compare_exchange_weak(pNode->pRetired, pNode))
+      ;
+   numRetired.fetch_add(1);
+}
+
+/*********************************************
+ * SKIP LIST :: RECLAIM
+ * Move the epoch on if we can, then free every retired node that is
+ * two epochs old and put the rest back. Whoever finds another reclaim
+ * already running leaves it to them.
+ ********************************************/
+template <typename T>
+void SkipList <T> :: reclaim()
+{
+   if (isReclaiming.exchange(true))
+      return;
+
+   unsigned long long epoch = Epoch::tryAdvance();
+   SNode * p = pRetired.exchange(nullptr);
+   SNode * pKeep = nullptr;
+   SNode * pKeepTail = nullptr;
+   size_t numFreed = 0;
+   while (p != nullptr)
+   {
+      SNode * pNext = p->pRetired;
+      if (p->retiredAt + 2 <= epoch)
+      {
+         SNode::destroy(p);
+         numFreed++;
+      }
+      else
+      {
+         p->pRetired = pKeep;
+         pKeep = p;
+         if (pKeepTail == nullptr)
+            pKeepTail = p;
+      }
+      p = pNext;
+   }
+
+   // erases may have retired more in the meantime
+   if (pKeep != nullptr)
+   {
+      pKeepTail->pRetired = pRetired.load();
+      while (!pRetired.compare_exchange_weak(pKeepTail->pRetired, pKeep))
+         ;
+   }
+   numRetired.fetch_sub(numFreed);
+   isReclaiming.store(false);
+}
+
+} // namespace custom
@@ -0,0 +1,548 @@
+/***********************************************************************
+ * Header:
+ *    SNAPSHOT
+ * Summary:
+ *    Save a BST to a file and load it back on every core. The elements
+ *    are written in order, in chunks of a few thousand. Each chunk has
+ *    its own CRC-32 and may be compressed on its own. A directory
+ *    at the front gives each chunk's offset, size, count, checksum and
+ *    first and last element, so a loader can check any chunk and know
+ *    where its keys fall without reading the others.
+ *
+ *    Loading reads the directory, then threads take chunks in turn.
+ *    Each thread reads, checks and decodes its chunk, then builds a
+ *    perfectly balanced, correctly colored subtree from it in O(chunk).
+ *    The first element of every chunk but the first is kept aside.
+ *    Once all chunks are built, one thread joins the subtrees left to
+ *    right with those elements between them. Each red-black join walks
+ *    down the taller tree's spine to the shorter one's black height and
+ *    lets balance() fix up, so joining costs O(log n) per chunk.
+ *
+ *    Elements are written as their bytes, like the spill file, so T must
+ *    be trivially copyable and the file is only good on machines with the
+ *    same layout. Integer keys may be stored as varint deltas instead,
+ *    which sorted keys shrink well under. A chunk that would not come
+ *    out smaller stays raw.
+ *
+ *    This will contain the class definition of:
+ *        Snapshot           : Save and load a BST in checksummed chunks
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include "bst.h"
+
+#include <algorithm>  // for std::min
+#include <atomic>     // for std::atomic
+#include <cstdint>    // for uint32_t and uint64_t
+#include <cstdio>     // for std::FILE
+#include <cstring>    // for memcpy, memset and memcmp
+#include <thread>     // for std::thread
+#include <type_traits>// for std::is_trivially_copyable and std::is_integral
+#include <vector>
+
+class TestSnapshot;  // forward declaration for unit tests
+
+namespace custom
+{
+
+/*****************************************************************
+ * SNAPSHOT
+ * Save a BST in independently checksummed chunks of sorted elements,
+ * and load it back with a thread per core
+ *****************************************************************/
+template <typename T>
+class Snapshot
+{
+   friend class ::TestSnapshot; // give unit tests access to the privates
+   static_assert(std::is_trivially_copyable<T>::value, "a snapshot holds the bytes of each element");
+public:
+   static const size_t CHUNK = 4096;   // elements per chunk unless told otherwise
+
+   static bool save(const BST<T> & bst, const char * path,
+                    size_t chunkSize = CHUNK, bool compress = true);
+   static bool load(BST<T> & bst, const char * path, unsigned int numThreads = 0);
+
+private:
+   typedef typename BST<T>::BNode BNode;
+
+   // how a chunk's bytes hold its elements
+   enum Encoding { RAW,      // the elements' bytes back to back
+                   DELTA };  // each element less the one before, as a varint
+
+   // varint deltas only work on integers, and bool has no unsigned twin
+   typedef std::integral_constant<bool,
+      std::is_integral<T>::value && !std::is_same<T, bool>::value> CanDelta;
+
+   // the start of the file
+   struct Header
+   {
+      char magic[8];               // MAGIC
+      uint32_t version;            // VERSION
+      uint32_t elementSize;        // sizeof(T) when saved
+      uint64_t numElements;
+      uint64_t numChunks;
+      uint32_t directoryChecksum;  // CRC-32 of the directory
+      uint32_t reserved;
+   };
+
+   // one chunk's line in the directory
+   struct Entry
+   {
+      uint64_t offset;    // where the chunk's bytes start in the file
+      uint32_t size;      // how many bytes it takes
+      uint32_t count;     // how many elements it holds
+      uint32_t checksum;  // CRC-32 of its bytes
+      uint32_t encoding;  // RAW or DELTA
+      T first;            // its smallest element
+      T last;             // its largest element
+   };
+
+   // one chunk, built into a subtree
+   struct Piece
+   {
+      BNode * pSeparator;   // the chunk's first element, between this piece and the last
+      BNode * pRoot;        // the rest of the chunk
+      size_t blackHeight;   // black nodes on any path down pRoot
+      bool isLoaded;        // read, checked and built
+   };
+
+   static const char MAGIC[8];
+   static const uint32_t VERSION = 1;
+
+   static bool readDirectory(const char * path, Header & header, std::vector<Entry> & directory);
+   static Piece loadChunk(std::FILE * pFile, const Entry & entry, bool isFirst,
+                          std::vector<unsigned char> & bytes, std::vector<T> & values);
+
+   static bool encode(const std::vector<T> & values, std::vector<unsigned char> & bytes, std::true_type);
+   static bool encode(const std::vector<T> &, std::vector<unsigned char> &, std::false_type) { return false; }
+   static bool decode(const std::vector<unsigned char> & bytes, std::vector<T> & values, std::true_type);
+   static bool decode(const std::vector<unsigned char> &, std::vector<T> &, std::false_type) { return false; }
+
+   static BNode * build(const T * pValues, size_t count, size_t depth, size_t redDepth);
+   static size_t blackHeightOf(size_t count);
+   static BNode * join(BNode * pLow, size_t blackLow, BNode * pMiddle,
+                       BNode * pHigh, size_t blackHigh, size_t & blackHeight);
+
+   static uint32_t checksum(const void * p, size_t size);
+};
+
+template <typename T>
+const char Snapshot <T> :: MAGIC[8] = { 'B', 'S', 'T', 'S', 'N', 'A', 'P', '\0' };
+
+/*********************************************
+ * SNAPSHOT :: SAVE
+ * Write the header and directory last, once the chunks are written
+ * and their offsets known. Returns false if the file could not be
+ * written.
+ ********************************************/
+template <typename T>
+bool Snapshot <T> :: save(const BST<T> & bst, const char * path, size_t chunkSize, bool compress)
+{
+   std::FILE * pFile = std::fopen(path, "wb");
+   if (pFile == nullptr)
+      return false;
+   if (chunkSize == 0)
+      chunkSize = CHUNK;
+
+   Header header;
+   std::memset(&header, 0, sizeof(header));
+   std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+   header.version = VERSION;
+   header.elementSize = (uint32_t)sizeof(T);
+   header.numElements = bst.size();
+   header.numChunks = (bst.size() + chunkSize - 1) / chunkSize;
+   std::vector<Entry> directory((size_t)header.numChunks);
+   if (!directory.empty())
+      std::memset(directory.data(), 0, directory.size() * sizeof(Entry));
+
+   uint64_t offset = sizeof(Header) + directory.size() * sizeof(Entry);
+   bool isWritten = std::fseek(pFile, (long)offset, SEEK_SET) == 0;
+   std::vector<T> values;
+   std::vector<unsigned char> bytes;
+   values.reserve(chunkSize);
+   auto it = bst.begin();
+   for (Entry & entry : directory)
+   {
+      values.clear();
+      for (; values.size() < chunkSize && it != bst.end(); ++it)
+         values.push_back(*it);
+
+      entry.encoding = DELTA;
+      if (!compress || !encode(values, bytes, CanDelta()))
+      {
+         entry.encoding = RAW;
+         bytes.resize(values.size() * sizeof(T));
+         std::memcpy(bytes.data(), values.data(), bytes.size());
+      }
+      entry.offset = offset;
+      entry.size = (uint32_t)bytes.size();
+      entry.count = (uint32_t)values.size();
+      entry.checksum = checksum(bytes.data(), bytes.size());
+      entry.first = values.front();
+      entry.last = values.back();
+      isWritten = isWritten && std::fwrite(bytes.data(), 1, bytes.size(), pFile) == bytes.size();
+      offset += bytes.size();
+   }
+
+   header.directoryChecksum = checksum(directory.data(), directory.size() * sizeof(Entry));
+   isWritten = isWritten && std::fseek(pFile, 0, SEEK_SET) == 0 &&
+      std::fwrite(&header, sizeof(header), 1, pFile) == 1 &&
+      (directory.empty() ||
+       std::fwrite(directory.data(), sizeof(Entry), directory.size(), pFile) == directory.size());
+   return std::fclose(pFile) == 0 && isWritten;
+}
+
+/*********************************************
+ * SNAPSHOT :: LOAD
+ * Replace what bst holds with the snapshot at path, decoding chunks on
+ * numThreads threads, or one per core if 0. If anything is missing,
+ * corrupt or out of order, bst is left as it was and this returns false.
+ ********************************************/
+template <typename T>
+bool Snapshot <T> :: load(BST<T> & bst, const char * path, unsigned int numThreads)
+{
+   Header header;
+   std::vector<Entry> directory;
+   if (!readDirectory(path, header, directory))
+      return false;
+
+   // every thread reads through its own file, so they never share a
+   // position or a lock
+   std::vector<Piece> pieces(directory.size());
+   std::atomic<size_t> next(0);
+   std::atomic<bool> isOpen(true);
+   auto work = [&]()
+   {
+      std::FILE * pFile = std::fopen(path, "rb");
+      if (pFile == nullptr)
+      {
+         isOpen = false;
+         return;
+      }
+      std::vector<unsigned char> bytes;
+      std::vector<T> values;
+      for (size_t i = next++; i < directory.size(); i = next++)
+         pieces[i] = loadChunk(pFile, directory[i], i == 0, bytes, values);
+      std::fclose(pFile);
+   };
+   if (numThreads == 0)
+      numThreads = std::max(1u, std::thread::hardware_concurrency());
+   numThreads = (unsigned int)std::min<size_t>(numThreads, directory.size());
+   std::vector<std::thread> threads;
+   for (unsigned int i = 1; i < numThreads; i++)
+      threads.emplace_back(work);
+   work();
+   for (std::thread & thread : threads)
+      thread.join();
+
+   bool isLoaded = isOpen.load();
+   for (const Piece & piece : pieces)
+      isLoaded = isLoaded && piece.isLoaded;
+   if (!isLoaded)
+   {
+      for (Piece & piece : pieces)
+         if (piece.isLoaded)
+         {
+            bst.clearNode(piece.pRoot);
+            bst.clearNode(piece.pSeparator);
+         }
+      return false;
+   }
+
+   // each join leaves the root's parent null for the next one to find
+   BNode * pRoot = nullptr;
+   size_t blackHeight = 0;
+   for (Piece & piece : pieces)
+   {
+      if (piece.pSeparator == nullptr)
+      {
+         pRoot = piece.pRoot;
+         blackHeight = piece.blackHeight;
+      }
+      else
+         pRoot = join(pRoot, blackHeight, piece.pSeparator, piece.pRoot, piece.blackHeight, blackHeight);
+   }
+
+   bst.clear();
+   bst.root = pRoot;
+   bst.numElements = (size_t)header.numElements;
+   if (bst.pSpill)
+      bst.trim();
+   return true;
+}
+
+/*********************************************
+ * SNAPSHOT :: READ DIRECTORY
+ * Read and check the header and the directory: the right element
+ * size, a good checksum, counts that add up, and chunks in order
+ ********************************************/
+template <typename T>
+bool Snapshot <T> :: readDirectory(const char * path, Header & header, std::vector<Entry> & directory)
+{
+   std::FILE * pFile = std::fopen(path, "rb");
+   if (pFile == nullptr)
+      return false;
+   long fileSize = -1;
+   if (std::fseek(pFile, 0, SEEK_END) == 0)
+      fileSize = std::ftell(pFile);
+   bool isRead = std::fseek(pFile, 0, SEEK_SET) == 0 &&
+      std::fread(&header, sizeof(header), 1, pFile) == 1 &&
+      std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+      header.version == VERSION &&
+      header.elementSize == sizeof(T) &&
+      header.numChunks <= header.numElements &&
+      header.numChunks <= (uint64_t)fileSize / sizeof(Entry);
+   if (isRead)
+   {
+      directory.resize((size_t)header.numChunks);
+      isRead = (directory.empty() ||
+                std::fread(directory.data(), sizeof(Entry), directory.size(), pFile) == directory.size()) &&
+         checksum(directory.data(), directory.size() * sizeof(Entry)) == header.directoryChecksum;
+   }
+   std::fclose(pFile);
+
+   uint64_t numElements = 0;
+   for (size_t i = 0; isRead && i < directory.size(); i++)
+   {
+      isRead = directory[i].count > 0 &&
+         (i == 0 || !(directory[i].first < directory[i - 1].last));
+      numElements += directory[i].count;
+   }
+   return isRead && numElements == header.numElements;
+}
+
+/*********************************************
+ * SNAPSHOT :: LOAD CHUNK
+ * Read one chunk, check it against its directory entry and build it
+ * into a balanced subtree. bytes and values are scratch space, kept by
+ * the caller from one chunk to the next.
+ ********************************************/
+template <typename T>
+typename Snapshot <T> :: Piece Snapshot <T> :: loadChunk(std::FILE * pFile, const Entry & entry,
+   bool isFirst, std::vector<unsigned char> & bytes, std::vector<T> & values)
+{
+   Piece piece = { nullptr, nullptr, 0, false };
+   bytes.resize(entry.size);
+   if (std::fseek(pFile, (long)entry.offset, SEEK_SET) != 0 ||
+       std::fread(bytes.data(), 1, bytes.size(), pFile) != bytes.size() ||
+       checksum(bytes.data(), bytes.size()) != entry.checksum)
+      return piece;
+
+   values.resize(entry.count);
+   if (entry.encoding == RAW && bytes.size() == values.size() * sizeof(T))
+      std::memcpy(values.data(), bytes.data(), bytes.size());
+   else if (entry.encoding != DELTA || !decode(bytes, values, CanDelta()))
+      return piece;
+
+   // the directory has to agree, and the chunk has to be in order
+   if (values.front() < entry.first || entry.first < values.front() ||
+       values.back() < entry.last || entry.last < values.back())
+      return piece;
+   for (size_t i = 1; i < values.size(); i++)
+      if (values[i] < values[i - 1])
+         return piece;
+
+   size_t skip = isFirst ? 0 : 1;
+   if (!isFirst)
+   {
+      piece.pSeparator = new BNode(values.front());
+      piece.pSeparator->isRed = false;
+   }
+   size_t count = values.size() - skip;
+   piece.blackHeight = blackHeightOf(count);
+   piece.pRoot = build(values.data() + skip, count, 0, piece.blackHeight);
+   piece.isLoaded = true;
+   return piece;
+}
+
+/*********************************************
+ * SNAPSHOT :: ENCODE
+ * Each element less the one before, seven bits to a byte with the
+ * high bit meaning more to come. Sorted keys make every delta
+ * non-negative, which unsigned arithmetic gets right even for signed
+ * keys. Returns false if that would not be smaller than raw.
+ ********************************************/
+template <typename T>
+bool Snapshot <T> :: encode(const std::vector<T> & values, std::vector<unsigned char> & bytes, std::true_type)
+{
+   typedef typename std::make_unsigned<T>::type U;
+   size_t rawSize = values.size() * sizeof(T);
+   bytes.clear();
+   U previous = 0;
+   for (T value : values)
+   {
+      U delta = (U)((U)value - previous);
+      previous = (U)value;
+      while (delta >= 0x80)
+      {
+         bytes.push_back((unsigned char)(delta | 0x80));
+         delta = (U)(delta >> 7);
+      }
+      bytes.push_back((unsigned char)delta);
+      if (bytes.size() >= rawSize)
+         return false;
+   }
+   return true;
+}
+
+/*********************************************
+ * SNAPSHOT :: DECODE
+ * Undo encode(), failing on a varint that runs past the end or too
+ * long for T, or on bytes left over
+ ********************************************/
+template <typename T>
+bool Snapshot <T> :: decode(const std::vector<unsigned char> & bytes, std::vector<T> & values, std::true_type)
+{
+   typedef typename std::make_unsigned<T>::type U;
+   const size_t MAX_SHIFT = sizeof(T) * 8;
+   size_t i = 0;
+   U previous = 0;
+   for (T & value : values)
+   {
+      U delta = 0;
+      for (size_t shift = 0; ; shift += 7)
+      {
+         if (i == bytes.size() || shift >= MAX_SHIFT)
+            return false;
+         unsigned char byte = bytes[i++];
+         delta = (U)(delta | ((U)(byte & 0x7f) << shift));
+         if ((byte & 0x80) == 0)
+            break;
+      }
+      previous = (U)(previous + delta);
+      value = (T)previous;
+   }
+   return i == bytes.size();
+}
+
+/*********************************************
+ * SNAPSHOT :: BUILD
+ * A subtree of pValues[0..count) with the middle element on top.
+ * Every level is full but maybe the last, which is colored red so all
+ * paths have the same number of black nodes.
+ ********************************************/
+template <typename T>
+typename Snapshot <T> :: BNode * Snapshot <T> :: build(const T * pValues, size_t count,
+   size_t depth, size_t redDepth)
+{
+   if (count == 0)
+      return nullptr;
+   size_t middle = count / 2;
+   BNode * pNode = new BNode(pValues[middle]);
+   pNode->isRed = (depth == redDepth);
+   pNode->pLeft = build(pValues, middle, depth + 1, redDepth);
+   pNode->pRight = build(pValues + middle + 1, count - middle - 1, depth + 1, redDepth);
+   BST<T>::setParent(pNode->pLeft, pNode);
+   BST<T>::setParent(pNode->pRight, pNode);
+   return pNode;
+}
+
+/*********************************************
+ * SNAPSHOT :: BLACK HEIGHT OF
+ * The full levels of a balanced subtree of count nodes, which are
+ * its black ones
+ ********************************************/
+template <typename T>
+size_t Snapshot <T> :: blackHeightOf(size_t count)
+{
+   size_t levels = 0;
+   while (((size_t)2 << levels) - 1 <= count)
+      levels++;
+   return levels;
+}
+
+/*********************************************
+ * SNAPSHOT :: JOIN
+ * Join pLow, pMiddle and pHigh, everything in pLow no greater than
+ * pMiddle and nothing in pHigh less. Walk down the taller tree's inner
+ * spine to a black node as high in black nodes as the shorter tree,
+ * put pMiddle there as a red node over the two, and let balance() fix
+ * it up as though it were just inserted. Returns the new root and
+ * sets blackHeight.
+ ********************************************/
+template <typename T>
+typename Snapshot <T> :: BNode * Snapshot <T> :: join(BNode * pLow, size_t blackLow,
+   BNode * pMiddle, BNode * pHigh, size_t blackHigh, size_t & blackHeight)
+{
+   if (blackLow == blackHigh)
+   {
+      pMiddle->pLeft = pLow;
+      pMiddle->pRight = pHigh;
+      BST<T>::setParent(pLow, pMiddle);
+      BST<T>::setParent(pHigh, pMiddle);
+      pMiddle->pParent = nullptr;
+      pMiddle->isRed = false;
+      blackHeight = blackLow + 1;
+      return pMiddle;
+   }
+
+   // side is the way down the taller tree toward the shorter one; the
+   // mirror-image cases are the same code with side and !side swapped
+   bool side = blackLow > blackHigh;
+   BNode * pTall = side ? pLow : pHigh;
+   BNode * pShort = side ? pHigh : pLow;
+   size_t height = side ? blackLow : blackHigh;   // of the subtree under pAt
+   size_t target = side ? blackHigh : blackLow;
+   BNode * pAbove = nullptr;
+   BNode * pAt = pTall;
+   while (pAt != nullptr && (height != target || pAt->isRed))
+   {
+      height -= pAt->isRed ? 0 : 1;
+      pAbove = pAt;
+      pAt = pAt->child(side);
+   }
+
+   pMiddle->setChild(!side, pAt);
+   pMiddle->setChild(side, pShort);
+   BST<T>::setParent(pAt, pMiddle);
+   BST<T>::setParent(pShort, pMiddle);
+   pMiddle->pParent = pAbove;
+   pAbove->setChild(side, pMiddle);
+   pMiddle->isRed = true;
+   pMiddle->balance();
+
+   // the fix-up may have rotated a new node to the top, or recolored
+   // its way up and added a black level
+   BNode * pRoot = pMiddle;
+   while (pRoot->pParent != nullptr)
+      pRoot = pRoot->pParent;
+   blackHeight = 0;
+   for (BNode * p = pRoot; p != nullptr; p = p->pLeft)
+      blackHeight += p->isRed ? 0 : 1;
+   return pRoot;
+}
+
+/*********************************************
+ * SNAPSHOT :: CHECKSUM
+ * CRC-32, as zlib and PNG compute it
+ ********************************************/
+template <typename T>
+uint32_t Snapshot <T> :: checksum(const void * p, size_t size)
+{
+   struct Table
+   {
+      Table()
+      {
+         for (uint32_t i = 0; i < 256; i++)
+         {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++)
+               crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+            entries[i] = crc;
+         }
+      }
+      uint32_t entries[256];
+   };
+   static const Table table;
+
+   const unsigned char * pBytes = static_cast<const unsigned char *>(p);
+   uint32_t crc = 0xFFFFFFFFu;
+   for (size_t i = 0; i < size; i++)
+      crc = table.entries[(crc ^ pBytes[i]) & 0xFF] ^ (crc >> 8);
+   return crc ^ 0xFFFFFFFFu;
+}
+
+} // namespace custom
@@ -0,0 +1,137 @@
+/***********************************************************************
+ * Header:
+ *    SORTED VECTOR
+ * Summary:
+ *    An ordered container that keeps its elements in one contiguous,
+ *    sorted array. Lookups are a binary search and iteration is a linear
+ *    scan, but every insert and erase shifts the elements behind it.
+ *    It satisfies the same interface as BST (see orderedContainer.h).
+ *
+ *    This will contain the class definition of:
+ *        SortedVector           : A sorted array behind the BST interface
+ *        SortedVector::iterator : An iterator through SortedVector
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include <vector>     // for std::vector
+#include <algorithm>  // for std::lower_bound and std::upper_bound
+#include <utility>    // for std::pair
+
+class TestOrderedContainer;
+
+namespace custom
+{
+
+/*****************************************************************
+ * SORTED VECTOR
+ * A sorted array that can stand in for a BST
+ *****************************************************************/
+template <typename T>
+class SortedVector
+{
+   friend class ::TestOrderedContainer;
+public:
+   //
+   // Construct
+   //
+
+   SortedVector() {}
+   SortedVector(const std::initializer_list<T>& il)
+   {
+      for (auto& element : il)
+         insert(element);
+   }
+
+   //
+   // Iterator
+   //
+
+   typedef typename std::vector<T>::const_iterator iterator;
+   iterator begin() const noexcept { return data.begin(); }
+   iterator end()   const noexcept { return data.end();   }
+
+   //
+   // Access
+   //
+
+   iterator find(const T& t)
+   {
+      auto it = lower_bound(t);
+      if (it != data.end() && !(t < *it))
+         return it;
+      return end();
+   }
+   iterator lower_bound(const T& t)
+   {
+      return std::lower_bound(data.cbegin(), data.cend(), t);
+   }
+   iterator upper_bound(const T& t)
+   {
+      return std::upper_bound(data.cbegin(), data.cend(), t);
+   }
+
+   //
+   // Insert
+   //
+
+   std::pair<iterator, bool> insert(const T&  t, bool keepUnique = false);
+   std::pair<iterator, bool> insert(      T&& t, bool keepUnique = false);
+
+   //
+   // Remove
+   //
+
+   iterator erase(iterator& it)
+   {
+      if (it == end())
+         return end();
+      return data.erase(it);
+   }
+   void clear() noexcept { data.clear(); }
+
+   //
+   // Status
+   //
+
+   bool   empty() const noexcept { return data.empty(); }
+   size_t size()  const noexcept { return data.size();  }
+
+private:
+   std::vector<T> data;     // the elements, always kept in sorted order
+};
+
+/*****************************************************
+ * SORTED VECTOR :: INSERT
+ * Insert after any equal elements so duplicates keep their
+ * insertion order, the same as BST
+ ****************************************************/
+template <typename T>
+std::pair<typename SortedVector <T> :: iterator, bool> SortedVector <T> :: insert(const T & t, bool keepUnique)
+{
+   if (keepUnique)
+   {
+      auto it = find(t);
+      if (it != end())
+         return std::pair<iterator, bool>(it, false);
+   }
+   auto it = data.insert(upper_bound(t), t);
+   return std::pair<iterator, bool>(it, true);
+}
+
+template <typename T>
+std::pair<typename SortedVector <T> :: iterator, bool> SortedVector <T> :: insert(T && t, bool keepUnique)
+{
+   if (keepUnique)
+   {
+      auto it = find(t);
+      if (it != end())
+         return std::pair<iterator, bool>(it, false);
+   }
+   auto it = data.insert(upper_bound(t), std::move(t));
+   return std::pair<iterator, bool>(it, true);
+}
+
+} // namespace custom
@@ -0,0 +1,348 @@
+/***********************************************************************
+ * Header:
+ *    SPLIT BST
+ * Summary:
+ *    A BST for large elements that keeps the part a descent reads apart
+ *    from the part it does not. Each BNode holds only a Hot entry: the
+ *    element's key, as KeyOf projects it, and a pointer to the element
+ *    itself, which lives in chunks of its own. With the links, color and
+ *    clock that is a node of one cache line for a small key, however big
+ *    T is, so a descent touches one line per level and reaches the
+ *    element only at the end. Keeping the elements out of the way also
+ *    leaves the nodes close together in the heap.
+ *
+ *    The order is the order of the keys, which need < and ==, and KeyOf
+ *    must give the same key for an element for as long as it is in the
+ *    tree. Lookups take a key rather than an element, since making a
+ *    whole T to search with would defeat the purpose. Elements read
+ *    through iterators are const, like the BST's.
+ *
+ *    This will contain the class definition of:
+ *        SplitBST           : A BST of small keys over out-of-line elements
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include "bst.h"
+
+#include <new>        // for placement new
+#include <type_traits>// for std::decay and std::aligned_storage
+#include <utility>    // for std::declval, std::move and std::pair
+#include <vector>
+
+class TestSplitBST;  // forward declaration for unit tests
+
+namespace custom
+{
+
+/*****************************************************************
+ * SPLIT BST
+ * A BST of Hot entries, key and pointer, over elements of type T
+ * allocated out of line. KeyOf is a function object from const T &
+ * to the key.
+ *****************************************************************/
+template <typename T, typename KeyOf>
+class SplitBST
+{
+   friend class ::TestSplitBST; // give unit tests access to the privates
+public:
+   typedef typename std::decay<decltype(std::declval<KeyOf>()(std::declval<const T &>()))>::type Key;
+
+   class iterator;
+
+   //
+   // Construct
+   //
+
+   SplitBST(KeyOf keyOf = KeyOf()) : keyOf(keyOf) {}
+   SplitBST(const SplitBST & rhs) : keyOf(rhs.keyOf)
+   {
+      *this = rhs;
+   }
+   SplitBST(SplitBST && rhs) : keyOf(rhs.keyOf)
+   {
+      *this = std::move(rhs);
+   }
+   ~SplitBST() { clear(); }
+
+   //
+   // Assign
+   //
+
+   SplitBST & operator = (const SplitBST & rhs);
+   SplitBST & operator = (SplitBST && rhs)
+   {
+      // the elements stay where they are, so only the hot tree moves
+      clear();
+      bst = std::move(rhs.bst);
+      cold.swap(rhs.cold);
+      keyOf = rhs.keyOf;
+      return *this;
+   }
+
+   //
+   // Iterator
+   //
+
+   iterator begin() const noexcept { return iterator(bst.begin()); }
+   iterator end()   const noexcept { return iterator(bst.end());   }
+
+   //
+   // Access
+   //
+
+   iterator find(const Key & key) const;
+   iterator lower_bound(const Key & key) const { return iterator(bst.lower_bound(probe(key))); }
+   iterator upper_bound(const Key & key) const { return iterator(bst.upper_bound(probe(key))); }
+
+   //
+   // Insert
+   //
+
+   std::pair<iterator, bool> insert(const T & t, bool keepUnique = false)
+   {
+      return insertCold(t, keepUnique);
+   }
+   std::pair<iterator, bool> insert(T && t, bool keepUnique = false)
+   {
+      return insertCold(std::move(t), keepUnique);
+   }
+
+   //
+   // Remove
+   //
+
+   iterator erase(iterator & it);
+   void clear() noexcept;
+
+   //
+   // Status
+   //
+
+   bool   empty() const noexcept { return bst.empty(); }
+   size_t size()  const noexcept { return bst.size();  }
+
+private:
+   /*****************************************************************
+    * COLD POOL
+    * The elements, carved out of chunks of their own so they do not
+    * come between the nodes in the heap. A free slot holds nothing
+    * but a link to the next one.
+    *****************************************************************/
+   class ColdPool
+   {
+   public:
+      static const size_t FIRST_CHUNK = 64;   // slots in the first chunk
+
+      ColdPool() : pFree(nullptr), numSlots(0) {}
+      ColdPool(const ColdPool &) = delete;
+      ColdPool & operator = (const ColdPool &) = delete;
+      ~ColdPool()
+      {
+         for (Slot * pChunk : chunks)
+            ::operator delete(pChunk);
+      }
+
+      // storage for one element, growing by as many slots as there
+      // are already when the free list runs out
+      void * take()
+      {
+         if (pFree == nullptr)
+            grow(numSlots == 0 ? FIRST_CHUNK : numSlots);
+         FreeSlot * pSlot = pFree;
+         pFree = pSlot->pNext;
+         return pSlot;
+      }
+
+      // storage for an element that has already been destroyed
+      void give(void * p)
+      {
+         FreeSlot * pSlot = new (p) FreeSlot;
+         pSlot->pNext = pFree;
+         pFree = pSlot;
+      }
+
+      void grow(size_t count)
+      {
+         Slot * pChunk = static_cast<Slot *>(::operator new(count * sizeof(Slot)));
+         chunks.push_back(pChunk);
+         numSlots += count;
+         for (size_t i = count; i > 0; i--)
+            give(&pChunk[i - 1]);
+      }
+
+      void swap(ColdPool & rhs)
+      {
+         std::swap(pFree, rhs.pFree);
+         std::swap(numSlots, rhs.numSlots);
+         chunks.swap(rhs.chunks);
+      }
+
+   private:
+      struct FreeSlot
+      {
+         FreeSlot * pNext;
+      };
+      typedef typename std::aligned_storage<
+         (sizeof(T) > sizeof(FreeSlot) ? sizeof(T) : sizeof(FreeSlot)),
+         (alignof(T) > alignof(FreeSlot) ? alignof(T) : alignof(FreeSlot))>::type Slot;
+
+      std::vector<Slot *> chunks;  // everything we got from ::operator new
+      FreeSlot * pFree;            // the free list
+      size_t numSlots;             // slots in all the chunks, free or not
+   };
+
+   // what a node holds: enough to steer a descent, and where the rest is
+   struct Hot
+   {
+      Key key;
+      T * pCold;
+      bool operator <  (const Hot & rhs) const { return key < rhs.key; }
+      // the same element, so iterators over equal keys still differ
+      bool operator == (const Hot & rhs) const { return pCold == rhs.pCold; }
+   };
+
+   static Hot probe(const Key & key) { return Hot{ key, nullptr }; }
+
+   template <class U>
+   std::pair<iterator, bool> insertCold(U && t, bool keepUnique);
+
+   BST<Hot> bst;    // the keys, in order
+   ColdPool cold;   // the elements
+   KeyOf keyOf;     // an element's key
+};
+
+/**********************************************************
+ * SPLIT BST ITERATOR
+ * A BST iterator over the Hot entries that reads through to
+ * the elements
+ *********************************************************/
+template <typename T, typename KeyOf>
+class SplitBST <T, KeyOf> :: iterator
+{
+   friend class SplitBST;
+public:
+   iterator() {}
+   explicit iterator(const typename BST<Hot>::iterator & it) : it(it) {}
+
+   bool operator == (const iterator & rhs) const { return it == rhs.it; }
+   bool operator != (const iterator & rhs) const { return it != rhs.it; }
+
+   const T & operator * () const { return *(*it).pCold; }
+   const T * operator -> () const { return (*it).pCold; }
+
+   iterator & operator ++ ()
+   {
+      ++it;
+      return *this;
+   }
+   iterator & operator -- ()
+   {
+      --it;
+      return *this;
+   }
+
+private:
+   typename BST<Hot>::iterator it;
+};
+
+/*********************************************
+ * SPLIT BST :: ASSIGNMENT
+ * Every element is copied, so the two trees share none
+ ********************************************/
+template <typename T, typename KeyOf>
+SplitBST <T, KeyOf> & SplitBST <T, KeyOf> :: operator = (const SplitBST & rhs)
+{
+   if (this == &rhs)
+      return *this;
+   clear();
+   keyOf = rhs.keyOf;
+   for (const T & t : rhs)
+      insert(t);
+   return *this;
+}
+
+/*********************************************
+ * SPLIT BST :: FIND
+ * An element with this key. BST::find compares with ==, which for Hot
+ * entries means the same element, so this walks down by key instead,
+ * in the same order as BST::find: == first, which is rarely true and
+ * so well predicted, then one < to pick the child. Asking < both ways
+ * measured about twice as slow. A frozen block is left to lower_bound.
+ ********************************************/
+template <typename T, typename KeyOf>
+typename SplitBST <T, KeyOf> :: iterator SplitBST <T, KeyOf> :: find(const Key & key) const
+{
+   typename BST<Hot>::BNode * pNode = bst.root;
+   while (pNode != nullptr && !BST<Hot>::isFrozen(pNode))
+   {
+      if (pNode->data.key == key)
+         return iterator(typename BST<Hot>::iterator(pNode));
+      else if (pNode->data.key < key)
+         pNode = pNode->pRight;
+      else
+         pNode = pNode->pLeft;
+   }
+   if (pNode == nullptr)
+      return end();
+
+   auto it = bst.lower_bound(probe(key));
+   if (it == bst.end() || key < (*it).key)
+      return end();
+   return iterator(it);
+}
+
+/*********************************************
+ * SPLIT BST :: INSERT COLD
+ * Allocate the element, then hang its key in the tree
+ ********************************************/
+template <typename T, typename KeyOf>
+template <class U>
+std::pair<typename SplitBST <T, KeyOf> :: iterator, bool>
+   SplitBST <T, KeyOf> :: insertCold(U && t, bool keepUnique)
+{
+   Key key = keyOf(t);
+   if (keepUnique)
+   {
+      iterator it = find(key);
+      if (it != end())
+         return std::make_pair(it, false);
+   }
+   T * pCold = new (cold.take()) T(std::forward<U>(t));
+   auto result = bst.insert(Hot{ std::move(key), pCold });
+   return std::make_pair(iterator(result.first), true);
+}
+
+/*********************************************
+ * SPLIT BST :: ERASE
+ * Remove the key from the tree, then free its element
+ ********************************************/
+template <typename T, typename KeyOf>
+typename SplitBST <T, KeyOf> :: iterator SplitBST <T, KeyOf> :: erase(iterator & it)
+{
+   if (it == end())
+      return end();
+   T * pCold = (*it.it).pCold;
+   iterator itNext(bst.erase(it.it));
+   pCold->~T();
+   cold.give(pCold);
+   return itNext;
+}
+
+/*********************************************
+ * SPLIT BST :: CLEAR
+ ********************************************/
+template <typename T, typename KeyOf>
+void SplitBST <T, KeyOf> :: clear() noexcept
+{
+   for (auto it = bst.begin(); it != bst.end(); ++it)
+   {
+      (*it).pCold->~T();
+      cold.give((*it).pCold);
+   }
+   bst.clear();
+}
+
+} // namespace custom
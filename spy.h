@@ -5,11 +5,26 @@
  *    Br. Helfrich
  * Summary:
  *    A mock class designed to measure its usage: a spy!
+ *
+ *    Each thread counts into a block of 64-bit counters of its own, so
+ *    spies used from several threads neither race nor contend. Reading
+ *    a count sums the blocks of every thread that has ever counted, and
+ *    the blocks outlive their threads so that finished work still adds
+ *    up. reset() and the num*() functions count from the last reset();
+ *    a Spy::Delta counts from its own construction, so deltas can nest
+ *    and overlap without disturbing each other or the tests.
  ************************************************************************/
 
 #pragma once
 
+#include <atomic>     // for std::atomic
 #include <cassert>
+#include <cstddef>    // for size_t
+#include <cstdint>    // for int64_t
+#include <memory>     // for std::unique_ptr
+#include <mutex>      // for std::mutex and std::lock_guard
+#include <new>        // for placement new
+#include <vector>
 
 enum { ALLOC,      // allocations, number of times NEW is called
        DELETE,     // deletions, number of times DELETE is called
@@ -35,14 +50,14 @@ public:
    int * p;
    
    // default constructor: allocate a spot and assign to zero
-   Spy() : p(nullptr) { counters[DEFAULT]++; }
+   Spy() : p(nullptr) { record(DEFAULT); }
    
    // non-default constructor: allocate a spot and assign to the value
    Spy(int value) : p(nullptr)
    {
       allocate();
       *p = value;
-      counters[NONDEFAULT]++;
+      record(NONDEFAULT);
    }
    
    // copy constructor: make a new copy
@@ -53,7 +68,7 @@ public:
          allocate();
          *p = rhs.get();
       }
-      counters[COPY]++;
+      record(COPY);
    }
    
    // move constructor: steal the data from the RHS
@@ -66,7 +81,7 @@ public:
       }
       else
          p = nullptr;
-      counters[COPY_MOVE]++;
+      record(COPY_MOVE);
    }
    
    // delete - remove the instance
@@ -74,7 +89,7 @@ public:
    {
       if (!empty())
          unallocate();
-      counters[DESTRUCTOR]++;
+      record(DESTRUCTOR);
    }
 
    // copy assignment operator
@@ -88,7 +103,7 @@ public:
       }
       else if (!empty())
          unallocate();
-      counters[ASSIGN]++;
+      record(ASSIGN);
       return *this;
    }
    
@@ -99,7 +114,7 @@ public:
          unallocate();
       p = rhs.p;
       rhs.p = nullptr;
-      counters[ASSIGN_MOVE]++;
+      record(ASSIGN_MOVE);
       return *this;
    }
    
@@ -126,7 +141,7 @@ public:
    // compare the values
    bool operator==(const Spy & rhs) const
    {
-      counters[EQUALS]++;
+      record(EQUALS);
       if (rhs.empty() && empty())
          return true;
       if (!rhs.empty() && !empty())
@@ -137,7 +152,7 @@ public:
    // a null value is assumed to be the smallest value
    bool operator<(const Spy & rhs) const
    {
-      counters[LESSTHAN]++;
+      record(LESSTHAN);
       if (rhs.empty() && empty())
          return false;
       if (!rhs.empty() && !empty())
@@ -148,35 +163,175 @@ public:
          return false;
    }
    
+   /*************************************************************
+    * SPY SNAPSHOT
+    * Every marker's count at one moment, summed over the threads
+    *************************************************************/
+   struct Snapshot
+   {
+      int64_t counts[NUM_MARKERS];
+
+      int64_t operator [] (int marker) const { return counts[marker]; }
+      Snapshot operator - (const Snapshot & rhs) const
+      {
+         Snapshot difference;
+         for (int i = 0; i < NUM_MARKERS; i++)
+            difference.counts[i] = counts[i] - rhs.counts[i];
+         return difference;
+      }
+   };
+
+   /*************************************************************
+    * SPY DELTA
+    * What has been counted since this was made, on every thread
+    *************************************************************/
+   class Delta
+   {
+   public:
+      Delta() : start(snapshot()) {}
+
+      int64_t operator [] (int marker) const { return total(marker) - start[marker]; }
+      Snapshot counts() const { return snapshot() - start; }
+
+   private:
+      Snapshot start;
+   };
+
+   // every thread's counts, now
+   static Snapshot snapshot()
+   {
+      Registry & reg = registry();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      Snapshot sum = {};
+      for (const std::unique_ptr<Block, Block::Deleter> & pBlock : reg.blocks)
+         for (int i = 0; i < NUM_MARKERS; i++)
+            sum.counts[i] += pBlock->counts[i].load(std::memory_order_relaxed);
+      return sum;
+   }
+
    // reset the counters for a new test
    static void reset()
    {
-      for (int i = 0; i < NUM_MARKERS; i++)
-         counters[i] = 0;
+      Snapshot now = snapshot();
+      Registry & reg = registry();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      reg.baseline = now;
    }
    
-   static int numAlloc()       { return counters[ALLOC];      }
-   static int numDelete()      { return counters[DELETE];     }
-   static int numDefault()     { return counters[DEFAULT];    }
-   static int numNondefault()  { return counters[NONDEFAULT]; }
-   static int numCopy()        { return counters[COPY];       }
-   static int numCopyMove()    { return counters[COPY_MOVE];  }
-   static int numDestructor()  { return counters[DESTRUCTOR]; }
-   static int numAssign()      { return counters[ASSIGN];     }
-   static int numAssignMove()  { return counters[ASSIGN_MOVE];}
-   static int numEquals()      { return counters[EQUALS];     }
-   static int numLessthan()    { return counters[LESSTHAN];   }
+   static int64_t numAlloc()       { return count(ALLOC);      }
+   static int64_t numDelete()      { return count(DELETE);     }
+   static int64_t numDefault()     { return count(DEFAULT);    }
+   static int64_t numNondefault()  { return count(NONDEFAULT); }
+   static int64_t numCopy()        { return count(COPY);       }
+   static int64_t numCopyMove()    { return count(COPY_MOVE);  }
+   static int64_t numDestructor()  { return count(DESTRUCTOR); }
+   static int64_t numAssign()      { return count(ASSIGN);     }
+   static int64_t numAssignMove()  { return count(ASSIGN_MOVE);}
+   static int64_t numEquals()      { return count(EQUALS);     }
+   static int64_t numLessthan()    { return count(LESSTHAN);   }
    
-   // keep track of how it is used
-   static int counters[NUM_MARKERS];
+   // count one use, by a Spy or anything else counted like one, such
+   // as a synthetic key. Only this thread writes its block, so a plain
+   // load and store will do: the atomics are only there so snapshot()
+   // can read while we write
+   static void record(int marker)
+   {
+      std::atomic<int64_t> & counter = block().counts[marker];
+      counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+   }
+
 private:
-   
+   // one thread's counters, written only by that thread. Aligned to a
+   // cache line so one thread's writes never land on another's line
+   struct alignas(64) Block
+   {
+      static const size_t CACHE_LINE = 64;
+
+      // C++14 new only promises fundamental alignment, so align by hand
+      static Block * create()
+      {
+         void * pRaw = ::operator new(sizeof(Block) + CACHE_LINE);
+         size_t address = (reinterpret_cast<size_t>(pRaw) + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+         Block * pBlock = new (reinterpret_cast<void *>(address)) Block;
+         pBlock->pRaw = pRaw;
+         return pBlock;
+      }
+      static void destroy(Block * pBlock)
+      {
+         void * pRaw = pBlock->pRaw;
+         pBlock->~Block();
+         ::operator delete(pRaw);
+      }
+      struct Deleter
+      {
+         void operator () (Block * pBlock) const { destroy(pBlock); }
+      };
+
+      std::atomic<int64_t> counts[NUM_MARKERS];
+      void * pRaw;             // what ::operator new actually returned
+
+   private:
+      Block() : pRaw(nullptr)
+      {
+         for (int i = 0; i < NUM_MARKERS; i++)
+            counts[i].store(0, std::memory_order_relaxed);
+      }
+   };
+
+   // every thread's block, and the counts at the last reset()
+   struct Registry
+   {
+      std::mutex mutex;
+      std::vector<std::unique_ptr<Block, Block::Deleter>> blocks;
+      Snapshot baseline = {};
+   };
+
+   static Registry & registry()
+   {
+      static Registry theRegistry;
+      return theRegistry;
+   }
+
+   // this thread's block, registered the first time it counts
+   static Block & block()
+   {
+      thread_local Block * pBlock = nullptr;
+      if (pBlock == nullptr)
+      {
+         Registry & reg = registry();
+         std::lock_guard<std::mutex> lock(reg.mutex);
+         reg.blocks.emplace_back(Block::create());
+         pBlock = reg.blocks.back().get();
+      }
+      return *pBlock;
+   }
+
+   // one marker summed over every thread
+   static int64_t total(int marker)
+   {
+      Registry & reg = registry();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      int64_t sum = 0;
+      for (const std::unique_ptr<Block, Block::Deleter> & pBlock : reg.blocks)
+         sum += pBlock->counts[marker].load(std::memory_order_relaxed);
+      return sum;
+   }
+
+   // one marker since the last reset()
+   static int64_t count(int marker)
+   {
+      int64_t sum = total(marker);
+      Registry & reg = registry();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      return sum - reg.baseline[marker];
+   }
+
    // allocate a new buffer
    void allocate()
    {
       assert(p == nullptr);
       p = new int;
-      counters[ALLOC]++;
+      record(ALLOC);
    }
    
    // free the buffer
@@ -185,7 +340,7 @@ private:
       assert(p != nullptr);
       delete p;
       p = nullptr;
-      counters[DELETE]++;
+      record(DELETE);
    }
    
 };
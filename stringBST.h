@@ -0,0 +1,520 @@
+/***********************************************************************
+ * Header:
+ *    STRING BST
+ * Summary:
+ *    A BST of strings whose key bytes live in one append-only arena owned
+ *    by the tree instead of a heap buffer per node. The arena keeps the
+ *    prefix every key in the tree shares once, and each node holds an
+ *    ArenaKey: the eight bytes after that prefix packed big-endian into
+ *    an integer, the length, and where the rest sits in the arena.
+ *
+ *    Keys that share a long prefix, like paths or encoded composite keys,
+ *    are therefore told apart by the first bytes that can differ, which
+ *    is where a comparison needs to look. A key that breaks the shared
+ *    prefix shortens it, and every key is repacked around the new one.
+ *    Erased keys leave their bytes behind until compact() copies the
+ *    live ones into a fresh arena in sorted order.
+ *
+ *    Keys are ordered as bytes, like memcmp, which is what the encoded
+ *    keys of keyEncoding.h are built for, and prefix_range() finds every
+ *    key that begins with a given prefix, such as an encoded tenant.
+ *
+ *    This will contain the class definition of:
+ *        StringArena        : The shared prefix and the tails of the keys
+ *        ArenaKey           : One key, as stored in a node
+ *        StringBST          : A BST of ArenaKeys and their arena
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include "bst.h"
+#include "keyEncoding.h"
+
+#include <cstdint>    // for uint32_t and uint64_t
+#include <cstring>    // for memcmp
+#include <memory>     // for std::unique_ptr
+#include <string>
+#include <utility>    // for std::pair
+#include <vector>
+
+class TestStringBST;  // forward declaration for unit tests
+
+namespace custom
+{
+
+/*****************************************************************
+ * STRING ARENA
+ * The bytes every key in the tree starts with, and append-only
+ * storage for the bytes of each key past its inline ones. Keys refer
+ * to the arena by offset, so it is free to move when it grows.
+ *****************************************************************/
+class StringArena
+{
+public:
+   StringArena() : live(0) {}
+
+   // copy bytes onto the end and return where they start
+   uint32_t append(const char * pBytes, size_t length)
+   {
+      uint32_t offset = (uint32_t)bytes.size();
+      bytes.insert(bytes.end(), pBytes, pBytes + length);
+      live += length;
+      return offset;
+   }
+
+   // the bytes at offset are no longer used by any key
+   void release(size_t length) { live -= length; }
+
+   size_t size()     const { return bytes.size(); }  // bytes held, live or not
+   size_t liveSize() const { return live;         }  // bytes still used by a key
+   uint32_t skip()   const { return (uint32_t)common.size(); }
+
+   std::string common;       // the prefix of every key in the tree
+   std::vector<char> bytes;  // the key tails, back to back
+   size_t live;              // bytes not yet released
+};
+
+/*****************************************************************
+ * ARENA KEY
+ * A string key past the tree's common prefix: the next eight bytes
+ * inline and the rest in a StringArena. It does not know which
+ * arena, or how long the common prefix is: whoever compares or
+ * reads it says.
+ *****************************************************************/
+class ArenaKey
+{
+   friend class StringBST;
+public:
+   static const uint32_t INLINE = 8;   // bytes kept in the window
+
+   ArenaKey() : window(0), offset(0), length(0) {}
+
+   // a key for s, which starts with skip common bytes, whose bytes past
+   // the window are at offset in the arena
+   ArenaKey(const std::string & s, uint32_t skip, uint32_t offset) :
+      window(pack(s, skip)), offset(offset), length((uint32_t)s.size()) {}
+
+   size_t size() const { return length; }
+
+   // rebuild the string from the arena's common prefix, the window and
+   // the arena's bytes
+   std::string str(const StringArena & arena) const
+   {
+      uint32_t skip = arena.skip();
+      std::string s(arena.common);
+      s.resize(length, '\0');
+      for (uint32_t i = skip; i < length && i < skip + INLINE; i++)
+         s[i] = (char)(window >> (8 * (skip + INLINE - 1 - i)));
+      if (length > skip + INLINE)
+         s.replace(skip + INLINE, length - skip - INLINE,
+                   arena.bytes.data() + offset, length - skip - INLINE);
+      return s;
+   }
+
+   // negative, zero or positive as lhs orders before, with or after
+   // rhs byte by byte like std::string, given that both start with the
+   // same skip bytes and where their tails are
+   static int compare(const ArenaKey & lhs, const char * pLhsTail,
+                      const ArenaKey & rhs, const char * pRhsTail, uint32_t skip)
+   {
+      if (lhs.window != rhs.window)
+         return lhs.window < rhs.window ? -1 : 1;
+      uint32_t inlineEnd = skip + INLINE;
+      if (lhs.length > inlineEnd && rhs.length > inlineEnd)
+      {
+         uint32_t common = (lhs.length < rhs.length ? lhs.length : rhs.length) - inlineEnd;
+         int compare = memcmp(pLhsTail, pRhsTail, common);
+         if (compare != 0)
+            return compare;
+      }
+      return (lhs.length > rhs.length) - (lhs.length < rhs.length);
+   }
+
+   // the same key of the same tree, which is what iterators compare
+   bool operator == (const ArenaKey & rhs) const
+   {
+      return window == rhs.window && length == rhs.length && offset == rhs.offset;
+   }
+   bool operator != (const ArenaKey & rhs) const { return !(*this == rhs); }
+
+private:
+   // the eight bytes after the first skip, big-endian so integer order
+   // is byte order
+   static uint64_t pack(const std::string & s, uint32_t skip)
+   {
+      uint64_t window = 0;
+      for (uint32_t i = skip; i < skip + INLINE; i++)
+         window = (window << 8) | (i < s.size() ? (unsigned char)s[i] : 0);
+      return window;
+   }
+
+   uint64_t window;              // bytes skip to skip + 7, zero padded
+   uint32_t offset;              // where the bytes past the window start in the arena
+   uint32_t length;              // bytes in the whole key
+};
+
+/*****************************************************************
+ * STRING BST
+ * A binary search tree of strings stored in an arena
+ *****************************************************************/
+class StringBST
+{
+   friend class ::TestStringBST; // give unit tests access to the privates
+public:
+   class iterator;
+
+   //
+   // Construct
+   //
+
+   StringBST() : pArena(new StringArena) {}
+   StringBST(const StringBST & rhs) : pArena(new StringArena)
+   {
+      *this = rhs;
+   }
+   StringBST(StringBST && rhs) : pArena(new StringArena)
+   {
+      *this = std::move(rhs);
+   }
+
+   //
+   // Assign
+   //
+
+   StringBST & operator = (const StringBST & rhs)
+   {
+      // the keys hold offsets, so they read the copied arena as they are
+      *pArena = *rhs.pArena;
+      bst = rhs.bst;
+      return *this;
+   }
+   StringBST & operator = (StringBST && rhs)
+   {
+      // the arena stays where it is on the heap, for iterators into it
+      bst = std::move(rhs.bst);
+      std::swap(pArena, rhs.pArena);
+      return *this;
+   }
+
+   //
+   // Iterator
+   //
+
+   iterator begin() const noexcept;
+   iterator end()   const noexcept;
+
+   //
+   // Access
+   //
+
+   iterator find(const std::string & s) const;
+   iterator lower_bound(const std::string & s) const;
+   iterator upper_bound(const std::string & s) const;
+   std::pair<iterator, iterator> prefix_range(const std::string & prefix) const;
+
+   //
+   // Insert
+   //
+
+   std::pair<iterator, bool> insert(const std::string & s, bool keepUnique = false);
+
+   //
+   // Remove
+   //
+
+   iterator erase(iterator & it);
+   void clear() noexcept
+   {
+      bst.clear();
+      pArena->common.clear();
+      pArena->bytes.clear();
+      pArena->live = 0;
+   }
+
+   //
+   // Status
+   //
+
+   bool   empty() const noexcept { return bst.empty(); }
+   size_t size()  const noexcept { return bst.size();  }
+
+   //
+   // Arena
+   //
+
+   size_t arenaSize()     const { return pArena->size();     }
+   size_t arenaLiveSize() const { return pArena->liveSize(); }
+   void compact() { repack(pArena->skip()); }
+
+private:
+   typedef BST<ArenaKey>::BNode BNode;
+
+   // negative, zero or positive as s orders before every key, starts
+   // with the common prefix, or orders after every key
+   int compareCommon(const std::string & s) const
+   {
+      const std::string & common = pArena->common;
+      if (s.size() < common.size())
+      {
+         int compare = memcmp(s.data(), common.data(), s.size());
+         return compare != 0 ? compare : -1;
+      }
+      return memcmp(s.data(), common.data(), common.size());
+   }
+
+   // where the bytes of s past the window are, for comparing with a key
+   const char * tailOf(const std::string & s) const
+   {
+      uint32_t inlineEnd = pArena->skip() + ArenaKey::INLINE;
+      return s.data() + (s.size() > inlineEnd ? inlineEnd : 0);
+   }
+
+   // the key in pNode against the key for s, resolving the node's tail
+   // in the arena
+   int compare(const BNode * pNode, const ArenaKey & key, const char * pTail) const
+   {
+      return ArenaKey::compare(pNode->data, pArena->bytes.data() + pNode->data.offset,
+                               key, pTail, pArena->skip());
+   }
+
+   // the first node that s is not greater than, or with isStrict the
+   // first it is less than
+   iterator bound(const std::string & s, bool isStrict) const;
+
+   // pack every key around the first skip bytes, which they all share,
+   // copying the live tails in key order into a fresh arena
+   void repack(uint32_t skip);
+   void repackNode(BNode * pNode, uint32_t skip, StringArena & arena);
+
+   BST<ArenaKey> bst;                  // the keys
+   std::unique_ptr<StringArena> pArena; // their bytes, on the heap so moves keep them put
+};
+
+/*****************************************************************
+ * STRING BST ITERATOR
+ * A BST iterator that knows the arena, so it can hand back the
+ * whole string
+ *****************************************************************/
+class StringBST :: iterator
+{
+   friend class StringBST;
+public:
+   iterator() : pArena(nullptr) {}
+   iterator(const BST<ArenaKey>::iterator & it, const StringArena * pArena) :
+      it(it), pArena(pArena) {}
+
+   bool operator == (const iterator & rhs) const { return it == rhs.it; }
+   bool operator != (const iterator & rhs) const { return it != rhs.it; }
+
+   // the key, rebuilt from its window and the arena
+   std::string operator * () const { return (*it).str(*pArena); }
+
+   iterator & operator ++ () { ++it; return *this; }
+   iterator & operator -- () { --it; return *this; }
+
+private:
+   BST<ArenaKey>::iterator it;
+   const StringArena * pArena;
+};
+
+inline StringBST::iterator StringBST :: begin() const noexcept
+{
+   return iterator(bst.begin(), pArena.get());
+}
+inline StringBST::iterator StringBST :: end() const noexcept
+{
+   return iterator(bst.end(), pArena.get());
+}
+
+/*********************************************
+ * STRING BST :: FIND
+ * One three-way comparison per level, the arena found once through
+ * the tree rather than through every key. A StringBST never freezes
+ * its BST, so there are no frozen links to look out for here or in
+ * the other descents.
+ ********************************************/
+inline StringBST::iterator StringBST :: find(const std::string & s) const
+{
+   if (bst.root == nullptr || compareCommon(s) != 0)
+      return end();
+   ArenaKey key(s, pArena->skip(), 0);
+   const char * pTail = tailOf(s);
+   BNode * pNode = bst.root;
+   while (pNode != nullptr)
+   {
+      int compare = this->compare(pNode, key, pTail);
+      if (compare == 0)
+         return iterator(BST<ArenaKey>::iterator(pNode), pArena.get());
+      pNode = pNode->child(compare < 0);
+   }
+   return end();
+}
+
+/*********************************************
+ * STRING BST :: LOWER BOUND
+ * The first key not less than s
+ ********************************************/
+inline StringBST::iterator StringBST :: lower_bound(const std::string & s) const
+{
+   return bound(s, false /* isStrict */);
+}
+
+/*********************************************
+ * STRING BST :: UPPER BOUND
+ * The first key greater than s
+ ********************************************/
+inline StringBST::iterator StringBST :: upper_bound(const std::string & s) const
+{
+   return bound(s, true /* isStrict */);
+}
+
+/*********************************************
+ * STRING BST :: BOUND
+ * A string that breaks the common prefix is below or above every key.
+ * Otherwise walk down without branching on the comparison, like
+ * BST::lower_bound.
+ ********************************************/
+inline StringBST::iterator StringBST :: bound(const std::string & s, bool isStrict) const
+{
+   if (bst.root == nullptr)
+      return end();
+   int common = compareCommon(s);
+   if (common != 0)
+      return common < 0 ? begin() : end();
+
+   ArenaKey key(s, pArena->skip(), 0);
+   const char * pTail = tailOf(s);
+   int limit = isStrict ? 0 : -1;   // go right while the node compares at most this
+   BNode * pResult = nullptr;
+   BNode * pNode = bst.root;
+   while (pNode != nullptr)
+   {
+      bool isRight = compare(pNode, key, pTail) <= limit;
+      pResult = (isRight ? pResult : pNode);
+      pNode = pNode->child(isRight);
+   }
+   return iterator(BST<ArenaKey>::iterator(pResult), pArena.get());
+}
+
+/*********************************************
+ * STRING BST :: INSERT
+ * Shorten the common prefix first if s breaks it. Then walk down
+ * comparing against s where it is, and only copy its tail into the
+ * arena once it is sure to go in, so a duplicate under keepUnique
+ * leaves nothing behind.
+ ********************************************/
+inline std::pair<StringBST::iterator, bool> StringBST :: insert(const std::string & s, bool keepUnique)
+{
+   // the first key is all common prefix, until the next one says otherwise
+   if (bst.root == nullptr)
+      pArena->common = s;
+   else if (compareCommon(s) != 0)
+   {
+      const std::string & common = pArena->common;
+      uint32_t skip = 0;
+      while (skip < common.size() && skip < s.size() && common[skip] == s[skip])
+         skip++;
+      repack(skip);
+   }
+
+   uint32_t skip = pArena->skip();
+   ArenaKey key(s, skip, 0);
+   const char * pTail = tailOf(s);
+   BNode * pNode = bst.root;
+   bool isRight = false;
+   while (pNode != nullptr)
+   {
+      int compare = this->compare(pNode, key, pTail);
+      if (keepUnique && compare == 0)
+         return std::make_pair(iterator(BST<ArenaKey>::iterator(pNode), pArena.get()), false);
+      isRight = compare <= 0;
+      if (pNode->child(isRight) == nullptr)
+         break;
+      pNode = pNode->child(isRight);
+   }
+
+   if (s.size() > skip + ArenaKey::INLINE)
+      key.offset = pArena->append(pTail, s.size() - skip - ArenaKey::INLINE);
+
+   BNode * pNew;
+   bst.clock++;
+   if (pNode == nullptr)
+   {
+      pNew = bst.root = bst.allocateNode(nullptr, false, key);
+      bst.root->written = bst.clock;
+      bst.root->isRed = false;
+   }
+   else
+   {
+      pNew = bst.attach(pNode, isRight, key);
+      // a rotation at the top leaves the old root under the new one
+      while (bst.root->pParent != nullptr)
+         bst.root = bst.root->pParent;
+   }
+   bst.numElements++;
+   return std::make_pair(iterator(BST<ArenaKey>::iterator(pNew), pArena.get()), true);
+}
+
+/*********************************************
+ * STRING BST :: ERASE
+ * The key's bytes stay in the arena until compact()
+ ********************************************/
+inline StringBST::iterator StringBST :: erase(iterator & it)
+{
+   uint32_t inlineEnd = pArena->skip() + ArenaKey::INLINE;
+   if (it != end() && (*it.it).length > inlineEnd)
+      pArena->release((*it.it).length - inlineEnd);
+   return iterator(bst.erase(it.it), pArena.get());
+}
+
+/*********************************************
+ * STRING BST :: PREFIX RANGE
+ * Every key that begins with prefix, from the first to just past the
+ * last
+ ********************************************/
+inline std::pair<StringBST::iterator, StringBST::iterator> StringBST :: prefix_range(const std::string & prefix) const
+{
+   std::string past = KeyEncoder::pastPrefix(prefix);
+   iterator itFirst = lower_bound(prefix);
+   return std::make_pair(itFirst, past.empty() ? end() : lower_bound(past));
+}
+
+/*********************************************
+ * STRING BST :: REPACK
+ * Drop the bytes of erased keys, leaving the live ones in key order
+ * so neighbors in the tree are neighbors in memory. With a shorter
+ * skip the windows move forward and take bytes from the common
+ * prefix, and the tails take the bytes they leave behind.
+ ********************************************/
+inline void StringBST :: repack(uint32_t skip)
+{
+   StringArena arena;
+   arena.common = pArena->common.substr(0, skip);
+   arena.bytes.reserve(pArena->liveSize());
+   repackNode(bst.root, skip, arena);
+   *pArena = std::move(arena);
+}
+
+/*********************************************
+ * STRING BST :: REPACK NODE
+ * In-order, so the arena ends up sorted
+ ********************************************/
+inline void StringBST :: repackNode(BNode * pNode, uint32_t skip, StringArena & arena)
+{
+   if (pNode == nullptr)
+      return;
+   repackNode(pNode->pLeft, skip, arena);
+   ArenaKey & key = pNode->data;
+   std::string s = key.str(*pArena);
+   key.window = ArenaKey::pack(s, skip);
+   if (key.length > skip + ArenaKey::INLINE)
+      key.offset = arena.append(s.data() + skip + ArenaKey::INLINE,
+                                key.length - skip - ArenaKey::INLINE);
+   else
+      key.offset = 0;
+   repackNode(pNode->pRight, skip, arena);
+}
+
+} // namespace custom
@@ -0,0 +1,178 @@
+/***********************************************************************
+ * Header:
+ *    SYNTHETIC
+ * Summary:
+ *    Key types made to measure, for finding out how the trees behave with
+ *    elements that are not ints. Each is an integer value dressed up with
+ *    a cost chosen at compile time:
+ *
+ *        SIZE          : bytes in the key
+ *        COMPARE_BYTES : bytes < and == memcmp, all but the last eight of
+ *                        them the same in every key so none can be skipped
+ *        COMPARE_SPIN  : extra steps of busy work per comparison
+ *        COPY_SPIN     : extra steps per copy construction or assignment
+ *        MOVE_SPIN     : extra steps per move construction or assignment
+ *        TRIVIAL       : trivially copyable, so containers may memcpy it
+ *
+ *    A step of busy work is one increment of a volatile, about a
+ *    nanosecond, which the optimizer cannot remove.
+ *
+ *    Keys count into the Spy counters: DEFAULT, NONDEFAULT, EQUALS and
+ *    LESSTHAN always, and COPY, COPY_MOVE, ASSIGN, ASSIGN_MOVE and
+ *    DESTRUCTOR unless TRIVIAL, since a trivially copyable type can do
+ *    nothing when it is copied. Read them with Spy::Delta.
+ *
+ *    This will contain the class definition of:
+ *        Synthetic          : A key of a given size, comparison and copy cost
+ *        SyntheticBytes     : The bytes of a Synthetic, and how they copy
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include "spy.h"
+
+#include <cstddef>    // for size_t
+#include <cstdint>    // for int64_t and uint64_t
+#include <cstring>    // for memcmp and memcpy
+
+namespace custom
+{
+
+/*********************************************
+ * SPIN
+ * steps of work the optimizer has to leave in
+ ********************************************/
+inline void spin(unsigned int steps)
+{
+   volatile unsigned int counter = 0;
+   for (unsigned int i = 0; i < steps; i++)
+      counter = counter + 1;
+}
+
+/*****************************************************************
+ * SYNTHETIC BYTES
+ * SIZE bytes that copy and move at a cost, counting as they go
+ *****************************************************************/
+template <size_t SIZE, unsigned int COPY_SPIN, unsigned int MOVE_SPIN, bool TRIVIAL>
+class SyntheticBytes
+{
+public:
+   SyntheticBytes() {}
+   SyntheticBytes(const SyntheticBytes & rhs)
+   {
+      std::memcpy(bytes, rhs.bytes, SIZE);
+      spin(COPY_SPIN);
+      Spy::record(COPY);
+   }
+   SyntheticBytes(SyntheticBytes && rhs) noexcept
+   {
+      std::memcpy(bytes, rhs.bytes, SIZE);
+      spin(MOVE_SPIN);
+      Spy::record(COPY_MOVE);
+   }
+   ~SyntheticBytes() { Spy::record(DESTRUCTOR); }
+
+   SyntheticBytes & operator = (const SyntheticBytes & rhs)
+   {
+      std::memcpy(bytes, rhs.bytes, SIZE);
+      spin(COPY_SPIN);
+      Spy::record(ASSIGN);
+      return *this;
+   }
+   SyntheticBytes & operator = (SyntheticBytes && rhs) noexcept
+   {
+      std::memcpy(bytes, rhs.bytes, SIZE);
+      spin(MOVE_SPIN);
+      Spy::record(ASSIGN_MOVE);
+      return *this;
+   }
+
+   unsigned char bytes[SIZE];
+};
+
+/*****************************************************************
+ * SYNTHETIC BYTES, trivially copyable
+ * Just the bytes: copying them is the compiler's business
+ *****************************************************************/
+template <size_t SIZE, unsigned int COPY_SPIN, unsigned int MOVE_SPIN>
+class SyntheticBytes <SIZE, COPY_SPIN, MOVE_SPIN, true>
+{
+   static_assert(COPY_SPIN == 0 && MOVE_SPIN == 0,
+                 "a trivially copyable key cannot spin when copied");
+public:
+   unsigned char bytes[SIZE];
+};
+
+/*****************************************************************
+ * SYNTHETIC
+ * An int64_t value that costs what it is told to. The value is
+ * stored big-endian with its sign bit flipped at the end of the
+ * compared bytes, so memcmp orders keys the way the values go.
+ *****************************************************************/
+template <size_t SIZE,
+          size_t COMPARE_BYTES = 8,
+          unsigned int COMPARE_SPIN = 0,
+          unsigned int COPY_SPIN = 0,
+          unsigned int MOVE_SPIN = 0,
+          bool TRIVIAL = false>
+class Synthetic : public SyntheticBytes <SIZE, COPY_SPIN, MOVE_SPIN, TRIVIAL>
+{
+   static_assert(COMPARE_BYTES >= 8, "the value takes eight bytes to compare");
+   static_assert(COMPARE_BYTES <= SIZE, "cannot compare more bytes than there are");
+
+   using SyntheticBytes <SIZE, COPY_SPIN, MOVE_SPIN, TRIVIAL> :: bytes;
+public:
+   static const bool isTrivial = TRIVIAL;
+
+   Synthetic()
+   {
+      setValue(0);
+      Spy::record(DEFAULT);
+   }
+   Synthetic(int64_t value)
+   {
+      setValue(value);
+      Spy::record(NONDEFAULT);
+   }
+
+   int64_t value() const
+   {
+      uint64_t bits = 0;
+      for (size_t i = COMPARE_BYTES - 8; i < COMPARE_BYTES; i++)
+         bits = (bits << 8) | bytes[i];
+      return (int64_t)(bits ^ SIGN);
+   }
+
+   bool operator < (const Synthetic & rhs) const
+   {
+      spin(COMPARE_SPIN);
+      Spy::record(LESSTHAN);
+      return std::memcmp(bytes, rhs.bytes, COMPARE_BYTES) < 0;
+   }
+
+   bool operator == (const Synthetic & rhs) const
+   {
+      spin(COMPARE_SPIN);
+      Spy::record(EQUALS);
+      return std::memcmp(bytes, rhs.bytes, COMPARE_BYTES) == 0;
+   }
+
+private:
+   static const uint64_t SIGN = (uint64_t)1 << 63;
+
+   // the same filler before the value in every key, and the value
+   void setValue(int64_t value)
+   {
+      std::memset(bytes, 0x5a, SIZE);
+      uint64_t bits = (uint64_t)value ^ SIGN;
+      for (size_t i = COMPARE_BYTES; i > COMPARE_BYTES - 8; i--)
+      {
+         bytes[i - 1] = (unsigned char)bits;
+         bits >>= 8;
+      }
+   }
+};
+
+} // namespace custom
@@ -14,7 +14,18 @@
 
 #include "testBST.h"        // for the BST unit tests
 #include "testSpy.h"        // for the spy unit tests
-int Spy::counters[] = {};
+#include "testOrderedContainer.h" // for the backend unit tests
+#include "testWorkload.h"   // for the workload generator unit tests
+#include "testStringBST.h"  // for the string arena unit tests
+#include "testLeftRight.h"  // for the left-right wrapper unit tests
+#include "testKeyRangeLock.h" // for the key range lock unit tests
+#include "testSnapshot.h"   // for the snapshot unit tests
+#include "testKeyEncoding.h" // for the key encoding unit tests
+#include "testSplitBST.h"   // for the hot/cold split BST unit tests
+#include "testTrace.h"      // for the trace-event unit tests
+#include "testRangeSet.h"   // for the interval set unit tests
+#include "testOrderBook.h"  // for the order book unit tests
+#include "testSynthetic.h"  // for the synthetic key unit tests
 
 /**********************************************************************
  * MAIN
@@ -26,6 +37,18 @@ int main()
    // unit tests
    TestSpy().run();
    TestBST().run();
+   TestOrderedContainer().run();
+   TestWorkload().run();
+   TestStringBST().run();
+   TestLeftRight().run();
+   TestKeyRangeLock().run();
+   TestSnapshot().run();
+   TestKeyEncoding().run();
+   TestSplitBST().run();
+   TestTrace().run();
+   TestRangeSet().run();
+   TestOrderBook().run();
+   TestSynthetic().run();
 #endif // DEBUG
    
    return 0;
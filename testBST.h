@@ -14,12 +14,16 @@
 #include "bst.h"
 #include "unitTest.h"
 #include "spy.h"
+#include "workload.h"
 
 #include <cassert>
 #include <memory>
 #include <iostream>
 #include <string>
 #include <functional> // for std::less and std::greater
+#include <set>        // for std::set
+#include <algorithm>  // for std::min and std::max
+#include <cstdlib>    // for std::abs
 
  /***********************************************
   * TEST BST
@@ -54,6 +58,8 @@ public:
       test_assign_oneToStandard();
       test_assign_standardToOne();
       test_assign_standardToStandard();
+      test_assign_standardToOtherShape();
+      test_assign_standardToLarger();
       test_assignMove_emptyToEmpty();
       test_assignMove_standardToEmpty();
       test_assignMove_emptyToStandard();
@@ -112,6 +118,13 @@ public:
       test_insert_case4cComplex();
       test_insert_case4dComplex();
 
+      // Upsert
+      test_upsert_empty();
+      test_upsert_existing();
+      test_upsert_missing();
+      test_upsert_counts();
+      test_upsert_frozen();
+
       // Remove
       test_erase_empty();
       test_erase_standardMissing();
@@ -128,6 +141,58 @@ public:
       test_size_empty();
       test_size_standard();
 
+      // Allocation
+      test_allocation_independent();
+      test_allocation_pairedSiblings();
+      test_allocation_pairedReuse();
+
+      // Capacity
+      test_capacity_empty();
+      test_capacity_standard();
+      test_reserve_empty();
+      test_reserve_smaller();
+      test_reserve_insertUsesChunk();
+      test_reserve_eraseReuses();
+      test_shrinkToFit_afterErase();
+
+      // Relayout
+      test_sampling_off();
+      test_sampling_countsPath();
+      test_sampling_period();
+      test_relayout_topLevels();
+      test_relayout_hotPath();
+      test_relayout_erase();
+
+      // Tiering
+      test_freeze_empty();
+      test_freeze_allHot();
+      test_freeze_coldSide();
+      test_freeze_access();
+      test_freeze_insertThaws();
+      test_freeze_eraseThaws();
+      test_freeze_copy();
+
+      // Spilling
+      test_spill_noLimit();
+      test_spill_oldestOut();
+      test_spill_faultIn();
+      test_spill_access();
+      test_spill_insert();
+      test_spill_freezesNodes();
+
+      // Estimate
+      test_estimate_empty();
+      test_estimate_ends();
+      test_estimate_close();
+      test_estimate_frozen();
+      test_histogram_equiDepth();
+      test_histogram_small();
+
+      // Workload
+      test_workload_recolorCascades();
+      test_workload_rotations();
+      test_workload_eraseChurn();
+
       report("BST");
    }
    
@@ -858,6 +923,102 @@ public:
    }
 
 
+   // assignment operator : standard = seven nodes in another shape
+   void test_assign_standardToOtherShape()
+   {  // setup
+      //                (50b) = bstSrc
+      //          +-------+-------+
+      //        (30b)           (70b)
+      //     +----+----+     +----+----+
+      //   (20r)     (40r) (60r)     (80r)
+      custom::BST <Spy> bstSrc;
+      setupStandardFixture(bstSrc);
+      //          (2b) = bstDest
+      //     +-----+-----+
+      //   (1b)        (4r)
+      //            +---+---+
+      //          (3b)     (6b)
+      //                 +--+--+
+      //               (5r)   (7r)
+      custom::BST <Spy> bstDest;
+      for (int i = 1; i <= 7; i++)
+         bstDest.insert(Spy(i));
+      std::set <void *> nodes;
+      for (auto it = bstDest.begin(); it != bstDest.end(); ++it)
+         nodes.insert(it.pNode);
+      Spy::reset();
+      // exercise
+      bstDest = bstSrc;
+      // verify
+      assertUnit(Spy::numAssign() == 7);      // assign [20][30][40][50][60][70][80]
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numDestructor() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(Spy::numNondefault() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numAssignMove() == 0);
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numLessthan() == 0);
+      bool reused = true;
+      for (auto it = bstDest.begin(); it != bstDest.end(); ++it)
+         reused = reused && nodes.count(it.pNode) == 1;
+      assertUnit(reused);
+      //                (50b)
+      //          +-------+-------+
+      //        (30b)           (70b)
+      //     +----+----+     +----+----+
+      //   (20r)     (40r) (60r)     (80r)
+      assertStandardFixture(bstSrc);
+      assertStandardFixture(bstDest);
+      // teardown
+      teardownStandardFixture(bstSrc);
+      teardownStandardFixture(bstDest);
+   }
+
+   // assignment operator : standard = ten nodes
+   void test_assign_standardToLarger()
+   {  // setup
+      //                (50b) = bstSrc
+      //          +-------+-------+
+      //        (30b)           (70b)
+      //     +----+----+     +----+----+
+      //   (20r)     (40r) (60r)     (80r)
+      custom::BST <Spy> bstSrc;
+      setupStandardFixture(bstSrc);
+      // [1] through [10] = bstDest
+      custom::BST <Spy> bstDest;
+      for (int i = 10; i >= 1; i--)
+         bstDest.insert(Spy(i));
+      Spy::reset();
+      // exercise
+      bstDest = bstSrc;
+      // verify
+      assertUnit(Spy::numAssign() == 7);      // assign  [20][30][40][50][60][70][80]
+      assertUnit(Spy::numDestructor() == 3);  // destroy the three left over
+      assertUnit(Spy::numDelete() == 3);      // delete  the three left over
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numDefault() == 0);
+      assertUnit(Spy::numNondefault() == 0);
+      assertUnit(Spy::numCopyMove() == 0);
+      assertUnit(Spy::numAssignMove() == 0);
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(bstDest.size() == 7);
+      //                (50b)
+      //          +-------+-------+
+      //        (30b)           (70b)
+      //     +----+----+     +----+----+
+      //   (20r)     (40r) (60r)     (80r)
+      assertStandardFixture(bstSrc);
+      assertStandardFixture(bstDest);
+      // teardown
+      teardownStandardFixture(bstSrc);
+      teardownStandardFixture(bstDest);
+   }
+
    /***************************************
     * Assignment-Move
     *    BST::operator=(BST &&)
@@ -3658,6 +3819,170 @@ public:
       bst.root = nullptr;
    }
 
+   /***************************************
+    * Upsert
+    *    BST::upsert(key, create, update)
+    ***************************************/
+
+   // an element whose key orders it and whose count rides along
+   struct Tally
+   {
+      int key;
+      int count;
+      bool operator <  (const Tally & rhs) const { return key <  rhs.key; }
+      bool operator == (const Tally & rhs) const { return key == rhs.key; }
+   };
+
+   // the first element is created as the black root
+   void test_upsert_empty()
+   {  // setup
+      custom::BST <Spy> bst;
+      int numUpdates = 0;
+      // exercise
+      auto pairBST = bst.upsert(Spy(50),
+         [](const Spy & key) { return key; },
+         [&numUpdates](Spy &) { numUpdates++; });
+      // verify
+      assertUnit(pairBST.second == true);
+      assertUnit(numUpdates == 0);
+      assertUnit(bst.numElements == 1);
+      assertUnit(bst.root != nullptr);
+      if (bst.root)
+      {
+         assertUnit(bst.root->data == Spy(50));
+         assertUnit(bst.root->isRed == false);
+      }
+   }  // teardown
+
+   // an existing element is updated where it is, found in one descent
+   void test_upsert_existing()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      custom::BST <Spy>::BNode * p40 = bst.root->pLeft->pRight;
+      Spy s(40);
+      Spy * pUpdated = nullptr;
+      int numCreates = 0;
+      Spy::reset();
+      // exercise
+      auto pairBST = bst.upsert(s,
+         [&numCreates](const Spy & key) { numCreates++; return key; },
+         [&pUpdated](Spy & spy) { pUpdated = &spy; });
+      // verify
+      assertUnit(Spy::numLessthan() == 5);    // compare [50][30][30][40][40]
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(numCreates == 0);
+      assertUnit(pUpdated == &p40->data);
+      assertUnit(pairBST.second == false);
+      assertUnit(pairBST.first == custom::BST <Spy>::iterator(p40));
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      assertStandardFixture(bst);
+      // teardown
+      teardownStandardFixture(bst);
+   }
+
+   // a missing element is created where insert would put it and balanced
+   void test_upsert_missing()
+   {  // setup
+      //                 50 
+      //          +-------+-------+
+      //         30              70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      custom::BST <Spy> bst;
+      setupStandardFixture(bst);
+      int numUpdates = 0;
+      Spy::reset();
+      // exercise
+      auto pairBST = bst.upsert(Spy(45),
+         [](const Spy & key) { return key; },
+         [&numUpdates](Spy &) { numUpdates++; });
+      // verify
+      assertUnit(Spy::numLessthan() == 5);    // compare [50][30][30][40][40]
+      assertUnit(Spy::numEquals() == 0);
+      assertUnit(Spy::numCopy() == 1);        // create() copies the key
+      assertUnit(numUpdates == 0);
+      assertUnit(pairBST.second == true);
+      assertUnit(bst.numElements == 8);
+      //                 50 
+      //          +-------+-------+
+      //        (30)             70  
+      //     +----+----+     +----+----+
+      //    20        40    60        80  
+      //               +--+
+      //                 (45)
+      custom::BST <Spy>::BNode * p30 = bst.root->pLeft;
+      assertUnit(p30->isRed == true);
+      assertUnit(p30->pLeft->isRed == false);
+      assertUnit(p30->pRight->isRed == false);
+      assertUnit(p30->pRight->pRight != nullptr);
+      if (p30->pRight->pRight)
+      {
+         assertUnit(p30->pRight->pRight->data == Spy(45));
+         assertUnit(p30->pRight->pRight->isRed == true);
+         assertUnit(pairBST.first == custom::BST <Spy>::iterator(p30->pRight->pRight));
+      }
+   }  // teardown
+
+   // counting words: each repeat bumps the count of the node already there
+   void test_upsert_counts()
+   {  // setup
+      custom::BST <Tally> bst;
+      const Tally * pFirst = nullptr;
+      // exercise
+      for (int key : { 5, 3, 5, 8, 5, 3 })
+      {
+         auto pairBST = bst.upsert(Tally{ key, 0 },
+            [](const Tally & tally) { return Tally{ tally.key, 1 }; },
+            [](Tally & tally) { tally.count++; });
+         if (key == 5 && pFirst == nullptr)
+            pFirst = &*pairBST.first;
+         else if (key == 5)
+            assertUnit(&*pairBST.first == pFirst);
+      }
+      // verify
+      assertUnit(bst.size() == 3);
+      auto it = bst.begin();
+      assertUnit((*it).key == 3 && (*it).count == 2);
+      ++it;
+      assertUnit((*it).key == 5 && (*it).count == 3);
+      ++it;
+      assertUnit((*it).key == 8 && (*it).count == 1);
+   }  // teardown
+
+   // an update in a frozen block thaws it first, as an insert would
+   void test_upsert_frozen()
+   {  // setup
+      custom::BST <Tally> bst;
+      for (int key = 0; key < 100; key++)
+         bst.insert(Tally{ key, 0 });
+      bst.freeze(0);
+      size_t numFrozen = bst.frozenSize();
+      // exercise
+      auto pairBST = bst.upsert(Tally{ 10, 0 },
+         [](const Tally & tally) { return tally; },
+         [](Tally & tally) { tally.count = 7; });
+      // verify
+      assertUnit(numFrozen > 0);
+      assertUnit(bst.frozenSize() < numFrozen);
+      assertUnit(pairBST.second == false);
+      assertUnit(!custom::BST <Tally>::isFrozen(pairBST.first.pNode));
+      assertUnit((*bst.lower_bound(Tally{ 10, 0 })).count == 7);
+      assertUnit(bst.size() == 100);
+   }  // teardown
+
    /***************************************
     * Erase
     *    BST::erase(it)
@@ -3974,6 +4299,832 @@ public:
    }
 
 
+   /***************************************
+    * ALLOCATION
+    *    BST::setAllocation(Allocation)
+    ***************************************/
+
+   // by default every node is its own allocation
+   void test_allocation_independent()
+   {  // setup
+      custom::BST <int> bst;
+      // exercise
+      bst.insert(50);
+      bst.insert(30);
+      bst.insert(70);
+      // verify
+      assertUnit(bst.getAllocation() == custom::BST <int> ::INDEPENDENT);
+      assertUnit(bst.root != nullptr);
+      if (bst.root && bst.root->pLeft && bst.root->pRight)
+      {
+         assertUnit(bst.root->slot == 0);
+         assertUnit(bst.root->pLeft->slot == 0);
+         assertUnit(bst.root->pRight->slot == 0);
+      }
+   }  // teardown
+
+   // siblings land side by side in one cache-aligned pair
+   void test_allocation_pairedSiblings()
+   {  // setup
+      custom::BST <int> bst;
+      bst.setAllocation(custom::BST <int> ::PAIRED);
+      // exercise
+      bst.insert(50);
+      bst.insert(30);
+      bst.insert(70);
+      // verify
+      //                (50b)
+      //          +-------+-------+
+      //        (30r)           (70r)
+      assertUnit(bst.root != nullptr);
+      if (bst.root && bst.root->pLeft && bst.root->pRight)
+      {
+         auto p30 = bst.root->pLeft;
+         auto p70 = bst.root->pRight;
+         assertUnit(bst.root->slot == 0);   // the root has no sibling
+         assertUnit(p30->slot == 1);
+         assertUnit(p70->slot == 2);
+         assertUnit((char *)p70 - (char *)p30 == sizeof(custom::BST <int> ::NodePair::Slot));
+         assertUnit((size_t)p30 % custom::BST <int> ::NodePair::CACHE_LINE == 0);
+      }
+   }  // teardown
+
+   // a new child moves into the half its erased sibling left behind
+   void test_allocation_pairedReuse()
+   {  // setup
+      //                (50b)
+      //          +-------+-------+
+      //      [[30r]]           (70r)
+      custom::BST <int> bst;
+      bst.setAllocation(custom::BST <int> ::PAIRED);
+      bst.insert(50);
+      bst.insert(30);
+      bst.insert(70);
+      auto it = bst.find(30);
+      void * pOld = it.pNode;
+      bst.erase(it);
+      // exercise
+      auto pairReturn = bst.insert(20);
+      // verify
+      //                (50b)
+      //          +-------+-------+
+      //        (20r)           (70r)
+      assertUnit(pairReturn.first.pNode == pOld);
+      assertUnit(pairReturn.first.pNode->slot == 1);
+      assertUnit(bst.size() == 3);
+   }  // teardown
+
+   /***************************************
+    * CAPACITY
+    *    BST::reserve(size_t)
+    *    BST::capacity()
+    *    BST::shrink_to_fit()
+    ***************************************/
+
+   // nothing reserved, nothing held
+   void test_capacity_empty()
+   {  // setup
+      custom::BST <int> bst;
+      // exercise and verify
+      assertUnit(bst.capacity() == 0);
+   }  // teardown
+
+   // without reserve, capacity is just the size
+   void test_capacity_standard()
+   {  // setup
+      custom::BST <int> bst;
+      // exercise
+      bst.insert(50);
+      bst.insert(30);
+      bst.insert(70);
+      // verify
+      assertUnit(bst.capacity() == 3);
+      assertUnit(bst.pool.chunks.size() == 0);
+   }  // teardown
+
+   // reserve sets aside one chunk
+   void test_reserve_empty()
+   {  // setup
+      custom::BST <int> bst;
+      // exercise
+      bst.reserve(100);
+      // verify
+      assertUnit(bst.capacity() == 100);
+      assertUnit(bst.size() == 0);
+      assertUnit(bst.root == nullptr);
+      assertUnit(bst.pool.chunks.size() == 1);
+      assertUnit(bst.pool.numFree == 100);
+   }  // teardown
+
+   // reserving less than we have does nothing
+   void test_reserve_smaller()
+   {  // setup
+      custom::BST <int> bst;
+      bst.reserve(10);
+      // exercise
+      bst.reserve(5);
+      // verify
+      assertUnit(bst.capacity() == 10);
+      assertUnit(bst.pool.chunks.size() == 1);
+   }  // teardown
+
+   // every insert after reserve lands in the chunk, side by side
+   void test_reserve_insertUsesChunk()
+   {  // setup
+      custom::BST <int> bst;
+      bst.reserve(7);
+      // exercise
+      for (int value : { 50, 30, 70, 20, 40, 60, 80 })
+         bst.insert(value);
+      // verify
+      assertUnit(bst.size() == 7);
+      assertUnit(bst.capacity() == 7);
+      assertUnit(bst.pool.numFree == 0);
+      assertUnit(bst.pool.chunks.size() == 1);
+      bool inChunk = true;
+      char * pBegin = reinterpret_cast<char *>(bst.pool.chunks[0]);
+      char * pEnd = pBegin + 7 * sizeof(custom::BST <int> ::NodePool::Slot);
+      for (auto it = bst.begin(); it != bst.end(); ++it)
+      {
+         char * pNode = reinterpret_cast<char *>(it.pNode);
+         inChunk = inChunk && it.pNode->slot == custom::BST <int> ::POOLED &&
+                   pNode >= pBegin && pNode < pEnd;
+      }
+      assertUnit(inChunk);
+      assertUnit(reinterpret_cast<char *>(bst.root) == pBegin);  // 50 went in first
+   }  // teardown
+
+   // an erased node goes back to the pool for the next insert
+   void test_reserve_eraseReuses()
+   {  // setup
+      custom::BST <int> bst;
+      bst.reserve(3);
+      bst.insert(50);
+      bst.insert(30);
+      bst.insert(70);
+      auto it = bst.find(30);
+      void * pOld = it.pNode;
+      // exercise
+      bst.erase(it);
+      auto pairReturn = bst.insert(20);
+      // verify
+      assertUnit(pairReturn.first.pNode == pOld);
+      assertUnit(bst.capacity() == 3);
+      assertUnit(bst.pool.chunks.size() == 1);
+   }  // teardown
+
+   // after a large erase the spare nodes are handed back
+   void test_shrinkToFit_afterErase()
+   {  // setup
+      custom::BST <Spy> bst;
+      bst.reserve(100);
+      for (int i = 0; i < 100; i++)
+         bst.insert(Spy(i));
+      for (int i = 0; i < 100; i++)
+         if (i % 10 != 0)
+         {
+            auto it = bst.find(Spy(i));
+            bst.erase(it);
+         }
+      void * pOldChunk = bst.pool.chunks[0];
+      Spy::reset();
+      // exercise
+      bst.shrink_to_fit();
+      // verify
+      assertUnit(Spy::numCopyMove() == 10);   // move [0][10][20] ... [90]
+      assertUnit(Spy::numDestructor() == 10); // destroy what was moved from
+      assertUnit(Spy::numCopy() == 0);
+      assertUnit(Spy::numAlloc() == 0);
+      assertUnit(Spy::numDelete() == 0);
+      assertUnit(Spy::numLessthan() == 0);
+      assertUnit(bst.size() == 10);
+      assertUnit(bst.capacity() == 10);
+      assertUnit(bst.pool.chunks.size() == 1);
+      assertUnit(bst.pool.chunks[0] != pOldChunk);
+      assertUnit(bst.root != nullptr);
+      if (bst.root)
+      {
+         bst.root->verifyBTree();
+         assertUnit(bst.root->pParent == nullptr);
+         assertUnit(bst.root->computeSize() == 10);
+      }
+      int expected = 0;
+      bool inOrder = true;
+      for (auto it = bst.begin(); it != bst.end(); ++it, expected += 10)
+         inOrder = inOrder && (*it).get() == expected;
+      assertUnit(inOrder);
+      assertUnit(expected == 100);
+   }  // teardown
+
+   /***************************************
+    * RELAYOUT
+    *    BST::setSampling(unsigned int)
+    *    BST::relayout(size_t, size_t)
+    ***************************************/
+
+   // without sampling, find counts nothing
+   void test_sampling_off()
+   {  // setup
+      custom::BST <int> bst;
+      for (int value : { 50, 30, 70, 20, 40 })
+         bst.insert(value);
+      // exercise
+      bst.find(20);
+      // verify
+      bool cold = true;
+      for (auto it = bst.begin(); it != bst.end(); ++it)
+         cold = cold && it.pNode->heat == 0;
+      assertUnit(cold);
+   }  // teardown
+
+   // a sampled find counts every node it passes through
+   void test_sampling_countsPath()
+   {  // setup
+      //                 50b
+      //          +-------+-------+
+      //         30b             70b
+      //     +----+----+
+      //    20r       40r
+      custom::BST <Spy> bst;
+      for (int value : { 50, 30, 70, 20, 40 })
+         bst.insert(Spy(value));
+      bst.setSampling(1);
+      Spy::reset();
+      // exercise
+      auto it = bst.find(Spy(40));
+      // verify
+      assertUnit(Spy::numEquals() == 3);    // same work as an unsampled find
+      assertUnit(Spy::numLessthan() == 2);
+      assertUnit(it != bst.end() && (*it).get() == 40);
+      assertUnit(bst.find(Spy(50)).pNode->heat == 2);
+      assertUnit(bst.find(Spy(30)).pNode->heat == 2);  // 50 30 again
+      assertUnit(bst.find(Spy(40)).pNode->heat == 2);  // 50 30 40 again
+      assertUnit(bst.find(Spy(20)).pNode->heat == 1);  // 50 30 20
+      assertUnit(bst.find(Spy(70)).pNode->heat == 1);  // 50 70
+   }  // teardown
+
+   // only every period-th find is counted
+   void test_sampling_period()
+   {  // setup
+      custom::BST <int> bst;
+      bst.insert(50);
+      bst.setSampling(4);
+      // exercise
+      for (int i = 0; i < 10; i++)
+         bst.find(50);
+      // verify
+      assertUnit(bst.root->heat == 2);
+   }  // teardown
+
+   // with nothing sampled, the top levels move into the block in level order
+   void test_relayout_topLevels()
+   {  // setup
+      custom::BST <int> bst;
+      for (int value : { 50, 30, 70, 20, 40, 60, 80, 10 })
+         bst.insert(value);
+      // exercise
+      bst.relayout(2, 100);
+      // verify
+      typedef custom::BST <int> ::HotRegion::Slot Slot;
+      Slot * pSlots = bst.hot.pSlots;
+      assertUnit(bst.hot.numSlots == 3);
+      assertUnit(bst.hot.numLive == 3);
+      assertUnit(reinterpret_cast<size_t>(pSlots) % 64 == 0);
+      assertUnit(bst.root == reinterpret_cast<void *>(&pSlots[0]));
+      assertUnit(bst.root->pLeft == reinterpret_cast<void *>(&pSlots[1]));
+      assertUnit(bst.root->pRight == reinterpret_cast<void *>(&pSlots[2]));
+      assertUnit(bst.root->slot == custom::BST <int> ::HOT);
+      assertUnit(bst.find(20).pNode->slot == 0);
+      assertUnit(bst.find(20).pNode->pParent == bst.root->pLeft);
+      assertUnit(bst.root->pLeft->pParent == bst.root);
+      bst.root->verifyBTree();
+      assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      int expected = 10;
+      bool inOrder = true;
+      for (auto it = bst.begin(); it != bst.end(); ++it, expected += 10)
+         inOrder = inOrder && *it == expected;
+      assertUnit(inOrder);
+      assertUnit(expected == 90);
+   }  // teardown
+
+   // the path to a hot key comes along, coolest first to go
+   void test_relayout_hotPath()
+   {  // setup
+      custom::BST <int> bst;
+      for (int value : { 50, 30, 70, 20, 40, 60, 80, 10 })
+         bst.insert(value);
+      bst.setSampling(1);
+      for (int i = 0; i < 8; i++)
+         bst.find(10);                        // 50 30 20 10
+      bst.find(80);                           // 50 70 80
+      // exercise
+      bst.relayout(1, 4);
+      // verify
+      bst.setSampling(0);
+      assertUnit(bst.hot.numSlots == 4);
+      bool hot = true;
+      for (int value : { 50, 30, 20, 10 })
+         hot = hot && bst.find(value).pNode->slot == custom::BST <int> ::HOT;
+      assertUnit(hot);
+      assertUnit(bst.find(70).pNode->slot == 0);
+      assertUnit(bst.find(10).pNode->heat == 4);       // halved
+      bst.root->verifyBTree();
+      assertUnit(bst.size() == 8);
+   }  // teardown
+
+   // erasing every hot node hands the block back
+   void test_relayout_erase()
+   {  // setup
+      custom::BST <Spy> bst;
+      for (int value : { 50, 30, 70 })
+         bst.insert(Spy(value));
+      bst.relayout(1, 1);
+      assertUnit(bst.hot.pRaw != nullptr);
+      // exercise
+      auto it = bst.find(Spy(50));
+      bst.erase(it);
+      // verify
+      assertUnit(bst.hot.pRaw == nullptr);
+      assertUnit(bst.size() == 2);
+      assertUnit(bst.root != nullptr && bst.root->slot == 0);
+   }  // teardown
+
+   /***************************************
+    * TIERING
+    *    BST::freeze(unsigned int)
+    *    BST::frozenSize()
+    ***************************************/
+
+   // 64 keys, then 200 inserts that all go down the right side,
+   // so the small keys have not been written near in a while
+   void setupColdLeft(custom::BST <int> & bst)
+   {
+      for (int key : Workload(1).shuffled(64))
+         bst.insert(key);
+      for (int key = 1000; key < 1200; key++)
+         bst.insert(key);
+   }
+
+   // the subtrees of the root that are frozen, and the elements in them
+   size_t numFrozenLinks(const custom::BST <int> & bst)
+   {
+      size_t count = 0;
+      std::vector<const custom::BST <int> ::BNode *> stack(1, bst.root);
+      while (!stack.empty())
+      {
+         auto p = stack.back();
+         stack.pop_back();
+         if (custom::BST <int> ::isFrozen(p))
+            count++;
+         else if (p != nullptr)
+         {
+            stack.push_back(p->pLeft);
+            stack.push_back(p->pRight);
+         }
+      }
+      return count;
+   }
+
+   // nothing to freeze
+   void test_freeze_empty()
+   {  // setup
+      custom::BST <int> bst;
+      // exercise and verify
+      assertUnit(bst.freeze(0) == 0);
+      assertUnit(bst.frozenSize() == 0);
+      assertUnit(bst.root == nullptr);
+   }  // teardown
+
+   // everything was written within the period
+   void test_freeze_allHot()
+   {  // setup
+      custom::BST <int> bst;
+      setupColdLeft(bst);
+      // exercise
+      size_t numFrozen = bst.freeze(1000);
+      // verify
+      assertUnit(numFrozen == 0);
+      assertUnit(numFrozenLinks(bst) == 0);
+   }  // teardown
+
+   // the side nobody wrote to goes into one Frozen
+   void test_freeze_coldSide()
+   {  // setup
+      custom::BST <int> bst;
+      setupColdLeft(bst);
+      // exercise
+      size_t numFrozen = bst.freeze(150);
+      // verify: [0..54] and [56..1008], on either side of 55, which
+      // the 120th insert went through
+      assertUnit(numFrozen == 72);
+      assertUnit(bst.frozenSize() == numFrozen);
+      assertUnit(numFrozenLinks(bst) == 2);
+      assertUnit(bst.size() == 264);
+      assertUnit(!custom::BST <int> ::isFrozen(bst.root));
+      // a second pass finds nothing new
+      assertUnit(bst.freeze(150) == 0);
+   }  // teardown
+
+   // a frozen subtree reads like any other
+   void test_freeze_access()
+   {  // setup
+      custom::BST <int> bst;
+      setupColdLeft(bst);
+      bst.freeze(150);
+      // exercise and verify
+      auto it = bst.find(17);
+      assertUnit(custom::BST <int> ::isFrozen(it.pNode));
+      assertUnit(it != bst.end() && *it == 17);
+      assertUnit(bst.find(64) == bst.end());
+      assertUnit(*bst.lower_bound(64) == 1000);
+      assertUnit(*bst.upper_bound(17) == 18);
+      assertUnit(*--bst.find(17) == 16);
+      assertUnit(*bst.begin() == 0);
+      int expected = 0;
+      bool inOrder = true;
+      for (auto it = bst.begin(); it != bst.end(); ++it)
+      {
+         inOrder = inOrder && *it == expected;
+         expected = (expected == 63 ? 1000 : expected + 1);
+      }
+      assertUnit(inOrder);
+      assertUnit(expected == 1200);
+   }  // teardown
+
+   // a write into a frozen subtree puts back exactly the nodes it had
+   void test_freeze_insertThaws()
+   {  // setup
+      custom::BST <int> bst;
+      setupColdLeft(bst);
+      custom::BST <int> twin(bst);
+      bst.freeze(150);
+      // exercise
+      bst.insert(30);
+      twin.insert(30);
+      // verify
+      assertUnit(bst.frozenSize() == 17);   // the other side of 55
+      assertUnit(bst.size() == 265);
+      thawAll(bst, bst.root);
+      assertUnit(sameShape(bst.root, twin.root));
+      bst.root->verifyBTree();
+      assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+   }  // teardown
+
+   // erasing a frozen element thaws its subtree first
+   void test_freeze_eraseThaws()
+   {  // setup
+      custom::BST <int> bst;
+      setupColdLeft(bst);
+      bst.freeze(150);
+      auto it = bst.find(17);
+      // exercise
+      auto itNext = bst.erase(it);
+      // verify
+      assertUnit(itNext != bst.end() && *itNext == 18);
+      assertUnit(bst.frozenSize() == 17);
+      assertUnit(bst.size() == 263);
+      assertUnit(bst.find(17) == bst.end());
+   }  // teardown
+
+   // a copy gets its own Frozen
+   void test_freeze_copy()
+   {  // setup
+      custom::BST <int> bst;
+      setupColdLeft(bst);
+      size_t numFrozen = bst.freeze(150);
+      // exercise
+      custom::BST <int> copy(bst);
+      bst.clear();
+      // verify
+      assertUnit(copy.frozenSize() == numFrozen);
+      assertUnit(copy.size() == 264);
+      assertUnit(*copy.find(17) == 17);
+   }  // teardown
+
+   // back to all nodes
+   void thawAll(custom::BST <int> & bst, custom::BST <int> ::BNode * p)
+   {
+      if (p == nullptr)
+         return;
+      bst.thawChildren(p);
+      thawAll(bst, p->pLeft);
+      thawAll(bst, p->pRight);
+   }
+
+   // same nodes, same colors, same places
+   bool sameShape(const custom::BST <int> ::BNode * p1, const custom::BST <int> ::BNode * p2)
+   {
+      if (p1 == nullptr || p2 == nullptr)
+         return p1 == p2;
+      return p1->data == p2->data && p1->isRed == p2->isRed &&
+             sameShape(p1->pLeft, p2->pLeft) && sameShape(p1->pRight, p2->pRight);
+   }
+
+   /***************************************
+    * SPILLING
+    *    BST::setMemoryLimit(size_t, const char *)
+    *    BST::residentSize()
+    ***************************************/
+
+   // 0 ... 9999 frozen into four Frozens under three nodes:
+   //       2047
+   //    +----+----+
+   // [0..2046]   4095
+   //          +----+----+
+   //    [2048..4094]   6143
+   //               +----+----+
+   //         [4096..6142] [6144..9999]
+   void setupFourBlocks(custom::BST <int> & bst)
+   {
+      for (int key = 0; key < 10000; key++)
+         bst.insert(key);
+      bst.freeze(0);
+   }
+
+   // the Frozens whose arrays are out in the spill file
+   size_t numSpilled(const custom::BST <int> & bst)
+   {
+      size_t count = 0;
+      std::vector<const custom::BST <int> ::BNode *> stack(1, bst.root);
+      while (!stack.empty())
+      {
+         auto p = stack.back();
+         stack.pop_back();
+         if (custom::BST <int> ::isFrozen(p))
+            count += custom::BST <int> ::frozenOf(p)->isLoaded() ? 0 : 1;
+         else if (p != nullptr)
+         {
+            stack.push_back(p->pLeft);
+            stack.push_back(p->pRight);
+         }
+      }
+      return count;
+   }
+
+   // without a limit everything is in memory
+   void test_spill_noLimit()
+   {  // setup
+      custom::BST <int> bst;
+      setupFourBlocks(bst);
+      // exercise and verify
+      assertUnit(bst.frozenSize() == 9997);
+      assertUnit(numFrozenLinks(bst) == 4);
+      assertUnit(numSpilled(bst) == 0);
+      assertUnit(bst.residentSize() == 3 * sizeof(custom::BST <int> ::BNode) +
+                                       9997 * (sizeof(int) + 1));
+   }  // teardown
+
+   // the two blocks used longest ago go to the file, keeping their ends
+   void test_spill_oldestOut()
+   {  // setup
+      custom::BST <int> bst;
+      setupFourBlocks(bst);
+      size_t before = bst.residentSize();
+      // exercise
+      bst.setMemoryLimit(1000);
+      // verify
+      assertUnit(numSpilled(bst) == 2);
+      auto pFirst = custom::BST <int> ::frozenOf(bst.root->pLeft);
+      assertUnit(!pFirst->isLoaded());
+      assertUnit(pFirst->values.size() == 2);
+      assertUnit(pFirst->values[0] == 0 && pFirst->values[1] == 2046);
+      assertUnit(pFirst->size() == 2047);
+      assertUnit(bst.frozenSize() == 9997);
+      assertUnit(bst.residentSize() == before - 2 * 2047 * (sizeof(int) + 1));
+   }  // teardown
+
+   // reading a spilled block brings it back and sends the oldest out
+   void test_spill_faultIn()
+   {  // setup
+      custom::BST <int> bst;
+      setupFourBlocks(bst);
+      bst.setMemoryLimit(1000);
+      // exercise
+      auto it = bst.find(10);
+      // verify
+      assertUnit(it != bst.end() && *it == 10);
+      assertUnit(custom::BST <int> ::frozenOf(bst.root->pLeft)->isLoaded());
+      assertUnit(!custom::BST <int> ::frozenOf(bst.root->pRight->pLeft)->isLoaded());
+      assertUnit(!custom::BST <int> ::frozenOf(bst.root->pRight->pRight->pLeft)->isLoaded());
+      assertUnit(numSpilled(bst) == 2);
+      // a key outside every block does not read anything in
+      assertUnit(bst.find(2047) != bst.end());
+      assertUnit(bst.find(-1) == bst.end());
+      assertUnit(numSpilled(bst) == 2);
+   }  // teardown
+
+   // spilled blocks read like any other
+   void test_spill_access()
+   {  // setup
+      custom::BST <int> bst;
+      setupFourBlocks(bst);
+      bst.setMemoryLimit(1000);
+      // exercise and verify
+      assertUnit(*bst.lower_bound(3000) == 3000);
+      assertUnit(*bst.upper_bound(2046) == 2047);
+      assertUnit(*bst.lower_bound(-5) == 0);
+      assertUnit(bst.upper_bound(9999) == bst.end());
+      int expected = 0;
+      bool inOrder = true;
+      for (auto it = bst.begin(); it != bst.end(); ++it)
+         inOrder = inOrder && *it == expected++;
+      assertUnit(inOrder);
+      assertUnit(expected == 10000);
+      assertUnit(numSpilled(bst) == 2);
+      // no limit brings everything back
+      bst.setMemoryLimit(0);
+      assertUnit(numSpilled(bst) == 0);
+   }  // teardown
+
+   // a write into a spilled block thaws it from the file
+   void test_spill_insert()
+   {  // setup
+      custom::BST <int> bst;
+      setupFourBlocks(bst);
+      bst.setMemoryLimit(1000);
+      // exercise
+      bst.insert(5000);
+      // verify
+      assertUnit(bst.size() == 10001);
+      assertUnit(bst.frozenSize() == 9997 - 2047);
+      assertUnit(*++bst.lower_bound(5000) == 5000);
+      thawAll(bst, bst.root);
+      bst.root->verifyBTree();
+      assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+   }  // teardown
+
+   // nodes over the limit are frozen so they can be spilled
+   void test_spill_freezesNodes()
+   {  // setup
+      custom::BST <int> bst;
+      for (int key = 0; key < 10000; key++)
+         bst.insert(key);
+      size_t limit = 100 * sizeof(custom::BST <int> ::BNode);
+      // exercise
+      bst.setMemoryLimit(limit);
+      // verify: what is left in memory is the nodes on the last few
+      // inserts' paths and the two blocks used last
+      assertUnit(bst.frozenSize() > 9000);
+      assertUnit(numSpilled(bst) > 0);
+      assertUnit(bst.residentSize() < 5000 * (sizeof(int) + 1));
+      assertUnit(bst.find(1234) != bst.end());
+   }  // teardown
+
+   /***************************************
+    * ESTIMATE
+    *    BST::estimate_count(const T &, const T &)
+    *    BST::build_histogram(size_t)
+    ***************************************/
+
+   // nothing in the tree, or nothing in the range
+   void test_estimate_empty()
+   {  // setup
+      custom::BST <int> bst;
+      // exercise and verify
+      assertUnit(bst.estimate_count(0, 100) == 0);
+      for (int key = 0; key < 10; key++)
+         bst.insert(key);
+      assertUnit(bst.estimate_count(5, 5) == 0);
+      assertUnit(bst.estimate_count(7, 3) == 0);
+   }  // teardown
+
+   // ranges past either end of the tree come out exact
+   void test_estimate_ends()
+   {  // setup
+      custom::BST <int> bst;
+      for (int key : Workload(1).shuffled(1000))
+         bst.insert(key);
+      // exercise and verify
+      assertUnit(bst.estimate_count(-1, 1000) == 1000);
+      assertUnit(bst.estimate_count(-50, 0) == 0);
+      assertUnit(bst.estimate_count(1000, 2000) == 0);
+   }  // teardown
+
+   // random ranges land near the exact count
+   void test_estimate_close()
+   {  // setup
+      custom::BST <int> bst;
+      for (int key : Workload(1).shuffled(1000))
+         bst.insert(key);
+      Workload workload(2);
+      std::vector<int> ends = workload.uniform(400, 1000);
+      // exercise
+      int worst = 0;
+      for (size_t i = 0; i < ends.size(); i += 2)
+      {
+         int lo = std::min(ends[i], ends[i + 1]);
+         int hi = std::max(ends[i], ends[i + 1]);
+         int error = (int)bst.estimate_count(lo, hi) - (hi - lo);
+         worst = std::max(worst, std::abs(error));
+      }
+      // verify: within an eighth of the tree
+      assertUnit(worst < 1000 / 8);
+   }  // teardown
+
+   // a Frozen knows its size, so a tree of them estimates exactly
+   void test_estimate_frozen()
+   {  // setup
+      custom::BST <int> bst;
+      setupFourBlocks(bst);
+      // exercise and verify
+      assertUnit(bst.estimate_count(100, 2000) == 1900);
+      assertUnit(bst.estimate_count(100, 9000) == 8900);
+      assertUnit(bst.estimate_count(2047, 2048) == 1);
+   }  // teardown
+
+   // every bucket gets the same number of elements
+   void test_histogram_equiDepth()
+   {  // setup
+      custom::BST <int> bst;
+      for (int key : Workload(1).shuffled(100))
+         bst.insert(key);
+      // exercise and verify
+      assertUnit(bst.build_histogram(4) == std::vector<int>({ 0, 25, 50, 75, 99 }));
+      assertUnit(bst.build_histogram(3) == std::vector<int>({ 0, 33, 66, 99 }));
+      assertUnit(bst.build_histogram(1) == std::vector<int>({ 0, 99 }));
+      assertUnit(bst.build_histogram(0).empty());
+   }  // teardown
+
+   // fewer elements than buckets gives one bucket each
+   void test_histogram_small()
+   {  // setup
+      custom::BST <int> bst;
+      // exercise and verify
+      assertUnit(bst.build_histogram(4).empty());
+      bst.insert(7);
+      bst.insert(5);
+      assertUnit(bst.build_histogram(4) == std::vector<int>({ 5, 7, 7 }));
+   }  // teardown
+
+   /***************************************
+    * WORKLOAD
+    *    long generated sequences
+    ***************************************/
+
+   // the inserts that recolor the most still leave a red-black tree
+   void test_workload_recolorCascades()
+   {  // setup
+      custom::BST <int> bst;
+      std::vector<int> keys = Workload(1).recolorCascades(1000);
+      // exercise
+      for (int key : keys)
+         bst.insert(key);
+      // verify
+      assertUnit(bst.size() == 1000);
+      assertUnit(bst.root != nullptr);
+      if (bst.root)
+      {
+         bst.root->verifyBTree();
+         assertUnit(bst.root->computeSize() == 1000);
+         assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      }
+   }  // teardown
+
+   // the inserts that rotate the most still leave a red-black tree
+   void test_workload_rotations()
+   {  // setup
+      custom::BST <int> bst;
+      std::vector<int> keys = Workload(1).rotations(1000);
+      // exercise
+      for (int key : keys)
+         bst.insert(key);
+      // verify
+      assertUnit(bst.size() == 1000);
+      assertUnit(bst.root != nullptr);
+      if (bst.root)
+      {
+         bst.root->verifyBTree();
+         assertUnit(bst.root->computeSize() == 1000);
+         assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      }
+   }  // teardown
+
+   // erase does not rebalance, but inserts after it must keep the tree sorted
+   void test_workload_eraseChurn()
+   {  // setup
+      custom::BST <int> bst;
+      std::vector<Workload::Operation> ops = Workload(1).eraseChurn(1000);
+      // exercise
+      size_t hits = Workload::apply(bst, ops);
+      // verify
+      assertUnit(hits == 1000);
+      assertUnit(bst.size() == 1000);
+      assertUnit(bst.root != nullptr);
+      if (bst.root)
+      {
+         bst.root->verifyBTree();
+         assertUnit(bst.root->computeSize() == 1000);
+      }
+      bool inOrder = true;
+      auto it = bst.begin();
+      for (int previous = *it; it != bst.end(); ++it)
+      {
+         inOrder = inOrder && !(*it < previous);
+         previous = *it;
+      }
+      assertUnit(inOrder);
+   }  // teardown
+
    /**************************************************************
     * SETUP STANDARD FIXTURE
     *                (50b)
@@ -0,0 +1,296 @@
+/***********************************************************************
+ * Header:
+ *    TEST KEY ENCODING
+ * Summary:
+ *    Unit tests for order-preserving key encoding
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "bst.h"
+#include "keyEncoding.h"
+#include "stringBST.h"
+#include "unitTest.h"
+
+#include <cstdint>    // for int32_t and int64_t
+#include <limits>     // for std::numeric_limits
+#include <string>
+#include <tuple>      // for std::tuple, whose < is the order to keep
+#include <vector>
+
+/***********************************************
+ * TEST KEY ENCODING
+ * Unit tests for the KeyEncoder, KeyDecoder and EncodedKey classes
+ ***********************************************/
+class TestKeyEncoding : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Order
+      test_int32_order();
+      test_int64_order();
+      test_float64_order();
+      test_float64_zeroAndNaN();
+      test_string_order();
+      test_composite_order();
+
+      // Decode
+      test_decode_roundTrip();
+      test_decode_truncated();
+
+      // Fixed width
+      test_encodedKey_order();
+      test_encodedKey_str();
+      test_pastPrefix_allOnes();
+
+      // Tree
+      test_tree_tenantScan();
+      test_tree_encodedKeyScan();
+
+      report("KeyEncoding");
+   }
+
+   /***************************************
+    * ORDER
+    ***************************************/
+
+   void test_int32_order()
+   {  // setup
+      std::vector<int32_t> values = { std::numeric_limits<int32_t>::min(), -70000, -1, 0, 1, 255, 256,
+                                      std::numeric_limits<int32_t>::max() };
+      // exercise and verify
+      for (size_t i = 1; i < values.size(); i++)
+         assertUnit(encode32(values[i - 1]) < encode32(values[i]));
+      assertUnit(encode32(0).size() == 4);
+      assertUnit(encode32(0) == std::string("\x80\0\0\0", 4));
+   }  // teardown
+
+   void test_int64_order()
+   {  // setup
+      std::vector<int64_t> values = { std::numeric_limits<int64_t>::min(), -4294967296ll, -1, 0, 1,
+                                      4294967296ll, std::numeric_limits<int64_t>::max() };
+      // exercise and verify
+      for (size_t i = 1; i < values.size(); i++)
+         assertUnit(custom::KeyEncoder().int64(values[i - 1]).str() <
+                    custom::KeyEncoder().int64(values[i]).str());
+   }  // teardown
+
+   void test_float64_order()
+   {  // setup
+      const double INF = std::numeric_limits<double>::infinity();
+      std::vector<double> values = { -INF, -1e300, -2.5, -1.0, -1e-300, 0.0, 1e-300, 1.0, 2.5, 1e300, INF };
+      // exercise and verify
+      for (size_t i = 1; i < values.size(); i++)
+         assertUnit(encodeDouble(values[i - 1]) < encodeDouble(values[i]));
+   }  // teardown
+
+   // equal doubles encode the same, and NaN goes after everything
+   void test_float64_zeroAndNaN()
+   {  // setup
+      const double NaN = std::numeric_limits<double>::quiet_NaN();
+      // exercise and verify
+      assertUnit(encodeDouble(-0.0) == encodeDouble(0.0));
+      assertUnit(encodeDouble(NaN) == encodeDouble(-NaN));
+      assertUnit(encodeDouble(std::numeric_limits<double>::infinity()) < encodeDouble(NaN));
+   }  // teardown
+
+   // a string comes before anything longer it begins, embedded nulls and all
+   void test_string_order()
+   {  // setup
+      std::vector<std::string> values = { "", std::string("\0", 1), std::string("\0\0", 2),
+                                          std::string("\0\x01", 2), "a", std::string("a\0", 2),
+                                          std::string("a\0b", 3), "a\x01", "ab", "b" };
+      // exercise and verify
+      for (size_t i = 1; i < values.size(); i++)
+         assertUnit(custom::KeyEncoder().string(values[i - 1]).str() <
+                    custom::KeyEncoder().string(values[i]).str());
+   }  // teardown
+
+   // the bytes sort the way the tuples do
+   void test_composite_order()
+   {  // setup
+      typedef std::tuple<int32_t, std::string, double> Key;
+      std::vector<Key> keys;
+      for (int32_t tenant : { -1, 0, 7 })
+         for (const char * name : { "", "a", "ab", "b" })
+            for (double score : { -1.5, 0.0, 3.25 })
+               keys.push_back(Key(tenant, name, score));
+      // exercise and verify
+      for (const Key & lhs : keys)
+         for (const Key & rhs : keys)
+            assertUnit((encodeKey(lhs) < encodeKey(rhs)) == (lhs < rhs));
+   }  // teardown
+
+   /***************************************
+    * DECODE
+    ***************************************/
+
+   void test_decode_roundTrip()
+   {  // setup
+      std::string name("x\0y", 3);
+      custom::KeyEncoder encoder;
+      encoder.int32(-7).int64(-123456789012ll).uint64(42).float64(-2.5).string(name);
+      int32_t tenant = 0;
+      int64_t timestamp = 0;
+      uint64_t id = 0;
+      double score = 0.0;
+      std::string decoded;
+      // exercise
+      custom::KeyDecoder decoder(encoder.str());
+      bool isRead = decoder.int32(tenant) && decoder.int64(timestamp) && decoder.uint64(id) &&
+                    decoder.float64(score) && decoder.string(decoded);
+      // verify
+      assertUnit(isRead);
+      assertUnit(decoder.done());
+      assertUnit(tenant == -7);
+      assertUnit(timestamp == -123456789012ll);
+      assertUnit(id == 42);
+      assertUnit(score == -2.5);
+      assertUnit(decoded == name);
+   }  // teardown
+
+   // a key that ends early, or a string without its end, reads nothing
+   void test_decode_truncated()
+   {  // setup
+      std::string shortInt("\x80\0", 2);
+      std::string openString = custom::KeyEncoder().string("abc").str();
+      openString.pop_back();
+      int32_t value = 5;
+      std::string s = "unchanged";
+      // exercise
+      custom::KeyDecoder intDecoder(shortInt);
+      custom::KeyDecoder stringDecoder(openString);
+      // verify
+      assertUnit(!intDecoder.int32(value));
+      assertUnit(value == 5);
+      assertUnit(!stringDecoder.string(s));
+      assertUnit(s == "unchanged");
+   }  // teardown
+
+   /***************************************
+    * FIXED WIDTH
+    ***************************************/
+
+   // the words compare the way the bytes do, across the word boundary too
+   void test_encodedKey_order()
+   {  // setup
+      std::vector<int64_t> timestamps = { -300, -1, 0, 255, 256, 1ll << 40 };
+      // exercise and verify
+      for (int32_t tenant : { -5, 0, 5 })
+         for (size_t i = 1; i < timestamps.size(); i++)
+         {
+            Key12 lhs(custom::KeyEncoder().int32(tenant).int64(timestamps[i - 1]).str());
+            Key12 rhs(custom::KeyEncoder().int32(tenant).int64(timestamps[i]).str());
+            assertUnit(lhs < rhs);
+            assertUnit(!(rhs < lhs));
+            assertUnit(lhs != rhs);
+         }
+      assertUnit(Key12(encode32(-1)) < Key12(encode32(0)));
+      assertUnit(Key12(encode32(7)) == Key12(encode32(7)));
+   }  // teardown
+
+   // the bytes come back, padded out to the full width
+   void test_encodedKey_str()
+   {  // setup
+      std::string bytes = custom::KeyEncoder().int32(-7).int64(42).str();
+      // exercise
+      std::string full = Key12(bytes).str();
+      std::string padded = Key12(encode32(3)).str();
+      // verify
+      assertUnit(full == bytes);
+      assertUnit(padded.size() == 12);
+      assertUnit(padded == encode32(3) + std::string(8, '\0'));
+   }  // teardown
+
+   void test_pastPrefix_allOnes()
+   {  // exercise and verify
+      assertUnit(custom::KeyEncoder::pastPrefix("ab") == "ac");
+      assertUnit(custom::KeyEncoder::pastPrefix(std::string("a\xff\xff", 3)) == "b");
+      assertUnit(custom::KeyEncoder::pastPrefix(std::string("\xff\xff", 2)).empty());
+      assertUnit(custom::KeyEncoder::pastPrefix("").empty());
+   }  // teardown
+
+   /***************************************
+    * TREE
+    ***************************************/
+
+   // the tenant alone is a prefix of all of that tenant's keys
+   void test_tree_tenantScan()
+   {  // setup
+      custom::StringBST tree;
+      for (int32_t tenant = -2; tenant <= 2; tenant++)
+         for (int64_t timestamp = 0; timestamp < 5; timestamp++)
+            tree.insert(custom::KeyEncoder().int32(tenant).int64(timestamp * 1000).uint64(7).str());
+      // exercise
+      auto range = tree.prefix_range(encode32(-1));
+      // verify
+      int64_t expected = 0;
+      for (auto it = range.first; it != range.second; ++it)
+      {
+         std::string key = *it;
+         custom::KeyDecoder decoder(key);
+         int32_t tenant = 0;
+         int64_t timestamp = 0;
+         assertUnit(decoder.int32(tenant) && decoder.int64(timestamp));
+         assertUnit(tenant == -1);
+         assertUnit(timestamp == expected);
+         expected += 1000;
+      }
+      assertUnit(expected == 5000);
+   }  // teardown
+
+   // one tenant's keys in a BST of fixed-width keys, between the
+   // padded prefix and the padded prefix just past it
+   void test_tree_encodedKeyScan()
+   {  // setup
+      custom::BST <Key12> bst;
+      for (int32_t tenant = -2; tenant <= 2; tenant++)
+         for (int64_t timestamp = 4; timestamp >= 0; timestamp--)
+            bst.insert(Key12(custom::KeyEncoder().int32(tenant).int64(timestamp).str()));
+      std::string prefix = encode32(1);
+      // exercise
+      auto itFirst = bst.lower_bound(Key12(prefix));
+      auto itLast = bst.lower_bound(Key12(custom::KeyEncoder::pastPrefix(prefix)));
+      // verify
+      int64_t expected = 0;
+      for (auto it = itFirst; it != itLast; ++it)
+      {
+         std::string key = (*it).str();
+         custom::KeyDecoder decoder(key);
+         int32_t tenant = 0;
+         int64_t timestamp = 0;
+         assertUnit(decoder.int32(tenant) && decoder.int64(timestamp));
+         assertUnit(decoder.done());
+         assertUnit(tenant == 1);
+         assertUnit(timestamp == expected);
+         expected++;
+      }
+      assertUnit(expected == 5);
+   }  // teardown
+
+private:
+   typedef custom::EncodedKey <12> Key12;  // an int32 and an int64
+
+   static std::string encode32(int32_t value)
+   {
+      return custom::KeyEncoder().int32(value).str();
+   }
+   static std::string encodeDouble(double value)
+   {
+      return custom::KeyEncoder().float64(value).str();
+   }
+   static std::string encodeKey(const std::tuple<int32_t, std::string, double> & key)
+   {
+      return custom::KeyEncoder().int32(std::get<0>(key))
+         .string(std::get<1>(key)).float64(std::get<2>(key)).str();
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,306 @@
+/***********************************************************************
+ * Header:
+ *    TEST KEY RANGE LOCK
+ * Summary:
+ *    Unit tests for key range locks and the range locked BST
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "keyRangeLock.h"
+#include "unitTest.h"
+
+#include <atomic>     // for std::atomic
+#include <chrono>     // for std::chrono::milliseconds
+#include <thread>     // for std::thread
+#include <vector>
+
+/***********************************************
+ * TEST KEY RANGE LOCK
+ * Unit tests for the KeyRangeLocks and RangeLockedBST classes
+ ***********************************************/
+class TestKeyRangeLock : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Locks
+      test_overlaps_closed();
+      test_locks_disjointBothHeld();
+      test_locks_intentBecomesHeld();
+      test_locks_overlapWaits();
+      test_locks_youngerIntentWaitedOut();
+
+      // Plan
+      test_plan_empty();
+      test_plan_blackParent();
+      test_plan_recolorToRoot();
+
+      // Tree
+      test_insert_keepUnique();
+      test_erase_missing();
+      test_exclusive_recounts();
+      test_threads_disjointWriters();
+
+      report("KeyRangeLock");
+   }
+
+   typedef custom::KeyRangeLocks <int> Locks;
+   typedef custom::RangeLockedBST <int> Tree;
+
+   /***************************************
+    * LOCKS
+    ***************************************/
+
+   // the ends count, and nullptr is no bound
+   void test_overlaps_closed()
+   {  // setup
+      int one = 1, two = 2, three = 3, four = 4;
+      // exercise and verify
+      assertUnit(Locks::overlaps(&one, &two, &two, &three));
+      assertUnit(!Locks::overlaps(&one, &two, &three, &four));
+      assertUnit(!Locks::overlaps(&three, &four, &one, &two));
+      assertUnit(Locks::overlaps(nullptr, &two, &one, nullptr));
+      assertUnit(!Locks::overlaps(nullptr, &one, &two, nullptr));
+      assertUnit(Locks::overlaps(nullptr, nullptr, &three, &three));
+   }  // teardown
+
+   void test_locks_disjointBothHeld()
+   {  // setup
+      Locks locks;
+      int lo1 = 10, hi1 = 20, lo2 = 30, hi2 = 40;
+      {
+         Locks::Lock lock1(locks);
+         Locks::Lock lock2(locks);
+         // exercise
+         bool held1 = lock1.acquire(&lo1, &hi1);
+         bool held2 = lock2.acquire(&lo2, &hi2);
+         // verify
+         assertUnit(held1 && held2);
+         assertUnit(locks.listed.size() == 2);
+      }
+      assertUnit(locks.listed.empty());
+   }  // teardown
+
+   void test_locks_intentBecomesHeld()
+   {  // setup
+      Locks locks;
+      Locks::Lock lock(locks);
+      int key = 15, lo = 10, hi = 20;
+      // exercise
+      lock.enter(key);
+      bool wasHeld = lock.isHeld;
+      bool held = lock.acquire(&lo, &hi);
+      // verify
+      assertUnit(!wasHeld);
+      assertUnit(held);
+      assertUnit(lock.isHeld);
+      assertUnit(locks.listed.size() == 1);
+      assertUnit(*lock.pLo == 10 && *lock.pHi == 20);
+   }  // teardown
+
+   // a second writer on overlapping keys goes only after the first is done
+   void test_locks_overlapWaits()
+   {  // setup
+      Locks locks;
+      int lo1 = 10, hi1 = 20, lo2 = 15, hi2 = 25;
+      std::atomic<bool> released(false);
+      bool overlapped = false;
+      Locks::Lock first(locks);
+      first.acquire(&lo1, &hi1);
+      // exercise
+      std::thread second([&]()
+      {
+         Locks::Lock lock(locks);
+         while (!lock.acquire(&lo2, &hi2))
+            ;
+         overlapped = !released.load();
+      });
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      released = true;
+      first.release();
+      second.join();
+      // verify
+      assertUnit(!overlapped);
+      assertUnit(locks.listed.empty());
+   }  // teardown
+
+   // an older writer waits for a younger reader in its range, then locks
+   void test_locks_youngerIntentWaitedOut()
+   {  // setup
+      Locks locks;
+      int older = 1, younger = 15, lo = 10, hi = 20;
+      Locks::Lock writer(locks);
+      Locks::Lock reader(locks);
+      writer.enter(older);
+      reader.enter(younger);
+      // exercise
+      std::thread leave([&]()
+      {
+         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+         reader.release();
+      });
+      bool held = writer.acquire(&lo, &hi);
+      leave.join();
+      // verify
+      assertUnit(held);
+      assertUnit(locks.listed.size() == 1);
+   }  // teardown
+
+   /***************************************
+    * PLAN
+    ***************************************/
+
+   // the first node is the root, so everything is locked
+   void test_plan_empty()
+   {  // setup
+      Tree tree;
+      Tree::Plan plan;
+      // exercise
+      bool isWrite = tree.planInsert(5, false, plan);
+      // verify
+      assertUnit(isWrite);
+      assertUnit(plan.pNode == nullptr);
+      assertUnit(plan.isWhole);
+      assertUnit(plan.pLo == nullptr && plan.pHi == nullptr);
+   }  // teardown
+
+   // Under a black parent only the parent's link changes, so the lock
+   // covers the keys under the grandparent.
+   void test_plan_blackParent()
+   {  // setup
+      Tree tree;
+      for (int key = 0; key < 1000; key += 10)
+         tree.insert(key);
+      Tree::Plan plan;
+      // exercise
+      tree.planInsert(505, false, plan);
+      // verify
+      assertUnit(plan.pNode->data == 500);
+      assertUnit(!plan.pNode->isRed);
+      assertUnit(plan.isRight);
+      assertUnit(!plan.isWhole);
+      assertUnit(*plan.pLo == 470 && *plan.pHi == 510);
+      // erasing 500 writes its parent's link, so it locks a level higher
+      assertUnit(tree.planErase(500, plan));
+      assertUnit(*plan.pLo == 470 && *plan.pHi == 550);
+      assertUnit(!tree.planErase(505, plan));
+   }  // teardown
+
+   // a red aunt recolors all the way to the root
+   void test_plan_recolorToRoot()
+   {  // setup
+      Tree tree;
+      for (int key : { 50, 30, 70 })
+         tree.insert(key);
+      Tree::Plan plan;
+      // exercise
+      tree.planInsert(20, false, plan);
+      // verify
+      assertUnit(plan.pNode->data == 30);
+      assertUnit(plan.isWhole);
+      assertUnit(plan.pLo == nullptr && plan.pHi == nullptr);
+   }  // teardown
+
+   /***************************************
+    * TREE
+    ***************************************/
+
+   void test_insert_keepUnique()
+   {  // setup
+      Tree tree;
+      tree.insert(5);
+      // exercise
+      bool inserted = tree.insert(5, true /* keepUnique */);
+      bool duplicate = tree.insert(5);
+      // verify
+      assertUnit(!inserted);
+      assertUnit(duplicate);
+      assertUnit(tree.size() == 2);
+      assertUnit(tree.locks.listed.empty());
+   }  // teardown
+
+   void test_erase_missing()
+   {  // setup
+      Tree tree;
+      for (int key : { 50, 30, 70, 20 })
+         tree.insert(key);
+      // exercise
+      bool erased = tree.erase(30);
+      bool missing = tree.erase(40);
+      // verify
+      assertUnit(erased);
+      assertUnit(!missing);
+      assertUnit(!tree.contains(30));
+      assertUnit(tree.contains(20));
+      assertUnit(tree.size() == 3);
+      assertUnit(tree.locks.listed.empty());
+   }  // teardown
+
+   // writes made through exclusive() show up in size()
+   void test_exclusive_recounts()
+   {  // setup
+      Tree tree;
+      tree.insert(1);
+      // exercise
+      size_t before = tree.exclusive([](custom::BST <int> & bst)
+      {
+         size_t size = bst.size();
+         bst.insert(2);
+         bst.insert(3);
+         return size;
+      });
+      // verify
+      assertUnit(before == 1);
+      assertUnit(tree.size() == 3);
+      assertUnit(tree.contains(3));
+   }  // teardown
+
+   // four writers in their own bands of keys, inserting and erasing
+   void test_threads_disjointWriters()
+   {  // setup
+      Tree tree;
+      const int BAND = 2000;
+      std::atomic<int> numWrong(0);
+      std::vector<std::thread> writers;
+      // exercise
+      for (int band = 0; band < 4; band++)
+         writers.emplace_back([&tree, &numWrong, band, BAND]()
+         {
+            for (int i = 0; i < BAND; i++)
+               tree.insert(band * BAND + (i * 7919) % BAND);
+            for (int i = 0; i < BAND; i += 2)
+               tree.erase(band * BAND + i);
+            for (int i = 0; i < BAND; i++)
+               if (tree.contains(band * BAND + i) != (i % 2 == 1))
+                  numWrong++;
+         });
+      for (std::thread & writer : writers)
+         writer.join();
+      // verify
+      assertUnit(numWrong.load() == 0);
+      assertUnit(tree.size() == 4 * BAND / 2);
+      tree.exclusive([&](custom::BST <int> & bst)
+      {
+         int previous = -1;
+         int numKeys = 0;
+         bool isOrdered = true;
+         for (int key : bst)
+         {
+            isOrdered = isOrdered && key > previous;
+            previous = key;
+            numKeys++;
+         }
+         assertUnit(isOrdered);
+         assertUnit(numKeys == 4 * BAND / 2);
+      });
+   }  // teardown
+};
+
+#endif // DEBUG
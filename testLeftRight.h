@@ -0,0 +1,186 @@
+/***********************************************************************
+ * Header:
+ *    TEST LEFT RIGHT
+ * Summary:
+ *    Unit tests for the left-right BST wrapper
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "leftRight.h"
+#include "unitTest.h"
+
+#include <atomic>     // for std::atomic
+#include <thread>     // for std::thread
+#include <vector>
+
+/***********************************************
+ * TEST LEFT RIGHT
+ * Unit tests for the LeftRight class
+ ***********************************************/
+class TestLeftRight : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Single thread
+      test_read_empty();
+      test_insert_bothCopies();
+      test_insert_keepUnique();
+      test_erase_bothCopies();
+      test_write_flips();
+      test_read_departs();
+
+      // Threads
+      test_threads_readersSeeWholeWrites();
+
+      report("LeftRight");
+   }
+
+   /***************************************
+    * SINGLE THREAD
+    ***************************************/
+
+   void test_read_empty()
+   {  // setup
+      custom::LeftRight <int> tree;
+      // exercise and verify
+      assertUnit(tree.size() == 0);
+      assertUnit(!tree.contains(5));
+      assertUnit(tree.readIndicators[0].isEmpty());
+      assertUnit(tree.readIndicators[1].isEmpty());
+   }  // teardown
+
+   // a write lands in both copies
+   void test_insert_bothCopies()
+   {  // setup
+      custom::LeftRight <int> tree;
+      // exercise
+      bool inserted = tree.insert(5);
+      tree.insert(3);
+      // verify
+      assertUnit(inserted);
+      assertUnit(tree.contains(5) && tree.contains(3));
+      assertUnit(!tree.contains(4));
+      assertUnit(tree.size() == 2);
+      for (const custom::BST <int> & bst : tree.instances)
+      {
+         assertUnit(bst.size() == 2);
+         assertUnit(*bst.begin() == 3);
+      }
+   }  // teardown
+
+   // both copies agree the second one is a duplicate
+   void test_insert_keepUnique()
+   {  // setup
+      custom::LeftRight <int> tree;
+      tree.insert(5);
+      // exercise
+      bool inserted = tree.insert(5, true /* keepUnique */);
+      // verify
+      assertUnit(!inserted);
+      assertUnit(tree.instances[0].size() == 1);
+      assertUnit(tree.instances[1].size() == 1);
+   }  // teardown
+
+   void test_erase_bothCopies()
+   {  // setup
+      custom::LeftRight <int> tree;
+      for (int key : { 50, 30, 70, 20 })
+         tree.insert(key);
+      // exercise
+      bool erased = tree.erase(30);
+      bool missing = tree.erase(40);
+      // verify
+      assertUnit(erased);
+      assertUnit(!missing);
+      assertUnit(!tree.contains(30));
+      assertUnit(tree.instances[0].size() == 3);
+      assertUnit(tree.instances[1].size() == 3);
+   }  // teardown
+
+   // each write moves the readers to the other copy and version
+   void test_write_flips()
+   {  // setup
+      custom::LeftRight <int> tree;
+      int side = tree.leftRight.load();
+      int version = tree.versionIndex.load();
+      // exercise
+      tree.insert(1);
+      // verify
+      assertUnit(tree.leftRight.load() == 1 - side);
+      assertUnit(tree.versionIndex.load() == 1 - version);
+      tree.insert(2);
+      assertUnit(tree.leftRight.load() == side);
+      assertUnit(tree.versionIndex.load() == version);
+   }  // teardown
+
+   // a reader is counted only while it reads
+   void test_read_departs()
+   {  // setup
+      custom::LeftRight <int> tree;
+      tree.insert(1);
+      bool inside = false;
+      // exercise
+      size_t size = tree.read([&](const custom::BST <int> & bst)
+      {
+         inside = !tree.readIndicators[tree.versionIndex.load()].isEmpty();
+         return bst.size();
+      });
+      // verify
+      assertUnit(size == 1);
+      assertUnit(inside);
+      assertUnit(tree.readIndicators[0].isEmpty());
+      assertUnit(tree.readIndicators[1].isEmpty());
+   }  // teardown
+
+   /***************************************
+    * THREADS
+    ***************************************/
+
+   // Readers never see half a write: one write inserts a key and its
+   // negative, so every read finds the two sides the same size.
+   void test_threads_readersSeeWholeWrites()
+   {  // setup
+      custom::LeftRight <int> tree;
+      std::atomic<bool> done(false);
+      std::atomic<int> numTorn(0);
+      std::vector<std::thread> readers;
+      for (int i = 0; i < 3; i++)
+         readers.emplace_back([&]()
+         {
+            while (!done.load())
+               if (tree.read([](const custom::BST <int> & bst)
+                  {
+                     size_t numNegative = 0;
+                     for (auto it = bst.begin(); it != bst.end() && *it < 0; ++it)
+                        numNegative++;
+                     return numNegative * 2 != bst.size();
+                  }))
+                  numTorn++;
+         });
+      // exercise
+      for (int key = 1; key <= 300; key++)
+         tree.write([key](custom::BST <int> & bst)
+         {
+            bst.insert(key);
+            bst.insert(-key);
+         });
+      done = true;
+      for (std::thread & reader : readers)
+         reader.join();
+      // verify
+      assertUnit(numTorn.load() == 0);
+      assertUnit(tree.size() == 600);
+      assertUnit(tree.instances[0].size() == 600);
+      assertUnit(tree.instances[1].size() == 600);
+   }  // teardown
+};
+
+#endif // DEBUG
@@ -0,0 +1,370 @@
+/***********************************************************************
+ * Header:
+ *    TEST ORDER BOOK
+ * Summary:
+ *    Unit tests for the price-level order book
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "orderBook.h"
+#include "unitTest.h"
+#include "workload.h"
+
+#include <cstdint>    // for int64_t and uint64_t
+#include <map>        // for std::map, the book the OrderBook should equal
+#include <vector>
+
+/***********************************************
+ * TEST ORDER BOOK
+ * Unit tests for the OrderBook class
+ ***********************************************/
+class TestOrderBook : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Add
+      test_add_best();
+      test_add_fifo();
+      test_add_hintedShape();
+      test_add_reusesOrders();
+
+      // Cancel
+      test_cancel_middle();
+      test_cancel_bestMoves();
+      test_reduce_keepsPlace();
+
+      // Match
+      test_match_partial();
+      test_match_sweep();
+      test_match_limit();
+
+      // Everything
+      test_replay_matchesMap();
+
+      report("OrderBook");
+   }
+
+   typedef custom::OrderBook Book;
+   typedef custom::OrderBook::Order Order;
+
+   /***************************************
+    * ADD
+    ***************************************/
+
+   // the highest bid and the lowest ask
+   void test_add_best()
+   {  // setup
+      Book book;
+      // exercise
+      book.add(Book::BID, 99, 10, 1);
+      book.add(Book::BID, 101, 20, 2);
+      book.add(Book::BID, 100, 30, 3);
+      book.add(Book::ASK, 105, 40, 4);
+      book.add(Book::ASK, 103, 50, 5);
+      // verify
+      assertUnit(book.best(Book::BID)->price == 101);
+      assertUnit(book.best(Book::BID)->quantity == 20);
+      assertUnit(book.best(Book::ASK)->price == 103);
+      assertUnit(book.numLevels(Book::BID) == 3);
+      assertUnit(book.numLevels(Book::ASK) == 2);
+      assertUnit(book.numOrders() == 5);
+   }  // teardown
+
+   // orders at one price queue up in the order they came
+   void test_add_fifo()
+   {  // setup
+      Book book;
+      // exercise
+      Order * pFirst = book.add(Book::ASK, 100, 5, 1);
+      book.add(Book::ASK, 100, 6, 2);
+      book.add(Book::ASK, 100, 7, 3);
+      // verify
+      const Book::Level * pLevel = book.best(Book::ASK);
+      assertUnit(pLevel->numOrders == 3);
+      assertUnit(pLevel->quantity == 18);
+      assertUnit(pLevel->front() == pFirst);
+      assertUnit(ids(*pLevel) == std::vector<uint64_t>({ 1, 2, 3 }));
+      assertUnit(book.numLevels(Book::ASK) == 1);
+   }  // teardown
+
+   // levels found from the best node land where insert would put them
+   void test_add_hintedShape()
+   {  // setup
+      Book book;
+      std::vector<int64_t> prices;
+      for (int i = 0; i < 300; i++)
+         prices.push_back(1000 + (i * 37) % 150);
+      // exercise
+      for (size_t i = 0; i < prices.size(); i++)
+         book.add(Book::BID, prices[i], 1, i);
+      // verify
+      assertUnit(book.numLevels(Book::BID) == 150);
+      assertUnit(book.best(Book::BID)->price == 1149);
+      assertUnit(isWellFormed(book, Book::BID));
+      const custom::BST<Book::Level> & bst = book.sides[Book::BID];
+      assertUnit(bst.root->pParent == nullptr);
+      assertUnit(bst.root->verifyRedBlack(bst.root->findDepth()));
+      int64_t previous = 1150;
+      for (const Book::Level & level : bst)
+      {
+         assertUnit(level.price < previous);
+         assertUnit(level.numOrders == 2);
+         previous = level.price;
+      }
+   }  // teardown
+
+   // a canceled order's slot is the next one handed out
+   void test_add_reusesOrders()
+   {  // setup
+      Book book;
+      Order * pOrder = book.add(Book::BID, 100, 1, 1);
+      book.cancel(pOrder);
+      // exercise
+      Order * pAgain = book.add(Book::ASK, 200, 2, 2);
+      // verify
+      assertUnit(pAgain == pOrder);
+      assertUnit(pAgain->id == 2 && pAgain->price == 200 && pAgain->side == Book::ASK);
+      assertUnit(book.numLevels(Book::BID) == 0);
+   }  // teardown
+
+   /***************************************
+    * CANCEL
+    ***************************************/
+
+   void test_cancel_middle()
+   {  // setup
+      Book book;
+      book.add(Book::BID, 100, 5, 1);
+      Order * pMiddle = book.add(Book::BID, 100, 6, 2);
+      book.add(Book::BID, 100, 7, 3);
+      // exercise
+      book.cancel(pMiddle);
+      // verify
+      const Book::Level * pLevel = book.best(Book::BID);
+      assertUnit(ids(*pLevel) == std::vector<uint64_t>({ 1, 3 }));
+      assertUnit(pLevel->quantity == 12);
+      assertUnit(pLevel->numOrders == 2);
+      assertUnit(book.numOrders() == 2);
+   }  // teardown
+
+   // the last order at the best price takes its level, and the next
+   // level is the best, with or without a right child
+   void test_cancel_bestMoves()
+   {  // setup
+      Book book;
+      std::vector<Order *> orders;
+      for (int64_t price : { 104, 102, 106, 101, 103, 105, 107 })
+         orders.push_back(book.add(Book::ASK, price, 1, (uint64_t)price));
+      // exercise and verify
+      book.cancel(orders[3]);   // 101, a leaf
+      assertUnit(book.best(Book::ASK)->price == 102);
+      book.cancel(orders[1]);   // 102, with 103 on its right
+      assertUnit(book.best(Book::ASK)->price == 103);
+      book.cancel(orders[4]);
+      assertUnit(book.best(Book::ASK)->price == 104);
+      assertUnit(isWellFormed(book, Book::ASK));
+      book.cancel(orders[0]);
+      book.cancel(orders[5]);
+      book.cancel(orders[2]);
+      book.cancel(orders[6]);
+      assertUnit(book.best(Book::ASK) == nullptr);
+      assertUnit(book.numLevels(Book::ASK) == 0);
+      assertUnit(book.numOrders() == 0);
+   }  // teardown
+
+   void test_reduce_keepsPlace()
+   {  // setup
+      Book book;
+      Order * pFirst = book.add(Book::ASK, 100, 10, 1);
+      Order * pSecond = book.add(Book::ASK, 100, 10, 2);
+      // exercise
+      book.reduce(pFirst, 4);
+      book.reduce(pSecond, 10);
+      // verify
+      const Book::Level * pLevel = book.best(Book::ASK);
+      assertUnit(pLevel->front() == pFirst);
+      assertUnit(pFirst->quantity == 6);
+      assertUnit(pLevel->quantity == 6);
+      assertUnit(ids(*pLevel) == std::vector<uint64_t>({ 1 }));
+   }  // teardown
+
+   /***************************************
+    * MATCH
+    ***************************************/
+
+   // the oldest order fills first, and a partial fill stays in line
+   void test_match_partial()
+   {  // setup
+      Book book;
+      book.add(Book::ASK, 100, 5, 1);
+      Order * pSecond = book.add(Book::ASK, 100, 10, 2);
+      std::vector<uint64_t> makers;
+      std::vector<int64_t> fills;
+      // exercise
+      int64_t left = book.match(Book::BID, 100, 8, [&](const Order & maker, int64_t filled)
+         {
+            makers.push_back(maker.id);
+            fills.push_back(filled);
+         });
+      // verify
+      assertUnit(left == 0);
+      assertUnit(makers == std::vector<uint64_t>({ 1, 2 }));
+      assertUnit(fills == std::vector<int64_t>({ 5, 3 }));
+      assertUnit(book.best(Book::ASK)->front() == pSecond);
+      assertUnit(pSecond->quantity == 7);
+      assertUnit(book.best(Book::ASK)->quantity == 7);
+      assertUnit(book.numOrders() == 1);
+   }  // teardown
+
+   // levels emptied from the top hand the best down to the next
+   void test_match_sweep()
+   {  // setup
+      Book book;
+      for (int64_t price = 90; price < 100; price++)
+         book.add(Book::BID, price, 10, (uint64_t)price);
+      int numFills = 0;
+      // exercise
+      int64_t left = book.match(Book::ASK, 0, 35, [&](const Order &, int64_t) { numFills++; });
+      // verify
+      assertUnit(left == 0);
+      assertUnit(numFills == 4);
+      assertUnit(book.best(Book::BID)->price == 96);
+      assertUnit(book.best(Book::BID)->quantity == 5);
+      assertUnit(book.numLevels(Book::BID) == 7);
+      assertUnit(isWellFormed(book, Book::BID));
+   }  // teardown
+
+   // nothing past the limit, and what is left is handed back
+   void test_match_limit()
+   {  // setup
+      Book book;
+      book.add(Book::ASK, 101, 10, 1);
+      book.add(Book::ASK, 102, 10, 2);
+      book.add(Book::ASK, 103, 10, 3);
+      // exercise
+      int64_t left = book.match(Book::BID, 102, 50, [](const Order &, int64_t) {});
+      int64_t none = book.match(Book::BID, 102, 5, [](const Order &, int64_t) {});
+      // verify
+      assertUnit(left == 30);
+      assertUnit(none == 5);
+      assertUnit(book.best(Book::ASK)->price == 103);
+      assertUnit(book.numOrders() == 1);
+   }  // teardown
+
+   /***************************************
+    * EVERYTHING
+    ***************************************/
+
+   // a replay leaves the same quantity at every price as a std::map
+   // kept by hand, with the best nodes where they should be
+   void test_replay_matchesMap()
+   {  // setup
+      Workload workload(7);
+      std::vector<Workload::MarketEvent> events = workload.marketReplay(20000, 500);
+      Book book;
+      std::vector<Order *> handles;
+      std::vector<char> isLive;
+      std::map<int64_t, int64_t> quantities[2];
+      auto onFill = [&](const Order & maker, int64_t filled)
+      {
+         quantities[maker.side][maker.price] -= filled;
+         if (filled == maker.quantity)
+            isLive[maker.id] = 0;
+      };
+      // exercise
+      for (const Workload::MarketEvent & event : events)
+      {
+         Book::Side side = (event.isBid ? Book::BID : Book::ASK);
+         if (event.type == Workload::MarketEvent::LIMIT)
+         {
+            int64_t left = book.match(side, event.price, event.quantity, onFill);
+            handles.push_back(nullptr);
+            isLive.push_back(0);
+            if (left > 0)
+            {
+               handles.back() = book.add(side, event.price, left, handles.size() - 1);
+               isLive.back() = 1;
+               quantities[side][event.price] += left;
+            }
+         }
+         else if (event.type == Workload::MarketEvent::CANCEL)
+         {
+            if (isLive[event.order])
+            {
+               quantities[handles[event.order]->side][handles[event.order]->price] -=
+                  handles[event.order]->quantity;
+               book.cancel(handles[event.order]);
+               isLive[event.order] = 0;
+            }
+         }
+         else
+            book.match(side, event.price, event.quantity, onFill);
+      }
+      // verify
+      for (int side = Book::BID; side <= Book::ASK; side++)
+      {
+         assertUnit(isWellFormed(book, (Book::Side)side));
+         size_t numLevels = 0;
+         for (const Book::Level & level : book.sides[side])
+         {
+            assertUnit(quantities[side][level.price] == level.quantity);
+            numLevels++;
+         }
+         size_t numPrices = 0;
+         for (const auto & entry : quantities[side])
+            numPrices += (entry.second != 0);
+         assertUnit(numLevels == numPrices);
+         assertUnit(numLevels == book.numLevels((Book::Side)side));
+      }
+      assertUnit(book.best(Book::BID) == nullptr || book.best(Book::ASK) == nullptr ||
+                 book.best(Book::BID)->price < book.best(Book::ASK)->price);
+   }  // teardown
+
+private:
+   // the ids at a level, front to back
+   static std::vector<uint64_t> ids(const Book::Level & level)
+   {
+      std::vector<uint64_t> v;
+      for (const Order * p = level.front(); p != nullptr; p = p->pNext)
+         v.push_back(p->id);
+      return v;
+   }
+
+   // the cached best is the first level, every level knows its node,
+   // and the totals add up
+   static bool isWellFormed(const Book & book, Book::Side side)
+   {
+      const custom::BST<Book::Level> & bst = book.sides[side];
+      if (bst.empty())
+         return book.pBest[side] == nullptr;
+      if (&*bst.begin() != &book.pBest[side]->data)
+         return false;
+      for (const Book::Level & level : bst)
+      {
+         if (&static_cast<Book::BNode *>(level.pNode)->data != &level)
+            return false;
+         int64_t quantity = 0;
+         size_t numOrders = 0;
+         for (const Order * p = level.front(); p != nullptr; p = p->pNext)
+         {
+            if (p->pLevel != &level || p->price != level.price || p->side != side)
+               return false;
+            quantity += p->quantity;
+            numOrders++;
+         }
+         if (quantity != level.quantity || numOrders != level.numOrders || numOrders == 0)
+            return false;
+      }
+      return true;
+   }
+};
+
+#endif // DEBUG
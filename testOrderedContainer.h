@@ -0,0 +1,795 @@
+/***********************************************************************
+ * Header:
+ *    TEST ORDERED CONTAINER
+ * Summary:
+ *    Unit tests run against every ordered-container backend
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "orderedContainer.h"
+#include "bst.h"
+#include "sortedVector.h"
+#include "bplusTree.h"
+#include "skipList.h"
+#include "fatTree.h"
+#include "yFastTrie.h"
+#include "workload.h"
+#include "unitTest.h"
+
+#include <atomic>     // for std::atomic
+#include <cstdint>    // for uint64_t
+#include <map>        // for std::map, the trie a YFastTrie should hold
+#include <set>        // for std::multiset, the keys a YFastTrie should hold
+#include <thread>     // for std::thread
+#include <vector>
+
+static_assert(custom::isOrderedContainer<custom::BST<int>,          int>::value, "BST");
+static_assert(custom::isOrderedContainer<custom::SortedVector<int>, int>::value, "SortedVector");
+static_assert(custom::isOrderedContainer<custom::BPlusTree<int>,    int>::value, "BPlusTree");
+static_assert(custom::isOrderedContainer<custom::SkipList<int>,     int>::value, "SkipList");
+static_assert(custom::isOrderedContainer<custom::FatTree<int>,      int>::value, "FatTree");
+static_assert(custom::isOrderedContainer<custom::YFastTrie<int>,    int>::value, "YFastTrie");
+
+/***********************************************
+ * TEST ORDERED CONTAINER
+ * The same unit tests for each backend
+ ***********************************************/
+class TestOrderedContainer : public UnitTest
+{
+public:
+   void run()
+   {
+      runBackend <custom::BST          <int>> ("OrderedContainer<BST>");
+      runBackend <custom::SortedVector <int>> ("OrderedContainer<SortedVector>");
+      runBackend <custom::BPlusTree    <int>> ("OrderedContainer<BPlusTree>");
+      runBackend <custom::SkipList     <int>> ("OrderedContainer<SkipList>");
+      runBackend <custom::FatTree      <int>> ("OrderedContainer<FatTree>");
+      runBackend <custom::YFastTrie    <int>> ("OrderedContainer<YFastTrie>");
+
+      // B+ tree structure
+      reset();
+      test_bplus_splitLeaf();
+      test_bplus_splitInner();
+      test_bplus_eraseEmptiesLeaf();
+      report("BPlusTree");
+
+      // 2-3-4 tree structure
+      reset();
+      test_fat_splitRoot();
+      test_fat_splitLeaf();
+      test_fat_invariants();
+      test_fat_searchInt();
+      report("FatTree");
+
+      // skip list reclamation
+      reset();
+      test_skip_churnReclaims();
+      test_skip_guardHoldsRetired();
+      test_skip_eraseRacesInsert();
+      report("SkipList");
+
+      // y-fast trie structure
+      reset();
+      test_yfast_splitBucket();
+      test_yfast_mergeBuckets();
+      test_yfast_duplicatesStayTogether();
+      test_yfast_manyDuplicates();
+      test_yfast_sparseUniverse();
+      test_yfast_invariants();
+      report("YFastTrie");
+   }
+
+   template <class Container>
+   void runBackend(const char * name)
+   {
+      reset();
+
+      // Insert
+      test_insert_ordered <Container>();
+      test_insert_duplicate <Container>();
+      test_insert_keepUnique <Container>();
+
+      // Find
+      test_find_present <Container>();
+      test_find_missing <Container>();
+      test_lowerBound_standard <Container>();
+      test_upperBound_standard <Container>();
+
+      // Remove
+      test_erase_returnsNext <Container>();
+      test_erase_all <Container>();
+      test_erase_many <Container>();
+
+      report(name);
+   }
+
+   /***************************************
+    * INSERT
+    ***************************************/
+
+   // insert out of order, iterate in order
+   template <class Container>
+   void test_insert_ordered()
+   {  // setup
+      Container c;
+      // exercise
+      setupStandardFixture(c);
+      // verify
+      assertUnit(c.size() == 7);
+      assertUnit(c.empty() == false);
+      assertUnit(toVector(c) == std::vector<int>({ 20, 30, 40, 50, 60, 70, 80 }));
+   }  // teardown
+
+   // duplicates are kept when keepUnique is not set
+   template <class Container>
+   void test_insert_duplicate()
+   {  // setup
+      Container c;
+      setupStandardFixture(c);
+      // exercise
+      auto pairReturn = c.insert(40, false /* keepUnique */);
+      // verify
+      assertUnit(pairReturn.second == true);
+      assertUnit(pairReturn.first != c.end());
+      if (pairReturn.first != c.end())
+         assertUnit(*pairReturn.first == 40);
+      assertUnit(c.size() == 8);
+      assertUnit(toVector(c) == std::vector<int>({ 20, 30, 40, 40, 50, 60, 70, 80 }));
+   }  // teardown
+
+   // keepUnique hands back the existing element
+   template <class Container>
+   void test_insert_keepUnique()
+   {  // setup
+      Container c;
+      setupStandardFixture(c);
+      // exercise
+      auto pairReturn = c.insert(40, true /* keepUnique */);
+      // verify
+      assertUnit(pairReturn.second == false);
+      assertUnit(pairReturn.first != c.end());
+      if (pairReturn.first != c.end())
+         assertUnit(*pairReturn.first == 40);
+      assertUnit(c.size() == 7);
+   }  // teardown
+
+   /***************************************
+    * FIND
+    ***************************************/
+
+   template <class Container>
+   void test_find_present()
+   {  // setup
+      Container c;
+      setupStandardFixture(c);
+      // exercise
+      auto it = c.find(60);
+      // verify
+      assertUnit(it != c.end());
+      if (it != c.end())
+         assertUnit(*it == 60);
+   }  // teardown
+
+   template <class Container>
+   void test_find_missing()
+   {  // setup
+      Container c;
+      setupStandardFixture(c);
+      // exercise
+      auto it = c.find(65);
+      // verify
+      assertUnit(it == c.end());
+   }  // teardown
+
+   template <class Container>
+   void test_lowerBound_standard()
+   {  // setup
+      Container c;
+      setupStandardFixture(c);
+      // exercise and verify
+      auto it = c.lower_bound(40);
+      assertUnit(it != c.end() && *it == 40);
+      it = c.lower_bound(45);
+      assertUnit(it != c.end() && *it == 50);
+      it = c.lower_bound(10);
+      assertUnit(it != c.end() && *it == 20);
+      it = c.lower_bound(90);
+      assertUnit(it == c.end());
+   }  // teardown
+
+   template <class Container>
+   void test_upperBound_standard()
+   {  // setup
+      Container c;
+      setupStandardFixture(c);
+      // exercise and verify
+      auto it = c.upper_bound(40);
+      assertUnit(it != c.end() && *it == 50);
+      it = c.upper_bound(45);
+      assertUnit(it != c.end() && *it == 50);
+      it = c.upper_bound(10);
+      assertUnit(it != c.end() && *it == 20);
+      it = c.upper_bound(80);
+      assertUnit(it == c.end());
+   }  // teardown
+
+   /***************************************
+    * ERASE
+    ***************************************/
+
+   // erase hands back the element after the one removed
+   template <class Container>
+   void test_erase_returnsNext()
+   {  // setup
+      Container c;
+      setupStandardFixture(c);
+      auto it = c.find(40);
+      // exercise
+      auto itReturn = c.erase(it);
+      // verify
+      assertUnit(itReturn != c.end());
+      if (itReturn != c.end())
+         assertUnit(*itReturn == 50);
+      assertUnit(c.size() == 6);
+      assertUnit(toVector(c) == std::vector<int>({ 20, 30, 50, 60, 70, 80 }));
+   }  // teardown
+
+   // erase everything, one element at a time
+   template <class Container>
+   void test_erase_all()
+   {  // setup
+      Container c;
+      setupStandardFixture(c);
+      // exercise
+      for (int value : { 50, 20, 80, 30, 70, 40, 60 })
+      {
+         auto it = c.find(value);
+         c.erase(it);
+      }
+      // verify
+      assertUnit(c.size() == 0);
+      assertUnit(c.empty() == true);
+      assertUnit(c.begin() == c.end());
+   }  // teardown
+
+   // enough elements to split nodes, then erase every other one
+   template <class Container>
+   void test_erase_many()
+   {  // setup
+      Container c;
+      std::vector<int> expected;
+      unsigned int seed = 7;
+      for (int i = 0; i < 1000; i++)
+      {
+         seed = seed * 1103515245u + 12345u;
+         c.insert((int)((seed >> 8) % 500));
+      }
+      // exercise
+      bool keep = true;
+      for (auto it = c.begin(); it != c.end(); )
+      {
+         if (keep)
+         {
+            expected.push_back(*it);
+            ++it;
+         }
+         else
+            it = c.erase(it);
+         keep = !keep;
+      }
+      // verify
+      assertUnit(c.size() == 500);
+      assertUnit(toVector(c) == expected);
+   }  // teardown
+
+   /***************************************
+    * B+ TREE STRUCTURE
+    ***************************************/
+
+   // one more than a leaf holds splits the root leaf in two
+   void test_bplus_splitLeaf()
+   {  // setup
+      custom::BPlusTree<int> tree;
+      // exercise
+      for (int i = 0; i <= custom::BPlusTree<int>::LEAF_MAX; i++)
+         tree.insert(i);
+      // verify
+      assertUnit(tree.root != nullptr);
+      if (tree.root)
+      {
+         assertUnit(tree.root->isLeaf == false);
+         assertUnit(tree.root->numKeys == 1);
+      }
+      assertUnit(tree.size() == custom::BPlusTree<int>::LEAF_MAX + 1);
+   }  // teardown
+
+   // enough leaves to split an inner node grows a third level
+   void test_bplus_splitInner()
+   {  // setup
+      custom::BPlusTree<int> tree;
+      const int num = custom::BPlusTree<int>::LEAF_MAX *
+                      custom::BPlusTree<int>::INNER_MAX;
+      // exercise
+      for (int i = 0; i < num; i++)
+         tree.insert(i);
+      // verify
+      int levels = 0;
+      for (auto p = tree.root; p != nullptr; levels++)
+         p = p->isLeaf ? nullptr : static_cast<custom::BPlusTree<int>::BPInner *>(p)->children[0];
+      assertUnit(levels == 3);
+      assertUnit(tree.size() == (size_t)num);
+      int expected = 0;
+      bool inOrder = true;
+      for (auto it = tree.begin(); it != tree.end(); ++it)
+         inOrder = inOrder && (*it == expected++);
+      assertUnit(inOrder);
+   }  // teardown
+
+   // erasing back down to one leaf collapses the root
+   void test_bplus_eraseEmptiesLeaf()
+   {  // setup
+      custom::BPlusTree<int> tree;
+      for (int i = 0; i <= custom::BPlusTree<int>::LEAF_MAX; i++)
+         tree.insert(i);
+      // exercise
+      for (int i = 0; i < custom::BPlusTree<int>::LEAF_MAX; i++)
+      {
+         auto it = tree.begin();
+         tree.erase(it);
+      }
+      // verify
+      assertUnit(tree.size() == 1);
+      assertUnit(tree.root != nullptr);
+      if (tree.root)
+         assertUnit(tree.root->isLeaf == true);
+      assertUnit(tree.begin() != tree.end() && *tree.begin() == custom::BPlusTree<int>::LEAF_MAX);
+   }  // teardown
+
+   /***************************************
+    * 2-3-4 TREE STRUCTURE
+    ***************************************/
+
+   // a fourth key splits the root: the middle one goes up
+   void test_fat_splitRoot()
+   {  // setup
+      custom::FatTree<int> tree;
+      // exercise
+      for (int value : { 10, 20, 30, 40 })
+         tree.insert(value);
+      // verify
+      //            [30]
+      //        +----+----+
+      //     [10 20]     [40]
+      assertUnit(tree.root != nullptr);
+      if (tree.root && tree.root->numKeys == 1 && !tree.root->isLeaf())
+      {
+         assertUnit(tree.root->keys[0] == 30);
+         auto pLeft = tree.root->children[0];
+         auto pRight = tree.root->children[1];
+         assertUnit(pLeft->numKeys == 2 && pLeft->keys[0] == 10 && pLeft->keys[1] == 20);
+         assertUnit(pRight->numKeys == 1 && pRight->keys[0] == 40);
+         assertUnit(pLeft->pParent == tree.root && pRight->pParent == tree.root);
+      }
+      else
+         assertUnit(false);
+   }  // teardown
+
+   // a full leaf under the root pushes its middle key up beside the old one
+   void test_fat_splitLeaf()
+   {  // setup
+      //            [30]
+      //        +----+----+
+      //     [10 20]   [40 50 60]
+      custom::FatTree<int> tree;
+      for (int value : { 10, 20, 30, 40, 50, 60 })
+         tree.insert(value);
+      // exercise
+      auto pairReturn = tree.insert(70);
+      // verify
+      //            [30 60]
+      //        +------+------+
+      //     [10 20] [40 50]  [70]
+      assertUnit(tree.root != nullptr);
+      if (tree.root && tree.root->numKeys == 2)
+      {
+         assertUnit(tree.root->keys[0] == 30);
+         assertUnit(tree.root->keys[1] == 60);
+         assertUnit(tree.root->children[1]->numKeys == 2);
+         assertUnit(tree.root->children[2]->numKeys == 1);
+      }
+      else
+         assertUnit(false);
+      assertUnit(pairReturn.first != tree.end() && *pairReturn.first == 70);
+   }  // teardown
+
+   // random inserts and erases keep every leaf at the same depth
+   void test_fat_invariants()
+   {  // setup
+      custom::FatTree<int> tree;
+      std::vector<Workload::Operation> ops = Workload(1).mix(4000, 500, 0.4, 0.0);
+      // exercise
+      Workload::apply(tree, ops);
+      // verify
+      int leafDepth = -1;
+      assertUnit(verifyFatNode(tree.root, nullptr, 0, leafDepth) == tree.size());
+      std::vector<int> v = toVector(tree);
+      bool sorted = true;
+      for (size_t i = 1; i < v.size(); i++)
+         sorted = sorted && !(v[i] < v[i - 1]);
+      assertUnit(sorted);
+   }  // teardown
+
+   // the int search agrees with the one built on <
+   void test_fat_searchInt()
+   {  // setup
+      int keys[4] = { 10, 20, 20, 0 };
+      // exercise and verify
+      bool same = true;
+      for (int numKeys = 0; numKeys <= 3; numKeys++)
+         for (int t : { 5, 10, 15, 20, 25 })
+         {
+            same = same &&
+               custom::FatSearch<int>::lower(keys, numKeys, t) ==
+               custom::FatSearch<long>::lower(std::vector<long>(keys, keys + 4).data(), numKeys, t);
+            same = same &&
+               custom::FatSearch<int>::upper(keys, numKeys, t) ==
+               custom::FatSearch<long>::upper(std::vector<long>(keys, keys + 4).data(), numKeys, t);
+         }
+      assertUnit(same);
+      assertUnit(custom::FatSearch<int>::lower(keys, 3, 20) == 1);
+      assertUnit(custom::FatSearch<int>::upper(keys, 3, 20) == 3);
+   }  // teardown
+
+   // count the keys below pNode, checking the 2-3-4 rules on the way
+   typedef custom::FatTree<int>::FNode FNode;
+   size_t verifyFatNode(const FNode * pNode, const FNode * pParent, int depth, int & leafDepth)
+   {
+      if (pNode == nullptr)
+         return 0;
+      assertUnit(pNode->pParent == pParent);
+      assertUnit(pNode->numKeys >= 1 && pNode->numKeys <= 3);
+      for (int i = 1; i < pNode->numKeys; i++)
+         assertUnit(!(pNode->keys[i] < pNode->keys[i - 1]));
+      if (pNode->isLeaf())
+      {
+         if (leafDepth < 0)
+            leafDepth = depth;
+         assertUnit(depth == leafDepth);
+         return pNode->numKeys;
+      }
+      size_t count = pNode->numKeys;
+      for (int i = 0; i <= pNode->numKeys; i++)
+      {
+         assertUnit(pNode->children[i] != nullptr);
+         count += verifyFatNode(pNode->children[i], pNode, depth + 1, leafDepth);
+      }
+      return count;
+   }
+
+   /***************************************
+    * SKIP LIST RECLAMATION
+    ***************************************/
+
+   // a list that stays the same size under churn does not keep every node
+   // it ever erased
+   void test_skip_churnReclaims()
+   {  // setup
+      typedef custom::SkipList<int> List;
+      List list;
+      for (int i = 0; i < 100; i++)
+         list.insert(i);
+      // exercise
+      for (int i = 0; i < 20000; i++)
+      {
+         list.insert(100 + i);
+         auto it = list.find(i);
+         list.erase(it);
+      }
+      // verify
+      assertUnit(list.size() == 100);
+      assertUnit(list.retired() <= 4 * List::RECLAIM_PERIOD);
+      assertUnit(*list.begin() == 20000);
+   }  // teardown
+
+   // nothing retired while a guard is held is freed until it goes
+   void test_skip_guardHoldsRetired()
+   {  // setup
+      typedef custom::SkipList<int> List;
+      List list;
+      for (int i = 0; i < 1000; i++)
+         list.insert(i);
+      // exercise
+      {
+         List::Guard guard;
+         auto itFirst = list.begin();
+         for (int i = 0; i < 1000; i += 2)
+         {
+            auto it = list.find(i);
+            list.erase(it);
+         }
+         // verify
+         assertUnit(list.retired() == 500);
+         assertUnit(*itFirst == 0);   // erased, but still readable
+      }
+      for (int i = 1; i < 1000; i += 2)
+      {
+         auto it = list.find(i);
+         list.erase(it);
+      }
+      assertUnit(list.empty());
+      assertUnit(list.retired() < 500);
+   }  // teardown
+
+   // Writers insert and erase the same few keys while readers find them.
+   // A node erased while its inserter is still linking upper levels must
+   // not stay linked anywhere once retired. Run under ASan or TSan.
+   void test_skip_eraseRacesInsert()
+   {  // setup
+      typedef custom::SkipList<int> List;
+      List list;
+      std::atomic<bool> done(false);
+      std::atomic<int> numWrong(0);
+      std::vector<std::thread> threads;
+      for (int i = 0; i < 2; i++)
+         threads.emplace_back([&]()
+         {
+            while (!done.load())
+               for (int key = 0; key < 8; key++)
+               {
+                  List::Guard guard;
+                  auto it = list.find(key);
+                  if (it != list.end() && *it != key)
+                     numWrong++;
+               }
+         });
+      // exercise
+      for (int i = 0; i < 4; i++)
+         threads.emplace_back([&, i]()
+         {
+            for (int round = 0; round < 10000; round++)
+            {
+               int key = (round + i) % 8;
+               list.insert(key);
+               List::Guard guard;
+               auto it = list.find(key);
+               if (it != list.end())
+                  list.erase(it);
+            }
+         });
+      for (size_t i = 2; i < threads.size(); i++)
+         threads[i].join();
+      done = true;
+      threads[0].join();
+      threads[1].join();
+      // verify
+      assertUnit(numWrong.load() == 0);
+      for (int level = 0; level < List::MAX_LEVEL; level++)
+         for (auto p = List::getNode(list.head[level].load()); p != nullptr;
+              p = List::getNode(p->next[level].load()))
+            assertUnit(!List::isMarked(p->next[level].load()));
+      size_t numLive = 0;
+      for (auto it = list.begin(); it != list.end(); ++it)
+         numLive++;
+      assertUnit(numLive == list.size());
+   }  // teardown
+
+   /***************************************
+    * Y-FAST TRIE STRUCTURE
+    ***************************************/
+
+   // one key too many for a bucket splits it in two at the middle
+   void test_yfast_splitBucket()
+   {  // setup
+      typedef custom::YFastTrie<int> Trie;
+      Trie trie;
+      for (int i = 0; i < (int)Trie::BUCKET_MAX; i++)
+         trie.insert(i * 10);
+      assertUnit(numBuckets(trie) == 1);
+      // exercise
+      auto pairReturn = trie.insert(5);
+      // verify
+      assertUnit(numBuckets(trie) == 2);
+      assertUnit(pairReturn.first != trie.end() && *pairReturn.first == 5);
+      assertUnit(trie.size() == Trie::BUCKET_MAX + 1);
+      if (trie.pFirst != nullptr && trie.pFirst->pNext != nullptr)
+      {
+         assertUnit(trie.pFirst->keys.size() == (Trie::BUCKET_MAX + 1) / 2);
+         assertUnit(trie.pFirst->pNext->rep == Trie::bitsOf((int)Trie::BUCKET_MAX / 2 * 10 - 10));
+      }
+      assertUnit(verifyYFast(trie) == trie.size());
+   }  // teardown
+
+   // a bucket that gets too small joins its neighbour
+   void test_yfast_mergeBuckets()
+   {  // setup
+      typedef custom::YFastTrie<int> Trie;
+      Trie trie;
+      for (int i = 0; i <= (int)Trie::BUCKET_MAX; i++)
+         trie.insert(i);
+      assertUnit(numBuckets(trie) == 2);
+      // exercise
+      auto it = trie.find(0);
+      while (numBuckets(trie) == 2 && it != trie.end())
+         it = trie.erase(it);
+      // verify
+      assertUnit(numBuckets(trie) == 1);
+      assertUnit(it != trie.end() && *it == (int)(Trie::BUCKET_MAX + 1 - trie.size()));
+      assertUnit(verifyYFast(trie) == trie.size());
+   }  // teardown
+
+   // a split never puts equal keys in two buckets, and they keep their order
+   void test_yfast_duplicatesStayTogether()
+   {  // setup
+      typedef custom::YFastTrie<int> Trie;
+      Trie trie;
+      trie.insert(1);
+      // exercise
+      for (int i = 0; i < 3 * (int)Trie::BUCKET_MAX; i++)
+         trie.insert(7);
+      trie.insert(9);
+      // verify
+      assertUnit(numBuckets(trie) == 3);
+      assertUnit(trie.lower_bound(7) != trie.end() && *trie.lower_bound(7) == 7);
+      assertUnit(trie.upper_bound(7) != trie.end() && *trie.upper_bound(7) == 9);
+      assertUnit(verifyYFast(trie) == trie.size());
+   }  // teardown
+
+   // a bucket of one key repeated thousands of times is left alone
+   // rather than rebuilt on every insert, and keys around it still split
+   void test_yfast_manyDuplicates()
+   {  // setup
+      typedef custom::YFastTrie<int> Trie;
+      Trie trie;
+      // exercise
+      for (int i = 0; i < 20000; i++)
+         trie.insert(7);
+      trie.insert(3);
+      trie.insert(9);
+      // verify
+      assertUnit(trie.size() == 20002);
+      assertUnit(numBuckets(trie) == 3);
+      assertUnit(*trie.begin() == 3);
+      assertUnit(trie.upper_bound(7) != trie.end() && *trie.upper_bound(7) == 9);
+      assertUnit(verifyYFast(trie) == trie.size());
+   }  // teardown
+
+   // keys spread over all 64 bits answer the same as a std::multiset
+   void test_yfast_sparseUniverse()
+   {  // setup
+      custom::YFastTrie<uint64_t> trie;
+      std::multiset<uint64_t> keys;
+      uint64_t seed = 12345;
+      for (int i = 0; i < 3000; i++)
+      {
+         seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+         trie.insert(seed);
+         keys.insert(seed);
+      }
+      trie.insert(0);
+      keys.insert(0);
+      trie.insert(UINT64_MAX);
+      keys.insert(UINT64_MAX);
+      // exercise and verify
+      bool same = true;
+      for (int i = 0; i < 3000; i++)
+      {
+         seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+         auto it = trie.lower_bound(seed);
+         auto itSet = keys.lower_bound(seed);
+         same = same && (it == trie.end()) == (itSet == keys.end());
+         if (it != trie.end() && itSet != keys.end())
+            same = same && *it == *itSet;
+         it = trie.upper_bound(seed - 1);
+         itSet = keys.upper_bound(seed - 1);
+         same = same && (it == trie.end()) == (itSet == keys.end());
+         if (it != trie.end() && itSet != keys.end())
+            same = same && *it == *itSet;
+      }
+      assertUnit(same);
+      assertUnit(*trie.begin() == 0);
+      assertUnit(trie.find(UINT64_MAX) != trie.end());
+      assertUnit(verifyYFast(trie) == keys.size());
+   }  // teardown
+
+   // random inserts and erases of negative and positive keys keep the
+   // buckets in order and the trie matching them
+   void test_yfast_invariants()
+   {  // setup
+      custom::YFastTrie<int> trie;
+      std::multiset<int> keys;
+      std::vector<Workload::Operation> ops = Workload(2).mix(6000, 800, 0.45, 0.0);
+      // exercise
+      for (Workload::Operation & op : ops)
+         op.key -= 400;
+      Workload::apply(trie, ops);
+      Workload::apply(keys, ops);
+      // verify
+      assertUnit(verifyYFast(trie) == keys.size());
+      assertUnit(std::vector<int>(keys.begin(), keys.end()) == toVector(trie));
+      trie.clear();
+      assertUnit(trie.empty() && trie.begin() == trie.end() && trie.prefixes.size() == 0);
+   }  // teardown
+
+   template <typename T>
+   size_t numBuckets(const custom::YFastTrie<T> & trie)
+   {
+      size_t count = 0;
+      for (auto pBucket = trie.pFirst; pBucket != nullptr; pBucket = pBucket->pNext)
+         count++;
+      return count;
+   }
+
+   // count the keys, checking every bucket holds keys from its rep up to
+   // the next one and the trie has exactly the prefixes of the reps
+   template <typename T>
+   size_t verifyYFast(const custom::YFastTrie<T> & trie)
+   {
+      typedef custom::YFastTrie<T> Trie;
+      typedef typename Trie::Bucket Bucket;
+      std::map<std::pair<int, uint64_t>, std::pair<const Bucket *, const Bucket *>> expected;
+      size_t count = 0;
+      if (trie.pFirst != nullptr)
+         assertUnit(trie.pFirst->rep == 0 && trie.pFirst->pPrev == nullptr);
+      for (const Bucket * pBucket = trie.pFirst; pBucket != nullptr; pBucket = pBucket->pNext)
+      {
+         if (pBucket->pNext != nullptr)
+         {
+            assertUnit(pBucket->pNext->pPrev == pBucket);
+            assertUnit(pBucket->rep < pBucket->pNext->rep);
+            assertUnit(!pBucket->pNext->keys.empty());
+         }
+         for (auto it = pBucket->keys.begin(); it != pBucket->keys.end(); ++it)
+         {
+            assertUnit(!(Trie::bitsOf(*it) < pBucket->rep));
+            if (pBucket->pNext != nullptr)
+               assertUnit(Trie::bitsOf(*it) < pBucket->pNext->rep);
+            count++;
+         }
+         for (int level = 0; level <= Trie::WIDTH; level++)
+         {
+            auto & entry = expected[std::make_pair(level, (uint64_t)Trie::prefixOf(pBucket->rep, level))];
+            if (entry.first == nullptr)
+               entry.first = pBucket;
+            entry.second = pBucket;
+         }
+      }
+      assertUnit(trie.prefixes.size() == expected.size());
+      for (auto & entry : expected)
+      {
+         auto pSlot = trie.prefixes.find(entry.first.first, (typename Trie::Bits)entry.first.second);
+         assertUnit(pSlot != nullptr);
+         if (pSlot != nullptr)
+            assertUnit(pSlot->pMin == entry.second.first && pSlot->pMax == entry.second.second);
+      }
+      assertUnit(count == trie.size());
+      return count;
+   }
+
+   /**************************************************************
+    * SETUP STANDARD FIXTURE
+    *    20 30 40 50 60 70 80, inserted out of order
+    *************************************************************/
+   template <class Container>
+   void setupStandardFixture(Container & c)
+   {
+      for (int value : { 50, 30, 70, 20, 40, 60, 80 })
+         c.insert(value);
+   }
+
+   // the elements in iteration order
+   template <class Container>
+   std::vector<int> toVector(const Container & c)
+   {
+      std::vector<int> v;
+      for (auto it = c.begin(); it != c.end(); ++it)
+         v.push_back(*it);
+      return v;
+   }
+};
+
+#endif // DEBUG
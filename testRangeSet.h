@@ -0,0 +1,297 @@
+/***********************************************************************
+ * Header:
+ *    TEST RANGE SET
+ * Summary:
+ *    Unit tests for the coalescing interval set
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "rangeSet.h"
+#include "unitTest.h"
+
+#include <set>        // for std::set, the set a RangeSet should equal
+#include <utility>    // for std::pair
+#include <vector>
+
+/***********************************************
+ * TEST RANGE SET
+ * Unit tests for the RangeSet class
+ ***********************************************/
+class TestRangeSet : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Insert
+      test_insert_disjoint();
+      test_insert_overlap();
+      test_insert_adjacent();
+      test_insert_inside();
+      test_insert_bridge();
+
+      // Erase
+      test_erase_split();
+      test_erase_ends();
+      test_erase_spanning();
+
+      // Access
+      test_contains_standard();
+      test_firstGap_standard();
+
+      // Rebuild
+      test_rebuild_churn();
+
+      // Everything
+      test_random_matchesSet();
+
+      report("RangeSet");
+   }
+
+   typedef custom::RangeSet <int> Ranges;
+   typedef std::vector<std::pair<int, int>> Intervals;
+
+   /***************************************
+    * INSERT
+    ***************************************/
+
+   void test_insert_disjoint()
+   {  // setup
+      Ranges ranges;
+      // exercise
+      ranges.insert(20, 30);
+      ranges.insert(0, 10);
+      ranges.insert(40, 41);
+      // verify
+      assertUnit(intervals(ranges) == Intervals({ { 0, 10 }, { 20, 30 }, { 40, 41 } }));
+      assertUnit(ranges.size() == 3);
+   }  // teardown
+
+   void test_insert_overlap()
+   {  // setup
+      Ranges ranges;
+      ranges.insert(10, 20);
+      // exercise
+      ranges.insert(15, 25);
+      ranges.insert(5, 12);
+      // verify
+      assertUnit(intervals(ranges) == Intervals({ { 5, 25 } }));
+   }  // teardown
+
+   // touching is enough to merge, from either side
+   void test_insert_adjacent()
+   {  // setup
+      Ranges ranges;
+      // exercise
+      for (int id = 0; id < 100; id++)
+         ranges.insert(id);
+      ranges.insert(-10, 0);
+      // verify
+      assertUnit(intervals(ranges) == Intervals({ { -10, 100 } }));
+      assertUnit(ranges.size() == 1);
+   }  // teardown
+
+   // nothing new, and empty intervals are nothing at all
+   void test_insert_inside()
+   {  // setup
+      Ranges ranges;
+      ranges.insert(10, 20);
+      // exercise
+      ranges.insert(12, 18);
+      ranges.insert(10, 20);
+      ranges.insert(30, 30);
+      ranges.insert(40, 35);
+      // verify
+      assertUnit(intervals(ranges) == Intervals({ { 10, 20 } }));
+   }  // teardown
+
+   // one interval across several swallows them all
+   void test_insert_bridge()
+   {  // setup
+      Ranges ranges;
+      for (int lo = 0; lo < 100; lo += 10)
+         ranges.insert(lo, lo + 5);
+      // exercise
+      ranges.insert(23, 70);
+      // verify
+      assertUnit(intervals(ranges) == Intervals({ { 0, 5 }, { 10, 15 }, { 20, 75 },
+                                                  { 80, 85 }, { 90, 95 } }));
+   }  // teardown
+
+   /***************************************
+    * ERASE
+    ***************************************/
+
+   // a hole in the middle leaves two intervals
+   void test_erase_split()
+   {  // setup
+      Ranges ranges;
+      ranges.insert(0, 100);
+      // exercise
+      ranges.erase(40, 60);
+      ranges.erase(10);
+      // verify
+      assertUnit(intervals(ranges) == Intervals({ { 0, 10 }, { 11, 40 }, { 60, 100 } }));
+   }  // teardown
+
+   void test_erase_ends()
+   {  // setup
+      Ranges ranges;
+      ranges.insert(0, 100);
+      // exercise
+      ranges.erase(-5, 10);
+      ranges.erase(90, 200);
+      ranges.erase(50, 50);
+      // verify
+      assertUnit(intervals(ranges) == Intervals({ { 10, 90 } }));
+   }  // teardown
+
+   // cut the end of one, remove those inside, cut the start of another
+   void test_erase_spanning()
+   {  // setup
+      Ranges ranges;
+      for (int lo = 0; lo < 100; lo += 10)
+         ranges.insert(lo, lo + 5);
+      // exercise
+      ranges.erase(3, 62);
+      // verify
+      assertUnit(intervals(ranges) == Intervals({ { 0, 3 }, { 62, 65 }, { 70, 75 },
+                                                  { 80, 85 }, { 90, 95 } }));
+   }  // teardown
+
+   /***************************************
+    * ACCESS
+    ***************************************/
+
+   void test_contains_standard()
+   {  // setup
+      Ranges ranges;
+      ranges.insert(10, 20);
+      ranges.insert(30, 40);
+      // exercise and verify
+      assertUnit(!ranges.contains(9));
+      assertUnit(ranges.contains(10));
+      assertUnit(ranges.contains(19));
+      assertUnit(!ranges.contains(20));
+      assertUnit(!ranges.contains(25));
+      assertUnit(ranges.contains(35));
+      assertUnit(!ranges.contains(40));
+      assertUnit((*ranges.find(15)).lo == 10);
+      assertUnit(ranges.find(25) == ranges.end());
+   }  // teardown
+
+   void test_firstGap_standard()
+   {  // setup
+      Ranges ranges;
+      ranges.insert(0, 10);
+      ranges.insert(12, 20);
+      ranges.insert(25, 30);
+      // exercise and verify
+      assertUnit(ranges.firstGap(1) == 10);
+      assertUnit(ranges.firstGap(2) == 10);
+      assertUnit(ranges.firstGap(3) == 20);
+      assertUnit(ranges.firstGap(6) == 30);
+      assertUnit(ranges.firstGap(1, 15) == 20);
+      assertUnit(ranges.firstGap(1, 22) == 22);
+      assertUnit(Ranges().firstGap(5, 7) == 7);
+   }  // teardown
+
+   /***************************************
+    * REBUILD
+    ***************************************/
+
+   // erasing and putting back the same values keeps the tree within
+   // red-black depth, because enough erases rebuild it
+   void test_rebuild_churn()
+   {  // setup
+      Ranges ranges;
+      for (int value = 0; value < 2000; value += 2)
+         ranges.insert(value);
+      unsigned int seed = 12345;
+      // exercise
+      for (int i = 0; i < 20000; i++)
+      {
+         seed = seed * 1103515245u + 12345u;
+         int value = (int)((seed >> 8) % 1000) * 2;
+         ranges.erase(value);
+         ranges.insert(value);
+      }
+      // verify
+      assertUnit(ranges.size() == 1000);
+      assertUnit(ranges.numErased <= ranges.size());
+      assertUnit(depth(ranges.bst.root) <= 20);  // 2 log2(1001)
+      for (int value = -1; value < 2000; value++)
+         assertUnit(ranges.contains(value) == (value >= 0 && value % 2 == 0));
+   }  // teardown
+
+   /***************************************
+    * EVERYTHING
+    ***************************************/
+
+   // random inserts and erases hold the same values as a std::set, and
+   // the intervals never touch
+   void test_random_matchesSet()
+   {  // setup
+      Ranges ranges;
+      std::set<int> values;
+      unsigned int seed = 12345;
+      // exercise
+      for (int i = 0; i < 2000; i++)
+      {
+         seed = seed * 1103515245u + 12345u;
+         int lo = (int)((seed >> 8) % 500);
+         int length = (int)((seed >> 20) % 12);
+         if ((seed >> 4) % 3 != 0)
+         {
+            ranges.insert(lo, lo + length);
+            for (int value = lo; value < lo + length; value++)
+               values.insert(value);
+         }
+         else
+         {
+            ranges.erase(lo, lo + length);
+            for (int value = lo; value < lo + length; value++)
+               values.erase(value);
+         }
+      }
+      // verify
+      for (int value = -1; value <= 512; value++)
+         assertUnit(ranges.contains(value) == (values.count(value) == 1));
+      Intervals v = intervals(ranges);
+      for (size_t i = 0; i < v.size(); i++)
+      {
+         assertUnit(v[i].first < v[i].second);
+         if (i > 0)
+            assertUnit(v[i - 1].second < v[i].first);
+      }
+   }  // teardown
+
+private:
+   // the intervals in order, as pairs
+   static Intervals intervals(const Ranges & ranges)
+   {
+      Intervals v;
+      for (const Ranges::Interval & interval : ranges)
+         v.push_back(std::make_pair(interval.lo, interval.hi));
+      return v;
+   }
+
+   // the number of nodes on the longest path down from pNode
+   template <class BNode>
+   static size_t depth(const BNode * pNode)
+   {
+      if (pNode == nullptr)
+         return 0;
+      size_t left = depth(pNode->pLeft);
+      size_t right = depth(pNode->pRight);
+      return 1 + (left > right ? left : right);
+   }
+};
+
+#endif // DEBUG
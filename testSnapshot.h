@@ -0,0 +1,300 @@
+/***********************************************************************
+ * Header:
+ *    TEST SNAPSHOT
+ * Summary:
+ *    Unit tests for saving and loading a BST in chunks
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "snapshot.h"
+#include "unitTest.h"
+
+#include <cstdio>     // for std::remove and std::FILE
+
+/***********************************************
+ * TEST SNAPSHOT
+ * Unit tests for the Snapshot class
+ ***********************************************/
+class TestSnapshot : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Round trip
+      test_roundTrip_empty();
+      test_roundTrip_raw();
+      test_roundTrip_delta();
+      test_roundTrip_threads();
+      test_roundTrip_struct();
+
+      // Pieces
+      test_build_colors();
+      test_join_tallerLow();
+
+      // Failure
+      test_load_missing();
+      test_load_corrupt();
+      test_load_wrongSize();
+
+      report("Snapshot");
+   }
+
+   typedef custom::Snapshot <int> Snap;
+   typedef custom::BST <int> ::BNode BNode;
+
+   const char * PATH = "testSnapshot.snap";
+
+   /***************************************
+    * ROUND TRIP
+    ***************************************/
+
+   void test_roundTrip_empty()
+   {  // setup
+      custom::BST <int> bst;
+      custom::BST <int> loaded;
+      loaded.insert(99);
+      // exercise
+      bool saved = Snap::save(bst, PATH);
+      bool isLoaded = Snap::load(loaded, PATH);
+      // verify
+      assertUnit(saved);
+      assertUnit(isLoaded);
+      assertUnit(loaded.size() == 0);
+      assertUnit(loaded.root == nullptr);
+      std::remove(PATH);
+   }  // teardown
+
+   // many small chunks, duplicates straddling them, all joined back up
+   void test_roundTrip_raw()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i = 0; i < 500; i++)
+         bst.insert((i * 37) % 250);
+      custom::BST <int> loaded;
+      // exercise
+      bool saved = Snap::save(bst, PATH, 7, false /* compress */);
+      bool isLoaded = Snap::load(loaded, PATH, 1);
+      // verify
+      assertUnit(saved);
+      assertUnit(isLoaded);
+      assertUnit(sameKeys(bst, loaded));
+      assertUnit(isRedBlack(loaded));
+      std::remove(PATH);
+   }  // teardown
+
+   // close sorted keys come out a quarter the size as varints
+   void test_roundTrip_delta()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i = -5000; i < 5000; i += 3)
+         bst.insert(i);
+      custom::BST <int> loaded;
+      // exercise
+      Snap::save(bst, PATH, 1000, false /* compress */);
+      long rawSize = fileSize(PATH);
+      bool saved = Snap::save(bst, PATH, 1000, true /* compress */);
+      long deltaSize = fileSize(PATH);
+      bool isLoaded = Snap::load(loaded, PATH, 1);
+      // verify
+      assertUnit(saved);
+      assertUnit(deltaSize < rawSize / 3);
+      assertUnit(isLoaded);
+      assertUnit(sameKeys(bst, loaded));
+      assertUnit(isRedBlack(loaded));
+      std::remove(PATH);
+   }  // teardown
+
+   void test_roundTrip_threads()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i = 0; i < 3000; i++)
+         bst.insert((i * 7919) % 3000);
+      custom::BST <int> loaded;
+      loaded.insert(-1);
+      // exercise
+      bool saved = Snap::save(bst, PATH, 100);
+      bool isLoaded = Snap::load(loaded, PATH, 4);
+      // verify
+      assertUnit(saved);
+      assertUnit(isLoaded);
+      assertUnit(loaded.size() == 3000);
+      assertUnit(sameKeys(bst, loaded));
+      assertUnit(isRedBlack(loaded));
+      std::remove(PATH);
+   }  // teardown
+
+   // anything trivially copyable saves as its bytes
+   void test_roundTrip_struct()
+   {  // setup
+      custom::BST <Pair> bst;
+      for (int i = 0; i < 100; i++)
+         bst.insert(Pair{ i * 0.5, i });
+      custom::BST <Pair> loaded;
+      // exercise
+      bool saved = custom::Snapshot <Pair> ::save(bst, PATH, 16);
+      bool isLoaded = custom::Snapshot <Pair> ::load(loaded, PATH, 2);
+      // verify
+      assertUnit(saved);
+      assertUnit(isLoaded);
+      assertUnit(loaded.size() == 100);
+      int i = 0;
+      for (const Pair & pair : loaded)
+      {
+         assertUnit(pair.key == i * 0.5 && pair.value == i);
+         i++;
+      }
+      std::remove(PATH);
+   }  // teardown
+
+   /***************************************
+    * PIECES
+    ***************************************/
+
+   // six nodes: two full levels of black and one red leaf underneath
+   void test_build_colors()
+   {  // setup
+      int values[] = { 10, 20, 30, 40, 50, 60 };
+      // exercise
+      size_t blackHeight = Snap::blackHeightOf(6);
+      BNode * pRoot = Snap::build(values, 6, 0, blackHeight);
+      // verify
+      assertUnit(blackHeight == 2);
+      assertUnit(pRoot->data == 40);
+      assertUnit(!pRoot->isRed);
+      assertUnit(pRoot->pLeft->data == 20 && !pRoot->pLeft->isRed);
+      assertUnit(pRoot->pLeft->pLeft->data == 10 && pRoot->pLeft->pLeft->isRed);
+      assertUnit(pRoot->verifyRedBlack(pRoot->findDepth()));
+      assertUnit(pRoot->findDepth() == 2);
+      custom::BST <int> ().clearNode(pRoot);
+   }  // teardown
+
+   // a short tree on the right goes down the tall one's right spine
+   void test_join_tallerLow()
+   {  // setup
+      int low[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+      int high[] = { 20 };
+      BNode * pLow = Snap::build(low, 15, 0, 4);
+      BNode * pHigh = Snap::build(high, 1, 0, 1);
+      BNode * pMiddle = new BNode(16);
+      size_t blackHeight = 0;
+      // exercise
+      BNode * pRoot = Snap::join(pLow, 4, pMiddle, pHigh, 1, blackHeight);
+      // verify
+      assertUnit(pRoot->pParent == nullptr);
+      assertUnit(!pRoot->isRed);
+      assertUnit(pRoot->verifyRedBlack(pRoot->findDepth()));
+      assertUnit(blackHeight == (size_t)pRoot->findDepth());
+      assertUnit(pRoot->computeSize() == 17);
+      custom::BST <int> ().clearNode(pRoot);
+   }  // teardown
+
+   /***************************************
+    * FAILURE
+    ***************************************/
+
+   void test_load_missing()
+   {  // setup
+      custom::BST <int> loaded;
+      loaded.insert(5);
+      // exercise
+      bool isLoaded = Snap::load(loaded, "testSnapshot.missing");
+      // verify
+      assertUnit(!isLoaded);
+      assertUnit(loaded.size() == 1);
+   }  // teardown
+
+   // one flipped bit fails its chunk's checksum, and bst is untouched
+   void test_load_corrupt()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i = 0; i < 1000; i++)
+         bst.insert(i);
+      Snap::save(bst, PATH, 100);
+      std::FILE * pFile = std::fopen(PATH, "r+b");
+      std::fseek(pFile, -5, SEEK_END);
+      int byte = std::fgetc(pFile);
+      std::fseek(pFile, -5, SEEK_END);
+      std::fputc(byte ^ 0x01, pFile);
+      std::fclose(pFile);
+      custom::BST <int> loaded;
+      loaded.insert(5);
+      // exercise
+      bool isLoaded = Snap::load(loaded, PATH, 2);
+      // verify
+      assertUnit(!isLoaded);
+      assertUnit(loaded.size() == 1);
+      assertUnit(*loaded.begin() == 5);
+      std::remove(PATH);
+   }  // teardown
+
+   // a snapshot of one type does not load as another
+   void test_load_wrongSize()
+   {  // setup
+      custom::BST <int> bst;
+      bst.insert(1);
+      Snap::save(bst, PATH);
+      custom::BST <long long> loaded;
+      // exercise
+      bool isLoaded = custom::Snapshot <long long> ::load(loaded, PATH);
+      // verify
+      assertUnit(!isLoaded);
+      assertUnit(loaded.size() == 0);
+      std::remove(PATH);
+   }  // teardown
+
+private:
+   struct Pair
+   {
+      double key;
+      int value;
+      bool operator < (const Pair & rhs) const { return key < rhs.key; }
+      bool operator == (const Pair & rhs) const { return key == rhs.key; }
+   };
+
+   // the same keys in the same order
+   template <class T>
+   static bool sameKeys(const custom::BST <T> & lhs, const custom::BST <T> & rhs)
+   {
+      if (lhs.size() != rhs.size())
+         return false;
+      auto itRhs = rhs.begin();
+      for (const T & t : lhs)
+      {
+         if (!(*itRhs == t))
+            return false;
+         ++itRhs;
+      }
+      return true;
+   }
+
+   // a valid red-black tree whose size matches its count
+   static bool isRedBlack(const custom::BST <int> & bst)
+   {
+      if (bst.root == nullptr)
+         return bst.size() == 0;
+      bst.root->verifyBTree();
+      return bst.root->pParent == nullptr && !bst.root->isRed &&
+         bst.root->verifyRedBlack(bst.root->findDepth()) &&
+         bst.root->computeSize() == (int)bst.size();
+   }
+
+   static long fileSize(const char * path)
+   {
+      std::FILE * pFile = std::fopen(path, "rb");
+      if (pFile == nullptr)
+         return -1;
+      std::fseek(pFile, 0, SEEK_END);
+      long size = std::ftell(pFile);
+      std::fclose(pFile);
+      return size;
+   }
+};
+
+#endif // DEBUG
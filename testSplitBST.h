@@ -0,0 +1,245 @@
+/***********************************************************************
+ * Header:
+ *    TEST SPLIT BST
+ * Summary:
+ *    Unit tests for the hot/cold split BST
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "splitBST.h"
+#include "unitTest.h"
+
+#include <utility>    // for std::move
+#include <vector>
+
+/***********************************************
+ * TEST SPLIT BST
+ * Unit tests for the SplitBST class
+ ***********************************************/
+class TestSplitBST : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Layout
+      test_hot_small();
+
+      // Tree
+      test_insert_ordered();
+      test_insert_duplicates();
+      test_insert_keepUnique();
+      test_find_standard();
+      test_bounds_standard();
+      test_erase_freesCold();
+      test_clear_freesCold();
+
+      // Copy and move
+      test_copy_deep();
+      test_move_keepsCold();
+
+      report("SplitBST");
+   }
+
+   // a big element that counts how many of it are alive
+   struct Record
+   {
+      Record(int key = 0, int value = 0) : key(key), value(value) { numLive++; }
+      Record(const Record & rhs) : key(rhs.key), value(rhs.value) { numLive++; }
+      ~Record() { numLive--; }
+      int key;
+      int value;
+      char payload[240];
+      static int numLive;
+   };
+   struct KeyOfRecord
+   {
+      int operator () (const Record & record) const { return record.key; }
+   };
+   typedef custom::SplitBST <Record, KeyOfRecord> Tree;
+
+   /***************************************
+    * LAYOUT
+    ***************************************/
+
+   // a node holds the key and a pointer, not the record
+   void test_hot_small()
+   {  // exercise and verify
+      assertUnit(sizeof(Tree::Hot) == 2 * sizeof(void *));
+      assertUnit(sizeof(Record) > 4 * sizeof(Tree::Hot));
+   }  // teardown
+
+   /***************************************
+    * TREE
+    ***************************************/
+
+   void test_insert_ordered()
+   {  // setup
+      Tree tree;
+      // exercise
+      setupStandardFixture(tree);
+      // verify
+      assertUnit(tree.size() == 7);
+      assertUnit(keys(tree) == std::vector<int>({ 10, 20, 30, 40, 50, 60, 70 }));
+      assertUnit(Record::numLive == 7);
+      tree.clear();
+   }  // teardown
+
+   // equal keys are both kept, in the order they came
+   void test_insert_duplicates()
+   {  // setup
+      Tree tree;
+      // exercise
+      tree.insert(Record(5, 1));
+      tree.insert(Record(5, 2));
+      tree.insert(Record(3, 3));
+      // verify
+      assertUnit(tree.size() == 3);
+      std::vector<int> values;
+      for (const Record & record : tree)
+         values.push_back(record.value);
+      assertUnit(values == std::vector<int>({ 3, 1, 2 }));
+      assertUnit(tree.begin() != ++tree.begin());
+      tree.clear();
+   }  // teardown
+
+   // a duplicate hands back the original and allocates nothing
+   void test_insert_keepUnique()
+   {  // setup
+      Tree tree;
+      tree.insert(Record(5, 1));
+      Record duplicate(5, 2);
+      int numLive = Record::numLive;
+      // exercise
+      auto result = tree.insert(duplicate, true /* keepUnique */);
+      // verify
+      assertUnit(!result.second);
+      assertUnit(result.first->value == 1);
+      assertUnit(Record::numLive == numLive);
+      assertUnit(tree.size() == 1);
+      tree.clear();
+   }  // teardown
+
+   void test_find_standard()
+   {  // setup
+      Tree tree;
+      setupStandardFixture(tree);
+      // exercise
+      auto itHit = tree.find(40);
+      auto itMiss = tree.find(45);
+      // verify
+      assertUnit(itHit != tree.end());
+      assertUnit((*itHit).key == 40 && itHit->value == 4);
+      assertUnit(itMiss == tree.end());
+      tree.clear();
+   }  // teardown
+
+   void test_bounds_standard()
+   {  // setup
+      Tree tree;
+      setupStandardFixture(tree);
+      // exercise and verify
+      assertUnit(tree.lower_bound(40)->key == 40);
+      assertUnit(tree.upper_bound(40)->key == 50);
+      assertUnit(tree.lower_bound(45)->key == 50);
+      assertUnit(tree.lower_bound(5)->key == 10);
+      assertUnit(tree.upper_bound(70) == tree.end());
+      tree.clear();
+   }  // teardown
+
+   void test_erase_freesCold()
+   {  // setup
+      Tree tree;
+      setupStandardFixture(tree);
+      auto it = tree.find(30);
+      // exercise
+      auto itNext = tree.erase(it);
+      // verify
+      assertUnit(itNext != tree.end() && itNext->key == 40);
+      assertUnit(Record::numLive == 6);
+      assertUnit(tree.size() == 6);
+      assertUnit(tree.find(30) == tree.end());
+      tree.clear();
+   }  // teardown
+
+   void test_clear_freesCold()
+   {  // setup
+      int numLive = Record::numLive;
+      {
+         Tree tree;
+         setupStandardFixture(tree);
+         // exercise
+         tree.clear();
+         // verify
+         assertUnit(tree.empty());
+         assertUnit(Record::numLive == numLive);
+         setupStandardFixture(tree);
+      }
+      assertUnit(Record::numLive == numLive);
+   }  // teardown
+
+   /***************************************
+    * COPY AND MOVE
+    ***************************************/
+
+   // the copy has elements of its own
+   void test_copy_deep()
+   {  // setup
+      Tree tree;
+      setupStandardFixture(tree);
+      // exercise
+      Tree copy(tree);
+      // verify
+      assertUnit(keys(copy) == keys(tree));
+      assertUnit(Record::numLive == 14);
+      assertUnit(&*copy.find(40) != &*tree.find(40));
+      tree.clear();
+      assertUnit(copy.find(40)->value == 4);
+      copy.clear();
+   }  // teardown
+
+   // the elements stay where they were
+   void test_move_keepsCold()
+   {  // setup
+      Tree tree;
+      setupStandardFixture(tree);
+      const Record * pRecord = &*tree.find(40);
+      // exercise
+      Tree moved(std::move(tree));
+      // verify
+      assertUnit(moved.size() == 7);
+      assertUnit(tree.empty());
+      assertUnit(&*moved.find(40) == pRecord);
+      assertUnit(Record::numLive == 7);
+      moved.clear();
+   }  // teardown
+
+   /**************************************************************
+    * SETUP STANDARD FIXTURE
+    *    keys 10 through 70, each value its key over 10
+    *************************************************************/
+   void setupStandardFixture(Tree & tree)
+   {
+      for (int key : { 40, 20, 60, 10, 30, 50, 70 })
+         tree.insert(Record(key, key / 10));
+   }
+
+   // the keys in iteration order
+   std::vector<int> keys(const Tree & tree)
+   {
+      std::vector<int> v;
+      for (const Record & record : tree)
+         v.push_back(record.key);
+      return v;
+   }
+};
+
+int TestSplitBST::Record::numLive = 0;
+
+#endif // DEBUG
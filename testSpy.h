@@ -13,6 +13,9 @@
 #include "spy.h"        // class under test
 #include "unitTest.h"   // unit test baseclass
 
+#include <thread>       // for std::thread
+#include <vector>
+
 /***********************************************
  * TEST SPY
  * Unit tests for the Spy class
@@ -68,6 +71,11 @@ public:
       test_lessthan_same();
       test_lessthan_firstSmaller();
       test_lessthan_firstLarger();
+
+      // Counting
+      test_counters_threads();
+      test_delta_scoped();
+      test_delta_nested();
   
       report("Spy");
    }
@@ -733,6 +741,74 @@ public:
          delete sDes.p;
       sDes.p = sSrc.p = nullptr;
    }
+
+   /***************************************
+    * COUNTING
+    ***************************************/
+
+   // spies made on several threads at once are all counted
+   void test_counters_threads()
+   {  // setup
+      const int numThreads = 4;
+      const int numEach = 10000;
+      std::vector<std::thread> threads;
+      Spy::reset();
+      // exercise
+      for (int t = 0; t < numThreads; t++)
+         threads.emplace_back([]()
+         {
+            for (int i = 0; i < numEach; i++)
+            {
+               Spy s(i);
+               Spy copy(s);
+            }
+         });
+      for (std::thread & thread : threads)
+         thread.join();
+      // verify
+      assertUnit(Spy::numNondefault() == numThreads * numEach);
+      assertUnit(Spy::numCopy() == numThreads * numEach);
+      assertUnit(Spy::numAlloc() == 2 * numThreads * numEach);
+      assertUnit(Spy::numDelete() == 2 * numThreads * numEach);
+      assertUnit(Spy::numDestructor() == 2 * numThreads * numEach);
+   }  // teardown
+
+   // a delta counts only what happens after it is made
+   void test_delta_scoped()
+   {  // setup
+      Spy s1(1);
+      Spy s2(2);
+      bool less = (s1 < s2);
+      // exercise
+      Spy::Delta delta;
+      less = (s2 < s1) || less;
+      less = (s1 < s2) && less;
+      bool equal = (s1 == s2);
+      // verify
+      assertUnit(less == true && equal == false);
+      assertUnit(delta[LESSTHAN] == 2);
+      assertUnit(delta[EQUALS] == 1);
+      assertUnit(delta.counts()[ALLOC] == 0);
+   }  // teardown
+
+   // deltas and reset() do not disturb one another
+   void test_delta_nested()
+   {  // setup
+      Spy::reset();
+      Spy::Delta outer;
+      Spy s1(1);
+      // exercise
+      Spy::Delta inner;
+      Spy s2(2);
+      Spy::reset();
+      Spy s3(3);
+      // verify
+      assertUnit(outer[NONDEFAULT] == 3);
+      assertUnit(inner[NONDEFAULT] == 2);
+      assertUnit(Spy::numNondefault() == 1);
+      Spy::Snapshot difference = Spy::snapshot() - Spy::snapshot();
+      assertUnit(difference[ALLOC] == 0);
+   }  // teardown
 };
 
 #endif // DEBUG
@@ -0,0 +1,365 @@
+/***********************************************************************
+ * Header:
+ *    TEST STRING BST
+ * Summary:
+ *    Unit tests for the arena-backed string BST
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "stringBST.h"
+#include "unitTest.h"
+
+#include <string>
+#include <utility>    // for std::move
+#include <vector>
+
+/***********************************************
+ * TEST STRING BST
+ * Unit tests for the StringBST class
+ ***********************************************/
+class TestStringBST : public UnitTest
+{
+public:
+   static_assert(sizeof(custom::ArenaKey) == 16,
+                 "a key is its prefix, offset and length, with no pointer to the arena");
+
+   void run()
+   {
+      reset();
+
+      // Key
+      test_key_shortNoArena();
+      test_key_longTailInArena();
+      test_key_orderSharedPrefix();
+      test_key_orderEmbeddedNull();
+
+      // Common prefix
+      test_common_sharedPrefixInline();
+      test_common_shrinks();
+      test_common_lookupOutside();
+
+      // Tree
+      test_insert_ordered();
+      test_insert_keepUnique();
+      test_find_standard();
+      test_lowerBound_standard();
+      test_prefixRange_standard();
+      test_prefixRange_allOnes();
+      test_erase_releases();
+
+      // Copy and move
+      test_copy_ownArena();
+      test_move_keepsKeys();
+
+      // Compact
+      test_compact_dropsErased();
+      test_compact_sortsArena();
+
+      report("StringBST");
+   }
+
+   /***************************************
+    * KEY
+    ***************************************/
+
+   // eight bytes or fewer never touch the arena
+   void test_key_shortNoArena()
+   {  // setup
+      custom::StringBST tree;
+      // exercise
+      tree.insert("");
+      tree.insert("a");
+      tree.insert("abcdefgh");
+      // verify
+      assertUnit(tree.size() == 3);
+      assertUnit(tree.arenaSize() == 0);
+      assertUnit(toVector(tree) == std::vector<std::string>({ "", "a", "abcdefgh" }));
+   }  // teardown
+
+   // only the bytes past the window go in the arena
+   void test_key_longTailInArena()
+   {  // setup
+      custom::StringBST tree;
+      tree.insert("b");
+      // exercise
+      tree.insert("abcdefghijk");
+      // verify
+      assertUnit(tree.arenaSize() == 3);
+      assertUnit(tree.arenaLiveSize() == 3);
+      assertUnit(*tree.begin() == "abcdefghijk");
+      assertUnit((*tree.begin()).size() == 11);
+   }  // teardown
+
+   // keys that agree on the prefix are ordered by the arena bytes
+   void test_key_orderSharedPrefix()
+   {  // setup
+      custom::StringBST tree;
+      // exercise
+      for (const char * s : { "prefix__b", "prefix__", "prefix__ab", "prefix__a", "prefix_", "prefix__aa" })
+         tree.insert(s);
+      // verify
+      assertUnit(toVector(tree) == std::vector<std::string>(
+         { "prefix_", "prefix__", "prefix__a", "prefix__aa", "prefix__ab", "prefix__b" }));
+   }  // teardown
+
+   // keys that share a long prefix keep it once and the bytes after it
+   // inline, so these never reach the arena
+   void test_common_sharedPrefixInline()
+   {  // setup
+      custom::StringBST tree;
+      // exercise
+      for (const char * s : { "/srv/data/customers/42", "/srv/data/customers/7",
+                              "/srv/data/customers/1234567", "/srv/data/customers/" })
+         tree.insert(s);
+      // verify
+      assertUnit(tree.pArena->common == "/srv/data/customers/");
+      assertUnit(tree.arenaSize() == 0);
+      assertUnit(toVector(tree) == std::vector<std::string>({ "/srv/data/customers/",
+         "/srv/data/customers/1234567", "/srv/data/customers/42", "/srv/data/customers/7" }));
+      assertUnit(tree.find("/srv/data/customers/7") != tree.end());
+   }  // teardown
+
+   // a key that breaks the shared prefix shortens it, and the keys
+   // already in the tree move the bytes they lose into the arena
+   void test_common_shrinks()
+   {  // setup
+      custom::StringBST tree;
+      tree.insert("/srv/data/customers/42");
+      tree.insert("/srv/data/customers/7");
+      // exercise
+      tree.insert("/srv/logs");
+      // verify
+      assertUnit(tree.pArena->common == "/srv/");
+      assertUnit(tree.arenaSize() == 9 + 8);
+      assertUnit(tree.arenaLiveSize() == 9 + 8);
+      assertUnit(toVector(tree) == std::vector<std::string>({
+         "/srv/data/customers/42", "/srv/data/customers/7", "/srv/logs" }));
+      assertUnit(tree.find("/srv/data/customers/42") != tree.end());
+      assertUnit(tree.find("/srv/logs") != tree.end());
+   }  // teardown
+
+   // a string outside the shared prefix is before or after every key
+   void test_common_lookupOutside()
+   {  // setup
+      custom::StringBST tree;
+      tree.insert("/srv/data/customers/42");
+      tree.insert("/srv/data/customers/7");
+      // exercise and verify
+      assertUnit(tree.find("/srv/data") == tree.end());
+      assertUnit(tree.find("/tmp") == tree.end());
+      assertUnit(tree.lower_bound("/srv/data") == tree.begin());
+      assertUnit(tree.upper_bound("/srv") == tree.begin());
+      assertUnit(tree.lower_bound("/tmp") == tree.end());
+      assertUnit(tree.upper_bound("/tmp") == tree.end());
+      assertUnit(tree.prefix_range("/srv/").first == tree.begin());
+      assertUnit(tree.prefix_range("/srv/").second == tree.end());
+   }  // teardown
+
+   // zero padding does not confuse "ab" with "ab\0"
+   void test_key_orderEmbeddedNull()
+   {  // setup
+      custom::StringBST tree;
+      std::string withNull("ab\0", 3);
+      // exercise
+      tree.insert(withNull);
+      tree.insert("ab");
+      // verify
+      assertUnit(toVector(tree) == std::vector<std::string>({ "ab", withNull }));
+      assertUnit(tree.find("ab") != tree.end());
+      assertUnit(tree.find(withNull) != tree.end());
+      assertUnit(tree.find("ab") != tree.find(withNull));
+   }  // teardown
+
+   /***************************************
+    * TREE
+    ***************************************/
+
+   void test_insert_ordered()
+   {  // setup
+      custom::StringBST tree;
+      // exercise
+      setupStandardFixture(tree);
+      // verify
+      assertUnit(tree.size() == 7);
+      assertUnit(toVector(tree) == std::vector<std::string>({
+         "apple", "apricot orchard", "banana", "blackberry bramble",
+         "cherry", "cranberry sauce", "date" }));
+   }  // teardown
+
+   // a duplicate hands back the original and adds nothing to the arena
+   void test_insert_keepUnique()
+   {  // setup
+      custom::StringBST tree;
+      setupStandardFixture(tree);
+      size_t arenaSize = tree.arenaSize();
+      // exercise
+      auto pairReturn = tree.insert("cranberry sauce", true /* keepUnique */);
+      // verify
+      assertUnit(pairReturn.second == false);
+      assertUnit(pairReturn.first != tree.end());
+      assertUnit(tree.size() == 7);
+      assertUnit(tree.arenaSize() == arenaSize);
+   }  // teardown
+
+   void test_find_standard()
+   {  // setup
+      custom::StringBST tree;
+      setupStandardFixture(tree);
+      // exercise and verify
+      auto it = tree.find("blackberry bramble");
+      assertUnit(it != tree.end());
+      if (it != tree.end())
+         assertUnit(*it == "blackberry bramble");
+      assertUnit(tree.find("blackberry") == tree.end());
+      assertUnit(tree.find("blackberry brambles") == tree.end());
+   }  // teardown
+
+   void test_lowerBound_standard()
+   {  // setup
+      custom::StringBST tree;
+      setupStandardFixture(tree);
+      // exercise and verify
+      auto it = tree.lower_bound("apricot");
+      assertUnit(it != tree.end() && *it == "apricot orchard");
+      it = tree.upper_bound("cherry");
+      assertUnit(it != tree.end() && *it == "cranberry sauce");
+      it = tree.lower_bound("zucchini");
+      assertUnit(it == tree.end());
+   }  // teardown
+
+   void test_prefixRange_standard()
+   {  // setup
+      custom::StringBST tree;
+      setupStandardFixture(tree);
+      // exercise
+      auto range = tree.prefix_range("b");
+      auto none = tree.prefix_range("bz");
+      auto all = tree.prefix_range("");
+      // verify
+      assertUnit(range.first != tree.end() && *range.first == "banana");
+      assertUnit(range.second != tree.end() && *range.second == "cherry");
+      assertUnit(none.first == none.second);
+      assertUnit(all.first == tree.begin() && all.second == tree.end());
+   }  // teardown
+
+   // trailing 0xFF bytes cannot be bumped, so the end comes from the byte before
+   void test_prefixRange_allOnes()
+   {  // setup
+      custom::StringBST tree;
+      std::string ones("a\xff\xff", 3);
+      for (const std::string & s : { std::string("a\xfe"), ones, ones + "z", std::string("b") })
+         tree.insert(s);
+      // exercise
+      auto range = tree.prefix_range(ones);
+      // verify
+      assertUnit(range.first != tree.end() && *range.first == ones);
+      assertUnit(range.second != tree.end() && *range.second == "b");
+   }  // teardown
+
+   // erased bytes stay in the arena but no longer count as live
+   void test_erase_releases()
+   {  // setup
+      custom::StringBST tree;
+      setupStandardFixture(tree);
+      size_t arenaSize = tree.arenaSize();
+      auto it = tree.find("cranberry sauce");
+      // exercise
+      auto itNext = tree.erase(it);
+      // verify
+      assertUnit(itNext != tree.end() && *itNext == "date");
+      assertUnit(tree.size() == 6);
+      assertUnit(tree.arenaSize() == arenaSize);
+      assertUnit(tree.arenaLiveSize() == arenaSize - 7);
+   }  // teardown
+
+   /***************************************
+    * COPY AND MOVE
+    ***************************************/
+
+   // a copy reads its own arena, not the original's
+   void test_copy_ownArena()
+   {  // setup
+      custom::StringBST * pTree = new custom::StringBST;
+      setupStandardFixture(*pTree);
+      // exercise
+      custom::StringBST copy(*pTree);
+      delete pTree;
+      // verify
+      assertUnit(copy.size() == 7);
+      assertUnit(copy.find("blackberry bramble") != copy.end());
+      assertUnit(toVector(copy).back() == "date");
+      assertUnit(*copy.find("apricot orchard") == "apricot orchard");
+   }  // teardown
+
+   void test_move_keepsKeys()
+   {  // setup
+      custom::StringBST tree;
+      setupStandardFixture(tree);
+      // exercise
+      custom::StringBST moved(std::move(tree));
+      // verify
+      assertUnit(moved.size() == 7);
+      assertUnit(tree.size() == 0);
+      assertUnit(moved.find("cranberry sauce") != moved.end());
+   }  // teardown
+
+   /***************************************
+    * COMPACT
+    ***************************************/
+
+   void test_compact_dropsErased()
+   {  // setup
+      custom::StringBST tree;
+      setupStandardFixture(tree);
+      auto it = tree.find("blackberry bramble");
+      tree.erase(it);
+      size_t live = tree.arenaLiveSize();
+      // exercise
+      tree.compact();
+      // verify
+      assertUnit(tree.arenaSize() == live);
+      assertUnit(tree.arenaLiveSize() == live);
+      assertUnit(toVector(tree) == std::vector<std::string>({
+         "apple", "apricot orchard", "banana", "cherry", "cranberry sauce", "date" }));
+   }  // teardown
+
+   // afterwards the tails sit in key order
+   void test_compact_sortsArena()
+   {  // setup
+      custom::StringBST tree;
+      tree.insert("zzzzzzzz_3");
+      tree.insert("aaaaaaaa_1");
+      tree.insert("mmmmmmmm_2");
+      // exercise
+      tree.compact();
+      // verify
+      assertUnit(std::string(tree.pArena->bytes.begin(), tree.pArena->bytes.end()) == "_1_2_3");
+   }  // teardown
+
+   /**************************************************************
+    * SETUP STANDARD FIXTURE
+    *    short keys inline, long keys with tails in the arena
+    *************************************************************/
+   void setupStandardFixture(custom::StringBST & tree)
+   {
+      for (const char * s : { "cherry", "apricot orchard", "date", "apple",
+                              "cranberry sauce", "banana", "blackberry bramble" })
+         tree.insert(s);
+   }
+
+   // the keys in iteration order
+   std::vector<std::string> toVector(const custom::StringBST & tree)
+   {
+      std::vector<std::string> v;
+      for (auto it = tree.begin(); it != tree.end(); ++it)
+         v.push_back(*it);
+      return v;
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,175 @@
+/***********************************************************************
+ * Header:
+ *    TEST SYNTHETIC
+ * Summary:
+ *    Unit tests for the synthetic key types
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "synthetic.h"
+#include "bst.h"
+#include "unitTest.h"
+
+#include <algorithm>  // for std::sort
+#include <type_traits>// for std::is_trivially_copyable
+#include <utility>    // for std::move
+#include <vector>
+
+/***********************************************
+ * TEST SYNTHETIC
+ * Unit tests for the Synthetic class
+ ***********************************************/
+class TestSynthetic : public UnitTest
+{
+public:
+   typedef custom::Synthetic <8>                             Small;
+   typedef custom::Synthetic <64, 48, 3>                     Wide;
+   typedef custom::Synthetic <32, 8, 0, 0, 0, true>          Trivial;
+   typedef custom::Synthetic <16, 16, 0, 5, 2>               Costly;
+
+   static_assert(sizeof(Small) == 8 && sizeof(Wide) == 64 && sizeof(Trivial) == 32,
+                 "a synthetic key is as big as it says");
+   static_assert(std::is_trivially_copyable<Trivial>::value, "TRIVIAL keys can be memcpy'd");
+   static_assert(!std::is_trivially_copyable<Small>::value, "other keys count their copies");
+
+   void run()
+   {
+      reset();
+
+      // Value
+      test_value_roundTrip();
+      test_compare_ordersByValue();
+
+      // Counting
+      test_counters_compare();
+      test_counters_copy();
+      test_counters_trivial();
+
+      // In a tree
+      test_bst_sorted();
+
+      report("Synthetic");
+   }
+
+   /***************************************
+    * VALUE
+    ***************************************/
+
+   // whatever went in comes back out, however wide the key
+   void test_value_roundTrip()
+   {  // setup
+      std::vector<int64_t> values = { 0, 1, -1, 255, 256, -256, INT64_MAX, INT64_MIN };
+      // exercise and verify
+      for (int64_t value : values)
+      {
+         assertUnit(Small(value).value() == value);
+         assertUnit(Wide(value).value() == value);
+         assertUnit(Trivial(value).value() == value);
+         assertUnit(Costly(value).value() == value);
+      }
+      assertUnit(Wide().value() == 0);
+   }  // teardown
+
+   // memcmp over the bytes agrees with < on the values, negatives first
+   void test_compare_ordersByValue()
+   {  // setup
+      std::vector<int64_t> values = { 300, -5, 0, 7, -300, 256, 1, -1 };
+      std::vector<Wide> keys(values.begin(), values.end());
+      // exercise
+      std::sort(keys.begin(), keys.end());
+      std::sort(values.begin(), values.end());
+      // verify
+      for (size_t i = 0; i < keys.size(); i++)
+         assertUnit(keys[i].value() == values[i]);
+      assertUnit(Wide(3) == Wide(3));
+      assertUnit(!(Wide(3) == Wide(4)));
+      assertUnit(!(Wide(3) < Wide(3)));
+   }  // teardown
+
+   /***************************************
+    * COUNTING
+    ***************************************/
+
+   void test_counters_compare()
+   {  // setup
+      Small a(1);
+      Small b(2);
+      Spy::Delta delta;
+      // exercise
+      bool less = (a < b);
+      bool equal = (a == b);
+      // verify
+      assertUnit(less == true && equal == false);
+      assertUnit(delta[LESSTHAN] == 1);
+      assertUnit(delta[EQUALS] == 1);
+      assertUnit(delta[COPY] == 0);
+   }  // teardown
+
+   // copies and moves each count once, and then the destructors
+   void test_counters_copy()
+   {  // setup
+      Costly a(1);
+      Spy::Delta delta;
+      // exercise
+      {
+         Costly b(a);
+         Costly c(std::move(b));
+         c = a;
+         c = std::move(b);
+      }
+      // verify
+      assertUnit(delta[COPY] == 1);
+      assertUnit(delta[COPY_MOVE] == 1);
+      assertUnit(delta[ASSIGN] == 1);
+      assertUnit(delta[ASSIGN_MOVE] == 1);
+      assertUnit(delta[DESTRUCTOR] == 2);
+      assertUnit(delta[NONDEFAULT] == 0);
+   }  // teardown
+
+   // a trivial key's copies go uncounted, but its comparisons do not
+   void test_counters_trivial()
+   {  // setup
+      Trivial a(1);
+      Spy::Delta delta;
+      // exercise
+      Trivial b(a);
+      Trivial c = b;
+      bool less = (c < a);
+      // verify
+      assertUnit(less == false && c.value() == 1);
+      assertUnit(delta[COPY] == 0 && delta[ASSIGN] == 0 && delta[DESTRUCTOR] == 0);
+      assertUnit(delta[LESSTHAN] == 1);
+   }  // teardown
+
+   /***************************************
+    * IN A TREE
+    ***************************************/
+
+   // a BST of synthetic keys is as ordered as one of ints, and the
+   // comparisons it made are counted: at least one per insert after the
+   // first, and no more than the red-black height of 2 log(n + 1) each
+   void test_bst_sorted()
+   {  // setup
+      custom::BST<Wide> bst;
+      Spy::Delta delta;
+      // exercise
+      for (int i = 0; i < 100; i++)
+         bst.insert(Wide((i * 37) % 100 - 50));
+      // verify
+      int64_t expected = -50;
+      bool sorted = true;
+      for (auto it = bst.begin(); it != bst.end(); ++it)
+         sorted = sorted && (*it).value() == expected++;
+      assertUnit(sorted);
+      assertUnit(expected == 50);
+      assertUnit(delta[LESSTHAN] >= 99);
+      assertUnit(delta[LESSTHAN] <= 100 * 14);
+   }  // teardown
+};
+
+#endif // DEBUG
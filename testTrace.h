@@ -0,0 +1,251 @@
+/***********************************************************************
+ * Header:
+ *    TEST TRACE
+ * Summary:
+ *    Unit tests for the trace-event buffers and the events BST records
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "bst.h"
+#include "trace.h"
+#include "unitTest.h"
+
+#include <cstdio>     // for std::remove and std::FILE
+#include <cstring>    // for strcmp
+#include <string>
+#include <thread>     // for std::thread
+#include <vector>
+
+/***********************************************
+ * TEST TRACE
+ * Unit tests for the Trace class
+ ***********************************************/
+class TestTrace : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Buffer
+      test_instant_recorded();
+      test_scope_span();
+      test_ring_keepsNewest();
+      test_threads_separate();
+      test_dump_json();
+
+#ifdef TRACE
+      // Tree
+      test_bst_insertCases();
+      test_bst_case3();
+      test_bst_case4c();
+      test_bst_iterate();
+#endif // TRACE
+
+      custom::Trace::clear();
+      report("Trace");
+   }
+
+   typedef custom::Trace Trace;
+
+   const char * PATH = "testTrace.json";
+
+   /***************************************
+    * BUFFER
+    ***************************************/
+
+   void test_instant_recorded()
+   {  // setup
+      Trace::clear();
+      // exercise
+      Trace::instant("mark");
+      // verify
+      std::vector<Trace::Event> events = Trace::events();
+      assertUnit(events.size() == 1);
+      assertUnit(std::strcmp(events[0].name, "mark") == 0);
+      assertUnit(events[0].phase == 'i');
+      assertUnit(events[0].duration == 0);
+   }  // teardown
+
+   // a span is recorded when it ends and covers what happened inside it
+   void test_scope_span()
+   {  // setup
+      Trace::clear();
+      // exercise
+      {
+         Trace::Scope scope("outer");
+         Trace::instant("inner");
+      }
+      // verify
+      std::vector<Trace::Event> events = Trace::events();
+      assertUnit(events.size() == 2);
+      assertUnit(std::strcmp(events[1].name, "outer") == 0);
+      assertUnit(events[1].phase == 'X');
+      assertUnit(events[1].start <= events[0].start);
+      assertUnit(events[0].start <= events[1].start + events[1].duration);
+   }  // teardown
+
+   // a full ring drops the oldest events first
+   void test_ring_keepsNewest()
+   {  // setup
+      Trace::clear();
+      for (int i = 0; i < 10; i++)
+         Trace::instant("old");
+      // exercise
+      for (size_t i = 0; i < Trace::CAPACITY - 1; i++)
+         Trace::instant("new");
+      Trace::instant("last");
+      // verify
+      std::vector<Trace::Event> events = Trace::events();
+      assertUnit(events.size() == Trace::CAPACITY);
+      assertUnit(std::strcmp(events.front().name, "new") == 0);
+      assertUnit(std::strcmp(events.back().name, "last") == 0);
+      for (size_t i = 1; i < events.size(); i++)
+         assertUnit(events[i - 1].start <= events[i].start);
+   }  // teardown
+
+   // another thread's events go in its own buffer, which outlives it
+   void test_threads_separate()
+   {  // setup
+      Trace::clear();
+      Trace::instant("main");
+      size_t numOther = 0;
+      // exercise
+      std::thread other([&numOther]()
+         {
+            Trace::instant("other");
+            Trace::instant("other");
+            numOther = Trace::events().size();
+         });
+      other.join();
+      // verify
+      assertUnit(numOther == 2);
+      assertUnit(Trace::events().size() == 1);
+      size_t numEvents = 0;
+      for (const auto & pBuffer : Trace::registry().buffers)
+         numEvents += pBuffer->events().size();
+      assertUnit(numEvents == 3);
+   }  // teardown
+
+   void test_dump_json()
+   {  // setup
+      Trace::clear();
+      {
+         Trace::Scope scope("span");
+      }
+      Trace::instant("say \"hi\"");
+      // exercise
+      bool isDumped = Trace::dump(PATH);
+      // verify
+      std::string json = readFile(PATH);
+      assertUnit(isDumped);
+      assertUnit(json.find("{\"traceEvents\":[") == 0);
+      assertUnit(json.find("{\"name\":\"span\",\"cat\":\"bst\",\"ph\":\"X\",\"ts\":") != std::string::npos);
+      assertUnit(json.find(",\"dur\":") != std::string::npos);
+      assertUnit(json.find("{\"name\":\"say \\\"hi\\\"\",\"cat\":\"bst\",\"ph\":\"i\",\"ts\":") != std::string::npos);
+      assertUnit(json.find(",\"s\":\"t\",\"pid\":1,\"tid\":") != std::string::npos);
+      std::string end = "}\n],\"displayTimeUnit\":\"ns\"}\n";
+      assertUnit(json.size() > end.size() && json.compare(json.size() - end.size(), end.size(), end) == 0);
+      std::remove(PATH);
+   }  // teardown
+
+#ifdef TRACE
+   /***************************************
+    * TREE
+    ***************************************/
+
+   // ascending keys: a root, a black parent, then a single rotation
+   // with mom on granny's right
+   void test_bst_insertCases()
+   {  // setup
+      custom::BST <int> bst;
+      Trace::clear();
+      // exercise
+      bst.insert(1);
+      bst.insert(2);
+      bst.insert(3);
+      // verify
+      assertUnit(names() == std::vector<std::string>({
+         "allocate", "insert",
+         "allocate", "balance 2", "insert",
+         "allocate", "balance 4b", "rotate", "insert" }));
+   }  // teardown
+
+   // a red aunt recolors, and the recolor goes on up to the root
+   void test_bst_case3()
+   {  // setup
+      custom::BST <int> bst;
+      bst.insert(2);
+      bst.insert(1);
+      bst.insert(3);
+      Trace::clear();
+      // exercise
+      bst.insert(4);
+      // verify
+      assertUnit(names() == std::vector<std::string>({
+         "allocate", "balance 3", "balance 1", "insert" }));
+   }  // teardown
+
+   // a zig-zag rotates twice, with mom on granny's left
+   void test_bst_case4c()
+   {  // setup
+      custom::BST <int> bst;
+      bst.insert(3);
+      bst.insert(1);
+      Trace::clear();
+      // exercise
+      bst.insert(2);
+      // verify
+      assertUnit(names() == std::vector<std::string>({
+         "allocate", "balance 4c", "rotate", "rotate", "insert" }));
+   }  // teardown
+
+   // one step per ++, and a find and erase each span their work
+   void test_bst_iterate()
+   {  // setup
+      custom::BST <int> bst;
+      for (int i : { 20, 10, 30 })
+         bst.insert(i);
+      Trace::clear();
+      // exercise
+      for (auto it = bst.begin(); it != bst.end(); ++it)
+         ;
+      auto it = bst.find(10);
+      bst.erase(it);
+      // verify
+      assertUnit(names() == std::vector<std::string>({
+         "iterator ++", "iterator ++", "iterator ++",
+         "find", "iterator ++", "free", "erase" }));
+   }  // teardown
+#endif // TRACE
+
+private:
+   // this thread's event names, oldest first
+   static std::vector<std::string> names()
+   {
+      std::vector<std::string> v;
+      for (const Trace::Event & event : Trace::events())
+         v.push_back(event.name);
+      return v;
+   }
+
+   static std::string readFile(const char * path)
+   {
+      std::string contents;
+      std::FILE * pFile = std::fopen(path, "rb");
+      if (pFile == nullptr)
+         return contents;
+      int c;
+      while ((c = std::fgetc(pFile)) != EOF)
+         contents.push_back((char)c);
+      std::fclose(pFile);
+      return contents;
+   }
+};
+
+#endif // DEBUG
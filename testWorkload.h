@@ -0,0 +1,322 @@
+/***********************************************************************
+ * Header:
+ *    TEST WORKLOAD
+ * Summary:
+ *    Unit tests for the workload generators
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#ifdef DEBUG
+
+#include "workload.h"
+#include "bst.h"
+#include "unitTest.h"
+
+#include <algorithm>  // for std::sort and std::count
+#include <set>
+#include <vector>
+
+/***********************************************
+ * TEST WORKLOAD
+ * Unit tests for the Workload class
+ ***********************************************/
+class TestWorkload : public UnitTest
+{
+public:
+   void run()
+   {
+      reset();
+
+      // Seed
+      test_seed_sameSeedSameKeys();
+      test_seed_differentSeedDifferentKeys();
+      test_seed_pinned();
+      test_seed_pinnedZipfian();
+
+      // Keys
+      test_uniform_range();
+      test_zipfian_skewed();
+      test_sequential_standard();
+      test_reverse_standard();
+      test_clustered_nearCenters();
+      test_sawtooth_teeth();
+      test_shuffled_permutation();
+
+      // Operations
+      test_mix_erasesArePresent();
+      test_deleteHeavy_shrinks();
+      test_marketReplay_wellFormed();
+
+      // Adversarial
+      test_recolorCascades_beatUniform();
+      test_rotations_beatUniform();
+      test_eraseChurn_erasesArePresent();
+
+      report("Workload");
+   }
+
+   /***************************************
+    * SEED
+    ***************************************/
+
+   void test_seed_sameSeedSameKeys()
+   {  // setup
+      Workload a(17);
+      Workload b(17);
+      // exercise and verify
+      assertUnit(a.uniform(100, 1000) == b.uniform(100, 1000));
+      assertUnit(a.zipfian(100, 1000) == b.zipfian(100, 1000));
+      assertUnit(a.recolorCascades(100) == b.recolorCascades(100));
+   }  // teardown
+
+   void test_seed_differentSeedDifferentKeys()
+   {  // setup
+      Workload a(17);
+      Workload b(18);
+      // exercise and verify
+      assertUnit(a.uniform(100, 1000) != b.uniform(100, 1000));
+   }  // teardown
+
+   // the keys do not depend on the standard library
+   void test_seed_pinned()
+   {  // setup
+      Workload workload(1);
+      // exercise
+      std::vector<int> keys = workload.uniform(4, 1000);
+      // verify
+      assertUnit(keys == std::vector<int>({ 528, 462, 930, 246 }));
+   }  // teardown
+
+   // nor do the Zipfian ones depend on the math library
+   void test_seed_pinnedZipfian()
+   {  // setup
+      Workload workload(1);
+      // exercise
+      std::vector<int> keys = workload.zipfian(4, 1000);
+      // verify
+      assertUnit(keys == std::vector<int>({ 11, 29, 0, 557 }));
+   }  // teardown
+
+   /***************************************
+    * KEYS
+    ***************************************/
+
+   void test_uniform_range()
+   {  // setup
+      Workload workload(1);
+      // exercise
+      std::vector<int> keys = workload.uniform(1000, 10);
+      // verify
+      bool inRange = true;
+      for (int key : keys)
+         inRange = inRange && key >= 0 && key < 10;
+      assertUnit(inRange);
+      for (int key = 0; key < 10; key++)
+         assertUnit(std::count(keys.begin(), keys.end(), key) > 50);
+   }  // teardown
+
+   // the smallest keys are drawn the most
+   void test_zipfian_skewed()
+   {  // setup
+      Workload workload(1);
+      // exercise
+      std::vector<int> keys = workload.zipfian(10000, 1000);
+      // verify
+      bool inRange = true;
+      for (int key : keys)
+         inRange = inRange && key >= 0 && key < 1000;
+      assertUnit(inRange);
+      long count0   = std::count(keys.begin(), keys.end(), 0);
+      long count1   = std::count(keys.begin(), keys.end(), 1);
+      long count100 = std::count(keys.begin(), keys.end(), 100);
+      assertUnit(count0 > count1);
+      assertUnit(count1 > count100);
+      assertUnit(count0 > 10000 / 20);
+      // 1 / 2^0.99 of the draws of 0, give or take the luck of the draw
+      assertUnit(count1 * 100 > count0 * 45 && count1 * 100 < count0 * 55);
+   }  // teardown
+
+   void test_sequential_standard()
+   {  // setup
+      Workload workload(1);
+      // exercise and verify
+      assertUnit(workload.sequential(4, 10) == std::vector<int>({ 10, 11, 12, 13 }));
+   }  // teardown
+
+   void test_reverse_standard()
+   {  // setup
+      Workload workload(1);
+      // exercise and verify
+      assertUnit(workload.reverse(4, 10) == std::vector<int>({ 13, 12, 11, 10 }));
+   }  // teardown
+
+   void test_clustered_nearCenters()
+   {  // setup
+      Workload workload(1);
+      // exercise
+      std::vector<int> keys = workload.clustered(1000, 1000000, 4, 10);
+      // verify
+      std::set<int> distinct(keys.begin(), keys.end());
+      assertUnit(distinct.size() <= 4 * 21);
+      assertUnit(distinct.size() > 4);
+   }  // teardown
+
+   void test_sawtooth_teeth()
+   {  // setup
+      Workload workload(1);
+      // exercise
+      std::vector<int> keys = workload.sawtooth(9, 3);
+      // verify
+      assertUnit(keys == std::vector<int>({ 0, 3, 6, 1, 4, 7, 2, 5, 8 }));
+   }  // teardown
+
+   void test_shuffled_permutation()
+   {  // setup
+      Workload workload(1);
+      // exercise
+      std::vector<int> keys = workload.shuffled(100);
+      // verify
+      assertUnit(keys != workload.sequential(100));
+      std::sort(keys.begin(), keys.end());
+      assertUnit(keys == workload.sequential(100));
+   }  // teardown
+
+   /***************************************
+    * OPERATIONS
+    ***************************************/
+
+   // every erase names a key an earlier insert put there
+   void test_mix_erasesArePresent()
+   {  // setup
+      Workload workload(1);
+      std::vector<Workload::Operation> ops = workload.mix(1000, 100, 0.3, 0.2);
+      std::multiset<int> model;
+      // exercise
+      size_t numErase = 0;
+      size_t numFind = 0;
+      bool present = true;
+      for (const Workload::Operation & op : ops)
+         if (op.type == Workload::Operation::INSERT)
+            model.insert(op.key);
+         else
+         {
+            present = present && model.count(op.key) > 0;
+            if (op.type == Workload::Operation::ERASE)
+            {
+               numErase++;
+               if (model.count(op.key))
+                  model.erase(model.find(op.key));
+            }
+            else
+               numFind++;
+         }
+      // verify
+      assertUnit(present);
+      assertUnit(numErase > 200 && numErase < 400);
+      assertUnit(numFind > 100 && numFind < 300);
+   }  // teardown
+
+   void test_deleteHeavy_shrinks()
+   {  // setup
+      Workload workload(1);
+      std::vector<Workload::Operation> ops = workload.deleteHeavy(1000, 1000000);
+      custom::BST<int> bst;
+      // exercise
+      size_t hits = Workload::apply(bst, ops);
+      // verify
+      assertUnit(bst.size() < 1000);
+      assertUnit(bst.size() == 2000 - 2 * hits);
+   }  // teardown
+
+   /***************************************
+    * ADVERSARIAL
+    ***************************************/
+
+   // more case 3 work than the same number of random inserts
+   void test_recolorCascades_beatUniform()
+   {  // setup
+      Workload workload(1);
+      // exercise
+      int adversarial = countFixUps(workload.recolorCascades(2000)).recolors;
+      int random      = countFixUps(workload.shuffled(2000)).recolors;
+      // verify
+      assertUnit(adversarial > random * 3 / 2);
+   }  // teardown
+
+   // more case 4 rotations than the same number of random inserts
+   void test_rotations_beatUniform()
+   {  // setup
+      Workload workload(1);
+      // exercise
+      int adversarial = countFixUps(workload.rotations(2000)).rotates;
+      int random      = countFixUps(workload.shuffled(2000)).rotates;
+      // verify
+      assertUnit(adversarial > random * 3 / 2);
+   }  // teardown
+
+   // every erase names a key that is in the tree at the time
+   void test_eraseChurn_erasesArePresent()
+   {  // setup
+      Workload workload(1);
+      std::vector<Workload::Operation> ops = workload.eraseChurn(500);
+      custom::BST<int> bst;
+      // exercise
+      size_t hits = Workload::apply(bst, ops);
+      // verify
+      assertUnit(hits == 500);
+      assertUnit(bst.size() == 500);
+   }  // teardown
+
+   // cancels name an earlier limit order, and limit orders rest on
+   // their own side of the mid
+   void test_marketReplay_wellFormed()
+   {  // setup
+      Workload workload(3);
+      // exercise
+      std::vector<Workload::MarketEvent> events = workload.marketReplay(5000, 1000);
+      // verify
+      size_t numLimits = 0;
+      size_t numCancels = 0;
+      for (const Workload::MarketEvent & event : events)
+         if (event.type == Workload::MarketEvent::LIMIT)
+         {
+            assertUnit(event.quantity >= 1 && event.quantity <= 100);
+            assertUnit(event.price > 500 && event.price < 1500);
+            numLimits++;
+         }
+         else if (event.type == Workload::MarketEvent::CANCEL)
+         {
+            assertUnit(event.order < numLimits);
+            numCancels++;
+         }
+         else
+            assertUnit(event.quantity >= 1 && event.quantity <= 200);
+      assertUnit(numLimits > 2300 && numLimits < 2700);
+      assertUnit(numCancels > 1500 && numCancels < 2000);
+   }  // teardown
+
+   // total the predicted fix-up work of inserting keys in order
+   struct Totals
+   {
+      int recolors;
+      int rotates;
+   };
+   Totals countFixUps(const std::vector<int> & keys)
+   {
+      Totals totals = { 0, 0 };
+      custom::BST<int> bst;
+      for (int key : keys)
+      {
+         Workload::FixUp fixUp = Workload::predictFixUp(bst, key);
+         totals.recolors += fixUp.recolors;
+         totals.rotates += fixUp.rotates ? 1 : 0;
+         bst.insert(key);
+      }
+      return totals;
+   }
+};
+
+#endif // DEBUG
@@ -0,0 +1,247 @@
+/***********************************************************************
+ * Header:
+ *    TRACE
+ * Summary:
+ *    Timestamped events from inside the tree, written out as Chrome
+ *    trace-event JSON for chrome://tracing or Perfetto to draw. Build
+ *    with TRACE defined and every trace(x) in bst.h records: a span for
+ *    each insert, upsert, find, bound and erase, and a mark for each
+ *    balance() case, rotation, node allocation and iterator step, so
+ *    a fix-up cascade shows up as a row of marks under its insert.
+ *    Without TRACE, trace(x) is nothing, as debug(x) is without DEBUG.
+ *
+ *    Each thread records into a ring buffer of its own, without locking,
+ *    and keeps only its last CAPACITY events. The buffers outlive their
+ *    threads so that dump() sees what finished threads did. dump() and
+ *    clear() read and reset the buffers of other threads, so call them
+ *    while the threads being traced are not recording.
+ *
+ *    This will contain the class definition of:
+ *        Trace              : The per-thread event buffers
+ *        Trace::Scope       : Record a span from construction to destruction
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#ifdef TRACE
+#define trace(x) x
+#else // !TRACE
+#define trace(x)
+#endif // !TRACE
+
+#include <chrono>     // for std::chrono::steady_clock
+#include <cstdint>    // for uint64_t
+#include <cstdio>     // for std::FILE
+#include <memory>     // for std::unique_ptr
+#include <mutex>      // for std::mutex and std::lock_guard
+#include <vector>
+
+class TestTrace;  // forward declaration for unit tests
+
+namespace custom
+{
+
+/*****************************************************************
+ * TRACE
+ * Static functions to record events on this thread and write out
+ * every thread's. Names are not copied, so they must outlive the
+ * dump: string literals, in practice.
+ *****************************************************************/
+class Trace
+{
+   friend class ::TestTrace; // give unit tests access to the privates
+public:
+   static const size_t CAPACITY = 1 << 16;   // events kept per thread
+
+   struct Event
+   {
+      const char * name;
+      uint64_t start;      // nanoseconds since the first event
+      uint64_t duration;   // nanoseconds, for a span
+      char phase;          // 'X' for a span, 'i' for a mark
+   };
+
+   // a mark: something that happened at one moment
+   static void instant(const char * name)
+   {
+      buffer().record(Event{ name, now(), 0, 'i' });
+   }
+
+   // a span: something that started at start and has just ended
+   static void complete(const char * name, uint64_t start)
+   {
+      buffer().record(Event{ name, start, now() - start, 'X' });
+   }
+
+   class Scope;
+
+   // this thread's events, oldest first
+   static std::vector<Event> events() { return buffer().events(); }
+
+   static bool dump(const char * path);
+   static void clear();
+
+   // nanoseconds since the first call
+   static uint64_t now()
+   {
+      static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+      return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now() - epoch).count();
+   }
+
+private:
+   /*****************************************************************
+    * BUFFER
+    * One thread's last CAPACITY events. Only that thread records.
+    *****************************************************************/
+   class Buffer
+   {
+   public:
+      Buffer(unsigned int tid) : ring(CAPACITY), next(0), count(0), tid(tid) {}
+
+      void record(const Event & event)
+      {
+         ring[next] = event;
+         next = (next + 1) % CAPACITY;
+         if (count < CAPACITY)
+            count++;
+      }
+
+      std::vector<Event> events() const
+      {
+         std::vector<Event> v;
+         v.reserve(count);
+         for (size_t i = 0; i < count; i++)
+            v.push_back(ring[(next + CAPACITY - count + i) % CAPACITY]);
+         return v;
+      }
+
+      void clear() { next = count = 0; }
+
+      unsigned int threadId() const { return tid; }
+
+   private:
+      std::vector<Event> ring;
+      size_t next;          // where the next event goes
+      size_t count;         // how many of ring are events
+      unsigned int tid;     // 1 for the first thread to record, and so on
+   };
+
+   // every thread's buffer, in the order the threads first recorded
+   struct Registry
+   {
+      std::mutex mutex;
+      std::vector<std::unique_ptr<Buffer>> buffers;
+   };
+
+   static Registry & registry()
+   {
+      static Registry theRegistry;
+      return theRegistry;
+   }
+
+   // this thread's buffer, registered the first time it is asked for
+   static Buffer & buffer()
+   {
+      thread_local Buffer * pBuffer = nullptr;
+      if (pBuffer == nullptr)
+      {
+         Registry & reg = registry();
+         std::lock_guard<std::mutex> lock(reg.mutex);
+         reg.buffers.emplace_back(new Buffer((unsigned int)reg.buffers.size() + 1));
+         pBuffer = reg.buffers.back().get();
+      }
+      return *pBuffer;
+   }
+
+   static void writeString(std::FILE * pFile, const char * s);
+};
+
+/*****************************************************************
+ * TRACE SCOPE
+ * A span named name, from here to the end of the enclosing block
+ *****************************************************************/
+class Trace :: Scope
+{
+public:
+   explicit Scope(const char * name) : name(name), start(Trace::now()) {}
+   Scope(const Scope &) = delete;
+   Scope & operator = (const Scope &) = delete;
+   ~Scope() { Trace::complete(name, start); }
+
+private:
+   const char * name;
+   uint64_t start;
+};
+
+/*********************************************
+ * TRACE :: DUMP
+ * Write every thread's events to path as a JSON object with a
+ * traceEvents array. Times are in microseconds, as the format wants.
+ ********************************************/
+inline bool Trace :: dump(const char * path)
+{
+   std::FILE * pFile = std::fopen(path, "w");
+   if (pFile == nullptr)
+      return false;
+
+   Registry & reg = registry();
+   std::lock_guard<std::mutex> lock(reg.mutex);
+   std::fputs("{\"traceEvents\":[", pFile);
+   bool isFirst = true;
+   for (const std::unique_ptr<Buffer> & pBuffer : reg.buffers)
+      for (const Event & event : pBuffer->events())
+      {
+         std::fputs(isFirst ? "\n" : ",\n", pFile);
+         isFirst = false;
+         std::fputs("{\"name\":", pFile);
+         writeString(pFile, event.name);
+         std::fprintf(pFile, ",\"cat\":\"bst\",\"ph\":\"%c\",\"ts\":%llu.%03u",
+                      event.phase,
+                      (unsigned long long)(event.start / 1000), (unsigned int)(event.start % 1000));
+         if (event.phase == 'X')
+            std::fprintf(pFile, ",\"dur\":%llu.%03u",
+                         (unsigned long long)(event.duration / 1000), (unsigned int)(event.duration % 1000));
+         else
+            std::fputs(",\"s\":\"t\"", pFile);
+         std::fprintf(pFile, ",\"pid\":1,\"tid\":%u}", pBuffer->threadId());
+      }
+   std::fputs("\n],\"displayTimeUnit\":\"ns\"}\n", pFile);
+   return std::fclose(pFile) == 0;
+}
+
+/*********************************************
+ * TRACE :: CLEAR
+ * Forget every thread's events
+ ********************************************/
+inline void Trace :: clear()
+{
+   Registry & reg = registry();
+   std::lock_guard<std::mutex> lock(reg.mutex);
+   for (const std::unique_ptr<Buffer> & pBuffer : reg.buffers)
+      pBuffer->clear();
+}
+
+/*********************************************
+ * TRACE :: WRITE STRING
+ * A JSON string, escaping what must be escaped
+ ********************************************/
+inline void Trace :: writeString(std::FILE * pFile, const char * s)
+{
+   std::fputc('"', pFile);
+   for (; *s != '\0'; s++)
+   {
+      unsigned char c = (unsigned char)*s;
+      if (c == '"' || c == '\\')
+         std::fprintf(pFile, "\\%c", c);
+      else if (c < 0x20)
+         std::fprintf(pFile, "\\u%04x", c);
+      else
+         std::fputc(c, pFile);
+   }
+   std::fputc('"', pFile);
+}
+
+} // namespace custom
@@ -0,0 +1,540 @@
+/***********************************************************************
+ * Header:
+ *    WORKLOAD
+ * Summary:
+ *    Key sequences and operation mixes shared by the unit tests and the
+ *    benchmarks. Every generator draws from one std::mt19937_64 seeded by
+ *    the caller and maps the raw 64-bit values to keys itself, never
+ *    through std::uniform_int_distribution or std::shuffle, whose output
+ *    differs between standard libraries, and without the libm functions
+ *    such as std::pow, which round differently from one to the next. The
+ *    same seed therefore gives the same keys on every compiler, and so
+ *    the same benchmark.
+ *
+ *        uniform, zipfian, sequential, reverse, clustered, sawtooth,
+ *        shuffled                    : keys to insert or look up
+ *        mix, deleteHeavy            : insert / erase / find operations
+ *        recolorCascades, rotations  : inserts chosen to make BST's
+ *                                      balance() work as hard as it can
+ *        eraseChurn                  : erase the root then insert, over
+ *                                      and over, which is what found the
+ *                                      crash when erase() skips rebalancing
+ *        marketReplay                : limit orders, cancels and market
+ *                                      orders around a wandering price
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include "bst.h"
+
+#include <algorithm>  // for std::upper_bound
+#include <cstddef>    // for size_t
+#include <cstdint>    // for uint64_t
+#include <random>     // for std::mt19937_64
+#include <utility>    // for std::swap
+#include <vector>
+
+/*************************************************************
+ * WORKLOAD
+ * A seedable source of keys and operations
+ *************************************************************/
+class Workload
+{
+public:
+   // one step of a mixed workload
+   struct Operation
+   {
+      enum Type { INSERT, ERASE, FIND };
+      Type type;
+      int key;
+   };
+
+   // one step of a synthetic market-data replay
+   struct MarketEvent
+   {
+      enum Type { LIMIT, CANCEL, MARKET };
+      Type type;
+      bool isBid;
+      int price;        // in ticks: the limit, or for MARKET the worst it takes
+      int quantity;
+      size_t order;     // for CANCEL, which LIMIT, counting from 0
+   };
+
+   // what balance() will do when a key is inserted
+   struct FixUp
+   {
+      int recolors;           // case 3 steps up the tree
+      bool rotates;           // ends with a case 4 rotation
+   };
+
+   explicit Workload(uint64_t seed) : engine(seed) {}
+
+   //
+   // Keys
+   //
+
+   // n keys drawn evenly from [0, range)
+   std::vector<int> uniform(size_t n, int range)
+   {
+      std::vector<int> keys(n);
+      for (size_t i = 0; i < n; i++)
+         keys[i] = (int)below((uint64_t)range);
+      return keys;
+   }
+
+   // n keys from [0, range) where key k is drawn in proportion to
+   // 1 / (k + 1)^theta, so 0 is the hottest. The weights are worked out
+   // in fixed point, theta to 1/65536, since std::pow rounds differently
+   // from one libm to the next and would move the keys with it.
+   std::vector<int> zipfian(size_t n, int range, double theta = 0.99)
+   {
+      // cumulative weights, each a 31-bit fraction, so a draw below the
+      // total lands on key k with the chance the weight of k gives it
+      uint64_t thetaFixed = (uint64_t)(theta * 65536.0 + 0.5);
+      std::vector<uint64_t> cumulative((size_t)range);
+      uint64_t total = 0;
+      for (int k = 0; k < range; k++)
+      {
+         uint64_t exponent = (thetaFixed * log2Fixed((uint64_t)k + 1)) >> 16;
+         total += exp2NegativeFixed(exponent);
+         cumulative[k] = total;
+      }
+
+      std::vector<int> keys(n);
+      for (size_t i = 0; i < n; i++)
+      {
+         uint64_t draw = below(total);
+         keys[i] = (int)(std::upper_bound(cumulative.begin(), cumulative.end(), draw) -
+                         cumulative.begin());
+      }
+      return keys;
+   }
+
+   // start, start + 1, ... start + n - 1
+   std::vector<int> sequential(size_t n, int start = 0)
+   {
+      std::vector<int> keys(n);
+      for (size_t i = 0; i < n; i++)
+         keys[i] = start + (int)i;
+      return keys;
+   }
+
+   // start + n - 1, ... start + 1, start
+   std::vector<int> reverse(size_t n, int start = 0)
+   {
+      std::vector<int> keys(n);
+      for (size_t i = 0; i < n; i++)
+         keys[i] = start + (int)(n - 1 - i);
+      return keys;
+   }
+
+   // n keys in [0, range) bunched around numClusters random centers,
+   // each no more than spread away from its center
+   std::vector<int> clustered(size_t n, int range, int numClusters, int spread)
+   {
+      std::vector<int> centers = uniform((size_t)numClusters, range);
+      std::vector<int> keys(n);
+      for (size_t i = 0; i < n; i++)
+      {
+         // the sum of two uniform offsets leans toward the center
+         int center = centers[below((uint64_t)numClusters)];
+         int offset = (int)below((uint64_t)spread + 1) + (int)below((uint64_t)spread + 1) - spread;
+         int key = center + offset;
+         keys[i] = (key < 0 ? 0 : (key >= range ? range - 1 : key));
+      }
+      return keys;
+   }
+
+   // numTeeth ascending runs, each starting just above where the last one
+   // started: 0 t 2t ... 1 t+1 2t+1 ... All n keys are distinct.
+   std::vector<int> sawtooth(size_t n, size_t numTeeth)
+   {
+      size_t toothLength = (n + numTeeth - 1) / numTeeth;
+      std::vector<int> keys(n);
+      for (size_t i = 0; i < n; i++)
+         keys[i] = (int)((i % toothLength) * numTeeth + i / toothLength);
+      return keys;
+   }
+
+   // 0 ... n - 1 in a random order
+   std::vector<int> shuffled(size_t n)
+   {
+      std::vector<int> keys = sequential(n);
+      for (size_t i = n; i > 1; i--)
+         std::swap(keys[i - 1], keys[below(i)]);
+      return keys;
+   }
+
+   //
+   // Operations
+   //
+
+   // n operations on keys in [0, range): eraseFraction of them erase a
+   // key that is present, findFraction look one up, the rest insert.
+   // An erase or find with nothing present inserts instead.
+   std::vector<Operation> mix(size_t n, int range, double eraseFraction, double findFraction)
+   {
+      std::vector<Operation> ops;
+      std::vector<int> present;
+      ops.reserve(n);
+      for (size_t i = 0; i < n; i++)
+      {
+         double u = unit();
+         Operation op;
+         if (present.empty() || u >= eraseFraction + findFraction)
+         {
+            op.type = Operation::INSERT;
+            op.key = (int)below((uint64_t)range);
+            present.push_back(op.key);
+         }
+         else
+         {
+            size_t index = below(present.size());
+            op.key = present[index];
+            if (u < eraseFraction)
+            {
+               op.type = Operation::ERASE;
+               present[index] = present.back();
+               present.pop_back();
+            }
+            else
+               op.type = Operation::FIND;
+         }
+         ops.push_back(op);
+      }
+      return ops;
+   }
+
+   // insert n keys, then n operations of which three in four are erases
+   std::vector<Operation> deleteHeavy(size_t n, int range)
+   {
+      std::vector<Operation> ops;
+      std::vector<int> present = uniform(n, range);
+      for (int key : present)
+         ops.push_back(Operation{ Operation::INSERT, key });
+      for (size_t i = 0; i < n; i++)
+      {
+         Operation op;
+         if (!present.empty() && below(4) != 0)
+         {
+            size_t index = below(present.size());
+            op = Operation{ Operation::ERASE, present[index] };
+            present[index] = present.back();
+            present.pop_back();
+         }
+         else
+         {
+            op = Operation{ Operation::INSERT, (int)below((uint64_t)range) };
+            present.push_back(op.key);
+         }
+         ops.push_back(op);
+      }
+      return ops;
+   }
+
+   //
+   // Adversarial
+   //
+
+   // n distinct inserts, each picked from `candidates` random keys for
+   // how far its case 3 recoloring climbs up the tree
+   std::vector<int> recolorCascades(size_t n, size_t candidates = 32)
+   {
+      return adversarial(n, candidates, false /* preferRotation */);
+   }
+
+   // n distinct inserts, each picked from `candidates` random keys for
+   // ending in a case 4 rotation
+   std::vector<int> rotations(size_t n, size_t candidates = 32)
+   {
+      return adversarial(n, candidates, true /* preferRotation */);
+   }
+
+   // insert n distinct keys, then n times erase whatever is at the root
+   // of a BST and insert a new key. BST::erase does not rebalance, so the
+   // colors drift away from red-black and balance() meets trees it was
+   // never written for.
+   std::vector<Operation> eraseChurn(size_t n)
+   {
+      std::vector<Operation> ops;
+      custom::BST<int> model;
+      int range = (int)(n * 8);
+      for (int key : distinct(n, range, model))
+         ops.push_back(Operation{ Operation::INSERT, key });
+      for (size_t i = 0; i < n && !model.empty(); i++)
+      {
+         custom::BST<int>::iterator it(model.root);
+         ops.push_back(Operation{ Operation::ERASE, *it });
+         model.erase(it);
+         int key = distinct(1, range, model)[0];
+         ops.push_back(Operation{ Operation::INSERT, key });
+      }
+      return ops;
+   }
+
+   // n events around a mid price that moves a tick one time in 16:
+   // half limit orders a geometric number of ticks behind the mid, mean
+   // 4, a third cancels of one of the last 1024 limit orders, which may
+   // have filled since, and the rest orders that take up to 3 ticks
+   // through the mid
+   std::vector<MarketEvent> marketReplay(size_t n, int startPrice = 100000)
+   {
+      std::vector<MarketEvent> events;
+      events.reserve(n);
+      int mid = startPrice;
+      size_t numLimits = 0;
+      for (size_t i = 0; i < n; i++)
+      {
+         if (below(16) == 0)
+            mid += (below(2) == 0 ? 1 : -1);
+         MarketEvent event = {};
+         event.isBid = (below(2) == 0);
+         double u = unit();
+         if (numLimits == 0 || u < 0.5)
+         {
+            int behind = 1;
+            while (behind < 64 && below(4) != 0)
+               behind++;
+            event.type = MarketEvent::LIMIT;
+            event.price = (event.isBid ? mid - behind : mid + behind);
+            event.quantity = 1 + (int)below(100);
+            numLimits++;
+         }
+         else if (u < 0.85)
+         {
+            event.type = MarketEvent::CANCEL;
+            event.order = numLimits - 1 - below(numLimits < 1024 ? numLimits : 1024);
+         }
+         else
+         {
+            event.type = MarketEvent::MARKET;
+            event.price = (event.isBid ? mid + 3 : mid - 3);
+            event.quantity = 1 + (int)below(200);
+         }
+         events.push_back(event);
+      }
+      return events;
+   }
+
+   //
+   // Apply
+   //
+
+   // run a list of operations against any ordered container and return
+   // how many of the erases and finds hit
+   template <class Container>
+   static size_t apply(Container & c, const std::vector<Operation> & ops)
+   {
+      size_t hits = 0;
+      for (const Operation & op : ops)
+      {
+         if (op.type == Operation::INSERT)
+            c.insert(op.key);
+         else
+         {
+            auto it = c.find(op.key);
+            if (it != c.end())
+            {
+               hits++;
+               if (op.type == Operation::ERASE)
+                  c.erase(it);
+            }
+         }
+      }
+      return hits;
+   }
+
+   // what balance() will do if key is inserted into bst, following the
+   // same cases without changing anything
+   static FixUp predictFixUp(const custom::BST<int> & bst, int key)
+   {
+      typedef custom::BST<int>::BNode BNode;
+      FixUp fixUp = { 0, false };
+
+      // find where the new node would hang
+      BNode * pParent = nullptr;
+      for (BNode * p = bst.root; p != nullptr; p = (key < p->data ? p->pLeft : p->pRight))
+         pParent = p;
+
+      // walk up the way balance() would
+      while (pParent != nullptr && pParent->isRed)
+      {
+         BNode * pGranny = pParent->pParent;
+         if (pGranny == nullptr)
+            break;
+         BNode * pAunt = (pGranny->pLeft == pParent) ? pGranny->pRight : pGranny->pLeft;
+         if (pAunt != nullptr && pAunt->isRed)
+         {
+            if (pGranny->isRed)
+               break;
+            fixUp.recolors++;
+            pParent = pGranny->pParent;
+         }
+         else
+         {
+            fixUp.rotates = true;
+            break;
+         }
+      }
+      return fixUp;
+   }
+
+private:
+   // n keys from [0, range) not already in model, inserted into it
+   std::vector<int> distinct(size_t n, int range, custom::BST<int> & model)
+   {
+      std::vector<int> keys;
+      while (keys.size() < n)
+      {
+         int key = (int)below((uint64_t)range);
+         if (model.insert(key, true /* keepUnique */).second)
+            keys.push_back(key);
+      }
+      return keys;
+   }
+
+   // Greedy search for the inserts that make balance() work hardest. The
+   // candidates are random keys plus one just past each end of the tree.
+   // The search keeps rediscovering that growing the tree at one end is
+   // the worst case, but a random key that does as much damage wins the
+   // tie, so the sequence still depends on the seed.
+   std::vector<int> adversarial(size_t n, size_t candidates, bool preferRotation)
+   {
+      typedef custom::BST<int>::BNode BNode;
+      custom::BST<int> model;
+      std::vector<int> keys;
+      int range = (int)(n * 8);
+      keys.reserve(n);
+      while (keys.size() < n)
+      {
+         int best = 0;
+         int bestScore = -1;
+         for (size_t i = 0; i < candidates + 2; i++)
+         {
+            int key;
+            if (i < candidates || model.root == nullptr)
+               key = (int)below((uint64_t)range);
+            else
+            {
+               BNode * p = model.root;
+               while ((i == candidates ? p->pLeft : p->pRight) != nullptr)
+                  p = (i == candidates ? p->pLeft : p->pRight);
+               key = (i == candidates ? p->data - 1 : p->data + 1);
+            }
+            if (model.find(key) != model.end())
+               continue;
+
+            // the goal counts double, the other fix-up work counts once
+            FixUp fixUp = predictFixUp(model, key);
+            int score = preferRotation ?
+                        (fixUp.rotates ? 2 : 0) + fixUp.recolors :
+                        2 * fixUp.recolors + (fixUp.rotates ? 1 : 0);
+            if (score > bestScore)
+            {
+               best = key;
+               bestScore = score;
+            }
+         }
+         if (bestScore >= 0)
+         {
+            model.insert(best);
+            keys.push_back(best);
+         }
+      }
+      return keys;
+   }
+
+   // uniform in [0, bound), rejecting the values that would bias it
+   uint64_t below(uint64_t bound)
+   {
+      uint64_t limit = UINT64_MAX - UINT64_MAX % bound;
+      uint64_t value;
+      do
+         value = engine();
+      while (value >= limit);
+      return value % bound;
+   }
+
+   // log2(x) for x >= 1, with 32 bits after the binary point
+   static uint64_t log2Fixed(uint64_t x)
+   {
+      uint64_t whole = 0;
+      while ((x >> whole) > 1)
+         whole++;
+
+      // x / 2^whole in [1, 2) with 31 bits after the point, squared once
+      // per bit of the fraction: each time it reaches 2 that bit is a 1
+      uint64_t y = (whole > 31 ? x >> (whole - 31) : x << (31 - whole));
+      uint64_t fraction = 0;
+      for (int bit = 31; bit >= 0; bit--)
+      {
+         y = (y * y) >> 31;
+         if (y >= ((uint64_t)2 << 31))
+         {
+            y >>= 1;
+            fraction |= (uint64_t)1 << bit;
+         }
+      }
+      return (whole << 32) | fraction;
+   }
+
+   // 2^-e for e with 32 bits after the binary point, as a fraction with
+   // 31 bits. The fraction of e is taken a bit at a time, each 1 bit
+   // multiplying in its factor from roots().
+   static uint64_t exp2NegativeFixed(uint64_t e)
+   {
+      const std::vector<uint64_t> & factors = roots();
+      uint64_t result = (uint64_t)1 << 31;
+      for (int bit = 31; bit >= 0; bit--)
+         if (e & ((uint64_t)1 << bit))
+            result = (result * factors[31 - bit]) >> 31;
+      uint64_t whole = e >> 32;
+      return (whole > 31 ? 0 : result >> whole);
+   }
+
+   // 2^-(1/2), 2^-(1/4), ... 2^-(1/2^32) as fractions with 31 bits, each
+   // the square root of the one before, so all of them are exact integer
+   // arithmetic
+   static const std::vector<uint64_t> & roots()
+   {
+      static const std::vector<uint64_t> factors = []()
+      {
+         std::vector<uint64_t> factors;
+         uint64_t factor = (uint64_t)1 << 30;
+         for (int i = 0; i < 32; i++)
+         {
+            factor = isqrt(factor << 31);
+            factors.push_back(factor);
+         }
+         return factors;
+      }();
+      return factors;
+   }
+
+   // the largest r with r * r <= x
+   static uint64_t isqrt(uint64_t x)
+   {
+      uint64_t root = 0;
+      for (uint64_t bit = (uint64_t)1 << 62; bit != 0; bit >>= 2)
+      {
+         if (x >= root + bit)
+         {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+         }
+         else
+            root >>= 1;
+      }
+      return root;
+   }
+
+   // uniform in [0, 1) with 53 bits of precision
+   double unit()
+   {
+      return (double)(engine() >> 11) * (1.0 / 9007199254740992.0);
+   }
+
+   std::mt19937_64 engine;   // fully specified by the standard, unlike the distributions
+};
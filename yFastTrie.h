@@ -0,0 +1,632 @@
+/***********************************************************************
+ * Header:
+ *    Y-FAST TRIE
+ * Summary:
+ *    An ordered container for integer keys whose predecessor queries
+ *    cost O(log log U) for a universe of U = 2^W keys rather than the
+ *    O(log n) of a comparison tree. The keys are cut into buckets of
+ *    between W / 4 and 2W consecutive keys, each bucket a small BST, so
+ *    the red-black core does the work inside a bucket in O(log W).
+ *
+ *    Each bucket has a representative, the least key it may hold, and
+ *    covers the keys from there up to the next representative. The
+ *    representatives live in an x-fast trie: the binary trie of their
+ *    bits, stored as a hash table from every prefix of every one of them
+ *    to the least and greatest representative below it. Finding the
+ *    bucket a key falls in is a binary search over the W + 1 prefix
+ *    lengths for the longest one some representative shares, which is
+ *    O(log W) hash probes, then one step to a neighbour in the sorted
+ *    list of buckets.
+ *
+ *    A bucket that outgrows 2W keys splits at its middle key and one that
+ *    falls under W / 4 merges with its neighbour, so only one in every
+ *    O(W) inserts or erases touches the trie, whose updates are O(W).
+ *    Equal keys always share a bucket, so a key repeated more than 2W
+ *    times makes a bucket that cannot split and grows past 2W.
+ *    The first bucket's representative is the least key there can be, so
+ *    every key has a bucket.
+ *
+ *    T is any integer type. Signed keys have their sign bit flipped so
+ *    that they order the same way as the bits do. It satisfies the same
+ *    interface as BST (see orderedContainer.h).
+ *
+ *    This will contain the class definition of:
+ *        YFastTrie           : Buckets of BSTs under an x-fast trie
+ *        YFastTrie::iterator : An iterator through YFastTrie
+ * Author
+ *    Ryan Madsen
+ ************************************************************************/
+
+#pragma once
+
+#include "bst.h"
+
+#include <cstddef>      // for size_t
+#include <cstdint>      // for uint64_t
+#include <type_traits>  // for std::make_unsigned and std::is_signed
+#include <utility>      // for std::pair
+#include <vector>
+
+class TestOrderedContainer;
+
+namespace custom
+{
+
+/*****************************************************************
+ * Y-FAST TRIE
+ * Integer keys in BST buckets, found through their representatives
+ *****************************************************************/
+template <typename T>
+class YFastTrie
+{
+   static_assert(std::is_integral<T>::value, "YFastTrie keys must be integers");
+   friend class ::TestOrderedContainer;
+
+   typedef typename std::make_unsigned<T>::type Bits;
+   struct Bucket;
+   class PrefixTable;
+public:
+   static const int WIDTH = (int)sizeof(T) * 8;          // W, bits in a key
+   static const size_t BUCKET_MAX = 2 * WIDTH;           // a bigger bucket splits
+   static const size_t BUCKET_MIN = WIDTH / 4;           // a smaller one merges
+
+   //
+   // Construct
+   //
+
+   YFastTrie() : pFirst(nullptr), numElements(0) {}
+   YFastTrie(const YFastTrie &  rhs) : pFirst(nullptr), numElements(0) { *this = rhs; }
+   YFastTrie(      YFastTrie && rhs) : pFirst(nullptr), numElements(0) { swap(rhs); }
+   ~YFastTrie() { clear(); }
+
+   //
+   // Assign
+   //
+
+   YFastTrie & operator = (const YFastTrie & rhs);
+   YFastTrie & operator = (YFastTrie && rhs)
+   {
+      clear();
+      swap(rhs);
+      return *this;
+   }
+   void swap(YFastTrie & rhs)
+   {
+      std::swap(pFirst, rhs.pFirst);
+      std::swap(numElements, rhs.numElements);
+      prefixes.swap(rhs.prefixes);
+   }
+
+   //
+   // Iterator
+   //
+
+   class iterator;
+   iterator begin() const noexcept { return firstFrom(pFirst); }
+   iterator end()   const noexcept { return iterator(); }
+
+   //
+   // Access
+   //
+
+   iterator find(const T & t);
+   iterator lower_bound(const T & t) const;
+   iterator upper_bound(const T & t) const;
+
+   //
+   // Insert
+   //
+
+   std::pair<iterator, bool> insert(const T & t, bool keepUnique = false);
+
+   //
+   // Remove
+   //
+
+   iterator erase(iterator & it);
+   void clear() noexcept;
+
+   //
+   // Status
+   //
+
+   bool   empty() const noexcept { return numElements == 0; }
+   size_t size()  const noexcept { return numElements;      }
+
+private:
+   // the first key in pBucket or a bucket after it
+   static iterator firstFrom(Bucket * pBucket);
+
+   // the key's bits, ordered the way the keys are
+   static Bits bitsOf(const T & t)
+   {
+      return (Bits)t ^ (std::is_signed<T>::value ? (Bits)((Bits)1 << (WIDTH - 1)) : (Bits)0);
+   }
+
+   // the first level bits of bits; level 0 is the root of the trie
+   static Bits prefixOf(Bits bits, int level)
+   {
+      return level == 0 ? (Bits)0 : (Bits)(bits >> (WIDTH - level));
+   }
+
+   Bucket * bucketOf(Bits bits) const;
+   void addRep(Bucket * pBucket);
+   void removeRep(Bucket * pBucket);
+   iterator redistribute(Bucket * pLeft, Bucket * pRight, iterator watch);
+
+   Bucket * pFirst;            // the bucket of the least keys, whose rep is 0
+   size_t numElements;         // keys in all the buckets
+   PrefixTable prefixes;       // the x-fast trie over the reps
+};
+
+/*****************************************************************
+ * Y-FAST TRIE BUCKET
+ * The keys from rep up to the next bucket's rep, in a list of the
+ * buckets in order
+ *****************************************************************/
+template <typename T>
+struct YFastTrie <T> :: Bucket
+{
+   explicit Bucket(Bits rep) : rep(rep), pPrev(nullptr), pNext(nullptr) {}
+
+   Bits rep;                   // the least key this bucket may hold
+   BST<T> keys;
+   Bucket * pPrev;
+   Bucket * pNext;
+};
+
+/*****************************************************************
+ * Y-FAST TRIE PREFIX TABLE
+ * Every prefix of every rep, with the least and greatest rep that
+ * starts with it. Open addressing with linear probing, kept at most
+ * half full, and deletion shifts the probe run back rather than
+ * leaving tombstones.
+ *****************************************************************/
+template <typename T>
+class YFastTrie <T> :: PrefixTable
+{
+public:
+   struct Slot
+   {
+      Bits prefix;
+      int level;               // -1 when the slot is empty
+      Bucket * pMin;           // the least rep with this prefix
+      Bucket * pMax;           // the greatest
+   };
+
+   static const size_t FIRST_CAPACITY = 64;
+
+   PrefixTable() : numUsed(0) {}
+
+   // the slot of this prefix, or nullptr
+   const Slot * find(int level, Bits prefix) const
+   {
+      if (slots.empty())
+         return nullptr;
+      size_t mask = slots.size() - 1;
+      for (size_t i = hash(level, prefix) & mask; slots[i].level >= 0; i = (i + 1) & mask)
+         if (slots[i].level == level && slots[i].prefix == prefix)
+            return &slots[i];
+      return nullptr;
+   }
+   Slot * find(int level, Bits prefix)
+   {
+      return const_cast<Slot *>(static_cast<const PrefixTable *>(this)->find(level, prefix));
+   }
+
+   // the slot of this prefix, made empty-handed if it is not there
+   Slot & insert(int level, Bits prefix)
+   {
+      if ((numUsed + 1) * 2 > slots.size())
+         grow();
+      size_t mask = slots.size() - 1;
+      size_t i = hash(level, prefix) & mask;
+      for (; slots[i].level >= 0; i = (i + 1) & mask)
+         if (slots[i].level == level && slots[i].prefix == prefix)
+            return slots[i];
+      slots[i] = Slot{ prefix, level, nullptr, nullptr };
+      numUsed++;
+      return slots[i];
+   }
+
+   // empty pSlot, moving back whatever probed past it
+   void erase(Slot * pSlot)
+   {
+      size_t mask = slots.size() - 1;
+      size_t hole = (size_t)(pSlot - slots.data());
+      for (size_t i = (hole + 1) & mask; slots[i].level >= 0; i = (i + 1) & mask)
+      {
+         // the entry at i may fill the hole if its home is not in (hole, i]
+         size_t home = hash(slots[i].level, slots[i].prefix) & mask;
+         if (((i - home) & mask) >= ((i - hole) & mask))
+         {
+            slots[hole] = slots[i];
+            hole = i;
+         }
+      }
+      slots[hole].level = -1;
+      numUsed--;
+   }
+
+   void clear()
+   {
+      slots.clear();
+      numUsed = 0;
+   }
+
+   void swap(PrefixTable & rhs)
+   {
+      slots.swap(rhs.slots);
+      std::swap(numUsed, rhs.numUsed);
+   }
+
+   size_t size() const { return numUsed; }
+
+private:
+   static size_t hash(int level, Bits prefix)
+   {
+      uint64_t h = (uint64_t)prefix * 0x9E3779B97F4A7C15ull ^ (uint64_t)level * 0xC2B2AE3D27D4EB4Full;
+      h ^= h >> 32;
+      return (size_t)h;
+   }
+
+   void grow()
+   {
+      std::vector<Slot> old;
+      old.swap(slots);
+      slots.assign(old.empty() ? FIRST_CAPACITY : old.size() * 2, Slot{ 0, -1, nullptr, nullptr });
+      numUsed = 0;
+      for (const Slot & slot : old)
+         if (slot.level >= 0)
+            insert(slot.level, slot.prefix) = slot;
+   }
+
+   std::vector<Slot> slots;    // a power of two of them
+   size_t numUsed;             // slots holding a prefix
+};
+
+/**********************************************************
+ * Y-FAST TRIE ITERATOR
+ * A bucket and a place in its BST
+ *********************************************************/
+template <typename T>
+class YFastTrie <T> :: iterator
+{
+   friend class YFastTrie <T>;
+   friend class ::TestOrderedContainer;
+public:
+   iterator() : pBucket(nullptr), it() {}
+   iterator(Bucket * pBucket, const typename BST<T>::iterator & it) : pBucket(pBucket), it(it) {}
+
+   bool operator == (const iterator & rhs) const
+   {
+      return pBucket == rhs.pBucket && it == rhs.it;
+   }
+   bool operator != (const iterator & rhs) const { return !(*this == rhs); }
+
+   // de-reference. Cannot change because it will invalidate the trie
+   const T & operator * () const { return *it; }
+
+   // on through this bucket, then to the first key of the next
+   iterator & operator ++ ()
+   {
+      if (pBucket == nullptr)
+         return *this;
+      ++it;
+      if (it == pBucket->keys.end())
+         *this = firstFrom(pBucket->pNext);
+      return *this;
+   }
+
+private:
+   Bucket * pBucket;                   // nullptr at the end
+   typename BST<T>::iterator it;       // the key within the bucket
+};
+
+/*********************************************
+ * Y-FAST TRIE :: ASSIGNMENT OPERATOR
+ * Elements arrive in order, so each one lands in the last bucket
+ ********************************************/
+template <typename T>
+YFastTrie <T> & YFastTrie <T> :: operator = (const YFastTrie <T> & rhs)
+{
+   if (this == &rhs)
+      return *this;
+   clear();
+   for (auto it = rhs.begin(); it != rhs.end(); ++it)
+      insert(*it);
+   return *this;
+}
+
+/*********************************************
+ * Y-FAST TRIE :: FIRST FROM
+ * Only the first bucket can be empty, and then it is the only one
+ ********************************************/
+template <typename T>
+typename YFastTrie <T> :: iterator YFastTrie <T> :: firstFrom(Bucket * pBucket)
+{
+   while (pBucket != nullptr && pBucket->keys.empty())
+      pBucket = pBucket->pNext;
+   return pBucket == nullptr ? iterator() : iterator(pBucket, pBucket->keys.begin());
+}
+
+/*********************************************
+ * Y-FAST TRIE :: BUCKET OF
+ * The bucket with the greatest rep not greater than bits. Prefixes
+ * in the trie are closed under shortening, so the levels with a match
+ * are 0 up to some length, found by binary search. Below that node the
+ * trie only goes the other way from bits: if bits turns right there,
+ * every rep below is smaller and the greatest is the answer; if it
+ * turns left, every rep below is larger and the answer is the bucket
+ * before the least of them.
+ ********************************************/
+template <typename T>
+typename YFastTrie <T> :: Bucket * YFastTrie <T> :: bucketOf(Bits bits) const
+{
+   const typename PrefixTable::Slot * pMatch = prefixes.find(0, 0);
+   int lo = 0;
+   int hi = WIDTH;
+   while (lo < hi)
+   {
+      int mid = (lo + hi + 1) / 2;
+      const typename PrefixTable::Slot * pSlot = prefixes.find(mid, prefixOf(bits, mid));
+      if (pSlot != nullptr)
+      {
+         lo = mid;
+         pMatch = pSlot;
+      }
+      else
+         hi = mid - 1;
+   }
+
+   if (lo == WIDTH)
+      return pMatch->pMin;
+   if ((bits >> (WIDTH - lo - 1)) & 1)
+      return pMatch->pMax;
+   return pMatch->pMin->pPrev;
+}
+
+/*********************************************
+ * Y-FAST TRIE :: ADD REP
+ * Put a bucket's rep into the trie. The bucket is already linked
+ * into the list.
+ ********************************************/
+template <typename T>
+void YFastTrie <T> :: addRep(Bucket * pBucket)
+{
+   for (int level = 0; level <= WIDTH; level++)
+   {
+      typename PrefixTable::Slot & slot = prefixes.insert(level, prefixOf(pBucket->rep, level));
+      if (slot.pMin == nullptr || pBucket->rep < slot.pMin->rep)
+         slot.pMin = pBucket;
+      if (slot.pMax == nullptr || slot.pMax->rep < pBucket->rep)
+         slot.pMax = pBucket;
+   }
+}
+
+/*********************************************
+ * Y-FAST TRIE :: REMOVE REP
+ * Take a bucket's rep out of the trie while it is still linked in.
+ * The reps under a prefix are consecutive, so the new least or
+ * greatest is the bucket's neighbour.
+ ********************************************/
+template <typename T>
+void YFastTrie <T> :: removeRep(Bucket * pBucket)
+{
+   for (int level = 0; level <= WIDTH; level++)
+   {
+      typename PrefixTable::Slot * pSlot = prefixes.find(level, prefixOf(pBucket->rep, level));
+      if (pSlot->pMin == pBucket && pSlot->pMax == pBucket)
+         prefixes.erase(pSlot);
+      else if (pSlot->pMin == pBucket)
+         pSlot->pMin = pBucket->pNext;
+      else if (pSlot->pMax == pBucket)
+         pSlot->pMax = pBucket->pPrev;
+   }
+}
+
+/*********************************************
+ * Y-FAST TRIE :: REDISTRIBUTE
+ * Share the keys of pLeft and the bucket after it, pRight, which is
+ * nullptr when pLeft is splitting on its own. If there are too many
+ * for one bucket they are cut at the middle, or at the nearest change
+ * of key so that equal keys stay together, and the second half goes to
+ * pRight under a new rep; otherwise pRight goes. Both BSTs are built
+ * again in order, so they come out balanced. Returns where the key at
+ * watch ended up.
+ ********************************************/
+template <typename T>
+typename YFastTrie <T> :: iterator YFastTrie <T> :: redistribute(Bucket * pLeft, Bucket * pRight, iterator watch)
+{
+   std::vector<T> values;
+   size_t iWatch = (size_t)-1;
+   values.reserve(pLeft->keys.size() + (pRight == nullptr ? 0 : pRight->keys.size()));
+   for (Bucket * pBucket : { pLeft, pRight })
+      if (pBucket != nullptr)
+         for (auto it = pBucket->keys.begin(); it != pBucket->keys.end(); ++it)
+         {
+            if (watch.pBucket == pBucket && &*watch.it == &*it)
+               iWatch = values.size();
+            values.push_back(*it);
+         }
+
+   size_t split = values.size();
+   if (values.size() > BUCKET_MAX)
+   {
+      split = values.size() / 2;
+      while (split > 0 && !(values[split - 1] < values[split]))
+         split--;
+      if (split == 0)
+      {
+         split = values.size() / 2;
+         while (split < values.size() && !(values[split - 1] < values[split]))
+            split++;
+      }
+   }
+
+   // one bucket of equal keys has nowhere to split, so leave it be
+   if (split == values.size() && pRight == nullptr)
+      return watch;
+
+   if (split < values.size())
+   {
+      Bits rep = bitsOf(values[split]);
+      if (pRight == nullptr)
+      {
+         pRight = new Bucket(rep);
+         pRight->pPrev = pLeft;
+         pRight->pNext = pLeft->pNext;
+         if (pLeft->pNext != nullptr)
+            pLeft->pNext->pPrev = pRight;
+         pLeft->pNext = pRight;
+         addRep(pRight);
+      }
+      else if (pRight->rep != rep)
+      {
+         removeRep(pRight);
+         pRight->rep = rep;
+         addRep(pRight);
+      }
+   }
+   else if (pRight != nullptr)
+   {
+      removeRep(pRight);
+      pLeft->pNext = pRight->pNext;
+      if (pRight->pNext != nullptr)
+         pRight->pNext->pPrev = pLeft;
+      delete pRight;
+      pRight = nullptr;
+   }
+
+   iterator result = watch;
+   pLeft->keys.clear();
+   if (pRight != nullptr)
+      pRight->keys.clear();
+   for (size_t i = 0; i < values.size(); i++)
+   {
+      Bucket * pBucket = (i < split ? pLeft : pRight);
+      auto it = pBucket->keys.insert(values[i]).first;
+      if (i == iWatch)
+         result = iterator(pBucket, it);
+   }
+   return result;
+}
+
+/*********************************************
+ * Y-FAST TRIE :: FIND
+ * Return the first element equal to t
+ ********************************************/
+template <typename T>
+typename YFastTrie <T> :: iterator YFastTrie <T> :: find(const T & t)
+{
+   if (pFirst == nullptr)
+      return end();
+   Bucket * pBucket = bucketOf(bitsOf(t));
+   auto it = pBucket->keys.find(t);
+   return it == pBucket->keys.end() ? end() : iterator(pBucket, it);
+}
+
+/*********************************************
+ * Y-FAST TRIE :: LOWER BOUND
+ * Return the first element that is not less than t: in t's bucket,
+ * or else the first of the next one
+ ********************************************/
+template <typename T>
+typename YFastTrie <T> :: iterator YFastTrie <T> :: lower_bound(const T & t) const
+{
+   if (pFirst == nullptr)
+      return end();
+   Bucket * pBucket = bucketOf(bitsOf(t));
+   auto it = pBucket->keys.lower_bound(t);
+   return it == pBucket->keys.end() ? firstFrom(pBucket->pNext) : iterator(pBucket, it);
+}
+
+/*********************************************
+ * Y-FAST TRIE :: UPPER BOUND
+ * Return the first element that is greater than t
+ ********************************************/
+template <typename T>
+typename YFastTrie <T> :: iterator YFastTrie <T> :: upper_bound(const T & t) const
+{
+   if (pFirst == nullptr)
+      return end();
+   Bucket * pBucket = bucketOf(bitsOf(t));
+   auto it = pBucket->keys.upper_bound(t);
+   return it == pBucket->keys.end() ? firstFrom(pBucket->pNext) : iterator(pBucket, it);
+}
+
+/*********************************************
+ * Y-FAST TRIE :: INSERT
+ * Into t's bucket, splitting it if that makes it too big
+ ********************************************/
+template <typename T>
+std::pair<typename YFastTrie <T> :: iterator, bool> YFastTrie <T> :: insert(const T & t, bool keepUnique)
+{
+   if (pFirst == nullptr)
+   {
+      pFirst = new Bucket(0);
+      addRep(pFirst);
+   }
+
+   Bucket * pBucket = bucketOf(bitsOf(t));
+   if (keepUnique)
+   {
+      auto itFound = pBucket->keys.find(t);
+      if (itFound != pBucket->keys.end())
+         return std::make_pair(iterator(pBucket, itFound), false);
+   }
+
+   iterator it(pBucket, pBucket->keys.insert(t).first);
+   numElements++;
+   // a bucket of nothing but t has nowhere to split
+   if (pBucket->keys.size() > BUCKET_MAX &&
+       (*pBucket->keys.begin() < t || pBucket->keys.upper_bound(t) != pBucket->keys.end()))
+      it = redistribute(pBucket, nullptr, it);
+   return std::make_pair(it, true);
+}
+
+/*********************************************
+ * Y-FAST TRIE :: ERASE
+ * Out of its bucket, merging the bucket with the one after it, or
+ * before it if it is the last, when it gets too small
+ ********************************************/
+template <typename T>
+typename YFastTrie <T> :: iterator YFastTrie <T> :: erase(iterator & it)
+{
+   if (it.pBucket == nullptr)
+      return end();
+
+   Bucket * pBucket = it.pBucket;
+   iterator itNext(pBucket, pBucket->keys.erase(it.it));
+   if (itNext.it == pBucket->keys.end())
+      itNext = firstFrom(pBucket->pNext);
+   numElements--;
+   it = end();
+
+   if (pBucket->keys.size() < BUCKET_MIN)
+   {
+      if (pBucket->pNext != nullptr)
+         itNext = redistribute(pBucket, pBucket->pNext, itNext);
+      else if (pBucket->pPrev != nullptr)
+         itNext = redistribute(pBucket->pPrev, pBucket, itNext);
+   }
+   return itNext;
+}
+
+/*********************************************
+ * Y-FAST TRIE :: CLEAR
+ ********************************************/
+template <typename T>
+void YFastTrie <T> :: clear() noexcept
+{
+   while (pFirst != nullptr)
+   {
+      Bucket * pNext = pFirst->pNext;
+      delete pFirst;
+      pFirst = pNext;
+   }
+   prefixes.clear();
+   numElements = 0;
+}
+
+} // namespace custom